@@ -16,7 +16,9 @@
 // License: GNU GPL v2.0
 //========================================================================
 
+#include <common/pcm_stream_out.h>
 #include <common/synth_config.h>
+#include <common/wave_export_manager.h>
 #include <common/wave_file.h>
 #include <envelope/envelope.h>
 #include <global/global_variables.h>
@@ -27,7 +29,12 @@ using namespace std;
 //========================================================================
 // MAIN
 //========================================================================
-int main() {
+// Usage: adsr_envelope_note [--raw] [OUTPUT]
+//   With OUTPUT the sounds are streamed back to back to one file ("-"
+//   for stdout) as they are generated, instead of being saved to
+//   separate files. "--raw" drops the WAVE header. For example:
+//     adsr_envelope_note - | aplay
+int main(int argc, char *argv[]) {
   // Param 1: Pitch
   vector<size_t> pitch = {20, 40, 60, 80, 100};
   // Param 2: Volume
@@ -70,8 +77,15 @@ int main() {
   //       with this restrictions modifying the end_amplitude_decay
   //       is equivalent to setting the sustain segment level.
   // Initialise the synthesiser
-  SynthConfig &synthesiser = SynthConfig::getInstance();
-  synthesiser.Init();
+  const SynthConfig synthesiser(kCdSampleRate);
+
+  // Optionally stream the sounds (see above)
+  bool raw = (argc > 1) && (string(argv[1]) == "--raw");
+  PcmStreamOut stream(raw ? PcmStreamFraming::kRaw : PcmStreamFraming::kWave);
+  if ((argc > 1 + raw) && !stream.Open(string(argv[1 + raw]))) return 1;
+  // Otherwise the files are written in the background, while the next
+  // sounds are being rendered
+  WaveExportManager exporter;
 
   for (auto it : pitch) {
     // 1. Generate filename
@@ -119,9 +133,21 @@ int main() {
     // 7.  Apply the envelope
     envelope.ApplyEnvelope(samples);
 
-    // 8. Save the samples to the file
-    WaveFileOut wf_out(duration);
-    wf_out.SaveBufferToFile(file_name, samples);
+    // 8. Save the samples to the file (or stream them)
+    if (stream.IsOpen()) {
+      if (!stream.Append(samples)) return 1;
+    } else {
+      exporter.Submit(file_name, std::move(samples));
+    }
+  }
+
+  // Wait for the files to be written and report the throughput
+  if (!stream.IsOpen()) {
+    bool success = exporter.Finish();
+    cout << "Exported " << exporter.metrics().number_of_files << " files: "
+         << exporter.files_per_second() << " files/s, "
+         << exporter.bytes_per_second() / (1 << 20) << " MB/s\n";
+    if (!success) return 1;
   }
 
   return 0;
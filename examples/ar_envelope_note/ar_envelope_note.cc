@@ -15,6 +15,7 @@
 // License: GNU GPL v2.0
 //========================================================================
 
+#include <common/pcm_stream_out.h>
 #include <common/synth_config.h>
 #include <common/wave_file.h>
 #include <envelope/envelope.h>
@@ -26,7 +27,12 @@ using namespace std;
 //========================================================================
 // MAIN
 //========================================================================
-int main() {
+// Usage: ar_envelope_note [--raw] [OUTPUT]
+//   With OUTPUT the sounds are streamed back to back to one file ("-"
+//   for stdout) as they are generated, instead of being saved to
+//   separate files. "--raw" drops the WAVE header. For example:
+//     ar_envelope_note - | aplay
+int main(int argc, char *argv[]) {
   // Param 1: Pitch
   vector<size_t> pitch = {20, 40, 60, 80, 100};
   // Param 2: Volume
@@ -46,8 +52,12 @@ int main() {
   char file_name[200];
 
   // Initialise the synthesiser
-  SynthConfig &synthesiser = SynthConfig::getInstance();
-  synthesiser.Init();
+  const SynthConfig synthesiser(kCdSampleRate);
+
+  // Optionally stream the sounds (see above)
+  bool raw = (argc > 1) && (string(argv[1]) == "--raw");
+  PcmStreamOut stream(raw ? PcmStreamFraming::kRaw : PcmStreamFraming::kWave);
+  if ((argc > 1 + raw) && !stream.Open(string(argv[1 + raw]))) return 1;
 
   // Initialise the envelope
   ArEnvelope envelope(synthesiser, peak_amplitude, attack_duration,
@@ -65,9 +75,13 @@ int main() {
     vector<int16_t> samples_out = osc(duration);
     envelope.ApplyEnvelope(samples_out);
 
-    // 3. Save the samples to the file
-    WaveFileOut wf_out(duration);
-    wf_out.SaveBufferToFile(file_name, samples_out);
+    // 3. Save the samples to the file (or stream them)
+    if (stream.IsOpen()) {
+      if (!stream.Append(samples_out)) return 1;
+    } else {
+      WaveFileOut wf_out(duration);
+      if (!wf_out.SaveBufferToFile(file_name, samples_out)) return 1;
+    }
   }
 
   return 0;
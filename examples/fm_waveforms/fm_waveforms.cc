@@ -16,7 +16,9 @@
 // License: GNU GPL v2.0
 //========================================================================
 
+#include <common/pcm_stream_out.h>
 #include <common/synth_config.h>
+#include <common/wave_export_manager.h>
 #include <common/wave_file.h>
 #include <fm_synthesiser/fm_synthesiser.h>
 #include <global/global_variables.h>
@@ -26,7 +28,12 @@ using namespace std;
 //========================================================================
 // MAIN
 //========================================================================
-int main() {
+// Usage: fm_waveforms [--raw] [OUTPUT]
+//   With OUTPUT the sounds are streamed back to back to one file ("-"
+//   for stdout) as they are generated, instead of being saved to
+//   separate files. "--raw" drops the WAVE header. For example:
+//     fm_waveforms - | aplay
+int main(int argc, char *argv[]) {
   // Param 1: Carrier's Pitch
   size_t pitch_carrier = 64;
   // Param 2: Modulator's Pitch
@@ -45,8 +52,15 @@ int main() {
   char file_name[200];
 
   // Initialise the synthesiser
-  SynthConfig &synthesiser = SynthConfig::getInstance();
-  synthesiser.Init();
+  const SynthConfig synthesiser(kCdSampleRate);
+
+  // Optionally stream the sounds (see above)
+  bool raw = (argc > 1) && (string(argv[1]) == "--raw");
+  PcmStreamOut stream(raw ? PcmStreamFraming::kRaw : PcmStreamFraming::kWave);
+  if ((argc > 1 + raw) && !stream.Open(string(argv[1 + raw]))) return 1;
+  // Otherwise the files are written in the background, while the next
+  // sounds are being rendered
+  WaveExportManager exporter;
 
   for (auto it : pitch_modulator) {
     for (auto it2 : index_of_modulation) {
@@ -61,11 +75,23 @@ int main() {
                                    pitch_carrier, it, it2);
       vector<int16_t> samples_output = fm_synthesiser(duration);
 
-      // 3. Save the samples to the file
-      WaveFileOut wf_out_sine(duration);
-      wf_out_sine.SaveBufferToFile(file_name, samples_output);
+      // 3. Save the samples to the file (or stream them)
+      if (stream.IsOpen()) {
+        if (!stream.Append(samples_output)) return 1;
+      } else {
+        exporter.Submit(file_name, std::move(samples_output));
+      }
     }
   }
 
+  // Wait for the files to be written and report the throughput
+  if (!stream.IsOpen()) {
+    bool success = exporter.Finish();
+    cout << "Exported " << exporter.metrics().number_of_files << " files: "
+         << exporter.files_per_second() << " files/s, "
+         << exporter.bytes_per_second() / (1 << 20) << " MB/s\n";
+    if (!success) return 1;
+  }
+
   return 0;
 }
@@ -16,7 +16,9 @@
 // License: GNU GPL v2.0
 //========================================================================
 
+#include <common/pcm_stream_out.h>
 #include <common/synth_config.h>
+#include <common/wave_export_manager.h>
 #include <common/wave_file.h>
 #include <global/global_variables.h>
 #include <oscillator/oscillator.h>
@@ -26,7 +28,12 @@ using namespace std;
 //========================================================================
 // MAIN
 //========================================================================
-int main() {
+// Usage: waveforms [--raw] [OUTPUT]
+//   With OUTPUT the sounds are streamed back to back to one file ("-"
+//   for stdout) as they are generated, instead of being saved to
+//   separate files. "--raw" drops the WAVE header. For example:
+//     waveforms - | aplay
+int main(int argc, char *argv[]) {
   // Param 1: Pitch
   vector<size_t> pitch = {45};
   // Param 2: Volume
@@ -40,8 +47,15 @@ int main() {
   char file_name[200];
 
   // Initialise the synthesiser
-  SynthConfig &synthesiser = SynthConfig::getInstance();
-  synthesiser.Init();
+  const SynthConfig synthesiser(kCdSampleRate);
+
+  // Optionally stream the sounds (see above)
+  bool raw = (argc > 1) && (string(argv[1]) == "--raw");
+  PcmStreamOut stream(raw ? PcmStreamFraming::kRaw : PcmStreamFraming::kWave);
+  if ((argc > 1 + raw) && !stream.Open(string(argv[1 + raw]))) return 1;
+  // Otherwise the files are written in the background, while the next
+  // sounds are being rendered
+  WaveExportManager exporter;
 
   for (auto it = pitch.begin(); it != pitch.end(); it++) {
     //----------------------------------------------------------------
@@ -54,9 +68,12 @@ int main() {
     SineWaveform osc_sine(synthesiser, volume, initial_phase, *it);
     vector<int16_t> samples_out_sine = osc_sine(duration);
 
-    // 3. Save the samples to the file
-    WaveFileOut wf_out_sine(duration);
-    wf_out_sine.SaveBufferToFile(file_name, samples_out_sine);
+    // 3. Save the samples to the file (or stream them)
+    if (stream.IsOpen()) {
+      if (!stream.Append(samples_out_sine)) return 1;
+    } else {
+      exporter.Submit(file_name, std::move(samples_out_sine));
+    }
 
     //----------------------------------------------------------------
     // Sawtooth
@@ -68,9 +85,12 @@ int main() {
     SawtoothWaveform osc_sawtooth(synthesiser, volume, initial_phase, *it);
     vector<int16_t> samples_out_sawtooth = osc_sawtooth(duration);
 
-    // 3. Save the samples to the file
-    WaveFileOut wf_out_sawtooth(duration);
-    wf_out_sawtooth.SaveBufferToFile(file_name, samples_out_sawtooth);
+    // 3. Save the samples to the file (or stream them)
+    if (stream.IsOpen()) {
+      if (!stream.Append(samples_out_sawtooth)) return 1;
+    } else {
+      exporter.Submit(file_name, std::move(samples_out_sawtooth));
+    }
 
     //----------------------------------------------------------------
     // Square wave
@@ -82,9 +102,12 @@ int main() {
     SquareWaveform osc_square(synthesiser, volume, initial_phase, *it);
     vector<int16_t> samples_out_square = osc_square(duration);
 
-    // 3. Save the samples to the file
-    WaveFileOut wf_out_square(duration);
-    wf_out_square.SaveBufferToFile(file_name, samples_out_square);
+    // 3. Save the samples to the file (or stream them)
+    if (stream.IsOpen()) {
+      if (!stream.Append(samples_out_square)) return 1;
+    } else {
+      exporter.Submit(file_name, std::move(samples_out_square));
+    }
 
     //----------------------------------------------------------------
     // Triangle wave
@@ -96,9 +119,21 @@ int main() {
     TriangleWaveform osc_triangle(synthesiser, volume, initial_phase, *it);
     vector<int16_t> samples_out_triangle = osc_triangle(duration);
 
-    // 3. Save the samples to the file
-    WaveFileOut wf_out_triangle(duration);
-    wf_out_triangle.SaveBufferToFile(file_name, samples_out_triangle);
+    // 3. Save the samples to the file (or stream them)
+    if (stream.IsOpen()) {
+      if (!stream.Append(samples_out_triangle)) return 1;
+    } else {
+      exporter.Submit(file_name, std::move(samples_out_triangle));
+    }
+  }
+
+  // Wait for the files to be written and report the throughput
+  if (!stream.IsOpen()) {
+    bool success = exporter.Finish();
+    cout << "Exported " << exporter.metrics().number_of_files << " files: "
+         << exporter.files_per_second() << " files/s, "
+         << exporter.bytes_per_second() / (1 << 20) << " MB/s\n";
+    if (!success) return 1;
   }
 
   return 0;
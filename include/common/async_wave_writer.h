@@ -0,0 +1,206 @@
+//=============================================================
+//  FILE:
+//    include/common/async_wave_writer.h
+//
+//  AUTHOR:
+//    zimzum@github
+//
+//  DESCRIPTION:
+//      The definition of the AsyncWaveWriter class - writes WAVE
+//      files on a dedicated I/O thread.
+//
+//  License: GNU GPL v2.0
+//=============================================================
+
+#ifndef ASYNC_WAVE_WRITER_H
+#define ASYNC_WAVE_WRITER_H
+
+#include <common/spsc_queue.h>
+#include <common/wave_file.h>
+#include <global/global_include.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+//=============================================================
+// STRUCT: AsyncWaveWriterMetrics
+//
+// DESCRIPTION:
+//  Statistics gathered by AsyncWaveWriter since the file was opened.
+//  A stall is a call to AcquireBlock() that had to wait for the I/O
+//  thread to recycle a block, i.e. the disk couldn't keep up with
+//  the renderer.
+//=============================================================
+struct AsyncWaveWriterMetrics {
+  // The number of blocks handed to the I/O thread
+  uint64_t number_of_blocks_submitted;
+  // The largest number of blocks that were waiting to be written
+  std::size_t max_queue_depth;
+  uint64_t number_of_stalls;
+  // The total time the render thread spent stalled, in nanoseconds
+  uint64_t stall_time_ns;
+};
+
+//=============================================================
+// CLASS: AsyncWaveWriter
+//
+// DESCRIPTION:
+//  Streams samples to a WAVE file without blocking the render thread
+//  on disk I/O. All the blocks are allocated up-front. The render
+//  thread fills a free block and submits it, the I/O thread appends
+//  it to the file and hands it back. The blocks travel between the
+//  two threads through two lock-free queues, so neither rendering
+//  nor submitting allocates or takes a lock. With at least two blocks
+//  rendering and writing overlap (double-buffering). More blocks
+//  absorb longer hiccups of the disk.
+//
+//  All the methods are meant to be called from a single (render)
+//  thread.
+//=============================================================
+class AsyncWaveWriter {
+ public:
+  //--------------------------------------------------------------
+  // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+  //--------------------------------------------------------------
+  explicit AsyncWaveWriter(
+      std::size_t block_size = kAsyncWaveWriterBlockSize,
+      std::size_t number_of_blocks = kAsyncWaveWriterNumberOfBlocks);
+  // Closes the file if it's still open
+  ~AsyncWaveWriter();
+  explicit AsyncWaveWriter(const AsyncWaveWriter& rhs) = delete;
+  explicit AsyncWaveWriter(AsyncWaveWriter&& rhs) = delete;
+  AsyncWaveWriter& operator=(const AsyncWaveWriter& rhs) = delete;
+  AsyncWaveWriter& operator=(AsyncWaveWriter&& rhs) = delete;
+
+  //--------------------------------------------------------------
+  // 2. GENERAL USER INTERFACE
+  //--------------------------------------------------------------
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Open()
+  //
+  //  DESCRIPTION:
+  //      Opens the file (see WaveFileStreamOut::Open()), resets the
+  //      metrics and starts the I/O thread.
+  //  INPUT:
+  //      The name of the file to write to.
+  //  OUTPUT:
+  //      True on success, false otherwise.
+  //--------------------------------------------------------------
+  bool Open(const std::string& file_name);
+
+  //--------------------------------------------------------------
+  //  NAME:
+  //      AcquireBlock()
+  //
+  //  DESCRIPTION:
+  //      Returns a free block to render into. Waits (and records a
+  //      stall) if all the blocks are queued for writing. The block
+  //      can hold block_size() samples and remains valid until it's
+  //      submitted with SubmitBlock().
+  //  INPUT:
+  //      None
+  //  OUTPUT:
+  //      Pointer to the first sample of the block.
+  //--------------------------------------------------------------
+  int16_t* AcquireBlock();
+
+  //--------------------------------------------------------------
+  //  NAME:
+  //      SubmitBlock()
+  //
+  //  DESCRIPTION:
+  //      Hands the block returned by the last call to AcquireBlock()
+  //      to the I/O thread.
+  //  INPUT:
+  //      The number of samples rendered into the block (at most
+  //      block_size()).
+  //  OUTPUT:
+  //      None
+  //--------------------------------------------------------------
+  void SubmitBlock(std::size_t number_of_samples);
+
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Write()
+  //
+  //  DESCRIPTION:
+  //      Copies the samples into as many blocks as required and
+  //      submits them. For callers that don't render into the blocks
+  //      directly.
+  //  INPUT:
+  //      The samples to write.
+  //  OUTPUT:
+  //      None
+  //--------------------------------------------------------------
+  void Write(const int16_t* samples, std::size_t number_of_samples);
+
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Close()
+  //
+  //  DESCRIPTION:
+  //      Waits for all the submitted blocks to be written, stops the
+  //      I/O thread and closes the file. Calling this method on a
+  //      writer that's not open does nothing.
+  //  INPUT:
+  //      None
+  //  OUTPUT:
+  //      True if every block was written and the file was closed
+  //      successfully, false otherwise.
+  //--------------------------------------------------------------
+  bool Close();
+
+  //--------------------------------------------------------------
+  // 3. ACCESSORS
+  //--------------------------------------------------------------
+  bool IsOpen() const { return io_thread_.joinable(); }
+  std::size_t block_size() const { return block_size_; }
+  std::size_t number_of_blocks() const { return number_of_blocks_; }
+  // The number of blocks waiting to be written
+  std::size_t queue_depth() const { return full_blocks_.size(); }
+  const AsyncWaveWriterMetrics& metrics() const { return metrics_; }
+
+ private:
+  //--------------------------------------------------------------
+  // 4. PRIVATE METHODS
+  //--------------------------------------------------------------
+  void IoThreadLoop();
+
+  //--------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------
+  // A block that has been (or is being) rendered
+  struct Block {
+    std::size_t index;
+    std::size_t number_of_samples;
+  };
+
+  const std::size_t block_size_;
+  const std::size_t number_of_blocks_;
+  // Storage for all the blocks, one after another
+  std::vector<int16_t> storage_;
+
+  // Render thread -> I/O thread
+  SpscQueue<Block> full_blocks_;
+  // I/O thread -> render thread
+  SpscQueue<std::size_t> free_blocks_;
+  // The block returned by the last AcquireBlock(), if any
+  std::size_t current_block_;
+  bool has_current_block_;
+
+  WaveFileStreamOut wave_file_;
+  std::thread io_thread_;
+  std::atomic<bool> stop_;
+  std::atomic<bool> failed_;
+
+  // Only used to put the idle I/O thread to sleep
+  std::mutex wake_up_mutex_;
+  std::condition_variable wake_up_;
+
+  AsyncWaveWriterMetrics metrics_;
+};
+
+#endif /* ASYNC_WAVE_WRITER_H */
@@ -0,0 +1,149 @@
+//=============================================================
+//  FILE:
+//    include/common/flac_codec.h
+//
+//  AUTHOR:
+//    zimzum@github
+//
+//  DESCRIPTION:
+//      The definition of the FlacEncoder and FlacDecoder classes -
+//      lossless compression of 16-bit PCM samples in the FLAC format.
+//
+//  License: GNU GPL v2.0
+//=============================================================
+
+#ifndef FLAC_CODEC_H
+#define FLAC_CODEC_H
+
+#include <global/global_variables.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//=============================================================
+// CLASS: FlacEncoder
+//
+// DESCRIPTION:
+//  Encodes 16-bit PCM samples as a FLAC stream (see [1]). The samples
+//  are split into frames of kFlacBlockSize samples per channel. Every
+//  channel of every frame is modelled with whichever of the following
+//  gives the fewest bits: a constant, one of the fixed polynomial
+//  predictors of order 0-4, a linear predictor (LPC) of order up to
+//  kFlacMaxLpcOrder, or the samples verbatim. Prediction residuals
+//  are Rice coded, with the parameter adapted per partition. Stereo
+//  frames pick the cheapest of left/right, left/side, right/side and
+//  mid/side. Frames are independent, so they're encoded in parallel.
+//
+//  REFERENCES:
+//      [1] https://xiph.org/flac/format.html
+//=============================================================
+class FlacEncoder {
+ public:
+  //--------------------------------------------------------------
+  // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+  //--------------------------------------------------------------
+  explicit FlacEncoder(uint32_t sample_rate, uint16_t number_of_channels,
+                       std::size_t number_of_threads = 1);
+  ~FlacEncoder() = default;
+  explicit FlacEncoder(const FlacEncoder& rhs) = delete;
+  explicit FlacEncoder(FlacEncoder&& rhs) = delete;
+  FlacEncoder& operator=(const FlacEncoder& rhs) = delete;
+  FlacEncoder& operator=(FlacEncoder&& rhs) = delete;
+
+  //--------------------------------------------------------------
+  // 2. GENERAL USER INTERFACE
+  //--------------------------------------------------------------
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Encode()
+  //
+  //  DESCRIPTION:
+  //      Encodes the samples as a complete FLAC stream. The output
+  //      doesn't depend on the number of threads.
+  //  INPUT:
+  //      samples           - interleaved 16-bit samples
+  //      number_of_samples - the number of samples (in all channels)
+  //  OUTPUT:
+  //      The FLAC stream, ready to be written to a file.
+  //--------------------------------------------------------------
+  std::vector<uint8_t> Encode(const int16_t* samples,
+                              std::size_t number_of_samples) const;
+
+  //--------------------------------------------------------------
+  // 3. ACCESSORS
+  //--------------------------------------------------------------
+  uint32_t sample_rate() const { return sample_rate_; }
+  uint16_t number_of_channels() const { return number_of_channels_; }
+
+ private:
+  //--------------------------------------------------------------
+  // 4. PRIVATE METHODS
+  //--------------------------------------------------------------
+  void EncodeFrame(const int16_t* samples, std::size_t block_size,
+                   uint32_t frame_number, std::vector<uint8_t>& output) const;
+
+  //--------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------
+  uint32_t sample_rate_;
+  uint16_t number_of_channels_;
+  std::size_t number_of_threads_;
+};
+
+//=============================================================
+// CLASS: FlacDecoder
+//
+// DESCRIPTION:
+//  Decodes FLAC streams with 16-bit samples, including ones that
+//  weren't produced by FlacEncoder. The CRCs of every frame are
+//  checked.
+//=============================================================
+class FlacDecoder {
+ public:
+  //--------------------------------------------------------------
+  // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+  //--------------------------------------------------------------
+  explicit FlacDecoder();
+  ~FlacDecoder() = default;
+  explicit FlacDecoder(const FlacDecoder& rhs) = delete;
+  explicit FlacDecoder(FlacDecoder&& rhs) = delete;
+  FlacDecoder& operator=(const FlacDecoder& rhs) = delete;
+  FlacDecoder& operator=(FlacDecoder&& rhs) = delete;
+
+  //--------------------------------------------------------------
+  // 2. GENERAL USER INTERFACE
+  //--------------------------------------------------------------
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Decode()
+  //
+  //  DESCRIPTION:
+  //      Decodes a complete FLAC stream.
+  //  INPUT:
+  //      data    - the stream, starting with the "fLaC" marker
+  //      size    - the size of the stream in bytes
+  //      samples - the decoded, interleaved samples
+  //  OUTPUT:
+  //      True on success. False if the stream is corrupted or doesn't
+  //      contain 16-bit samples.
+  //--------------------------------------------------------------
+  bool Decode(const uint8_t* data, std::size_t size,
+              std::vector<int16_t>& samples);
+
+  //--------------------------------------------------------------
+  // 3. ACCESSORS
+  //--------------------------------------------------------------
+  // Valid after a successful call to Decode()
+  uint32_t sample_rate() const { return sample_rate_; }
+  uint16_t number_of_channels() const { return number_of_channels_; }
+
+ private:
+  //--------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------
+  uint32_t sample_rate_;
+  uint16_t number_of_channels_;
+};
+
+#endif /* FLAC_CODEC_H */
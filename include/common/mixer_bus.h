@@ -0,0 +1,144 @@
+//=============================================================
+//  FILE:
+//    include/common/mixer_bus.h
+//
+//  AUTHOR:
+//    zimzum@github
+//
+//  DESCRIPTION:
+//      The definition of the MixerBus class - sums several signals
+//      into one, e.g. the notes of a chord or the layers of a
+//      patch - and of the routine that it's built on.
+//
+//  License: GNU GPL v2.0
+//=============================================================
+
+#ifndef MIXER_BUS_H
+#define MIXER_BUS_H
+
+#include <global/global_variables.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//--------------------------------------------------------------
+//  NAME:
+//      MixSignals()
+//
+//  DESCRIPTION:
+//      Adds the inputs, each scaled by its own gain, to the bus:
+//          bus[n] += sum_i g_i * x_i[n]
+//      16-bit inputs are first converted to float (full scale is
+//      1.0, as in ConvertPcm16ToFloat()), so the sum can't overflow.
+//      The inputs are added 8 samples at a time, in blocks that keep
+//      the bus in L1 while every input streams through once. The
+//      inputs are added in order, so the result doesn't depend on
+//      the length or the alignment of the signals.
+//  INPUT:
+//      inputs            - the signals to add
+//      gains             - the gain of every input
+//      number_of_inputs  - the number of inputs
+//      number_of_samples - the length of the signals
+//      bus               - the bus to add to
+//  OUTPUT:
+//      None
+//--------------------------------------------------------------
+void MixSignals(const float* const* inputs, const float* gains,
+                std::size_t number_of_inputs, std::size_t number_of_samples,
+                float* bus);
+void MixSignals(const int16_t* const* inputs, const float* gains,
+                std::size_t number_of_inputs, std::size_t number_of_samples,
+                float* bus);
+
+//=============================================================
+// CLASS: MixerBus
+//
+// DESCRIPTION:
+//  Adding 16-bit signals (e.g. from SineWaveform or FmSynthesiser)
+//  directly overflows as soon as their peaks add up to more than
+//  full scale. MixerBus accumulates them in float instead, so
+//  there's headroom for any number of signals, and converts the
+//  mix back to 16 bits in one pass at the end, clipping (rather
+//  than wrapping around) whatever is still out of range. Signals
+//  can be added one at a time or several at once (cheaper, as the
+//  bus is only loaded and stored once per block), in 16 bits or in
+//  float (e.g. from a VoiceManager). The bus has a fixed length
+//  and is allocated on construction.
+//=============================================================
+class MixerBus {
+ public:
+  //--------------------------------------------------------------
+  // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+  //--------------------------------------------------------------
+  //--------------------------------------------------------------
+  //  NAME:
+  //      MixerBus()
+  //
+  //  DESCRIPTION:
+  //      Constructor. The bus starts silent.
+  //  INPUT:
+  //      number_of_samples - the length of the bus
+  //--------------------------------------------------------------
+  explicit MixerBus(std::size_t number_of_samples);
+  ~MixerBus() = default;
+  explicit MixerBus(const MixerBus& rhs) = delete;
+  explicit MixerBus(MixerBus&& rhs) = delete;
+  MixerBus& operator=(const MixerBus& rhs) = delete;
+  MixerBus& operator=(MixerBus&& rhs) = delete;
+
+  //--------------------------------------------------------------
+  // 2. GENERAL USER INTERFACE
+  //--------------------------------------------------------------
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Add()
+  //
+  //  DESCRIPTION:
+  //      Adds signals to the bus, each scaled by its own gain (see
+  //      MixSignals()). Every signal has to be as long as the bus.
+  //  INPUT:
+  //      inputs / input   - the signals to add / the signal to add
+  //      gains / gain     - the gain of every signal / of the signal
+  //      number_of_inputs - the number of signals
+  //  OUTPUT:
+  //      None
+  //--------------------------------------------------------------
+  void Add(const int16_t* const* inputs, const float* gains,
+           std::size_t number_of_inputs);
+  void Add(const float* const* inputs, const float* gains,
+           std::size_t number_of_inputs);
+  void Add(const int16_t* input, float gain = 1.0f);
+  void Add(const float* input, float gain = 1.0f);
+
+  //--------------------------------------------------------------
+  //  NAME:
+  //      ConvertToPcm16()
+  //
+  //  DESCRIPTION:
+  //      Converts the mix to 16-bit samples, clipping the samples
+  //      that are out of range. The bus is left as it is.
+  //  INPUT:
+  //      output - the converted mix, size() samples
+  //  OUTPUT:
+  //      None
+  //--------------------------------------------------------------
+  void ConvertToPcm16(int16_t* output) const;
+
+  // Silences the bus
+  void Clear();
+
+  //--------------------------------------------------------------
+  // 3. ACCESSORS
+  //--------------------------------------------------------------
+  std::size_t size() const { return bus_.size(); }
+  const float* data() const { return bus_.data(); }
+
+ private:
+  //--------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------
+  std::vector<float> bus_;
+};
+
+#endif /* MIXER_BUS_H */
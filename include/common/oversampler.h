@@ -0,0 +1,161 @@
+//=============================================================
+//  FILE:
+//    include/common/oversampler.h
+//
+//  AUTHOR:
+//    zimzum@github
+//
+//  DESCRIPTION:
+//      The definition of the Oversampler class - runs part of the
+//      signal chain at a multiple of the sampling rate and decimates
+//      the result back.
+//
+//  License: GNU GPL v2.0
+//=============================================================
+
+#ifndef OVERSAMPLER_H
+#define OVERSAMPLER_H
+
+#include <global/global_variables.h>
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+//=============================================================
+// CLASS: Oversampler
+//
+// DESCRIPTION:
+//  Naive waveforms and nonlinear stages produce harmonics above
+//  the Nyquist frequency, which fold back (alias) into the audible
+//  band. Rendered at 2x, 4x or 8x the sampling rate, those
+//  harmonics land above the audible band instead, where the
+//  decimator removes them before the rate is brought back down.
+//  Only the wrapped part of the chain pays for the higher rate -
+//  e.g. an oscillator constructed with a SynthConfig at
+//  factor() * sampling_rate().
+//
+//  The decimator is a cascade of half-band FIR filters, each
+//  halving the rate. Every other coefficient of a half-band
+//  filter is zero, and decimation only needs every other output,
+//  so each stage is evaluated in polyphase form: the input is split
+//  into its even and odd samples, the even phase is just scaled
+//  by 1/2 and only the odd phase is filtered (symmetric taps are
+//  folded, so each tap costs one multiplication per two samples).
+//  Four output samples are computed at a time with SSE. The last
+//  stage has the sharpest filter (kHalfBandFinalStageLength
+//  coefficients), the earlier ones only need to protect the band
+//  that the later stages keep (kHalfBandStageLength).
+//
+//  The samples are processed in blocks of at most block_size()
+//  output samples, so the memory used doesn't depend on the length
+//  of the signal and nothing is allocated after construction. The
+//  state of the filters carries over between calls.
+//=============================================================
+class Oversampler {
+ public:
+  //--------------------------------------------------------------
+  // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+  //--------------------------------------------------------------
+  explicit Oversampler(std::size_t factor,
+                       std::size_t block_size = kOversamplerBlockSize);
+  ~Oversampler();
+  explicit Oversampler(const Oversampler& rhs) = delete;
+  explicit Oversampler(Oversampler&& rhs) = delete;
+  Oversampler& operator=(const Oversampler& rhs) = delete;
+  Oversampler& operator=(Oversampler&& rhs) = delete;
+
+  //--------------------------------------------------------------
+  // 2. GENERAL USER INTERFACE
+  //--------------------------------------------------------------
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Process()
+  //
+  //  DESCRIPTION:
+  //      Runs the wrapped part of the chain at the higher rate and
+  //      decimates its output. The render callback is called once
+  //      per block with a buffer to fill with the given number of
+  //      samples at the higher rate (at most factor() * block_size()).
+  //  INPUT:
+  //      render            - renders the oversampled signal
+  //      number_of_samples - the number of output samples (at the
+  //                          original rate)
+  //      output            - the output buffer
+  //  OUTPUT:
+  //      None
+  //--------------------------------------------------------------
+  void Process(const std::function<void(float*, std::size_t)>& render,
+               std::size_t number_of_samples, float* output);
+
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Decimate()
+  //
+  //  DESCRIPTION:
+  //      Like Process(), but the oversampled signal has already
+  //      been rendered.
+  //  INPUT:
+  //      input             - the oversampled signal, factor() *
+  //                          number_of_samples samples
+  //      number_of_samples - the number of output samples
+  //      output            - the output buffer
+  //  OUTPUT:
+  //      None
+  //--------------------------------------------------------------
+  void Decimate(const float* input, std::size_t number_of_samples,
+                float* output);
+
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Reset()
+  //
+  //  DESCRIPTION:
+  //      Clears the state of the filters, e.g. before an unrelated
+  //      signal is processed.
+  //  INPUT:
+  //      None
+  //  OUTPUT:
+  //      None
+  //--------------------------------------------------------------
+  void Reset();
+
+  //--------------------------------------------------------------
+  // 3. ACCESSORS
+  //--------------------------------------------------------------
+  std::size_t factor() const { return factor_; }
+  std::size_t block_size() const { return block_size_; }
+  // The delay introduced by the decimator, in output samples
+  double latency() const;
+
+ private:
+  //--------------------------------------------------------------
+  // 4. PRIVATE METHODS
+  //--------------------------------------------------------------
+  void DecimateBlock(const float* input, std::size_t number_of_samples,
+                     float* output);
+
+  //--------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------
+  // One half-band filter of the cascade
+  struct Stage {
+    // The non-zero coefficients of one half of the (symmetric) odd
+    // phase, starting next to the centre tap
+    std::vector<float> coefficients;
+    // The even and the odd phase of the input: the last
+    // 2 * coefficients.size() - 1 samples of the previous block
+    // followed by the current block
+    std::vector<float> even;
+    std::vector<float> odd;
+  };
+
+  const std::size_t factor_;
+  const std::size_t block_size_;
+  std::vector<Stage> stages_;
+  // Ping-pong buffers for the output of all stages but the last one,
+  // and for the render callback
+  std::vector<float> buffers_[2];
+};
+
+#endif /* OVERSAMPLER_H */
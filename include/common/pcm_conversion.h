@@ -0,0 +1,88 @@
+//=============================================================
+//  FILE:
+//    include/common/pcm_conversion.h
+//
+//  AUTHOR:
+//    zimzum@github
+//
+//  DESCRIPTION:
+//      Routines for converting between the layouts of PCM samples
+//      used by the synthesiser and by the WAVE files.
+//
+//  License: GNU GPL v2.0
+//=============================================================
+
+#ifndef PCM_CONVERSION_H
+#define PCM_CONVERSION_H
+
+#include <cstddef>
+#include <cstdint>
+
+//--------------------------------------------------------------
+//  NAME:
+//      InterleaveChannels()
+//
+//  DESCRIPTION:
+//      Interleaves planar channel buffers into frames, i.e. for
+//      channels A, B and C produces A0 B0 C0 A1 B1 C1 ... Stereo and
+//      4-channel layouts are interleaved with SIMD shuffles. Other
+//      layouts are interleaved two channels at a time, in blocks that
+//      fit in L1 together with the corresponding input.
+//  INPUT:
+//      channels           - pointers to the planar buffers, one per
+//                           channel, number_of_frames samples each
+//      number_of_channels - the number of channels
+//      number_of_frames   - the number of samples in every channel
+//      interleaved        - the output buffer, large enough for
+//                           number_of_channels * number_of_frames
+//                           samples
+//  OUTPUT:
+//      None
+//--------------------------------------------------------------
+void InterleaveChannels(const int16_t* const* channels,
+                        std::size_t number_of_channels,
+                        std::size_t number_of_frames, int16_t* interleaved);
+
+//--------------------------------------------------------------
+//  NAME:
+//      ConvertFloatToPcm16()
+//      ConvertFloatToPcm24()
+//
+//  DESCRIPTION:
+//      Quantise floating point samples in the range [-1, 1) to 16-bit
+//      and packed 24-bit (3 bytes, little-endian) PCM, respectively.
+//      The samples are rounded to the nearest integer, and samples
+//      out of range are clipped. 4 samples are converted at a time.
+//  INPUT:
+//      input             - the samples to convert
+//      number_of_samples - the number of samples to convert
+//      output            - the converted samples
+//  OUTPUT:
+//      None
+//--------------------------------------------------------------
+void ConvertFloatToPcm16(const float* input, std::size_t number_of_samples,
+                         int16_t* output);
+void ConvertFloatToPcm24(const float* input, std::size_t number_of_samples,
+                         uint8_t* output);
+
+//--------------------------------------------------------------
+//  NAME:
+//      ConvertPcm16ToFloat()
+//      ConvertPcm24ToFloat()
+//
+//  DESCRIPTION:
+//      The counterparts of the above. Every 16-bit and 24-bit sample
+//      converts to float exactly and back to the same sample.
+//  INPUT:
+//      input             - the samples to convert
+//      number_of_samples - the number of samples to convert
+//      output            - the converted samples
+//  OUTPUT:
+//      None
+//--------------------------------------------------------------
+void ConvertPcm16ToFloat(const int16_t* input, std::size_t number_of_samples,
+                         float* output);
+void ConvertPcm24ToFloat(const uint8_t* input, std::size_t number_of_samples,
+                         float* output);
+
+#endif /* PCM_CONVERSION_H */
@@ -0,0 +1,182 @@
+//=============================================================
+//  FILE:
+//    include/common/pcm_stream_out.h
+//
+//  AUTHOR:
+//    zimzum@github
+//
+//  DESCRIPTION:
+//      The definition of the PcmStreamOut class - streams samples
+//      to a file descriptor, e.g. stdout or a pipe.
+//
+//  License: GNU GPL v2.0
+//=============================================================
+
+#ifndef PCM_STREAM_OUT_H
+#define PCM_STREAM_OUT_H
+
+#include <common/wave_file.h>
+#include <global/global_variables.h>
+
+#include <string>
+#include <vector>
+
+//--------------------------------------------------------------
+//  NAME:
+//      PcmStreamFraming
+//
+//  DESCRIPTION:
+//      What precedes the samples in the stream:
+//          - kRaw - nothing, just the interleaved 16-bit samples
+//          - kWave - a WAVE header (the default)
+//--------------------------------------------------------------
+enum class PcmStreamFraming { kRaw, kWave };
+
+//=============================================================
+// CLASS: PcmStreamOut
+//
+// DESCRIPTION:
+//  Streams 16-bit PCM samples to a file descriptor as they are
+//  rendered, so that the samples can be piped straight into other
+//  tools (encoders, players, analysers) without a temporary file.
+//  The samples are collected in a page-aligned buffer and written
+//  in whole buffers (kPcmStreamBufferSize bytes, by default as much
+//  as a pipe holds), so that the consumer is woken up once per
+//  buffer rather than once per block of samples. Large blocks are
+//  written straight from the caller's memory.
+//
+//  With kWave framing the header is padded (with a "JUNK" chunk) to
+//  kPcmStreamAlignment bytes, so that the samples start at a page
+//  boundary of the stream and every write is a whole number of
+//  pages - consumers can splice() the pages through. The length of
+//  a stream isn't known when the header is written, so its sizes
+//  are set to "unknown" (0xFFFFFFFF, which common tools read as
+//  "until the end of the stream"). If the descriptor refers to a
+//  regular file, Close() patches the actual sizes in.
+//=============================================================
+class PcmStreamOut : public WaveFile {
+ public:
+  //--------------------------------------------------------------
+  // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+  //--------------------------------------------------------------
+  explicit PcmStreamOut(PcmStreamFraming framing = PcmStreamFraming::kWave,
+                        uint16_t number_of_channels = kNumberOfChannelsMono,
+                        std::size_t buffer_size = kPcmStreamBufferSize);
+  ~PcmStreamOut();
+  explicit PcmStreamOut(const PcmStreamOut& rhs) = delete;
+  explicit PcmStreamOut(PcmStreamOut&& rhs) = delete;
+  PcmStreamOut& operator=(const PcmStreamOut& rhs) = delete;
+  PcmStreamOut& operator=(PcmStreamOut&& rhs) = delete;
+
+  //--------------------------------------------------------------
+  // 2. GENERAL USER INTERFACE
+  //--------------------------------------------------------------
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Open()
+  //
+  //  DESCRIPTION:
+  //      Starts a stream on the given file descriptor. The descriptor
+  //      is not closed by this class. The header (if any) is only
+  //      buffered, nothing is written yet.
+  //  INPUT:
+  //      file_descriptor - the descriptor to write to, e.g.
+  //                        STDOUT_FILENO
+  //  OUTPUT:
+  //      True on success, false otherwise.
+  //--------------------------------------------------------------
+  bool Open(int file_descriptor);
+
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Open()
+  //
+  //  DESCRIPTION:
+  //      Like above, but creates (or truncates) the named file and
+  //      streams to it. "-" stands for stdout.
+  //  INPUT:
+  //      The name of the file to write to.
+  //  OUTPUT:
+  //      True on success, false otherwise.
+  //--------------------------------------------------------------
+  bool Open(const std::string& file_name);
+
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Append()
+  //
+  //  DESCRIPTION:
+  //      Appends interleaved samples to the stream. Samples are
+  //      written whenever a whole buffer is available.
+  //  INPUT:
+  //      The samples to append.
+  //  OUTPUT:
+  //      True on success, false otherwise.
+  //--------------------------------------------------------------
+  bool Append(const int16_t* samples, std::size_t number_of_samples);
+  bool Append(const std::vector<int16_t>& samples);
+
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Flush()
+  //
+  //  DESCRIPTION:
+  //      Writes whatever is in the buffer, even if it's not a whole
+  //      buffer, e.g. to let the consumer catch up at the end of a
+  //      note.
+  //  INPUT:
+  //      None
+  //  OUTPUT:
+  //      True on success, false otherwise.
+  //--------------------------------------------------------------
+  bool Flush();
+
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Close()
+  //
+  //  DESCRIPTION:
+  //      Flushes the buffer, patches the header of regular files and
+  //      closes the descriptor if it was opened by name. Calling this
+  //      method on a stream that's not open does nothing.
+  //  INPUT:
+  //      None
+  //  OUTPUT:
+  //      True on success, false otherwise.
+  //--------------------------------------------------------------
+  bool Close();
+
+  //--------------------------------------------------------------
+  // 3. ACCESSORS
+  //--------------------------------------------------------------
+  bool IsOpen() const { return file_descriptor_ >= 0; }
+  PcmStreamFraming framing() const { return framing_; }
+  std::size_t buffer_size() const { return buffer_size_; }
+  uint64_t number_of_samples_written() const {
+    return bytes_written_ / sizeof(int16_t);
+  }
+
+ private:
+  //--------------------------------------------------------------
+  // 4. PRIVATE METHODS
+  //--------------------------------------------------------------
+  void SerialiseStreamHeader(uint8_t* header, bool sizes_known);
+
+  //--------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------
+  PcmStreamFraming framing_;
+  std::size_t buffer_size_;
+  // The buffer is carved out of this storage at a page boundary
+  std::vector<uint8_t> storage_;
+  uint8_t* buffer_;
+  std::size_t bytes_buffered_;
+  int file_descriptor_;
+  bool owns_file_descriptor_;
+  // Where the header is in the file, or -1 if it can't be patched
+  int64_t header_offset_;
+  // The number of bytes of samples appended so far
+  uint64_t bytes_written_;
+};
+
+#endif /* PCM_STREAM_OUT_H */
@@ -0,0 +1,176 @@
+//=============================================================
+//  FILE:
+//    include/common/pitch_tables.h
+//
+//  AUTHOR:
+//    zimzum@github
+//
+//  DESCRIPTION:
+//      Compile-time tables of the frequencies of the equal-tempered
+//      scale and of the corresponding phase increments at the common
+//      sampling rates. Used by SynthConfig.
+//
+//  License: GNU GPL v2.0
+//=============================================================
+
+#ifndef PITCH_TABLES_H
+#define PITCH_TABLES_H
+
+#include <cstddef>
+#include <cstdint>
+
+//=============================================================
+// CONSTANTS
+//=============================================================
+// The number of pitches in the tables (has to match
+// kNumberOfFrequencies)
+constexpr std::size_t kPitchTableSize = 128;
+
+// The reference pitch: A4 (index 57) is exactly 440Hz, so middle C
+// (C4) is at index 48
+constexpr std::size_t kPitchA4 = 57;
+constexpr double kFrequencyA4 = 440.0;
+
+// Pi to the full precision of a double
+constexpr double kPitchTablePi = 3.141592653589793;
+
+//=============================================================
+// GENERATORS
+//=============================================================
+//--------------------------------------------------------------
+//  NAME:
+//      SemitoneRatio()
+//
+//  DESCRIPTION:
+//      2^(semitone/12), correctly rounded, for semitones within an
+//      octave.
+//--------------------------------------------------------------
+constexpr double SemitoneRatio(std::size_t semitone) {
+  return (semitone == 0)    ? 1.0
+         : (semitone == 1)  ? 1.0594630943592953
+         : (semitone == 2)  ? 1.122462048309373
+         : (semitone == 3)  ? 1.189207115002721
+         : (semitone == 4)  ? 1.2599210498948732
+         : (semitone == 5)  ? 1.3348398541700344
+         : (semitone == 6)  ? 1.4142135623730951
+         : (semitone == 7)  ? 1.4983070768766815
+         : (semitone == 8)  ? 1.5874010519681996
+         : (semitone == 9)  ? 1.681792830507429
+         : (semitone == 10) ? 1.7817974362806785
+                            : 1.887748625363387;
+}
+
+//--------------------------------------------------------------
+//  NAME:
+//      OctaveRatio()
+//
+//  DESCRIPTION:
+//      2^octave. Exact, so scaling by it adds no error.
+//--------------------------------------------------------------
+constexpr double OctaveRatio(int octave) {
+  return (octave == 0)  ? 1.0
+         : (octave > 0) ? 2.0 * OctaveRatio(octave - 1)
+                        : 0.5 * OctaveRatio(octave + 1);
+}
+
+//--------------------------------------------------------------
+//  NAME:
+//      PitchFrequency()
+//
+//  DESCRIPTION:
+//      The frequency of the given pitch, i.e. 440 * 2^((pitch-57)/12).
+//      Computed directly rather than by repeated multiplication, so
+//      there is no accumulated error - every entry is within an ulp
+//      or two of the exact value.
+//--------------------------------------------------------------
+constexpr double PitchFrequency(std::size_t pitch) {
+  // pitch + 3 is the number of semitones above A(-1), five octaves
+  // below A4
+  return kFrequencyA4 * SemitoneRatio((pitch + 3) % 12) *
+         OctaveRatio(static_cast<int>((pitch + 3) / 12) - 5);
+}
+
+//--------------------------------------------------------------
+//  NAME:
+//      FoldPhaseIncrement()
+//
+//  DESCRIPTION:
+//      Folds a phase increment into the [0, kPi) range (like fmod()
+//      does, which isn't constexpr).
+//--------------------------------------------------------------
+constexpr double FoldPhaseIncrement(double phase_increment) {
+  return (phase_increment < kPitchTablePi)
+             ? phase_increment
+             : FoldPhaseIncrement(phase_increment - kPitchTablePi);
+}
+
+//--------------------------------------------------------------
+//  NAME:
+//      PitchPhaseIncrement()
+//
+//  DESCRIPTION:
+//      The phase increment per sample of the given pitch at the
+//      given sampling rate, in the [0, kPi) range. Can be called at
+//      run time too, for sampling rates without a table.
+//--------------------------------------------------------------
+constexpr double PitchPhaseIncrement(uint32_t sampling_rate,
+                                     std::size_t pitch) {
+  return FoldPhaseIncrement(2.0 * kPitchTablePi / sampling_rate *
+                            PitchFrequency(pitch));
+}
+
+//=============================================================
+// TABLES
+//=============================================================
+// A pack of indices 0, 1, ..., N-1 for generating the tables
+// (std::index_sequence is C++14)
+template <std::size_t... Indices>
+struct PitchIndexSequence {};
+
+template <std::size_t N, std::size_t... Indices>
+struct MakePitchIndexSequence
+    : MakePitchIndexSequence<N - 1, N - 1, Indices...> {};
+
+template <std::size_t... Indices>
+struct MakePitchIndexSequence<0, Indices...> {
+  typedef PitchIndexSequence<Indices...> type;
+};
+
+template <typename Sequence>
+struct PitchTableGenerator;
+
+template <std::size_t... Indices>
+struct PitchTableGenerator<PitchIndexSequence<Indices...>> {
+  static constexpr double frequencies[sizeof...(Indices)] = {
+      PitchFrequency(Indices)...};
+
+  template <uint32_t SamplingRate>
+  struct PhaseIncrements {
+    static constexpr double values[sizeof...(Indices)] = {
+        PitchPhaseIncrement(SamplingRate, Indices)...};
+  };
+};
+
+template <std::size_t... Indices>
+constexpr double PitchTableGenerator<
+    PitchIndexSequence<Indices...>>::frequencies[sizeof...(Indices)];
+
+template <std::size_t... Indices>
+template <uint32_t SamplingRate>
+constexpr double PitchTableGenerator<PitchIndexSequence<Indices...>>::
+    PhaseIncrements<SamplingRate>::values[sizeof...(Indices)];
+
+//--------------------------------------------------------------
+//  NAME:
+//      PitchTable
+//
+//  DESCRIPTION:
+//      The tables themselves:
+//          - PitchTable::frequencies - the frequency of every pitch
+//          - PitchTable::PhaseIncrements<rate>::values - the phase
+//            increment of every pitch at the given sampling rate
+//--------------------------------------------------------------
+typedef PitchTableGenerator<MakePitchIndexSequence<kPitchTableSize>::type>
+    PitchTable;
+
+#endif /* PITCH_TABLES_H */
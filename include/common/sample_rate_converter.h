@@ -0,0 +1,227 @@
+//=============================================================
+//  FILE:
+//    include/common/sample_rate_converter.h
+//
+//  AUTHOR:
+//    zimzum@github
+//
+//  DESCRIPTION:
+//      The definitions of the SampleRateConverter class - converts
+//      a stream of samples between two arbitrary sampling rates - and
+//      of the ResampledWaveFileIn class, which reads a WAVE file at
+//      the sampling rate of the synthesiser.
+//
+//  License: GNU GPL v2.0
+//=============================================================
+
+#ifndef SAMPLE_RATE_CONVERTER_H
+#define SAMPLE_RATE_CONVERTER_H
+
+#include <common/synth_config.h>
+#include <common/wave_file.h>
+#include <global/global_variables.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//=============================================================
+// CLASS: SampleRateConverter
+//
+// DESCRIPTION:
+//  A streaming sample rate converter for any pair of sampling
+//  rates. Every output frame is interpolated from the
+//  kResamplerNumberOfTaps input frames around its position with a
+//  Kaiser-windowed sinc, which cuts off below the lower of the two
+//  Nyquist frequencies (so it also removes the aliases when
+//  downsampling).
+//
+//  The ratio of the rates is reduced to L/M, and the position of
+//  every output frame is tracked exactly, as a whole input frame
+//  plus a fraction in units of 1/L. The filter is precomputed for
+//  every one of the L fractions (polyphase), so converting a frame
+//  is a single dot product per channel, 4 taps at a time with SSE.
+//  When L is too large for a table (see
+//  kResamplerMaxNumberOfPhases), the table has fewer phases and
+//  the two neighbouring ones are interpolated.
+//
+//  The input and output frames are interleaved and processed in
+//  blocks of any size. The state carries over between calls, so
+//  the output doesn't depend on how the input is split.
+//=============================================================
+class SampleRateConverter {
+ public:
+  //--------------------------------------------------------------
+  // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+  //--------------------------------------------------------------
+  explicit SampleRateConverter(
+      uint32_t input_rate, uint32_t output_rate,
+      uint16_t number_of_channels = kNumberOfChannelsMono);
+  ~SampleRateConverter();
+  explicit SampleRateConverter(const SampleRateConverter& rhs) = delete;
+  explicit SampleRateConverter(SampleRateConverter&& rhs) = delete;
+  SampleRateConverter& operator=(const SampleRateConverter& rhs) = delete;
+  SampleRateConverter& operator=(SampleRateConverter&& rhs) = delete;
+
+  //--------------------------------------------------------------
+  // 2. GENERAL USER INTERFACE
+  //--------------------------------------------------------------
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Process()
+  //
+  //  DESCRIPTION:
+  //      Converts the next block of the stream. Every output frame
+  //      needs latency() input frames after it, so the output lags
+  //      behind the input - pass kResamplerNumberOfTaps / 2 frames
+  //      of silence at the end of the stream to flush it. The
+  //      output frame n is at the position n * input_rate() /
+  //      output_rate() of the input stream.
+  //  INPUT:
+  //      input            - the interleaved input frames
+  //      number_of_frames - the number of input frames
+  //      output           - the output buffer, large enough for
+  //                         max_output_frames(number_of_frames)
+  //                         frames
+  //  OUTPUT:
+  //      The number of output frames.
+  //--------------------------------------------------------------
+  std::size_t Process(const float* input, std::size_t number_of_frames,
+                      float* output);
+
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Reset()
+  //
+  //  DESCRIPTION:
+  //      Starts a new stream.
+  //  INPUT:
+  //      None
+  //  OUTPUT:
+  //      None
+  //--------------------------------------------------------------
+  void Reset();
+
+  //--------------------------------------------------------------
+  // 3. ACCESSORS
+  //--------------------------------------------------------------
+  uint32_t input_rate() const { return input_rate_; }
+  uint32_t output_rate() const { return output_rate_; }
+  uint16_t number_of_channels() const { return number_of_channels_; }
+  // The most output frames that Process() can produce from the
+  // given number of input frames
+  std::size_t max_output_frames(std::size_t number_of_frames) const;
+  // The number of input frames that an output frame has to wait
+  // for
+  std::size_t latency() const { return number_of_taps_ / 2; }
+
+ private:
+  //--------------------------------------------------------------
+  // 4. PRIVATE METHODS
+  //--------------------------------------------------------------
+  void DesignFilter();
+  float Interpolate(const float* frames, uint64_t fraction) const;
+
+  //--------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------
+  const uint32_t input_rate_;
+  const uint32_t output_rate_;
+  const uint16_t number_of_channels_;
+  // The ratio of the rates, output_rate_ / input_rate_ = L / M
+  uint64_t interpolation_;
+  uint64_t decimation_;
+  std::size_t number_of_taps_;
+  // The filter: number_of_phases_ + 1 rows of number_of_taps_
+  // coefficients (the last row is the first one, one frame later)
+  std::size_t number_of_phases_;
+  std::vector<float> coefficients_;
+  // The input frames that are still needed, one buffer per channel
+  std::vector<std::vector<float>> history_;
+  std::size_t history_size_;
+  // The position of the next output frame - the index of the first
+  // frame it's interpolated from within history_, and the fraction
+  // in units of 1 / interpolation_
+  std::size_t position_;
+  uint64_t fraction_;
+};
+
+//=============================================================
+// CLASS: ResampledWaveFileIn
+//
+// DESCRIPTION:
+//  Reads a WAVE file opened with WaveFileIn::Open() at the
+//  sampling rate of a SynthConfig, whatever the rate of the file.
+//  The file is read and converted in blocks of kResamplerBlockSize
+//  frames, so samples at any rate can be streamed without an
+//  offline conversion step. Files at the sampling rate of the
+//  SynthConfig are read without conversion.
+//=============================================================
+class ResampledWaveFileIn {
+ public:
+  //--------------------------------------------------------------
+  // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+  //--------------------------------------------------------------
+  explicit ResampledWaveFileIn(WaveFileIn& wave_file,
+                               const SynthConfig& synthesiser);
+  ~ResampledWaveFileIn();
+  explicit ResampledWaveFileIn(const ResampledWaveFileIn& rhs) = delete;
+  explicit ResampledWaveFileIn(ResampledWaveFileIn&& rhs) = delete;
+  ResampledWaveFileIn& operator=(const ResampledWaveFileIn& rhs) = delete;
+  ResampledWaveFileIn& operator=(ResampledWaveFileIn&& rhs) = delete;
+
+  //--------------------------------------------------------------
+  // 2. GENERAL USER INTERFACE
+  //--------------------------------------------------------------
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Read()
+  //
+  //  DESCRIPTION:
+  //      Reads the next frames of the file, at the sampling rate of
+  //      the SynthConfig, as floating point numbers.
+  //  INPUT:
+  //      samples          - the output buffer, large enough for
+  //                         number_of_frames * num_channels()
+  //                         interleaved samples
+  //      number_of_frames - the number of frames to read
+  //  OUTPUT:
+  //      The number of frames read. Less than requested at the end
+  //      of the file or if the file could not be read.
+  //--------------------------------------------------------------
+  std::size_t Read(float* samples, std::size_t number_of_frames);
+
+  //--------------------------------------------------------------
+  // 3. ACCESSORS
+  //--------------------------------------------------------------
+  // The length of the file at the sampling rate of the SynthConfig
+  uint64_t number_of_frames() const { return number_of_frames_; }
+  uint64_t frames_read() const { return frames_read_; }
+
+ private:
+  //--------------------------------------------------------------
+  // 4. PRIVATE METHODS
+  //--------------------------------------------------------------
+  bool Refill();
+
+  //--------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------
+  WaveFileIn& wave_file_;
+  const uint16_t number_of_channels_;
+  SampleRateConverter converter_;
+  uint64_t number_of_frames_;
+  uint64_t frames_read_;
+  // The next frame of the file to read, and the number of frames of
+  // silence fed to the converter after the end of the file
+  uint64_t next_input_frame_;
+  std::size_t padding_;
+  // A block of input frames, and the converted frames that haven't
+  // been returned yet
+  std::vector<float> input_;
+  std::vector<float> output_;
+  std::size_t output_position_;
+  std::size_t output_size_;
+};
+
+#endif /* SAMPLE_RATE_CONVERTER_H */
@@ -0,0 +1,131 @@
+//=============================================================
+//  FILE:
+//    include/common/spsc_queue.h
+//
+//  AUTHOR:
+//    zimzum@github
+//
+//  DESCRIPTION:
+//      The definition of the SpscQueue class template - a bounded,
+//      lock-free, single-producer/single-consumer queue.
+//
+//  License: GNU GPL v2.0
+//=============================================================
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+//=============================================================
+// CLASS: SpscQueue
+//
+// DESCRIPTION:
+//  A bounded FIFO queue that is safe to use from exactly two threads:
+//  one calling Push() and one calling Pop(). Neither blocks, allocates
+//  or takes a lock - all the storage is allocated in the constructor.
+//  The capacity is rounded up to a power of two so that wrapping the
+//  indices is a mask rather than a division.
+//=============================================================
+template <typename T>
+class SpscQueue {
+ public:
+  //--------------------------------------------------------------
+  // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+  //--------------------------------------------------------------
+  explicit SpscQueue(std::size_t capacity)
+      : slots_(RoundUpToPowerOfTwo(capacity)),
+        mask_(slots_.size() - 1),
+        head_(0),
+        tail_(0) {}
+  ~SpscQueue() = default;
+  explicit SpscQueue(const SpscQueue& rhs) = delete;
+  explicit SpscQueue(SpscQueue&& rhs) = delete;
+  SpscQueue& operator=(const SpscQueue& rhs) = delete;
+  SpscQueue& operator=(SpscQueue&& rhs) = delete;
+
+  //--------------------------------------------------------------
+  // 2. GENERAL USER INTERFACE
+  //--------------------------------------------------------------
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Push()
+  //
+  //  DESCRIPTION:
+  //      Adds an element at the back of the queue. Producer only.
+  //  INPUT:
+  //      The element to add
+  //  OUTPUT:
+  //      False if the queue is full, true otherwise.
+  //--------------------------------------------------------------
+  bool Push(const T& value) {
+    const std::size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == slots_.size()) {
+      return false;
+    }
+
+    slots_[tail & mask_] = value;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Pop()
+  //
+  //  DESCRIPTION:
+  //      Removes the element at the front of the queue. Consumer only.
+  //  INPUT:
+  //      Where to store the removed element
+  //  OUTPUT:
+  //      False if the queue is empty, true otherwise.
+  //--------------------------------------------------------------
+  bool Pop(T& value) {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) return false;
+
+    value = slots_[head & mask_];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  //--------------------------------------------------------------
+  // 3. ACCESSORS
+  //--------------------------------------------------------------
+  // The number of elements in the queue. Exact only when called from
+  // either of the two threads while the other one is idle.
+  std::size_t size() const {
+    return tail_.load(std::memory_order_acquire) -
+           head_.load(std::memory_order_acquire);
+  }
+  bool empty() const { return size() == 0; }
+  std::size_t capacity() const { return slots_.size(); }
+
+ private:
+  //--------------------------------------------------------------
+  // 4. PRIVATE METHODS
+  //--------------------------------------------------------------
+  static std::size_t RoundUpToPowerOfTwo(std::size_t value) {
+    std::size_t result = 1;
+    while (result < value) result <<= 1;
+    return result;
+  }
+
+  //--------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------
+  std::vector<T> slots_;
+  const std::size_t mask_;
+  // Written by the consumer only. Padded onto a separate cache line from
+  // tail_ so that the two threads don't keep invalidating each other.
+  char padding_0_[64];
+  std::atomic<std::size_t> head_;
+  char padding_1_[64 - sizeof(std::atomic<std::size_t>)];
+  // Written by the producer only
+  std::atomic<std::size_t> tail_;
+  char padding_2_[64 - sizeof(std::atomic<std::size_t>)];
+};
+
+#endif /* SPSC_QUEUE_H */
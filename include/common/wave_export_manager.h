@@ -0,0 +1,169 @@
+//=============================================================
+//  FILE:
+//    include/common/wave_export_manager.h
+//
+//  AUTHOR:
+//    zimzum@github
+//
+//  DESCRIPTION:
+//      The definition of the WaveExportManager class - writes many
+//      WAVE files in parallel with rendering.
+//
+//  License: GNU GPL v2.0
+//=============================================================
+
+#ifndef WAVE_EXPORT_MANAGER_H
+#define WAVE_EXPORT_MANAGER_H
+
+#include <common/wave_file.h>
+#include <global/global_include.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+//=============================================================
+// STRUCT: WaveExportMetrics
+//
+// DESCRIPTION:
+//  Statistics gathered by WaveExportManager since it was created.
+//  A stall is a call to Submit() that had to wait for a file to be
+//  written, i.e. the disk couldn't keep up with the renderer.
+//=============================================================
+struct WaveExportMetrics {
+  // The number of files written successfully and the number of files
+  // that couldn't be written
+  uint64_t number_of_files;
+  uint64_t number_of_failures;
+  // The total size of the files written, headers included
+  uint64_t number_of_bytes;
+  // The largest number of files that were queued or being written
+  std::size_t max_files_in_flight;
+  uint64_t number_of_stalls;
+  // The total time the render thread spent stalled, in nanoseconds
+  uint64_t stall_time_ns;
+  // From the creation of the manager until the last file was written,
+  // in nanoseconds
+  uint64_t elapsed_time_ns;
+};
+
+//=============================================================
+// CLASS: WaveExportManager
+//
+// DESCRIPTION:
+//  Exports rendered sounds to WAVE files (one file per sound) on a
+//  pool of I/O threads, so that rendering the next sound overlaps
+//  with writing the previous ones. The samples are moved into the
+//  manager, never copied. At most max_files_in_flight() files are
+//  queued or being written at any time - Submit() waits for a slot
+//  otherwise. This bounds both the number of concurrent writes and
+//  the memory held by samples that haven't been written yet.
+//
+//  Every file is written with WaveFileOut, i.e. a canonical header
+//  and the samples in one write per file, whatever its length.
+//=============================================================
+class WaveExportManager {
+ public:
+  //--------------------------------------------------------------
+  // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+  //--------------------------------------------------------------
+  explicit WaveExportManager(
+      std::size_t number_of_threads = kWaveExportNumberOfThreads,
+      std::size_t max_files_in_flight = kWaveExportMaxFilesInFlight);
+  // Waits for all the submitted files to be written
+  ~WaveExportManager();
+  explicit WaveExportManager(const WaveExportManager& rhs) = delete;
+  explicit WaveExportManager(WaveExportManager&& rhs) = delete;
+  WaveExportManager& operator=(const WaveExportManager& rhs) = delete;
+  WaveExportManager& operator=(WaveExportManager&& rhs) = delete;
+
+  //--------------------------------------------------------------
+  // 2. GENERAL USER INTERFACE
+  //--------------------------------------------------------------
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Submit()
+  //
+  //  DESCRIPTION:
+  //      Queues the samples to be written to the given file (created
+  //      or truncated) and returns as soon as there's a free slot,
+  //      usually straight away. Can be called from several threads.
+  //  INPUT:
+  //      file_name          - the name of the file to write to
+  //      samples            - the (interleaved) samples, taken over
+  //                           by the manager
+  //      number_of_channels - the number of channels in the file
+  //      sample_rate        - the sample rate the samples were
+  //                           rendered at
+  //  OUTPUT:
+  //      None
+  //--------------------------------------------------------------
+  void Submit(const std::string& file_name, std::vector<int16_t>&& samples,
+              uint16_t number_of_channels = kNumberOfChannelsMono,
+              uint32_t sample_rate = kCdSampleRate);
+
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Finish()
+  //
+  //  DESCRIPTION:
+  //      Waits for all the submitted files to be written and stops
+  //      the I/O threads. No files can be submitted afterwards.
+  //      Calling this method again does nothing.
+  //  INPUT:
+  //      None
+  //  OUTPUT:
+  //      True if every file was written successfully, false
+  //      otherwise.
+  //--------------------------------------------------------------
+  bool Finish();
+
+  //--------------------------------------------------------------
+  // 3. ACCESSORS
+  //--------------------------------------------------------------
+  std::size_t number_of_threads() const { return number_of_threads_; }
+  std::size_t max_files_in_flight() const { return max_files_in_flight_; }
+  // A snapshot, the I/O threads may still be updating the metrics
+  WaveExportMetrics metrics() const;
+  // Throughput over WaveExportMetrics::elapsed_time_ns
+  double files_per_second() const;
+  double bytes_per_second() const;
+
+ private:
+  //--------------------------------------------------------------
+  // 4. PRIVATE METHODS
+  //--------------------------------------------------------------
+  struct Job;
+  static bool WriteFile(Job& job, uint64_t& number_of_bytes);
+  void IoThreadLoop();
+
+  //--------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------
+  // A file waiting to be written
+  struct Job {
+    std::string file_name;
+    std::vector<int16_t> samples;
+    uint16_t number_of_channels;
+    uint32_t sample_rate;
+  };
+
+  const std::size_t number_of_threads_;
+  const std::size_t max_files_in_flight_;
+  std::vector<std::thread> io_threads_;
+  std::chrono::steady_clock::time_point start_time_;
+
+  // Guards everything below
+  mutable std::mutex mutex_;
+  std::deque<Job> jobs_;
+  // Queued plus being written
+  std::size_t files_in_flight_;
+  bool stop_;
+  std::condition_variable job_available_;
+  std::condition_variable slot_available_;
+  WaveExportMetrics metrics_;
+};
+
+#endif /* WAVE_EXPORT_MANAGER_H */
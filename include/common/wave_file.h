@@ -16,9 +16,22 @@
 #define WAVEFILE_H
 
 #include <global/global_include.h>
+#include <global/global_variables.h>
 #include <exception>
 #include <vector>
 
+//--------------------------------------------------------------
+//  NAME:
+//      SampleFormat
+//
+//  DESCRIPTION:
+//      The format of the samples in a WAVE file:
+//          - kPcm16 - 16-bit PCM (the default)
+//          - kPcm24 - packed 24-bit PCM, 3 bytes per sample
+//          - kFloat32 - 32-bit IEEE float, in the range [-1, 1)
+//--------------------------------------------------------------
+enum class SampleFormat { kPcm16, kPcm24, kFloat32 };
+
 //=============================================================
 // CLASS: WaveFile
 //
@@ -41,7 +54,20 @@ class WaveFile {
   //--------------------------------------------------------------
   // 2. GENERAL USER INTERFACE
   //--------------------------------------------------------------
-  // None
+  //--------------------------------------------------------------
+  //  NAME:
+  //      ForceRf64()
+  //
+  //  DESCRIPTION:
+  //      Makes the file RF64 regardless of the size of the data. By
+  //      default a file is only promoted to RF64 when its data
+  //      doesn't fit in a RIFF file (i.e. exceeds 4GB).
+  //  INPUT:
+  //      None
+  //  OUTPUT:
+  //      None
+  //--------------------------------------------------------------
+  void ForceRf64();
 
   //--------------------------------------------------------------
   // 3. ACCESSORS
@@ -59,6 +85,13 @@ class WaveFile {
   uint16_t bits_per_sample();
   uint32_t subchunk_2_id();
   uint32_t subchunk_2_size();
+  // The size of the data in bytes. Unlike subchunk_2_size() this is
+  // valid for RF64 files too.
+  uint64_t data_size();
+  bool is_rf64();
+  SampleFormat sample_format() const;
+  // The number of bytes that precede the samples
+  std::size_t header_size() const;
 
  protected:
   //--------------------------------------------------------------
@@ -77,6 +110,22 @@ class WaveFile {
   void set_bits_per_sample(uint16_t value);
   void set_subchunk_2_id(uint32_t value);
   void set_subchunk_2_size(uint32_t value);
+  // Sets the size of the data and all the fields derived from it. This
+  // is where a file is promoted to RF64.
+  void set_data_size(uint64_t value);
+  // Reserve space for the "ds64" chunk in the header, so that the file
+  // can be promoted to RF64 after the header was written.
+  void set_reserve_ds64(bool value);
+  // Sets the number of channels, the format of the samples and all the
+  // fields derived from them
+  void set_sample_layout(uint16_t number_of_channels,
+                         SampleFormat sample_format);
+
+  //--------------------------------------------------------------
+  // HELPERS FOR DERIVED CLASSES
+  //--------------------------------------------------------------
+  void SerialiseHeader(uint8_t* header) const;
+  bool ParseChunks(int file_descriptor, uint64_t& data_offset);
 
  private:
   //---------------------------------------------------------
@@ -116,6 +165,30 @@ class WaveFile {
   //              +-------------------+   ---
   //
   //---------------------------------------------------------
+  // Files with more than 4GB of data are written in the RF64 format
+  // instead (see EBU Tech 3306). "RIFF" becomes "RF64", the 32-bit
+  // sizes are set to 0xFFFFFFFF and the actual, 64-bit sizes are stored
+  // in the "ds64" chunk, which precedes the "fmt " sub-chunk:
+  //
+  //  Field Size       Field name
+  //  (bytes)
+  //              +-------------------+    ---
+  //     4        | Ds64Id            |       |
+  //              |-------------------|       |
+  //     4        | Ds64Size (28)     |       |
+  //              |-------------------|       |
+  //     8        | RiffSize          |       |
+  //              |-------------------|       | ---> The "ds64" chunk
+  //     8        | DataSize          |       |
+  //              |-------------------|       |
+  //     8        | SampleCount       |       |
+  //              |-------------------|       |
+  //     4        | TableLength (0)   |       |
+  //              +-------------------+    ---
+  //
+  // A file that might have to be promoted once the samples are written
+  // holds a "JUNK" chunk of the same size in that place instead.
+  //---------------------------------------------------------
 
   uint32_t chunk_id_;
   // The size of the rest of the chunk following this number. This is
@@ -134,6 +207,83 @@ class WaveFile {
   uint16_t bits_per_sample_;
   uint32_t subchunk_2_id_;
   uint32_t subchunk_2_size_;
+
+  uint64_t data_size_;
+  bool rf64_;
+  bool force_rf64_;
+  bool reserve_ds64_;
+};
+
+//=============================================================
+//  CLASS: WaveFileOutMapping
+//
+// DESCRIPTION:
+//  A writable view of the samples in an output WAVE file that is
+//  mapped into memory (see WaveFileOut::MapBufferToFile()). The
+//  header is already in place, so oscillators and envelopes can
+//  render straight into the file - there's no buffer in user space
+//  and nothing is copied. The samples reach the disk through the
+//  page cache, at the latest when the file is unmapped (i.e. when
+//  this object is destroyed). It can be moved, but not copied.
+//=============================================================
+class WaveFileOutMapping {
+ public:
+  //--------------------------------------------------------------
+  // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+  //--------------------------------------------------------------
+  explicit WaveFileOutMapping();
+  ~WaveFileOutMapping();
+  WaveFileOutMapping(const WaveFileOutMapping& rhs) = delete;
+  WaveFileOutMapping(WaveFileOutMapping&& rhs);
+  WaveFileOutMapping& operator=(const WaveFileOutMapping& rhs) = delete;
+  WaveFileOutMapping& operator=(WaveFileOutMapping&& rhs);
+
+  //--------------------------------------------------------------
+  // 2. GENERAL USER INTERFACE
+  //--------------------------------------------------------------
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Evict()
+  //
+  //  DESCRIPTION:
+  //      Tells the kernel that the given samples are final: their
+  //      write-back is started and the pages are dropped from this
+  //      process (only whole pages within the range are). Call it
+  //      behind the render position to keep the resident set small
+  //      for arbitrarily long files.
+  //  INPUT:
+  //      first_sample      - the first sample of the range
+  //      number_of_samples - the length of the range
+  //  OUTPUT:
+  //      None
+  //--------------------------------------------------------------
+  void Evict(std::size_t first_sample, std::size_t number_of_samples);
+
+  //--------------------------------------------------------------
+  // 3. ACCESSORS
+  //--------------------------------------------------------------
+  int16_t* data() { return samples_; }
+  std::size_t size() const { return number_of_samples_; }
+  bool empty() const { return number_of_samples_ == 0; }
+  int16_t* begin() { return samples_; }
+  int16_t* end() { return samples_ + number_of_samples_; }
+
+ private:
+  //--------------------------------------------------------------
+  // 4. PRIVATE METHODS
+  //--------------------------------------------------------------
+  void Release();
+
+  //--------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------
+  // The whole file as mapped by mmap()
+  void* mapping_;
+  std::size_t mapping_size_;
+  // The samples within the mapping
+  int16_t* samples_;
+  std::size_t number_of_samples_;
+  friend class WaveFileOut;
 };
 
 //=============================================================
@@ -142,14 +292,21 @@ class WaveFile {
 // DESCRIPTION:
 //  Represents an output WAVE file. Implemented for writing WAVE
 //  files to disk. Does not hold output samples. These are always
-//  passed in an input vector.
+//  passed in an input vector, either already interleaved or as
+//  one (planar) vector per channel. Samples in 16-bit PCM are
+//  written as they are, floating point samples are converted to
+//  the format of the file.
 //=============================================================
 class WaveFileOut : public WaveFile {
  public:
   //--------------------------------------------------------------
   // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
   //--------------------------------------------------------------
-  explicit WaveFileOut(uint32_t number_of_seconds);
+  // The file holds number_of_seconds of samples at sample_rate
+  explicit WaveFileOut(uint32_t number_of_seconds,
+                       uint16_t number_of_channels = kNumberOfChannelsMono,
+                       SampleFormat sample_format = SampleFormat::kPcm16,
+                       uint32_t sample_rate = kCdSampleRate);
   ~WaveFileOut();
 
   //--------------------------------------------------------------
@@ -161,15 +318,248 @@ class WaveFileOut : public WaveFile {
   //
   //  DESCRIPTION:
   //      Saves the content of this file to the specified physical file.
-  //      The data samples are passed as argument.
+  //      The data samples are passed as argument. The header and the
+  //      samples are handed to the kernel together, in one vectored
+  //      write. Only for 16-bit PCM files.
   //  INPUT:
   //      The name of the file to write to and the data samples.
   //  OUTPUT:
-  //      Vector containing read samples.
-  //
+  //      True on success, false otherwise.
+  //  EXCEPTIONS:
+  //      BufferToSmallException
   //--------------------------------------------------------------
-  void SaveBufferToFile(const std::string& file_name,
+  bool SaveBufferToFile(const std::string& file_name,
                         std::vector<int16_t>& samples);
+
+  //--------------------------------------------------------------
+  //  NAME:
+  //      SaveBufferToFile()
+  //
+  //  DESCRIPTION:
+  //      Like above, but the samples are passed as one buffer per
+  //      channel. The channels are interleaved into frames (see
+  //      InterleaveChannels()) through a fixed-size buffer, one
+  //      buffer-full at a time, so no interleaved copy of the whole
+  //      file is ever made. Only for 16-bit PCM files.
+  //  INPUT:
+  //      The name of the file to write to and the data samples,
+  //      num_channels() buffers of equal length.
+  //  OUTPUT:
+  //      True on success, false otherwise.
+  //  EXCEPTIONS:
+  //      BufferToSmallException
+  //--------------------------------------------------------------
+  bool SaveBufferToFile(const std::string& file_name,
+                        const std::vector<std::vector<int16_t>>& channels);
+
+  //--------------------------------------------------------------
+  //  NAME:
+  //      SaveBufferToFile()
+  //
+  //  DESCRIPTION:
+  //      Like above, but the (interleaved) samples are floating point
+  //      numbers. Float files are written straight from the input
+  //      vector. For PCM files the samples are converted (see
+  //      ConvertFloatToPcm16/24()) through a fixed-size buffer.
+  //  INPUT:
+  //      The name of the file to write to and the data samples.
+  //  OUTPUT:
+  //      True on success, false otherwise.
+  //  EXCEPTIONS:
+  //      BufferToSmallException
+  //--------------------------------------------------------------
+  bool SaveBufferToFile(const std::string& file_name,
+                        const std::vector<float>& samples);
+
+  //--------------------------------------------------------------
+  //  NAME:
+  //      SaveBufferToFlacFile()
+  //
+  //  DESCRIPTION:
+  //      Like the first SaveBufferToFile(), but the samples are
+  //      compressed losslessly (see FlacEncoder) and saved as a FLAC
+  //      file instead. The frames of the file are encoded in
+  //      parallel. Only for 16-bit PCM.
+  //  INPUT:
+  //      The name of the file to write to, the data samples and the
+  //      number of threads to encode with.
+  //  OUTPUT:
+  //      True on success, false otherwise.
+  //  EXCEPTIONS:
+  //      BufferToSmallException
+  //--------------------------------------------------------------
+  bool SaveBufferToFlacFile(const std::string& file_name,
+                            std::vector<int16_t>& samples,
+                            std::size_t number_of_threads = 1);
+
+  //--------------------------------------------------------------
+  //  NAME:
+  //      MapBufferToFile()
+  //
+  //  DESCRIPTION:
+  //      Creates (or truncates) the file, allocates all of its blocks
+  //      up-front (so that rendering can't run out of disk space
+  //      half-way through a file), writes the header and maps the
+  //      file into memory. The returned view covers all the samples
+  //      of the file, which are rendered into it in place, e.g. with
+  //      Oscillator::operator()(int16_t*, std::size_t). Only for
+  //      16-bit PCM files.
+  //  INPUT:
+  //      The name of the file to write to.
+  //  OUTPUT:
+  //      View of the samples. Empty if the file could not be created
+  //      or mapped.
+  //--------------------------------------------------------------
+  WaveFileOutMapping MapBufferToFile(const std::string& file_name);
+
+  //--------------------------------------------------------------
+  // 4. MUTATORS
+  //--------------------------------------------------------------
+  // Resizes the file to number_of_frames frames (one sample per
+  // channel), for sounds that don't last a whole number of seconds
+  void set_number_of_frames(uint64_t number_of_frames);
+};
+
+//=============================================================
+// CLASS: WaveFileStreamOut
+//
+// DESCRIPTION:
+//  Represents an output WAVE file that is written incrementally,
+//  block by block, as the samples are rendered. Neither the length
+//  of the file nor the samples need to be known up-front. Open()
+//  writes a placeholder header, Append() streams the samples to
+//  disk and Close() patches the sizes in the header. Memory usage
+//  doesn't depend on the length of the file.
+//=============================================================
+class WaveFileStreamOut : public WaveFile {
+ public:
+  //--------------------------------------------------------------
+  // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+  //--------------------------------------------------------------
+  explicit WaveFileStreamOut(
+      uint16_t number_of_channels = kNumberOfChannelsMono,
+      SampleFormat sample_format = SampleFormat::kPcm16,
+      uint32_t sample_rate = kCdSampleRate);
+  // Closes the file if it's still open
+  ~WaveFileStreamOut();
+
+  //--------------------------------------------------------------
+  // 2. GENERAL USER INTERFACE
+  //--------------------------------------------------------------
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Open()
+  //
+  //  DESCRIPTION:
+  //      Creates (or truncates) the file and writes a header for a
+  //      file without samples.
+  //  INPUT:
+  //      The name of the file to write to.
+  //  OUTPUT:
+  //      True on success, false otherwise.
+  //--------------------------------------------------------------
+  bool Open(const std::string& file_name);
+
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Append()
+  //
+  //  DESCRIPTION:
+  //      Writes a block of samples at the end of the file. The file
+  //      has to be open. For multichannel files the samples are
+  //      interleaved frames. 16-bit samples can only be appended to
+  //      16-bit PCM files. Floating point samples are converted to
+  //      the format of the file.
+  //  INPUT:
+  //      The samples to write.
+  //  OUTPUT:
+  //      True on success, false otherwise.
+  //--------------------------------------------------------------
+  bool Append(const int16_t* samples, std::size_t number_of_samples);
+  bool Append(const std::vector<int16_t>& samples);
+  bool Append(const float* samples, std::size_t number_of_samples);
+  bool Append(const std::vector<float>& samples);
+
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Close()
+  //
+  //  DESCRIPTION:
+  //      Updates the header with the final sizes and closes the file.
+  //      If there's more than 4GB of samples, the file is promoted to
+  //      RF64 (Open() reserves space for this in the header). Calling
+  //      this method on a file that's not open does nothing.
+  //  INPUT:
+  //      None
+  //  OUTPUT:
+  //      True on success, false otherwise.
+  //--------------------------------------------------------------
+  bool Close();
+
+  //--------------------------------------------------------------
+  // 3. ACCESSORS
+  //--------------------------------------------------------------
+  bool IsOpen() const { return file_descriptor_ >= 0; }
+  uint64_t number_of_samples_written() const;
+
+ private:
+  //--------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------
+  int file_descriptor_;
+  // The number of bytes of samples written so far
+  uint64_t bytes_written_;
+  // Floating point samples are converted to PCM here
+  std::vector<uint8_t> conversion_buffer_;
+};
+
+//=============================================================
+//  CLASS: WaveFileMapping
+//
+// DESCRIPTION:
+//  A read-only view of the samples in a WAVE file that is mapped
+//  into memory (see WaveFileIn::MapBufferFromFile()). The samples
+//  are paged in by the kernel on first access and are never
+//  copied. The file stays mapped for as long as this object
+//  exists. It can be moved, but not copied.
+//=============================================================
+class WaveFileMapping {
+ public:
+  //--------------------------------------------------------------
+  // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+  //--------------------------------------------------------------
+  explicit WaveFileMapping();
+  ~WaveFileMapping();
+  WaveFileMapping(const WaveFileMapping& rhs) = delete;
+  WaveFileMapping(WaveFileMapping&& rhs);
+  WaveFileMapping& operator=(const WaveFileMapping& rhs) = delete;
+  WaveFileMapping& operator=(WaveFileMapping&& rhs);
+
+  //--------------------------------------------------------------
+  // 3. ACCESSORS
+  //--------------------------------------------------------------
+  const int16_t* data() const { return samples_; }
+  std::size_t size() const { return number_of_samples_; }
+  bool empty() const { return number_of_samples_ == 0; }
+  const int16_t* begin() const { return samples_; }
+  const int16_t* end() const { return samples_ + number_of_samples_; }
+
+ private:
+  //--------------------------------------------------------------
+  // 4. PRIVATE METHODS
+  //--------------------------------------------------------------
+  void Release();
+
+  //--------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------
+  // The whole file as mapped by mmap()
+  void* mapping_;
+  std::size_t mapping_size_;
+  // The samples within the mapping
+  const int16_t* samples_;
+  std::size_t number_of_samples_;
+  friend class WaveFileIn;
 };
 
 //=============================================================
@@ -179,14 +569,18 @@ class WaveFileOut : public WaveFile {
 // DESCRIPTION:
 //  Represents an input WAVE file. Implemented for reading WAVE
 //  files from disk. Does not hold the input samples. Instead it reads
-//  them and returns to the user when requested.
+//  them and returns to the user when requested. The header is found
+//  by walking the list of RIFF chunks, so files with chunks other
+//  than the canonical ones (e.g. "LIST", "fact" or "bext") are read
+//  correctly. Once a file is open (see Open()), any range of frames
+//  can be read from it (see ReadFrames()) without reading the rest.
 //=============================================================
 class WaveFileIn : public WaveFile {
  public:
   //--------------------------------------------------------------
   // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
   //--------------------------------------------------------------
-  explicit WaveFileIn() {}
+  explicit WaveFileIn();
   ~WaveFileIn();
 
   //--------------------------------------------------------------
@@ -199,18 +593,139 @@ class WaveFileIn : public WaveFile {
   //  DESCRIPTION:
   //      Reads a WaveFile. The WAVE header is saved in the appropriate
   //      variables in the base clase. The audio samples are read into
-  //      a vector and returned. The Wave file is expected to be in the
-  //      canonical WAVE format as described above (see also:
-  //      http://soundfile.sapp.org/doc/WaveFormat/).
+  //      a vector, with one bulk read, and returned. The Wave file is
+  //      expected to be in the canonical WAVE format as described
+  //      above (see also: http://soundfile.sapp.org/doc/WaveFormat/),
+  //      possibly with additional chunks, or in the RF64 format.
+  //      24-bit and floating point samples are converted to 16 bits.
+  //      FLAC files (see SaveBufferToFlacFile()) are recognised and
+  //      decoded - the header then describes the decoded samples.
   //  INPUT:
   //      The name of the file to read.
   //  OUTPUT:
-  //      Vector containing read samples.
-  //  EXCEPTIONS:
-  //      BufferToSmallException, std::ofstream::failure
+  //      Vector containing read samples. Empty if the file could not
+  //      be read.
   //
   //--------------------------------------------------------------
   std::vector<int16_t> ReadBufferFromFile(const std::string& file_name);
+
+  //--------------------------------------------------------------
+  //  NAME:
+  //      MapBufferFromFile()
+  //
+  //  DESCRIPTION:
+  //      Like ReadBufferFromFile(), but instead of copying the audio
+  //      samples into a vector the file is mapped into memory and a
+  //      read-only view of the samples is returned. Nothing is read
+  //      until the samples are accessed. Suitable for large files
+  //      and sample libraries.
+  //  INPUT:
+  //      The name of the file to map.
+  //  OUTPUT:
+  //      View of the samples. Empty if the file could not be mapped
+  //      or doesn't contain 16-bit samples.
+  //
+  //--------------------------------------------------------------
+  WaveFileMapping MapBufferFromFile(const std::string& file_name);
+
+  //--------------------------------------------------------------
+  //  NAME:
+  //      ReadFloatBufferFromFile()
+  //
+  //  DESCRIPTION:
+  //      Like ReadBufferFromFile(), but the samples are returned as
+  //      floating point numbers in the range [-1, 1). Float files are
+  //      read straight into the output vector, PCM files are converted
+  //      through a fixed-size buffer.
+  //  INPUT:
+  //      The name of the file to read.
+  //  OUTPUT:
+  //      Vector containing read samples.
+  //--------------------------------------------------------------
+  std::vector<float> ReadFloatBufferFromFile(const std::string& file_name);
+
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Open()
+  //
+  //  DESCRIPTION:
+  //      Opens the file for random access and parses its header. The
+  //      chunks are walked with positioned reads, skipping the ones
+  //      that aren't needed, until the "data" chunk is found. Its
+  //      size is trimmed to the whole frames that are actually in the
+  //      file, so that truncated files can still be read. No samples
+  //      are read.
+  //  INPUT:
+  //      The name of the file to open.
+  //  OUTPUT:
+  //      True on success. False if the file could not be opened, is
+  //      not a WAVE file or its samples are in a format other than
+  //      those in SampleFormat.
+  //--------------------------------------------------------------
+  bool Open(const std::string& file_name);
+
+  //--------------------------------------------------------------
+  //  NAME:
+  //      ReadFrames()
+  //
+  //  DESCRIPTION:
+  //      Reads a range of frames (one sample from every channel) from
+  //      the file opened with Open(). Only the requested frames are
+  //      read, with positioned reads, so any number of threads can
+  //      read from the same file at the same time. Samples in formats
+  //      other than the requested one are converted.
+  //  INPUT:
+  //      first_frame - the index of the first frame to read
+  //      count       - the number of frames to read
+  //      samples     - the output buffer, large enough for
+  //                    count * num_channels() samples
+  //  OUTPUT:
+  //      The number of frames read (the vector version returns the
+  //      samples instead). Less than requested if the range extends
+  //      past the end of the data, 0 if the read failed.
+  //--------------------------------------------------------------
+  std::size_t ReadFrames(uint64_t first_frame, std::size_t count,
+                         int16_t* samples);
+  std::size_t ReadFrames(uint64_t first_frame, std::size_t count,
+                         float* samples);
+  std::vector<int16_t> ReadFrames(uint64_t first_frame, std::size_t count);
+
+  //--------------------------------------------------------------
+  //  NAME:
+  //      Close()
+  //
+  //  DESCRIPTION:
+  //      Closes the file opened with Open(). Calling this method on a
+  //      file that's not open does nothing. The header stays valid.
+  //  INPUT:
+  //      None
+  //  OUTPUT:
+  //      True on success, false otherwise.
+  //--------------------------------------------------------------
+  bool Close();
+
+  //--------------------------------------------------------------
+  // 3. ACCESSORS
+  //--------------------------------------------------------------
+  bool IsOpen() const { return file_descriptor_ >= 0; }
+  // The position of the first sample in the file
+  uint64_t data_offset() const { return data_offset_; }
+  uint64_t number_of_frames();
+
+ private:
+  //--------------------------------------------------------------
+  // 4. PRIVATE METHODS
+  //--------------------------------------------------------------
+  bool ReadFlacFile(const std::string& file_name,
+                    std::vector<int16_t>& samples);
+  bool ReadSamples(uint64_t first_sample, std::size_t number_of_samples,
+                   float* samples);
+
+  //--------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------
+  int file_descriptor_;
+  uint64_t data_offset_;
 };
 
 //=============================================================
@@ -53,7 +53,51 @@ class Envelope {
   //  OUTPUT:
   //      None
   //--------------------------------------------------------------------
-  virtual void ApplyEnvelope(std::vector<int16_t> &samples) const = 0;
+  void ApplyEnvelope(std::vector<int16_t> &samples) const {
+    ApplyEnvelope(samples.data(), samples.size());
+  }
+
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      ApplyEnvelope()
+  //
+  //  DESCRIPTION:
+  //      Like above, but the signal can live anywhere, e.g. in a file
+  //      mapped with WaveFileOut::MapBufferToFile().
+  //  INPUT:
+  //      samples           - the signal, modified in place
+  //      number_of_samples - the length of the signal
+  //  OUTPUT:
+  //      None
+  //--------------------------------------------------------------------
+  virtual void ApplyEnvelope(int16_t *samples,
+                             std::size_t number_of_samples) const = 0;
+
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      ApplyEnvelopeBatch()
+  //
+  //  DESCRIPTION:
+  //      Apply the envelope represented by this object to every buffer
+  //      passed as input. The result is identical to calling
+  //      ApplyEnvelope() for every buffer, but the work is tiled: every
+  //      block of kEnvelopeBatchBlockSize gains is applied to all buffers
+  //      before moving on to the next block, so that the gains stay in
+  //      L1 instead of being re-streamed from memory for every buffer.
+  //      Optionally, the buffers are split between several threads
+  //      (every thread runs the same tiled loop over its share).
+  //  INPUT:
+  //      buffers           - buffers on which the envelope will be
+  //                          applied. All buffers have to be of identical
+  //                          length and satisfy the requirements of
+  //                          ApplyEnvelope().
+  //      number_of_threads - the number of threads to use (1 means that
+  //                          the caller's thread does all the work)
+  //  OUTPUT:
+  //      None
+  //--------------------------------------------------------------------
+  void ApplyEnvelopeBatch(std::vector<std::vector<int16_t>> &buffers,
+                          std::size_t number_of_threads = 1) const;
 
   //--------------------------------------------------------------------
   // 3. ACCESSORS
@@ -66,6 +110,37 @@ class Envelope {
   //--------------------------------------------------------------------
   // None
 
+  //--------------------------------------------------------------------
+  // HELPERS FOR DERIVED CLASSES
+  //--------------------------------------------------------------------
+  // A segment together with the position of its first sample within the
+  // signal that the envelope is applied to.
+  struct SegmentSpan {
+    Segment *segment;
+    std::size_t offset;
+  };
+
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      GetSegmentSpans()
+  //
+  //  DESCRIPTION:
+  //      Describes where every segment of this envelope is applied within
+  //      a signal of the given length.
+  //  INPUT:
+  //      number_of_samples - the length of the signal
+  //      spans             - filled with one entry per segment
+  //  OUTPUT:
+  //      None
+  //--------------------------------------------------------------------
+  virtual void GetSegmentSpans(std::size_t number_of_samples,
+                               std::vector<SegmentSpan> &spans) const = 0;
+
+  static void PrepareSegment(Segment &segment);
+  static void ApplySegment(Segment &segment, int16_t *samples);
+  static void ApplySegmentRange(const Segment &segment, std::size_t begin,
+                                std::size_t end, int16_t *samples);
+
  private:
   //--------------------------------------------------------------------
   // 5. DATA MEMMBERS
@@ -102,14 +177,16 @@ class ArEnvelope : public Envelope {
   //      decay_duration_arg  - Duration of the decay in seconds. Has
   //                            to be non-negative.
   //--------------------------------------------------------------------
-  explicit ArEnvelope(SynthConfig &synthesiser, float peak_amplitude_arg,
+  explicit ArEnvelope(const SynthConfig &synthesiser, float peak_amplitude_arg,
                       double attack_duration_arg, double decay_duration_arg);
   virtual ~ArEnvelope() = default;
 
   //--------------------------------------------------------------------
   // 2. GENERAL USER INTERFACE
   //--------------------------------------------------------------------
-  void ApplyEnvelope(std::vector<int16_t> &samples) const final;
+  using Envelope::ApplyEnvelope;
+  void ApplyEnvelope(int16_t *samples,
+                     std::size_t number_of_samples) const final;
 
   //--------------------------------------------------------------------
   // 3. ACCESSORS
@@ -123,13 +200,21 @@ class ArEnvelope : public Envelope {
   // None
 
  private:
+  //--------------------------------------------------------------------
+  // INTERFACE DEFINITION
+  //--------------------------------------------------------------------
+  void GetSegmentSpans(std::size_t number_of_samples,
+                       std::vector<SegmentSpan> &spans) const final;
+
   //--------------------------------------------------------------------
   // 5. DATA MEMMBERS
   //--------------------------------------------------------------------
   std::size_t attack_number_of_samples_;
   std::size_t decay_number_of_samples_;
-  LinearSegment decay_segment_;
-  LinearSegment attack_segment_;
+  // The segments generate their samples on first use, i.e. from within
+  // ApplyEnvelope(), which is const (see Envelope::PrepareSegment())
+  mutable LinearSegment decay_segment_;
+  mutable LinearSegment attack_segment_;
 };
 
 //========================================================================
@@ -173,7 +258,9 @@ class AdsrEnvelope : public Envelope {
   //--------------------------------------------------------------------
   // 2. GENERAL USER INTERFACE
   //--------------------------------------------------------------------
-  void ApplyEnvelope(std::vector<int16_t> &samples) const final;
+  using Envelope::ApplyEnvelope;
+  void ApplyEnvelope(int16_t *samples,
+                     std::size_t number_of_samples) const final;
 
   //--------------------------------------------------------------------
   // 3. ACCESSORS
@@ -187,6 +274,12 @@ class AdsrEnvelope : public Envelope {
   // None
 
  private:
+  //--------------------------------------------------------------------
+  // INTERFACE DEFINITION
+  //--------------------------------------------------------------------
+  void GetSegmentSpans(std::size_t number_of_samples,
+                       std::vector<SegmentSpan> &spans) const final;
+
   //--------------------------------------------------------------------
   // 5. DATA MEMMBERS
   //--------------------------------------------------------------------
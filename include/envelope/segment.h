@@ -16,9 +16,12 @@
 
 #include <global/global_include.h>
 
+#include <mutex>
+
 //========================================================================
 // FORWARD DECLARATIONS
 //========================================================================
+class Envelope;
 class ArEnvelope;
 class AdsrEnvelope;
 
@@ -84,9 +87,12 @@ class Segment {
   //      GenerateSamples()
   //
   //  DESCRIPTION:
-  //      Generates the samples for this segment. Note that every time the
-  //      parameters of a segment are changed, this method needs to be called
-  //      to regrenerate the samples.
+  //      Generates the samples for this segment. Segments don't generate
+  //      their samples on construction. Instead, this method is called on
+  //      first use (e.g. from GetSamples() or when the segment is applied
+  //      by an envelope). Every time the parameters of a segment are
+  //      changed the samples are invalidated and will be regenerated on
+  //      next use. Calling this method directly is still allowed.
   //  INPUT:
   //      None
   //  OUTPUT:
@@ -99,7 +105,9 @@ class Segment {
   //      operator[]
   //
   //  DESCRIPTION:
-  //      Return the n-th element in the segment.
+  //      Return the n-th element in the segment. The non-const version
+  //      generates the samples first if necessary, the const version
+  //      requires them to have been generated already.
   //  INPUT:
   //      Index of the segment element to be returned.
   //  OUTPUT:
@@ -121,7 +129,7 @@ class Segment {
   //--------------------------------------------------------------------
   virtual bool IsEmpty() const = 0;
 
-  bool IsGenerated() { return generated_; }
+  bool IsGenerated() const { return generated_; }
 
   //--------------------------------------------------------------------
   //  NAME:
@@ -136,15 +144,39 @@ class Segment {
   //--------------------------------------------------------------------
   virtual std::size_t GetLength() const = 0;
 
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      IsConstant()
+  //
+  //  DESCRIPTION:
+  //      Checks whether every sample in this segment has the same value.
+  //      Applying such a segment reduces to scaling by a single gain, so
+  //      envelopes can skip the per-sample table altogether.
+  //  INPUT:
+  //      gain - set to the value of the segment if it is constant
+  //  OUTPUT:
+  //      True if the segment is constant, false otherwise.
+  //--------------------------------------------------------------------
+  virtual bool IsConstant(float& gain) const { return false; }
+
   //--------------------------------------------------------------------
   // 3. ACCESSORS
   //--------------------------------------------------------------------
   // None
 
  protected:
+  // Discards the samples after the parameters were changed, so that
+  // they're regenerated on next use
+  void Invalidate();
+
   std::vector<float> samples_;
   bool generated_;
   std::size_t number_of_samples_;
+  // Envelopes generate the samples through this flag, so that a segment
+  // applied from several threads at once is generated exactly once (see
+  // Envelope::PrepareSegment()). Replaced by Invalidate().
+  std::unique_ptr<std::once_flag> generate_once_;
+  friend Envelope;
 
  private:
   //--------------------------------------------------------------------
@@ -192,12 +224,12 @@ class ConstantSegment : public Segment {
   //--------------------------------------------------------------------
   void SetAmplitude(float amp) {
     amplitude_ = amp;
-    generated_ = false;
+    Invalidate();
   }
 
   void SetNumberOfSamples(size_t n) {
     number_of_samples_ = n;
-    generated_ = false;
+    Invalidate();
   }
 
   //--------------------------------------------------------------------
@@ -206,6 +238,7 @@ class ConstantSegment : public Segment {
   virtual void GenerateSamples() override;
   bool IsEmpty() const override;
   std::size_t GetLength() const override;
+  bool IsConstant(float& gain) const override;
 
  private:
   //--------------------------------------------------------------------
@@ -259,17 +292,17 @@ class LinearSegment : public Segment {
   //--------------------------------------------------------------------
   void SetPeakAmplitude(float amp) {
     peak_amplitude_ = amp;
-    generated_ = false;
+    Invalidate();
   }
 
   void SetNumberOfSamples(size_t n) {
     number_of_samples_ = n;
-    generated_ = false;
+    Invalidate();
   }
 
   void SetGradient(SegmentGradient grad) {
     seg_gradient_ = grad;
-    generated_ = false;
+    Invalidate();
   }
 
   //--------------------------------------------------------------------
@@ -278,6 +311,7 @@ class LinearSegment : public Segment {
   virtual void GenerateSamples() override;
   bool IsEmpty() const override;
   std::size_t GetLength() const override;
+  bool IsConstant(float& gain) const override;
 
  private:
   //--------------------------------------------------------------------
@@ -329,22 +363,22 @@ class ExponentialSegment : public Segment {
   //--------------------------------------------------------------------
   void SetStartAmplitude(float amp) {
     amplitude_start_ = amp;
-    generated_ = false;
+    Invalidate();
   }
 
   void SetEndAmplitude(float amp) {
     amplitude_end_ = amp;
-    generated_ = false;
+    Invalidate();
   }
 
   void SetExponent(float exp) {
     exponent_ = exp;
-    generated_ = false;
+    Invalidate();
   }
 
   void SetNumberOfSamples(size_t n) {
     number_of_samples_ = n;
-    generated_ = false;
+    Invalidate();
   }
 
   //--------------------------------------------------------------------
@@ -353,6 +387,7 @@ class ExponentialSegment : public Segment {
   virtual void GenerateSamples() override;
   bool IsEmpty() const override;
   std::size_t GetLength() const override;
+  bool IsConstant(float& gain) const override;
 
   //--------------------------------------------------------------------
   // 3. ACCESSORS
@@ -15,18 +15,15 @@
 #ifndef GLOBAL_H
 #define GLOBAL_H
 
+#include <cstddef>
 #include <cstdint>
 
 //=============================================================
 // Floating point globals
 //=============================================================
-extern const double kTwelthRootOfTwo;
-
 extern const double kPi;
 extern const double kTwoPi;
 
-extern const double kNoteC0;
-
 extern const double kEps;
 
 //=============================================================
@@ -37,10 +34,23 @@ extern const double kEps;
 //-------------------------------------------------------------
 extern const uint16_t kNumberOfBitsPerByte;
 extern const uint8_t kNumberOfBitsPerSample;
+extern const uint8_t kNumberOfBitsPerSample24;
+extern const uint8_t kNumberOfBitsPerSample32;
+
+extern const float kPcm16FullScale;
+extern const float kPcm24FullScale;
 
 extern const uint8_t kWaveFileHeaderSize;
+extern const uint8_t kWaveFileCanonicalHeaderSize;
+extern const uint8_t kWaveFileExtendedHeaderSize;
 
 extern const uint32_t kRiffChunkId;
+extern const uint32_t kRf64ChunkId;
+extern const uint32_t kRf64SizePlaceholder;
+
+extern const uint32_t kDs64ChunkId;
+extern const uint32_t kJunkChunkId;
+extern const uint32_t kDs64ChunkSize;
 
 extern const uint32_t kRiffFormat;
 
@@ -51,15 +61,84 @@ extern const uint32_t kDataSubchunkId;
 extern const uint32_t kPcmSubchunk1Size;
 
 extern const uint16_t kPcmAudioFormat;
+extern const uint16_t kIeeeFloatAudioFormat;
+extern const uint16_t kExtensibleAudioFormat;
+extern const uint32_t kExtensibleSubFormatOffset;
 
 extern const uint16_t kNumberOfChannelsMono;
 extern const uint16_t kNumberOfChannelsStereo;
 
+extern const std::size_t kInterleaveBlockSize;
+extern const std::size_t kWaveFileWriteBufferSize;
+
+extern const std::size_t kAsyncWaveWriterBlockSize;
+extern const std::size_t kAsyncWaveWriterNumberOfBlocks;
+
+extern const std::size_t kWaveExportNumberOfThreads;
+extern const std::size_t kWaveExportMaxFilesInFlight;
+
+extern const std::size_t kPcmStreamBufferSize;
+extern const std::size_t kPcmStreamAlignment;
+extern const uint32_t kWaveFileUnknownSize;
+
+extern const uint32_t kFlacStreamMarker;
+extern const std::size_t kFlacBlockSize;
+extern const std::size_t kFlacMaxLpcOrder;
+extern const unsigned kFlacLpcPrecision;
+extern const unsigned kFlacMaxPartitionOrder;
+
+//-------------------------------------------------------------
+// Oversampler
+//-------------------------------------------------------------
+extern const std::size_t kOversamplerBlockSize;
+extern const std::size_t kHalfBandFinalStageLength;
+extern const std::size_t kHalfBandStageLength;
+
+//-------------------------------------------------------------
+// SampleRateConverter
+//-------------------------------------------------------------
+extern const std::size_t kResamplerNumberOfTaps;
+extern const std::size_t kResamplerMaxNumberOfPhases;
+extern const double kResamplerCutoff;
+extern const double kResamplerKaiserBeta;
+extern const std::size_t kResamplerBlockSize;
+
+//-------------------------------------------------------------
+// MixerBus
+//-------------------------------------------------------------
+extern const std::size_t kMixerBlockSize;
+
 //-------------------------------------------------------------
 // SynthConfig
 //-------------------------------------------------------------
 extern const std::size_t kNumberOfFrequencies;
 
+//-------------------------------------------------------------
+// VoiceManager
+//-------------------------------------------------------------
+extern const std::size_t kNumberOfVoices;
+
+//-------------------------------------------------------------
+// ProcessingGraph
+//-------------------------------------------------------------
+extern const std::size_t kGraphBlockSize;
+
+//-------------------------------------------------------------
+// MidiFile
+//-------------------------------------------------------------
+extern const uint32_t kMidiHeaderChunkId;
+extern const uint32_t kMidiTrackChunkId;
+extern const uint8_t kMidiSetTempoType;
+extern const uint8_t kMidiEndOfTrackType;
+extern const uint32_t kMidiDefaultTempo;
+extern const uint8_t kMidiNoteOfFirstPitch;
+extern const std::size_t kMidiNumberOfChannels;
+
+//-------------------------------------------------------------
+// Envelope
+//-------------------------------------------------------------
+extern const std::size_t kEnvelopeBatchBlockSize;
+
 //-------------------------------------------------------------
 // General
 //-------------------------------------------------------------
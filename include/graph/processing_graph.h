@@ -0,0 +1,254 @@
+//========================================================================
+//  FILE:
+//      include/graph/processing_graph.h
+//
+//  AUTHOR:
+//      zimzum@github
+//
+//  DESCRIPTION:
+//      Defines the classes for chaining the stages of the synthesiser
+//      into a graph that's processed in blocks:
+//       a) ProcessorNode - pure abstract base class for the nodes
+//       b) ProcessingGraph - the graph
+//
+//  License: GNU GPL v2.0
+//========================================================================
+
+#ifndef PROCESSING_GRAPH_H
+#define PROCESSING_GRAPH_H
+
+#include <global/global_include.h>
+#include <graph/work_stealing_pool.h>
+
+//========================================================================
+// CLASS: ProcessorNode
+//
+// DESCRIPTION:
+//      Base class for the nodes of a ProcessingGraph - defines the
+//      interface. A node reads a fixed number of input signals and
+//      writes one output signal (unless it's a sink), one block at a
+//      time. Nodes keep their state (e.g. a phase) between blocks.
+//      When the graph runs on several threads, different nodes may be
+//      processed at the same time, so nodes must not share any state
+//      that isn't read-only (e.g. two VoiceNodes can't share a
+//      VoiceManager).
+//========================================================================
+class ProcessorNode {
+ public:
+  //--------------------------------------------------------------------
+  // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+  //--------------------------------------------------------------------
+  explicit ProcessorNode(std::size_t number_of_inputs);
+  virtual ~ProcessorNode();
+  explicit ProcessorNode(const ProcessorNode& rhs) = delete;
+  explicit ProcessorNode(ProcessorNode&& rhs) = delete;
+  ProcessorNode& operator=(const ProcessorNode& rhs) = delete;
+  ProcessorNode& operator=(ProcessorNode&& rhs) = delete;
+
+  //--------------------------------------------------------------------
+  // 2. GENERAL USER INTERFACE
+  //--------------------------------------------------------------------
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      Process()
+  //
+  //  DESCRIPTION:
+  //      Processes the next block. The output never shares memory with
+  //      any of the inputs.
+  //  INPUT:
+  //      inputs            - number_of_inputs() input blocks
+  //      output            - the output block (nullptr for sinks)
+  //      number_of_samples - the length of the blocks
+  //  OUTPUT:
+  //      None
+  //--------------------------------------------------------------------
+  virtual void Process(const float* const* inputs, float* output,
+                       std::size_t number_of_samples) = 0;
+
+  //--------------------------------------------------------------------
+  // 3. ACCESSORS
+  //--------------------------------------------------------------------
+  std::size_t number_of_inputs() const { return number_of_inputs_; }
+  // Sinks consume their inputs, but don't produce a signal
+  virtual bool has_output() const { return true; }
+
+ private:
+  //--------------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------------
+  const std::size_t number_of_inputs_;
+};
+
+//========================================================================
+// CLASS: ProcessingGraph
+//
+// DESCRIPTION:
+//      A directed acyclic graph of ProcessorNodes, e.g.:
+//
+//          OscillatorNode -> FmNode -> EnvelopeNode -> SinkNode
+//
+//      Once all the nodes are connected, Compile() works out the order
+//      in which the nodes run (every node after all of its inputs) and
+//      which buffer holds the output of every node. The buffers come
+//      from a pool and are reused: a buffer goes back to the pool as
+//      soon as the last node that reads it has run (liveness analysis),
+//      so the graph needs as many buffers as there are signals alive at
+//      the same time, rather than one per node. After that, processing
+//      a block just runs the nodes in order - nothing is allocated or
+//      looked up.
+//
+//      Independent branches (e.g. separate voices or buses) can also run
+//      on several threads. Every block is then a run of a
+//      WorkStealingPool: a node starts as soon as the nodes feeding it
+//      have finished the block, on whichever thread is free. A buffer is
+//      then only reused by a node that depends on all the nodes that
+//      used it before, so the nodes that may run at the same time never
+//      share a buffer. Every node still processes every block exactly
+//      once and only after its inputs, so the output doesn't depend on
+//      the number of threads.
+//========================================================================
+class ProcessingGraph {
+ public:
+  //--------------------------------------------------------------------
+  // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+  //--------------------------------------------------------------------
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      ProcessingGraph()
+  //
+  //  DESCRIPTION:
+  //      Constructor
+  //  INPUT:
+  //      block_size        - the maximum length of the blocks
+  //      number_of_threads - the number of threads that process every
+  //                          block (1 for the calling thread only)
+  //--------------------------------------------------------------------
+  explicit ProcessingGraph(std::size_t block_size = kGraphBlockSize,
+                           std::size_t number_of_threads = 1);
+  ~ProcessingGraph();
+  explicit ProcessingGraph(const ProcessingGraph& rhs) = delete;
+  explicit ProcessingGraph(ProcessingGraph&& rhs) = delete;
+  ProcessingGraph& operator=(const ProcessingGraph& rhs) = delete;
+  ProcessingGraph& operator=(ProcessingGraph&& rhs) = delete;
+
+  //--------------------------------------------------------------------
+  // 2. GENERAL USER INTERFACE
+  //--------------------------------------------------------------------
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      AddNode()
+  //
+  //  DESCRIPTION:
+  //      Adds a node to the graph. The graph takes the ownership of the
+  //      node.
+  //  INPUT:
+  //      node - the node
+  //  OUTPUT:
+  //      The id of the node within this graph.
+  //--------------------------------------------------------------------
+  std::size_t AddNode(std::unique_ptr<ProcessorNode> node);
+
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      Connect()
+  //
+  //  DESCRIPTION:
+  //      Feeds the output of one node to an input of another one. The
+  //      same output can feed any number of inputs, but every input is
+  //      fed by one output (connecting it again replaces the source).
+  //  INPUT:
+  //      source      - the id of the node that produces the signal
+  //      destination - the id of the node that consumes it
+  //      input       - the index of the input of the destination
+  //  OUTPUT:
+  //      None
+  //--------------------------------------------------------------------
+  void Connect(std::size_t source, std::size_t destination,
+               std::size_t input = 0);
+
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      Compile()
+  //
+  //  DESCRIPTION:
+  //      Computes the order of execution and assigns the buffers (see
+  //      above). Has to be called after the graph was modified and
+  //      before it's processed.
+  //  INPUT:
+  //      None
+  //  OUTPUT:
+  //      True on success. False if an input isn't connected or the
+  //      graph has a cycle.
+  //--------------------------------------------------------------------
+  bool Compile();
+
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      Process()
+  //
+  //  DESCRIPTION:
+  //      Runs the graph for the given number of samples, in blocks of
+  //      at most block_size() samples. The graph has to be compiled.
+  //      Returns once all the nodes have processed all the samples.
+  //  INPUT:
+  //      number_of_samples - the number of samples to process
+  //  OUTPUT:
+  //      None
+  //--------------------------------------------------------------------
+  void Process(std::size_t number_of_samples);
+
+  //--------------------------------------------------------------------
+  // 3. ACCESSORS
+  //--------------------------------------------------------------------
+  std::size_t block_size() const { return block_size_; }
+  std::size_t number_of_threads() const {
+    return (pool_ != nullptr) ? pool_->number_of_threads() : 1;
+  }
+  std::size_t number_of_nodes() const { return nodes_.size(); }
+  ProcessorNode& node(std::size_t node_id) { return *nodes_[node_id].node; }
+  bool is_compiled() const { return compiled_; }
+  // The order in which the nodes run
+  const std::vector<std::size_t>& schedule() const { return schedule_; }
+  // The size of the buffer pool
+  std::size_t number_of_buffers() const { return buffers_.size(); }
+
+ private:
+  //--------------------------------------------------------------------
+  // 4. PRIVATE METHODS
+  //--------------------------------------------------------------------
+  std::vector<std::vector<bool>> FindAncestors(
+      const std::vector<std::vector<std::size_t>>& consumers) const;
+  bool FollowsAllUsers(
+      std::size_t node_id, std::size_t writer_id,
+      const std::vector<std::vector<std::size_t>>& consumers,
+      const std::vector<std::vector<bool>>& ancestors) const;
+
+  //--------------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------------
+  struct NodeEntry {
+    std::unique_ptr<ProcessorNode> node;
+    // The node feeding every input (kNoNode if none)
+    std::vector<std::size_t> sources;
+    // Assigned by Compile(): the input buffers and the output buffer
+    std::vector<const float*> input_buffers;
+    float* output_buffer;
+  };
+
+  // Marks inputs that aren't connected
+  static const std::size_t kNoNode;
+
+  const std::size_t block_size_;
+  std::vector<NodeEntry> nodes_;
+  std::vector<std::size_t> schedule_;
+  std::vector<std::vector<float>> buffers_;
+  bool compiled_;
+
+  // Only when running on several threads: the pool and the
+  // dependencies between the nodes (the id of a task is the id of its
+  // node)
+  std::unique_ptr<WorkStealingPool> pool_;
+  TaskGraph tasks_;
+};
+
+#endif /* PROCESSING_GRAPH_H */
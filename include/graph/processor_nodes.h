@@ -0,0 +1,272 @@
+//========================================================================
+//  FILE:
+//      include/graph/processor_nodes.h
+//
+//  AUTHOR:
+//      zimzum@github
+//
+//  DESCRIPTION:
+//      Defines the nodes that a ProcessingGraph is built of:
+//       a) OscillatorNode - a basic waveform
+//       b) FmNode - a waveform with its phase modulated by the input
+//       c) VoiceNode - the notes played by a VoiceManager
+//       d) EnvelopeNode - applies an envelope to the input
+//       e) MixerNode - mixes the inputs
+//       f) SinkNode - passes the input on to the user
+//
+//  License: GNU GPL v2.0
+//========================================================================
+
+#ifndef PROCESSOR_NODES_H
+#define PROCESSOR_NODES_H
+
+#include <common/synth_config.h>
+#include <envelope/segment.h>
+#include <global/global_include.h>
+#include <graph/processing_graph.h>
+#include <oscillator/waveform_shape.h>
+#include <voice/voice_manager.h>
+
+#include <functional>
+
+//========================================================================
+// CLASS: OscillatorNode
+//
+// DESCRIPTION:
+//      Generates a basic waveform (no inputs):
+//          y[n] = A * wave(phi_n)
+//========================================================================
+class OscillatorNode : public ProcessorNode {
+ public:
+  //--------------------------------------------------------------------
+  // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+  //--------------------------------------------------------------------
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      OscillatorNode()
+  //
+  //  DESCRIPTION:
+  //      Constructor
+  //  INPUT:
+  //      synthesiser     - currently used synthesiser
+  //      waveform        - the shape of the waveform
+  //      amplitude       - peak amplitude of the waveform
+  //      frequency       - the frequency (range: according to Nyquist)
+  //      initial_phase   - initial phase of the waveform
+  //                        (range: [0, kTwoPi))
+  //--------------------------------------------------------------------
+  explicit OscillatorNode(const SynthConfig& synthesiser, Waveform waveform,
+                          float amplitude, double frequency,
+                          double initial_phase = 0.0);
+  ~OscillatorNode() = default;
+
+  //--------------------------------------------------------------------
+  // 2. GENERAL USER INTERFACE
+  //--------------------------------------------------------------------
+  void Process(const float* const* inputs, float* output,
+               std::size_t number_of_samples) final;
+
+ private:
+  //--------------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------------
+  const Waveform waveform_;
+  const float amplitude_;
+  const double phase_increment_;
+  double phase_;
+};
+
+//========================================================================
+// CLASS: FmNode
+//
+// DESCRIPTION:
+//      Generates a waveform with the phase modulated by the input (the
+//      classic form of FM, see FmSynthesiser):
+//          y[n] = A * wave(phi_n + I * x[n])
+//      where I is the index of modulation. The input is usually a sine
+//      wave from an OscillatorNode with an amplitude of 1.
+//========================================================================
+class FmNode : public ProcessorNode {
+ public:
+  //--------------------------------------------------------------------
+  // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+  //--------------------------------------------------------------------
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      FmNode()
+  //
+  //  DESCRIPTION:
+  //      Constructor
+  //  INPUT:
+  //      synthesiser         - currently used synthesiser
+  //      waveform            - the shape of the carrier
+  //      amplitude           - peak amplitude of the carrier
+  //      frequency           - the frequency of the carrier
+  //      index_of_modulation - the index of modulation
+  //--------------------------------------------------------------------
+  explicit FmNode(const SynthConfig& synthesiser, Waveform waveform,
+                  float amplitude, double frequency,
+                  double index_of_modulation);
+  ~FmNode() = default;
+
+  //--------------------------------------------------------------------
+  // 2. GENERAL USER INTERFACE
+  //--------------------------------------------------------------------
+  void Process(const float* const* inputs, float* output,
+               std::size_t number_of_samples) final;
+
+ private:
+  //--------------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------------
+  const Waveform waveform_;
+  const float amplitude_;
+  const double phase_increment_;
+  const double index_of_modulation_;
+  double phase_;
+};
+
+//========================================================================
+// CLASS: VoiceNode
+//
+// DESCRIPTION:
+//      Renders the notes played by a VoiceManager (no inputs). The
+//      notes are started and stopped through the VoiceManager, between
+//      the calls to ProcessingGraph::Process().
+//========================================================================
+class VoiceNode : public ProcessorNode {
+ public:
+  //--------------------------------------------------------------------
+  // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+  //--------------------------------------------------------------------
+  explicit VoiceNode(VoiceManager& voices);
+  ~VoiceNode() = default;
+
+  //--------------------------------------------------------------------
+  // 2. GENERAL USER INTERFACE
+  //--------------------------------------------------------------------
+  void Process(const float* const* inputs, float* output,
+               std::size_t number_of_samples) final;
+
+ private:
+  //--------------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------------
+  VoiceManager& voices_;
+};
+
+//========================================================================
+// CLASS: EnvelopeNode
+//
+// DESCRIPTION:
+//      Multiplies the input by an envelope made of segments, played one
+//      after another (e.g. the attack, decay, sustain and release of an
+//      ADSR envelope). After the last segment the envelope stays at its
+//      final level. The segments are generated on construction.
+//========================================================================
+class EnvelopeNode : public ProcessorNode {
+ public:
+  //--------------------------------------------------------------------
+  // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+  //--------------------------------------------------------------------
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      EnvelopeNode()
+  //
+  //  DESCRIPTION:
+  //      Constructor
+  //  INPUT:
+  //      segments - the segments of the envelope, in order
+  //--------------------------------------------------------------------
+  explicit EnvelopeNode(
+      const std::vector<std::unique_ptr<Segment>>& segments);
+  ~EnvelopeNode() = default;
+
+  //--------------------------------------------------------------------
+  // 2. GENERAL USER INTERFACE
+  //--------------------------------------------------------------------
+  void Process(const float* const* inputs, float* output,
+               std::size_t number_of_samples) final;
+
+ private:
+  //--------------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------------
+  // The gain for every sample of the envelope
+  std::vector<float> gains_;
+  float final_gain_;
+  std::size_t position_;
+};
+
+//========================================================================
+// CLASS: MixerNode
+//
+// DESCRIPTION:
+//      Mixes the inputs, each with its own gain:
+//          y[n] = sum_i g_i * x_i[n]
+//========================================================================
+class MixerNode : public ProcessorNode {
+ public:
+  //--------------------------------------------------------------------
+  // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+  //--------------------------------------------------------------------
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      MixerNode()
+  //
+  //  DESCRIPTION:
+  //      Constructor
+  //  INPUT:
+  //      gains - the gain of every input (one input per gain)
+  //--------------------------------------------------------------------
+  explicit MixerNode(const std::vector<float>& gains);
+  ~MixerNode() = default;
+
+  //--------------------------------------------------------------------
+  // 2. GENERAL USER INTERFACE
+  //--------------------------------------------------------------------
+  void Process(const float* const* inputs, float* output,
+               std::size_t number_of_samples) final;
+
+ private:
+  //--------------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------------
+  const std::vector<float> gains_;
+};
+
+//========================================================================
+// CLASS: SinkNode
+//
+// DESCRIPTION:
+//      Passes every block of the input to a callback, e.g. one that
+//      appends it to a WaveFileStreamOut. Has no output.
+//========================================================================
+class SinkNode : public ProcessorNode {
+ public:
+  //--------------------------------------------------------------------
+  // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+  //--------------------------------------------------------------------
+  explicit SinkNode(
+      const std::function<void(const float*, std::size_t)>& consume);
+  ~SinkNode() = default;
+
+  //--------------------------------------------------------------------
+  // 2. GENERAL USER INTERFACE
+  //--------------------------------------------------------------------
+  void Process(const float* const* inputs, float* output,
+               std::size_t number_of_samples) final;
+
+  //--------------------------------------------------------------------
+  // 3. ACCESSORS
+  //--------------------------------------------------------------------
+  bool has_output() const final { return false; }
+
+ private:
+  //--------------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------------
+  const std::function<void(const float*, std::size_t)> consume_;
+};
+
+#endif /* PROCESSOR_NODES_H */
@@ -0,0 +1,150 @@
+//========================================================================
+//  FILE:
+//      include/graph/work_stealing_pool.h
+//
+//  AUTHOR:
+//      zimzum@github
+//
+//  DESCRIPTION:
+//      Defines the WorkStealingPool class - runs a graph of dependent
+//      tasks on several threads.
+//
+//  License: GNU GPL v2.0
+//========================================================================
+
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <global/global_include.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+//========================================================================
+// STRUCT: TaskGraph
+//
+// DESCRIPTION:
+//      The dependencies between the tasks run by a WorkStealingPool. A
+//      task is ready once all the tasks it depends on have finished.
+//========================================================================
+struct TaskGraph {
+  // The number of tasks that every task waits for
+  std::vector<std::size_t> number_of_dependencies;
+  // The tasks waiting for every task (a task appears once per
+  // dependency)
+  std::vector<std::vector<std::size_t>> successors;
+};
+
+//========================================================================
+// CLASS: WorkStealingPool
+//
+// DESCRIPTION:
+//      A pool of threads that runs all the tasks of a TaskGraph, every
+//      task once, as soon as its dependencies are met. Every thread has
+//      its own queue of ready tasks: the tasks that a thread makes ready
+//      go to its own queue and are taken from the back (so the data
+//      they read is still in its cache), and a thread that runs out of
+//      tasks steals the oldest task from the front of another thread's
+//      queue. Every run has a fresh set of dependency counters, so the
+//      same graph can be run over and over (e.g. once per block). The
+//      thread that calls Run() takes part in the work.
+//========================================================================
+class WorkStealingPool {
+ public:
+  //--------------------------------------------------------------------
+  // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+  //--------------------------------------------------------------------
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      WorkStealingPool()
+  //
+  //  DESCRIPTION:
+  //      Constructor. Starts number_of_threads - 1 threads (the thread
+  //      calling Run() is the remaining one).
+  //  INPUT:
+  //      number_of_threads - the number of threads that run the tasks
+  //--------------------------------------------------------------------
+  explicit WorkStealingPool(std::size_t number_of_threads);
+  // Stops the threads
+  ~WorkStealingPool();
+  explicit WorkStealingPool(const WorkStealingPool& rhs) = delete;
+  explicit WorkStealingPool(WorkStealingPool&& rhs) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool& rhs) = delete;
+  WorkStealingPool& operator=(WorkStealingPool&& rhs) = delete;
+
+  //--------------------------------------------------------------------
+  // 2. GENERAL USER INTERFACE
+  //--------------------------------------------------------------------
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      Run()
+  //
+  //  DESCRIPTION:
+  //      Runs all the tasks and returns once they have all finished.
+  //      A task only starts after all the tasks it depends on have
+  //      finished (and sees everything they wrote). The graph has to be
+  //      acyclic.
+  //  INPUT:
+  //      tasks   - the dependencies between the tasks
+  //      execute - runs the given task
+  //  OUTPUT:
+  //      None
+  //--------------------------------------------------------------------
+  void Run(const TaskGraph& tasks,
+           const std::function<void(std::size_t)>& execute);
+
+  //--------------------------------------------------------------------
+  // 3. ACCESSORS
+  //--------------------------------------------------------------------
+  std::size_t number_of_threads() const { return queues_.size(); }
+  // The number of tasks that were run by a thread other than the one
+  // that made them ready
+  uint64_t number_of_steals() const { return number_of_steals_; }
+
+ private:
+  //--------------------------------------------------------------------
+  // 4. PRIVATE METHODS
+  //--------------------------------------------------------------------
+  void WorkerLoop(std::size_t worker_id);
+  void RunTasks(std::size_t worker_id);
+  void Push(std::size_t worker_id, std::size_t task);
+  bool Pop(std::size_t worker_id, std::size_t& task);
+  bool Steal(std::size_t worker_id, std::size_t& task);
+
+  //--------------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------------
+  // The ready tasks of one thread. Every task is queued at most once
+  // per run, so the queue never holds more than the number of tasks
+  // and is simply reset for every run.
+  struct TaskQueue {
+    std::mutex mutex;
+    std::vector<std::size_t> tasks;
+    std::size_t front;
+    std::size_t back;
+  };
+
+  std::vector<std::unique_ptr<TaskQueue>> queues_;
+  std::vector<std::thread> threads_;
+
+  // The current run
+  const TaskGraph* tasks_;
+  const std::function<void(std::size_t)>* execute_;
+  std::unique_ptr<std::atomic<std::size_t>[]> pending_dependencies_;
+  std::size_t capacity_;
+  std::atomic<std::size_t> remaining_tasks_;
+  std::atomic<uint64_t> number_of_steals_;
+
+  // Wakes up the threads for a run, and the caller once they're done
+  std::mutex mutex_;
+  std::condition_variable run_started_;
+  std::condition_variable run_finished_;
+  uint64_t run_id_;
+  std::size_t busy_threads_;
+  bool stop_;
+};
+
+#endif /* WORK_STEALING_POOL_H */
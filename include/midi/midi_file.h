@@ -0,0 +1,136 @@
+//========================================================================
+//  FILE:
+//      include/midi/midi_file.h
+//
+//  AUTHOR:
+//      zimzum@github
+//
+//  DESCRIPTION:
+//      Defines the MidiFile class - the notes of a Standard MIDI File.
+//
+//  License: GNU GPL v2.0
+//========================================================================
+
+#ifndef MIDI_FILE_H
+#define MIDI_FILE_H
+
+#include <global/global_include.h>
+
+//========================================================================
+// STRUCT: MidiNoteEvent
+//
+// DESCRIPTION:
+//      A note starting or stopping. A Note On with a velocity of 0 is a
+//      Note Off.
+//========================================================================
+struct MidiNoteEvent {
+  // The time of the event from the start of the file, in seconds
+  double time;
+  bool note_on;
+  uint8_t channel;
+  // The MIDI note number (60 is middle C) and the velocity
+  // (range: [0, 127])
+  uint8_t key;
+  uint8_t velocity;
+};
+
+//========================================================================
+// CLASS: MidiFile
+//
+// DESCRIPTION:
+//      The notes of a Standard MIDI File (format 0 or 1), one list per
+//      track, with the times already converted from ticks to seconds.
+//      The tempo changes are taken from all the tracks (normally the
+//      first one), so they apply to every track, as in format 1. Files
+//      with SMPTE time division ignore the tempo. Everything else
+//      (controllers, program changes, SysEx, meta events) is skipped.
+//========================================================================
+class MidiFile {
+ public:
+  //--------------------------------------------------------------------
+  // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+  //--------------------------------------------------------------------
+  MidiFile();
+  ~MidiFile() = default;
+  explicit MidiFile(const MidiFile& rhs) = delete;
+  explicit MidiFile(MidiFile&& rhs) = delete;
+  MidiFile& operator=(const MidiFile& rhs) = delete;
+  MidiFile& operator=(MidiFile&& rhs) = delete;
+
+  //--------------------------------------------------------------------
+  // 2. GENERAL USER INTERFACE
+  //--------------------------------------------------------------------
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      Parse()
+  //
+  //  DESCRIPTION:
+  //      Reads the notes from the contents of a Standard MIDI File,
+  //      replacing the ones read before.
+  //  INPUT:
+  //      data - the contents of the file
+  //      size - the size of the file in bytes
+  //  OUTPUT:
+  //      True on success. False if the file isn't a valid format 0 or
+  //      format 1 file (the file is then left empty).
+  //--------------------------------------------------------------------
+  bool Parse(const uint8_t* data, std::size_t size);
+
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      Load()
+  //
+  //  DESCRIPTION:
+  //      Like Parse(), for the file with the given name.
+  //  INPUT:
+  //      file_name - the name of the file
+  //  OUTPUT:
+  //      True on success, false otherwise.
+  //--------------------------------------------------------------------
+  bool Load(const std::string& file_name);
+
+  //--------------------------------------------------------------------
+  // 3. ACCESSORS
+  //--------------------------------------------------------------------
+  std::size_t number_of_tracks() const { return tracks_.size(); }
+  // The notes of a track, in order
+  const std::vector<MidiNoteEvent>& track(std::size_t track_id) const {
+    return tracks_[track_id];
+  }
+  // The time of the end of the longest track, in seconds
+  double duration() const { return duration_; }
+
+ private:
+  //--------------------------------------------------------------------
+  // 4. PRIVATE METHODS
+  //--------------------------------------------------------------------
+  // The events of a track, timed in ticks
+  struct TimedEvent {
+    uint64_t tick;
+    MidiNoteEvent event;
+  };
+  struct TempoChange {
+    uint64_t tick;
+    uint32_t microseconds_per_quarter_note;
+  };
+
+  bool ParseTrack(const uint8_t* data, std::size_t size,
+                  std::vector<TimedEvent>& events, uint64_t& end_tick,
+                  std::vector<TempoChange>& tempo_changes) const;
+  double TicksToSeconds(uint64_t tick,
+                        const std::vector<TempoChange>& tempo_changes,
+                        const std::vector<double>& change_times) const;
+  void Clear();
+
+  //--------------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------------
+  std::vector<std::vector<MidiNoteEvent>> tracks_;
+  double duration_;
+  // The time division: ticks per quarter note, or (SMPTE) ticks per
+  // second
+  uint16_t ticks_per_quarter_note_;
+  double ticks_per_second_;
+};
+
+#endif /* MIDI_FILE_H */
@@ -0,0 +1,148 @@
+//========================================================================
+//  FILE:
+//      include/midi/midi_renderer.h
+//
+//  AUTHOR:
+//      zimzum@github
+//
+//  DESCRIPTION:
+//      Defines the MidiRenderer class - renders Standard MIDI Files
+//      offline.
+//
+//  License: GNU GPL v2.0
+//========================================================================
+
+#ifndef MIDI_RENDERER_H
+#define MIDI_RENDERER_H
+
+#include <common/synth_config.h>
+#include <global/global_include.h>
+#include <midi/midi_file.h>
+#include <voice/voice_manager.h>
+
+#include <functional>
+
+//========================================================================
+// STRUCT: MidiRenderMetrics
+//
+// DESCRIPTION:
+//      Statistics of the last file rendered by a MidiRenderer.
+//========================================================================
+struct MidiRenderMetrics {
+  // The number of parts, i.e. of channels with notes over all the
+  // tracks (every part is rendered by its own voices, in parallel)
+  std::size_t number_of_parts;
+  uint64_t number_of_notes;
+  // The length of the output, in samples and in seconds
+  uint64_t number_of_samples;
+  double rendered_duration;
+  // The time it took to render (and write) the output, in nanoseconds
+  uint64_t elapsed_time_ns;
+};
+
+//========================================================================
+// CLASS: MidiRenderer
+//
+// DESCRIPTION:
+//      Renders the notes of a MidiFile (mono). Every part, i.e. every
+//      channel of every track with notes on it, gets its own
+//      VoiceManager, so the parts are rendered in parallel on a
+//      ProcessingGraph (even those of a format 0 file):
+//
+//          VoiceNode (track 1, channel 1) ---+
+//          VoiceNode (track 1, channel 2) ---+--> MixerNode -> SinkNode
+//          VoiceNode (track 2, channel 1) ---+
+//          ...                            ---+
+//
+//      A Note Off only releases the notes of its own part, so the same
+//      key can be held on two channels at once.
+//      The events are sample accurate: the graph is processed up to the
+//      sample at which the next event happens, the events at that
+//      sample are passed to the voices and processing resumes. After
+//      the end of the file the notes still held are released, and the
+//      output runs on until the releases are over. The graph mixes the
+//      parts in a fixed order, so the output doesn't depend on the
+//      number of threads.
+//========================================================================
+class MidiRenderer {
+ public:
+  //--------------------------------------------------------------------
+  // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+  //--------------------------------------------------------------------
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      MidiRenderer()
+  //
+  //  DESCRIPTION:
+  //      Constructor
+  //  INPUT:
+  //      synthesiser       - currently used synthesiser
+  //      parameters        - the sound of the notes (of all the parts)
+  //      number_of_threads - the number of threads rendering the parts
+  //      number_of_voices  - the number of voices of every part
+  //--------------------------------------------------------------------
+  explicit MidiRenderer(const SynthConfig& synthesiser,
+                        const VoiceParameters& parameters,
+                        std::size_t number_of_threads = 1,
+                        std::size_t number_of_voices = kNumberOfVoices);
+  ~MidiRenderer() = default;
+  explicit MidiRenderer(const MidiRenderer& rhs) = delete;
+  explicit MidiRenderer(MidiRenderer&& rhs) = delete;
+  MidiRenderer& operator=(const MidiRenderer& rhs) = delete;
+  MidiRenderer& operator=(MidiRenderer&& rhs) = delete;
+
+  //--------------------------------------------------------------------
+  // 2. GENERAL USER INTERFACE
+  //--------------------------------------------------------------------
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      Render()
+  //
+  //  DESCRIPTION:
+  //      Renders the file and passes the output to the callback, block
+  //      by block, in order (see above).
+  //  INPUT:
+  //      file    - the file to render
+  //      consume - receives every block of the output
+  //  OUTPUT:
+  //      None
+  //--------------------------------------------------------------------
+  void Render(const MidiFile& file,
+              const std::function<void(const float*, std::size_t)>& consume);
+
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      RenderToFile()
+  //
+  //  DESCRIPTION:
+  //      Like Render(), but the output is streamed to a 16-bit WAVE file
+  //      (see WaveFileStreamOut) as it's rendered, at the sampling rate
+  //      of the synthesiser. Samples out of range are clipped.
+  //  INPUT:
+  //      file      - the file to render
+  //      file_name - the name of the WAVE file to write to
+  //  OUTPUT:
+  //      True on success, false if the WAVE file couldn't be written.
+  //--------------------------------------------------------------------
+  bool RenderToFile(const MidiFile& file, const std::string& file_name);
+
+  //--------------------------------------------------------------------
+  // 3. ACCESSORS
+  //--------------------------------------------------------------------
+  const MidiRenderMetrics& metrics() const { return metrics_; }
+  // The time it took to render the last file over its duration, i.e.
+  // below 1 the file was rendered faster than real time
+  double real_time_factor() const;
+
+ private:
+  //--------------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------------
+  const SynthConfig& synthesiser_;
+  const VoiceParameters parameters_;
+  const std::size_t number_of_threads_;
+  const std::size_t number_of_voices_;
+  MidiRenderMetrics metrics_;
+};
+
+#endif /* MIDI_RENDERER_H */
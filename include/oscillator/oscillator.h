@@ -92,14 +92,29 @@ class Oscillator {
   //--------------------------------------------------------------------
   std::vector<int16_t> operator()(uint32_t number_of_seconds);
 
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      operator()
+  //
+  //  DESCRIPTION:
+  //      Like above, but the waveform is generated straight into the
+  //      memory provided by the caller (e.g. a file mapped with
+  //      WaveFileOut::MapBufferToFile()), so nothing is allocated.
+  //  INPUT:
+  //      samples           - the output buffer
+  //      number_of_samples - the length of the waveform in samples
+  //  RETURN:
+  //      None
+  //--------------------------------------------------------------------
+  void operator()(int16_t* samples, std::size_t number_of_samples);
+
  private:
   //--------------------------------------------------------------------
   // 3. INTERFACE DEFINITION
   //--------------------------------------------------------------------
-  virtual std::vector<int16_t> GenWaveform(size_t number_of_samples,
-                                           int16_t peak_amplitude,
-                                           double initial_phase,
-                                           double phase_increment) const = 0;
+  virtual void GenWaveform(int16_t* samples, size_t number_of_samples,
+                           int16_t peak_amplitude, double initial_phase,
+                           double phase_increment) const = 0;
 
   //--------------------------------------------------------------------
   // 4. DATA MEMMBERS
@@ -165,9 +180,9 @@ class SineWaveform : public Oscillator {
   //--------------------------------------------------------------------
   // 2. INTERFACE DEFINITION
   //--------------------------------------------------------------------
-  std::vector<int16_t> GenWaveform(size_t number_of_samples,
-                                   int16_t peak_amplitude, double initial_phase,
-                                   double phase_increment) const final;
+  void GenWaveform(int16_t* samples, size_t number_of_samples,
+                   int16_t peak_amplitude, double initial_phase,
+                   double phase_increment) const final;
 };
 
 //========================================================================
@@ -228,9 +243,9 @@ class SawtoothWaveform : public Oscillator {
   //--------------------------------------------------------------------
   // 2. INTERFACE DEFINITION
   //--------------------------------------------------------------------
-  std::vector<int16_t> GenWaveform(size_t number_of_samples,
-                                   int16_t peak_amplitude, double initial_phase,
-                                   double phase_increment) const final;
+  void GenWaveform(int16_t* samples, size_t number_of_samples,
+                   int16_t peak_amplitude, double initial_phase,
+                   double phase_increment) const final;
 };
 
 //========================================================================
@@ -291,9 +306,9 @@ class SquareWaveform : public Oscillator {
   //--------------------------------------------------------------------
   // 2. INTERFACE DEFINITION
   //--------------------------------------------------------------------
-  std::vector<int16_t> GenWaveform(size_t number_of_samples,
-                                   int16_t peak_amplitude, double initial_phase,
-                                   double phase_increment) const final;
+  void GenWaveform(int16_t* samples, size_t number_of_samples,
+                   int16_t peak_amplitude, double initial_phase,
+                   double phase_increment) const final;
 };
 
 //========================================================================
@@ -352,9 +367,9 @@ class TriangleWaveform : public Oscillator {
   //--------------------------------------------------------------------
   // 2. INTERFACE DEFINITION
   //--------------------------------------------------------------------
-  std::vector<int16_t> GenWaveform(size_t number_of_samples,
-                                   int16_t peak_amplitude, double initial_phase,
-                                   double phase_increment) const final;
+  void GenWaveform(int16_t* samples, size_t number_of_samples,
+                   int16_t peak_amplitude, double initial_phase,
+                   double phase_increment) const final;
 };
 
 #endif /* #define OSCILLATOR_H */
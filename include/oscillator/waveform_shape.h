@@ -0,0 +1,61 @@
+//========================================================================
+//  FILE:
+//      include/oscillator/waveform_shape.h
+//
+//  AUTHOR:
+//      zimzum@github
+//
+//  DESCRIPTION:
+//      One period of every basic waveform as a function of the phase,
+//      shared by the parts of the synthesiser that generate waveforms
+//      sample by sample, in blocks (e.g. VoiceManager and
+//      OscillatorNode).
+//
+//  License: GNU GPL v2.0
+//========================================================================
+
+#ifndef WAVEFORM_SHAPE_H
+#define WAVEFORM_SHAPE_H
+
+#include <global/global_include.h>
+
+//========================================================================
+// The shapes of the basic waveforms. The Oscillator classes generate
+// their own (e.g. TriangleWaveform reflects its phase instead of
+// wrapping it, so it isn't sampled from TriangleShape()).
+//========================================================================
+enum class Waveform { kSine, kSawtooth, kSquare, kTriangle };
+
+//------------------------------------------------------------------------
+//  NAME:
+//      SineShape(), SawtoothShape(), SquareShape(), TriangleShape()
+//
+//  DESCRIPTION:
+//      The value of every waveform (range: [-1, 1]) for phases in the
+//      [0, kTwoPi) range.
+//------------------------------------------------------------------------
+inline double SineShape(double phase) { return sin(phase); }
+
+inline double SawtoothShape(double phase) {
+  return (phase < kPi) ? phase / kPi : phase / kPi - 2.0;
+}
+
+inline double SquareShape(double phase) { return (phase > kPi) ? 1.0 : -1.0; }
+
+inline double TriangleShape(double phase) {
+  return 1.0 - 2.0 / kPi * fabs(phase - kPi);
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      WrapPhase()
+//
+//  DESCRIPTION:
+//      Brings any phase into the [0, kTwoPi) range, e.g. after it was
+//      modulated.
+//------------------------------------------------------------------------
+inline double WrapPhase(double phase) {
+  return phase - kTwoPi * floor(phase / kTwoPi);
+}
+
+#endif /* WAVEFORM_SHAPE_H */
@@ -0,0 +1,224 @@
+//========================================================================
+//  FILE:
+//      include/voice/voice_manager.h
+//
+//  AUTHOR:
+//      zimzum@github
+//
+//  DESCRIPTION:
+//      Defines the VoiceManager class - plays any number of notes at the
+//      same time with a fixed pool of voices.
+//
+//  License: GNU GPL v2.0
+//========================================================================
+
+#ifndef VOICE_MANAGER_H
+#define VOICE_MANAGER_H
+
+#include <common/synth_config.h>
+#include <global/global_include.h>
+#include <oscillator/waveform_shape.h>
+
+//========================================================================
+// STRUCT: VoiceParameters
+//
+// DESCRIPTION:
+//      Describes the sound of every note played by a VoiceManager: the
+//      waveform, a linear ADSR envelope and optional FM. With FM the
+//      phase of the waveform is modulated by a sine wave at
+//      modulator_ratio times the frequency of the note:
+//          y[n] = A * env[n] * wave(phi_n + I * sin(psi_n))
+//      where I is the index of modulation (0 disables FM).
+//========================================================================
+struct VoiceParameters {
+  Waveform waveform = Waveform::kSine;
+  // The peak amplitude of a note at full velocity (range: [0, 1])
+  float amplitude = 0.25f;
+  // The envelope: durations in seconds, the sustain level relative to
+  // the peak (range: [0, 1])
+  double attack_duration = 0.01;
+  double decay_duration = 0.1;
+  float sustain_level = 0.7f;
+  double release_duration = 0.2;
+  // FM
+  double modulator_ratio = 1.0;
+  double index_of_modulation = 0.0;
+};
+
+//========================================================================
+// CLASS: VoiceManager
+//
+// DESCRIPTION:
+//      Renders notes with a fixed-size pool of voices that is allocated
+//      up front. Every voice holds the complete state of one note - the
+//      phases of the oscillator and of the FM modulator and the state of
+//      the envelope - and renders it in blocks of any length, so notes
+//      can start and stop between blocks.
+//
+//      Taking a voice for a new note is O(1): the idle voices are kept
+//      on a free list. When none is idle a voice is stolen, again in
+//      O(1) - the one that has been released the longest, or if every
+//      voice is still held, the oldest one. Once a voice's release
+//      finishes it goes back to the free list. Nothing is allocated
+//      after construction, so the cost of a block only depends on the
+//      number of active voices.
+//========================================================================
+class VoiceManager {
+ public:
+  //--------------------------------------------------------------------
+  // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+  //--------------------------------------------------------------------
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      VoiceManager()
+  //
+  //  DESCRIPTION:
+  //      Constructor. Allocates all the voices.
+  //  INPUT:
+  //      synthesiser      - currently used synthesiser
+  //      parameters       - the sound of the notes
+  //      number_of_voices - the size of the pool, i.e. the largest
+  //                         number of notes that sound at the same time
+  //--------------------------------------------------------------------
+  explicit VoiceManager(const SynthConfig& synthesiser,
+                        const VoiceParameters& parameters,
+                        std::size_t number_of_voices = kNumberOfVoices);
+  ~VoiceManager();
+  explicit VoiceManager(const VoiceManager& rhs) = delete;
+  explicit VoiceManager(VoiceManager&& rhs) = delete;
+  VoiceManager& operator=(const VoiceManager& rhs) = delete;
+  VoiceManager& operator=(VoiceManager&& rhs) = delete;
+
+  //--------------------------------------------------------------------
+  // 2. GENERAL USER INTERFACE
+  //--------------------------------------------------------------------
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      NoteOn()
+  //
+  //  DESCRIPTION:
+  //      Starts a note at the beginning of the next block. If the same
+  //      pitch is still held, that note is released first.
+  //  INPUT:
+  //      pitch_id - index into the frequency table (range:
+  //                 [0, kNumberOfFrequencies))
+  //      velocity - the loudness of the note (range: [0, 1])
+  //  OUTPUT:
+  //      None
+  //--------------------------------------------------------------------
+  void NoteOn(std::size_t pitch_id, float velocity = 1.0f);
+
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      NoteOff()
+  //
+  //  DESCRIPTION:
+  //      Releases the note held at the given pitch (if any) at the
+  //      beginning of the next block.
+  //  INPUT:
+  //      pitch_id - index into the frequency table
+  //  OUTPUT:
+  //      None
+  //--------------------------------------------------------------------
+  void NoteOff(std::size_t pitch_id);
+
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      AllNotesOff()
+  //
+  //  DESCRIPTION:
+  //      Releases all the held notes.
+  //  INPUT:
+  //      None
+  //  OUTPUT:
+  //      None
+  //--------------------------------------------------------------------
+  void AllNotesOff();
+
+  //--------------------------------------------------------------------
+  //  NAME:
+  //      Render()
+  //
+  //  DESCRIPTION:
+  //      Renders the next block of all the active voices, mixed
+  //      together.
+  //  INPUT:
+  //      samples           - the output buffer (overwritten)
+  //      number_of_samples - the length of the block
+  //  OUTPUT:
+  //      None
+  //--------------------------------------------------------------------
+  void Render(float* samples, std::size_t number_of_samples);
+
+  //--------------------------------------------------------------------
+  // 3. ACCESSORS
+  //--------------------------------------------------------------------
+  std::size_t number_of_voices() const { return voices_.size(); }
+  std::size_t number_of_active_voices() const;
+  // The number of notes that took a voice from another note
+  uint64_t number_of_stolen_voices() const { return number_of_stolen_; }
+
+ private:
+  // The voices are kept on three intrusive lists: idle, held and
+  // released (the latter two from the oldest to the newest)
+  enum VoiceList { kIdle, kHeld, kReleased, kNumberOfLists };
+
+  enum class EnvelopeStage { kAttack, kDecay, kSustain, kRelease, kOff };
+
+  struct Voice {
+    std::size_t pitch_id;
+    float gain;
+    // The oscillator and the FM modulator
+    double phase;
+    double phase_increment;
+    double modulator_phase;
+    double modulator_phase_increment;
+    // The envelope: the current level, its change per sample and the
+    // number of samples left in the current stage
+    EnvelopeStage stage;
+    float level;
+    float level_increment;
+    std::size_t stage_samples_left;
+    // The list the voice is on, and its neighbours there
+    VoiceList list;
+    std::size_t previous;
+    std::size_t next;
+  };
+
+  // The first and the last voice on a list
+  struct ListEnds {
+    std::size_t head;
+    std::size_t tail;
+    std::size_t size;
+  };
+
+  //--------------------------------------------------------------------
+  // 4. PRIVATE METHODS
+  //--------------------------------------------------------------------
+  std::size_t TakeVoice();
+  void MoveVoice(std::size_t voice_id, VoiceList list);
+  void ReleaseVoice(std::size_t voice_id);
+  void StartStage(Voice& voice, EnvelopeStage stage) const;
+  void RenderVoice(std::size_t voice_id, float* samples,
+                   std::size_t number_of_samples);
+  template <double (*Shape)(double)>
+  void RenderRun(Voice& voice, float* samples,
+                 std::size_t number_of_samples) const;
+
+  //--------------------------------------------------------------------
+  // 5. DATA MEMMBERS
+  //--------------------------------------------------------------------
+  const SynthConfig& synthesiser_;
+  const VoiceParameters parameters_;
+  // The lengths of the stages of the envelope in samples
+  std::size_t attack_samples_;
+  std::size_t decay_samples_;
+  std::size_t release_samples_;
+  std::vector<Voice> voices_;
+  ListEnds lists_[kNumberOfLists];
+  // The voice that holds every pitch (or voices_.size() if none)
+  std::vector<std::size_t> held_voices_;
+  uint64_t number_of_stolen_;
+};
+
+#endif /* VOICE_MANAGER_H */
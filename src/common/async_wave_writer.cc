@@ -0,0 +1,179 @@
+//========================================================================
+//  FILE:
+//      src/common/async_wave_writer.cc
+//
+//  AUTHOR:
+//      zimzum@github
+//
+//  DESCRIPTION:
+//      Implementation of the AsyncWaveWriter class.
+//
+//  License: GNU GPL v2.0
+//========================================================================
+
+#include <common/async_wave_writer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+using namespace std;
+
+//========================================================================
+// CLASS: AsyncWaveWriter
+//========================================================================
+//------------------------------------------------------------------------
+// 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+//------------------------------------------------------------------------
+AsyncWaveWriter::AsyncWaveWriter(size_t block_size, size_t number_of_blocks)
+    : block_size_(block_size),
+      number_of_blocks_(number_of_blocks),
+      storage_(block_size * number_of_blocks),
+      full_blocks_(number_of_blocks),
+      free_blocks_(number_of_blocks),
+      current_block_(0),
+      has_current_block_(false),
+      stop_(false),
+      failed_(false),
+      metrics_() {
+  assert(block_size_ > 0);
+  assert(number_of_blocks_ > 0);
+
+  // Initially all the blocks are free
+  for (size_t idx = 0; idx < number_of_blocks_; idx++) {
+    free_blocks_.Push(idx);
+  }
+}
+
+AsyncWaveWriter::~AsyncWaveWriter() { Close(); }
+
+//------------------------------------------------------------------------
+// 2. GENERAL USER INTERFACE
+//------------------------------------------------------------------------
+bool AsyncWaveWriter::Open(const std::string& file_name) {
+  Close();
+
+  if (!wave_file_.Open(file_name)) return false;
+
+  metrics_ = AsyncWaveWriterMetrics();
+  stop_.store(false);
+  failed_.store(false);
+  io_thread_ = thread(&AsyncWaveWriter::IoThreadLoop, this);
+
+  return true;
+}
+
+int16_t* AsyncWaveWriter::AcquireBlock() {
+  assert(IsOpen());
+
+  if (!has_current_block_) {
+    if (!free_blocks_.Pop(current_block_)) {
+      // All the blocks are waiting to be written - the disk is slower
+      // than the renderer.
+      chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      while (!free_blocks_.Pop(current_block_)) {
+        this_thread::yield();
+      }
+
+      metrics_.number_of_stalls++;
+      metrics_.stall_time_ns += chrono::duration_cast<chrono::nanoseconds>(
+                                    chrono::steady_clock::now() - start)
+                                    .count();
+    }
+    has_current_block_ = true;
+  }
+
+  return storage_.data() + current_block_ * block_size_;
+}
+
+void AsyncWaveWriter::SubmitBlock(size_t number_of_samples) {
+  assert(IsOpen());
+  assert(has_current_block_ && "No block to submit!");
+  assert(number_of_samples <= block_size_);
+
+  Block block;
+  block.index = current_block_;
+  block.number_of_samples = number_of_samples;
+  has_current_block_ = false;
+
+  // Can't fail - there are never more blocks than the queue can hold
+  full_blocks_.Push(block);
+
+  metrics_.number_of_blocks_submitted++;
+  metrics_.max_queue_depth =
+      max(metrics_.max_queue_depth, full_blocks_.size());
+
+  wake_up_.notify_one();
+}
+
+void AsyncWaveWriter::Write(const int16_t* samples, size_t number_of_samples) {
+  while (number_of_samples > 0) {
+    size_t length = min(number_of_samples, block_size_);
+
+    memcpy(AcquireBlock(), samples, length * sizeof(int16_t));
+    SubmitBlock(length);
+
+    samples += length;
+    number_of_samples -= length;
+  }
+}
+
+bool AsyncWaveWriter::Close() {
+  if (!IsOpen()) return true;
+
+  // The I/O thread drains the queue before it exits
+  stop_.store(true);
+  wake_up_.notify_one();
+  io_thread_.join();
+
+  bool success = wave_file_.Close();
+  return success && !failed_.load();
+}
+
+//------------------------------------------------------------------------
+// 4. PRIVATE METHODS
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
+//  NAME:
+//      IoThreadLoop()
+//
+//  DESCRIPTION:
+//      The body of the I/O thread. Appends the submitted blocks to the
+//      file in order and hands them back to the render thread. Sleeps
+//      while there's nothing to write. The render thread notifies
+//      without taking the mutex (so that submitting never blocks), so a
+//      wake-up can be missed - the timed wait bounds the resulting
+//      delay. After a failed write the blocks are still recycled (and
+//      dropped), so that the render thread never deadlocks.
+//  INPUT:
+//      None
+//  OUTPUT:
+//      None
+//------------------------------------------------------------------------
+void AsyncWaveWriter::IoThreadLoop() {
+  Block block;
+
+  while (true) {
+    if (full_blocks_.Pop(block)) {
+      if (!failed_.load(memory_order_relaxed) &&
+          !wave_file_.Append(storage_.data() + block.index * block_size_,
+                             block.number_of_samples)) {
+        failed_.store(true);
+      }
+      free_blocks_.Push(block.index);
+      continue;
+    }
+
+    // Every block submitted before Close() was called is visible by now,
+    // so an empty queue means that everything has been written.
+    if (stop_.load()) {
+      if (full_blocks_.empty()) break;
+      continue;
+    }
+
+    unique_lock<mutex> lock(wake_up_mutex_);
+    wake_up_.wait_for(lock, chrono::milliseconds(1), [this] {
+      return !full_blocks_.empty() || stop_.load();
+    });
+  }
+}
@@ -0,0 +1,1199 @@
+//========================================================================
+//  FILE:
+//      src/common/flac_codec.cc
+//
+//  AUTHOR:
+//      zimzum@github
+//
+//  DESCRIPTION:
+//      Implementation of the FlacEncoder and FlacDecoder classes. The
+//      format is described in https://xiph.org/flac/format.html. All
+//      the section references below are to this document.
+//
+//  License: GNU GPL v2.0
+//========================================================================
+
+#include <common/flac_codec.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+using namespace std;
+
+//========================================================================
+// UTILITIES
+//========================================================================
+// Constants defined by the format
+static const uint32_t kFlacFrameSync = 0xFFF8;
+static const unsigned kFlacMaxRiceParameter = 14;
+static const unsigned kFlacRiceEscape = 15;
+static const unsigned kFlacStreamInfoSize = 34;
+// Subframe types (SUBFRAME_HEADER)
+static const unsigned kFlacSubframeConstant = 0;
+static const unsigned kFlacSubframeVerbatim = 1;
+static const unsigned kFlacSubframeFixed = 8;
+static const unsigned kFlacSubframeLpc = 32;
+// Channel assignments (FRAME_HEADER)
+static const unsigned kFlacLeftSide = 8;
+static const unsigned kFlacRightSide = 9;
+static const unsigned kFlacMidSide = 10;
+
+//------------------------------------------------------------------------
+//  NAME:
+//      Crc8/Crc16
+//
+//  DESCRIPTION:
+//      The CRCs protecting frame headers (CRC-8, polynomial 0x07) and
+//      whole frames (CRC-16, polynomial 0x8005). Both are MSB-first and
+//      start from 0.
+//------------------------------------------------------------------------
+static uint8_t Crc8(const uint8_t* data, size_t size) {
+  uint8_t crc = 0;
+
+  for (size_t idx = 0; idx < size; idx++) {
+    crc ^= data[idx];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x80) ? static_cast<uint8_t>((crc << 1) ^ 0x07)
+                         : static_cast<uint8_t>(crc << 1);
+    }
+  }
+
+  return crc;
+}
+
+static uint16_t Crc16(const uint8_t* data, size_t size) {
+  // Table driven - this runs over every byte of every frame
+  static const vector<uint16_t> table = [] {
+    vector<uint16_t> result(256);
+    for (unsigned byte = 0; byte < 256; byte++) {
+      uint16_t crc = static_cast<uint16_t>(byte << 8);
+      for (int bit = 0; bit < 8; bit++) {
+        crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x8005)
+                             : static_cast<uint16_t>(crc << 1);
+      }
+      result[byte] = crc;
+    }
+    return result;
+  }();
+
+  uint16_t crc = 0;
+  for (size_t idx = 0; idx < size; idx++) {
+    crc = static_cast<uint16_t>((crc << 8) ^ table[(crc >> 8) ^ data[idx]]);
+  }
+
+  return crc;
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      FoldResidual
+//
+//  DESCRIPTION:
+//      Maps signed residuals onto unsigned numbers (0, -1, 1, -2, ...
+//      become 0, 1, 2, 3, ...), as required by Rice coding.
+//------------------------------------------------------------------------
+static uint32_t FoldResidual(int32_t residual) {
+  return (static_cast<uint32_t>(residual) << 1) ^
+         static_cast<uint32_t>(residual >> 31);
+}
+
+//------------------------------------------------------------------------
+//  CLASS:
+//      BitWriter
+//
+//  DESCRIPTION:
+//      Appends bit fields, MSB first, to a vector of bytes.
+//------------------------------------------------------------------------
+class BitWriter {
+ public:
+  explicit BitWriter(vector<uint8_t>& output)
+      : output_(output), accumulator_(0), number_of_bits_(0) {}
+
+  // Up to 32 bits at a time
+  void Write(uint32_t value, unsigned bits) {
+    if (bits == 0) return;
+
+    accumulator_ = (accumulator_ << bits) |
+                   (value & ((static_cast<uint64_t>(1) << bits) - 1));
+    number_of_bits_ += bits;
+    while (number_of_bits_ >= 8) {
+      number_of_bits_ -= 8;
+      output_.push_back(static_cast<uint8_t>(accumulator_ >> number_of_bits_));
+    }
+  }
+
+  void WriteSigned(int32_t value, unsigned bits) {
+    Write(static_cast<uint32_t>(value), bits);
+  }
+
+  // 'quotient' zeros followed by a one, then the low 'parameter' bits
+  void WriteRice(uint32_t value, unsigned parameter) {
+    uint32_t quotient = value >> parameter;
+    uint32_t remainder = value & ((1u << parameter) - 1);
+
+    if (quotient + 1 + parameter <= 32) {
+      Write((1u << parameter) | remainder, quotient + 1 + parameter);
+      return;
+    }
+
+    for (; quotient >= 32; quotient -= 32) Write(0, 32);
+    Write(1, quotient + 1);
+    Write(remainder, parameter);
+  }
+
+  void AlignToByte() {
+    if (number_of_bits_ > 0) Write(0, 8 - number_of_bits_);
+  }
+
+ private:
+  vector<uint8_t>& output_;
+  uint64_t accumulator_;
+  unsigned number_of_bits_;
+};
+
+//------------------------------------------------------------------------
+//  CLASS:
+//      BitReader
+//
+//  DESCRIPTION:
+//      Reads bit fields, MSB first, from a buffer. Reading past the end
+//      returns zeros and sets the error flag.
+//------------------------------------------------------------------------
+class BitReader {
+ public:
+  explicit BitReader(const uint8_t* data, size_t size)
+      : data_(data), size_(size), position_(0), error_(false) {}
+
+  // Up to 32 bits at a time
+  uint32_t Read(unsigned bits) {
+    if (bits == 0) return 0;
+    if (position_ + bits > size_ * 8) {
+      error_ = true;
+      return 0;
+    }
+
+    size_t byte = position_ >> 3;
+    unsigned offset = position_ & 7;
+    unsigned number_of_bytes = (offset + bits + 7) / 8;
+    uint64_t value = 0;
+    for (unsigned idx = 0; idx < number_of_bytes; idx++) {
+      value = (value << 8) | data_[byte + idx];
+    }
+
+    position_ += bits;
+    value >>= number_of_bytes * 8 - offset - bits;
+    return static_cast<uint32_t>(value &
+                                 ((static_cast<uint64_t>(1) << bits) - 1));
+  }
+
+  int32_t ReadSigned(unsigned bits) {
+    if (bits == 0) return 0;
+    uint32_t value = Read(bits);
+    // Sign-extend
+    return static_cast<int32_t>(value << (32 - bits)) >> (32 - bits);
+  }
+
+  // The number of zeros before the next one
+  uint32_t ReadUnary() {
+    uint32_t count = 0;
+
+    while (position_ < size_ * 8) {
+      unsigned offset = position_ & 7;
+      unsigned byte = (data_[position_ >> 3] << offset) & 0xFF;
+
+      if (byte == 0) {
+        count += 8 - offset;
+        position_ += 8 - offset;
+        continue;
+      }
+
+      unsigned zeros = __builtin_clz(byte) - 24;
+      count += zeros;
+      position_ += zeros + 1;
+      return count;
+    }
+
+    error_ = true;
+    return 0;
+  }
+
+  void AlignToByte() { position_ = (position_ + 7) & ~static_cast<size_t>(7); }
+
+  void Seek(size_t byte_position) {
+    position_ = byte_position * 8;
+    if (byte_position > size_) error_ = true;
+  }
+
+  size_t byte_position() const { return position_ >> 3; }
+  bool error() const { return error_; }
+
+ private:
+  const uint8_t* data_;
+  size_t size_;
+  size_t position_;
+  bool error_;
+};
+
+//------------------------------------------------------------------------
+//  NAME:
+//      WriteUtf8
+//
+//  DESCRIPTION:
+//      Writes the frame number in the "UTF-8" code used by frame headers.
+//------------------------------------------------------------------------
+static void WriteUtf8(BitWriter& writer, uint32_t value) {
+  if (value < 0x80) {
+    writer.Write(value, 8);
+    return;
+  }
+
+  // With n continuation bytes (6 bits each), the leading byte holds
+  // 6 - n bits, i.e. 5n + 6 bits in total
+  unsigned continuation_bytes = 1;
+  while ((continuation_bytes < 5) &&
+         ((value >> (5 * continuation_bytes + 6)) != 0)) {
+    continuation_bytes++;
+  }
+
+  uint32_t lead = (0xFF << (7 - continuation_bytes)) & 0xFF;
+  writer.Write(lead | (value >> (6 * continuation_bytes)), 8);
+  for (unsigned idx = continuation_bytes; idx > 0; idx--) {
+    writer.Write(0x80 | ((value >> (6 * (idx - 1))) & 0x3F), 8);
+  }
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      ReadUtf8
+//
+//  DESCRIPTION:
+//      The counterpart of WriteUtf8. Sample numbers (variable block
+//      size streams) can take up to 36 bits, hence 64-bit output.
+//------------------------------------------------------------------------
+static bool ReadUtf8(BitReader& reader, uint64_t& value) {
+  uint32_t lead = reader.Read(8);
+
+  // The number of leading ones is the length of the code
+  unsigned length = 0;
+  while ((length < 8) && (lead & (0x80u >> length))) length++;
+  if ((length == 1) || (length == 8)) return false;
+
+  value = (length == 0) ? lead : (lead & (0x7Fu >> length));
+  for (unsigned idx = 1; idx < length; idx++) {
+    uint32_t byte = reader.Read(8);
+    if ((byte & 0xC0) != 0x80) return false;
+    value = (value << 6) | (byte & 0x3F);
+  }
+
+  return !reader.error();
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      ChooseRiceParameters
+//
+//  DESCRIPTION:
+//      Chooses the partition order and the Rice parameter of every
+//      partition (RESIDUAL_CODING_METHOD_PARTITIONED_RICE) that minimise
+//      the size of the coded residual. The sums of the residuals in the
+//      partitions are calculated once, for the highest partition order,
+//      and merged pairwise for the lower ones. The size is estimated
+//      from the sums, as in the reference encoder.
+//  INPUT:
+//      folded          - the folded residual of the whole block (the
+//                        first predictor_order entries are unused)
+//      block_size      - the number of samples in the block
+//      predictor_order - the number of warm-up samples
+//      partition_order - the chosen partition order
+//      parameters      - the chosen Rice parameters
+//  OUTPUT:
+//      The size of the coded residual in bits.
+//------------------------------------------------------------------------
+static uint64_t ChooseRiceParameters(const uint32_t* folded, size_t block_size,
+                                     unsigned predictor_order,
+                                     unsigned& partition_order,
+                                     vector<unsigned>& parameters) {
+  // Step 1: The highest usable order - the partitions have to divide the
+  //         block evenly and the first one has to hold more than the
+  //         warm-up samples
+  unsigned max_order = 0;
+  while ((max_order < kFlacMaxPartitionOrder) &&
+         (block_size % (static_cast<size_t>(2) << max_order) == 0) &&
+         ((block_size >> (max_order + 1)) > predictor_order)) {
+    max_order++;
+  }
+
+  // Step 2: The sums for the highest order
+  vector<uint64_t> sums(static_cast<size_t>(1) << max_order);
+  size_t partition_size = block_size >> max_order;
+  for (size_t partition = 0; partition < sums.size(); partition++) {
+    size_t begin = (partition == 0) ? predictor_order
+                                    : partition * partition_size;
+    size_t end = (partition + 1) * partition_size;
+    uint64_t sum = 0;
+    for (size_t idx = begin; idx < end; idx++) sum += folded[idx];
+    sums[partition] = sum;
+  }
+
+  // Step 3: Evaluate every order, from the highest down
+  uint64_t best_bits = UINT64_MAX;
+  for (int order = static_cast<int>(max_order); order >= 0; order--) {
+    size_t number_of_partitions = static_cast<size_t>(1) << order;
+    uint64_t bits = 4;
+    vector<unsigned> order_parameters(number_of_partitions);
+
+    partition_size = block_size >> order;
+    for (size_t partition = 0; partition < number_of_partitions;
+         partition++) {
+      uint64_t count = partition_size - ((partition == 0) ? predictor_order
+                                                          : 0);
+      uint64_t sum = sums[partition];
+
+      // 2^k close to the mean, then the cheapest of its neighbours
+      unsigned parameter = 0;
+      while ((parameter < kFlacMaxRiceParameter) &&
+             ((count << (parameter + 1)) < sum)) {
+        parameter++;
+      }
+
+      uint64_t best_partition_bits = UINT64_MAX;
+      unsigned first = (parameter > 0) ? parameter - 1 : 0;
+      unsigned last = min(parameter + 1, kFlacMaxRiceParameter);
+      for (unsigned candidate = first; candidate <= last; candidate++) {
+        uint64_t candidate_bits = count * (candidate + 1) + (sum >> candidate);
+        if (candidate_bits < best_partition_bits) {
+          best_partition_bits = candidate_bits;
+          order_parameters[partition] = candidate;
+        }
+      }
+
+      bits += 4 + best_partition_bits;
+    }
+
+    if (bits < best_bits) {
+      best_bits = bits;
+      partition_order = static_cast<unsigned>(order);
+      parameters.swap(order_parameters);
+    }
+
+    // Merge the sums for the next order down
+    for (size_t partition = 0; partition < number_of_partitions / 2;
+         partition++) {
+      sums[partition] = sums[2 * partition] + sums[2 * partition + 1];
+    }
+  }
+
+  // The coding method
+  return best_bits + 2;
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      WriteResidual
+//
+//  DESCRIPTION:
+//      Writes the Rice coded residual (RESIDUAL) with the parameters
+//      chosen by ChooseRiceParameters.
+//------------------------------------------------------------------------
+static void WriteResidual(BitWriter& writer, const uint32_t* folded,
+                          size_t block_size, unsigned predictor_order,
+                          unsigned partition_order,
+                          const vector<unsigned>& parameters) {
+  size_t partition_size = block_size >> partition_order;
+
+  writer.Write(0, 2);
+  writer.Write(partition_order, 4);
+  for (size_t partition = 0; partition < parameters.size(); partition++) {
+    size_t begin = (partition == 0) ? predictor_order
+                                    : partition * partition_size;
+    size_t end = (partition + 1) * partition_size;
+
+    writer.Write(parameters[partition], 4);
+    for (size_t idx = begin; idx < end; idx++) {
+      writer.WriteRice(folded[idx], parameters[partition]);
+    }
+  }
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      FixedResidual
+//
+//  DESCRIPTION:
+//      Calculates the residual of the fixed polynomial predictor of the
+//      given order (SUBFRAME_FIXED).
+//------------------------------------------------------------------------
+static void FixedResidual(const int32_t* samples, size_t block_size,
+                          unsigned order, int32_t* residual) {
+  for (size_t idx = order; idx < block_size; idx++) {
+    const int32_t* x = samples + idx;
+    switch (order) {
+      case 0:
+        residual[idx] = x[0];
+        break;
+      case 1:
+        residual[idx] = x[0] - x[-1];
+        break;
+      case 2:
+        residual[idx] = x[0] - 2 * x[-1] + x[-2];
+        break;
+      case 3:
+        residual[idx] = x[0] - 3 * x[-1] + 3 * x[-2] - x[-3];
+        break;
+      default:
+        residual[idx] = x[0] - 4 * x[-1] + 6 * x[-2] - 4 * x[-3] + x[-4];
+        break;
+    }
+  }
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      CalculateLpc
+//
+//  DESCRIPTION:
+//      Calculates the linear predictor for the samples: autocorrelation
+//      of the windowed (Welch) samples, followed by the Levinson-Durbin
+//      recursion. The order is chosen from the prediction errors of all
+//      the orders that the recursion goes through, by estimating the
+//      size of the subframe. The coefficients are then quantised to
+//      kFlacLpcPrecision bits, with the rounding error carried over
+//      from one coefficient to the next.
+//  INPUT:
+//      samples           - the samples
+//      block_size        - the number of samples
+//      bits_per_sample   - the size of the warm-up samples in bits
+//      coefficients      - the quantised coefficients (output)
+//      shift             - the quantisation shift (output)
+//  OUTPUT:
+//      False if no usable predictor was found, true otherwise.
+//------------------------------------------------------------------------
+static bool CalculateLpc(const int32_t* samples, size_t block_size,
+                         unsigned bits_per_sample,
+                         vector<int32_t>& coefficients, int& shift) {
+  const size_t max_order = kFlacMaxLpcOrder;
+  if (block_size <= 2 * max_order) return false;
+
+  // Step 1: Autocorrelation of the windowed samples
+  vector<double> windowed(block_size);
+  const double half = (block_size - 1) / 2.0;
+  for (size_t idx = 0; idx < block_size; idx++) {
+    double position = (idx - half) / half;
+    windowed[idx] = samples[idx] * (1.0 - position * position);
+  }
+
+  vector<double> autocorrelation(max_order + 1);
+  for (size_t lag = 0; lag <= max_order; lag++) {
+    double sum = 0;
+    for (size_t idx = lag; idx < block_size; idx++) {
+      sum += windowed[idx] * windowed[idx - lag];
+    }
+    autocorrelation[lag] = sum;
+  }
+  if (autocorrelation[0] == 0) return false;
+
+  // Step 2: Levinson-Durbin recursion. Keep the predictor of every order
+  //         and pick the one that's expected to give the smallest
+  //         subframe.
+  vector<vector<double>> lpc(max_order, vector<double>(max_order));
+  vector<double> current(max_order);
+  vector<double> previous(max_order);
+  double error = autocorrelation[0];
+  size_t best_order = 0;
+  double best_bits = 0;
+
+  for (size_t order = 0; order < max_order; order++) {
+    double reflection = -autocorrelation[order + 1];
+    for (size_t idx = 0; idx < order; idx++) {
+      reflection -= current[idx] * autocorrelation[order - idx];
+    }
+    reflection /= error;
+
+    copy(current.begin(), current.begin() + order, previous.begin());
+    current[order] = reflection;
+    for (size_t idx = 0; idx < order; idx++) {
+      current[idx] += reflection * previous[order - 1 - idx];
+    }
+    error *= 1.0 - reflection * reflection;
+
+    // The predictor in the FLAC convention: x[n] = sum(lpc[j] * x[n-1-j])
+    for (size_t idx = 0; idx <= order; idx++) lpc[order][idx] = -current[idx];
+
+    // Bits per residual of a Laplacian source with this error, plus the
+    // warm-up samples and the coefficients
+    double error_per_sample = max(error, 0.0) / block_size;
+    double bits_per_residual =
+        (error_per_sample > 0) ? max(0.0, 0.5 * log2(error_per_sample)) : 0;
+    double bits = bits_per_residual * (block_size - order - 1) +
+                  (order + 1) * (bits_per_sample + kFlacLpcPrecision);
+    if ((order == 0) || (bits < best_bits)) {
+      best_bits = bits;
+      best_order = order + 1;
+    }
+
+    if (error <= 0) break;
+  }
+
+  // Step 3: Quantise the coefficients
+  const vector<double>& predictor = lpc[best_order - 1];
+  double max_coefficient = 0;
+  for (size_t idx = 0; idx < best_order; idx++) {
+    max_coefficient = max(max_coefficient, fabs(predictor[idx]));
+  }
+  if (max_coefficient <= 0) return false;
+
+  int exponent;
+  frexp(max_coefficient, &exponent);
+  shift = static_cast<int>(kFlacLpcPrecision) - 1 - exponent;
+  shift = min(max(shift, 0), 15);
+
+  const int32_t max_quantised = (1 << (kFlacLpcPrecision - 1)) - 1;
+  const int32_t min_quantised = -(1 << (kFlacLpcPrecision - 1));
+  double rounding_error = 0;
+  coefficients.resize(best_order);
+  for (size_t idx = 0; idx < best_order; idx++) {
+    rounding_error += predictor[idx] * (1 << shift);
+    long quantised = lround(rounding_error);
+    quantised = min<long>(max<long>(quantised, min_quantised), max_quantised);
+    rounding_error -= quantised;
+    coefficients[idx] = static_cast<int32_t>(quantised);
+  }
+
+  return true;
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      LpcResidual
+//
+//  DESCRIPTION:
+//      Calculates the residual of the quantised linear predictor
+//      (SUBFRAME_LPC).
+//------------------------------------------------------------------------
+static void LpcResidual(const int32_t* samples, size_t block_size,
+                        const vector<int32_t>& coefficients, int shift,
+                        int32_t* residual) {
+  const size_t order = coefficients.size();
+
+  for (size_t idx = order; idx < block_size; idx++) {
+    int64_t prediction = 0;
+    for (size_t tap = 0; tap < order; tap++) {
+      prediction += static_cast<int64_t>(coefficients[tap]) *
+                    samples[idx - 1 - tap];
+    }
+    residual[idx] = samples[idx] - static_cast<int32_t>(prediction >> shift);
+  }
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      EncodeSubframe
+//
+//  DESCRIPTION:
+//      Encodes one channel of a frame (SUBFRAME), with whichever of the
+//      subframe types gives the fewest bits.
+//------------------------------------------------------------------------
+static void EncodeSubframe(BitWriter& writer, const int32_t* samples,
+                           size_t block_size, unsigned bits_per_sample) {
+  // Step 1: A constant subframe is the cheapest if it applies
+  if (all_of(samples, samples + block_size,
+             [samples](int32_t sample) { return sample == samples[0]; })) {
+    writer.Write(kFlacSubframeConstant << 1, 8);
+    writer.WriteSigned(samples[0], bits_per_sample);
+    return;
+  }
+
+  // Step 2: Try the fixed predictors and the linear predictor
+  vector<int32_t> residual(block_size);
+  vector<uint32_t> folded(block_size);
+  vector<uint32_t> best_folded;
+  vector<unsigned> parameters;
+  vector<unsigned> best_parameters;
+  unsigned partition_order = 0;
+  unsigned best_partition_order = 0;
+  unsigned best_type = kFlacSubframeVerbatim;
+  unsigned best_order = 0;
+  uint64_t best_bits = 8 + static_cast<uint64_t>(block_size) * bits_per_sample;
+
+  auto evaluate = [&](unsigned type, unsigned order, uint64_t overhead) {
+    for (size_t idx = order; idx < block_size; idx++) {
+      folded[idx] = FoldResidual(residual[idx]);
+    }
+
+    uint64_t bits = 8 + overhead + order * bits_per_sample +
+                    ChooseRiceParameters(folded.data(), block_size, order,
+                                         partition_order, parameters);
+    if (bits < best_bits) {
+      best_bits = bits;
+      best_type = type;
+      best_order = order;
+      best_partition_order = partition_order;
+      best_parameters.swap(parameters);
+      best_folded.swap(folded);
+      folded.resize(block_size);
+    }
+  };
+
+  for (unsigned order = 0; order <= 4 && order < block_size; order++) {
+    FixedResidual(samples, block_size, order, residual.data());
+    evaluate(kFlacSubframeFixed, order, 0);
+  }
+
+  vector<int32_t> coefficients;
+  int shift = 0;
+  if (CalculateLpc(samples, block_size, bits_per_sample, coefficients,
+                   shift)) {
+    unsigned order = static_cast<unsigned>(coefficients.size());
+    LpcResidual(samples, block_size, coefficients, shift, residual.data());
+    evaluate(kFlacSubframeLpc, order, 4 + 5 + order * kFlacLpcPrecision);
+  }
+
+  // Step 3: Write the winner
+  if (best_type == kFlacSubframeVerbatim) {
+    writer.Write(kFlacSubframeVerbatim << 1, 8);
+    for (size_t idx = 0; idx < block_size; idx++) {
+      writer.WriteSigned(samples[idx], bits_per_sample);
+    }
+    return;
+  }
+
+  if (best_type == kFlacSubframeLpc) {
+    writer.Write((kFlacSubframeLpc | (best_order - 1)) << 1, 8);
+  } else {
+    writer.Write((kFlacSubframeFixed | best_order) << 1, 8);
+  }
+
+  for (size_t idx = 0; idx < best_order; idx++) {
+    writer.WriteSigned(samples[idx], bits_per_sample);
+  }
+
+  if (best_type == kFlacSubframeLpc) {
+    writer.Write(kFlacLpcPrecision - 1, 4);
+    writer.WriteSigned(shift, 5);
+    for (auto coefficient : coefficients) {
+      writer.WriteSigned(coefficient, kFlacLpcPrecision);
+    }
+  }
+
+  WriteResidual(writer, best_folded.data(), block_size, best_order,
+                best_partition_order, best_parameters);
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      DecodeSubframe
+//
+//  DESCRIPTION:
+//      The counterpart of EncodeSubframe. Supports all the subframe
+//      types, wasted bits and both residual coding methods.
+//------------------------------------------------------------------------
+static bool DecodeSubframe(BitReader& reader, size_t block_size,
+                           unsigned bits_per_sample, int32_t* samples) {
+  if (reader.Read(1) != 0) return false;
+  unsigned type = reader.Read(6);
+
+  unsigned wasted_bits = 0;
+  if (reader.Read(1)) wasted_bits = reader.ReadUnary() + 1;
+  if (wasted_bits >= bits_per_sample) return false;
+  bits_per_sample -= wasted_bits;
+
+  // Step 1: Constant and verbatim subframes
+  if (type == kFlacSubframeConstant) {
+    fill(samples, samples + block_size, reader.ReadSigned(bits_per_sample));
+  } else if (type == kFlacSubframeVerbatim) {
+    for (size_t idx = 0; idx < block_size; idx++) {
+      samples[idx] = reader.ReadSigned(bits_per_sample);
+    }
+  } else {
+    // Step 2: Predicted subframes - warm-up samples and predictor
+    bool lpc = (type & kFlacSubframeLpc) != 0;
+    if (!lpc && ((type & ~7u) != kFlacSubframeFixed || (type & 7) > 4)) {
+      return false;
+    }
+
+    size_t order = lpc ? (type & 31) + 1 : (type & 7);
+    if (order > block_size) return false;
+    for (size_t idx = 0; idx < order; idx++) {
+      samples[idx] = reader.ReadSigned(bits_per_sample);
+    }
+
+    vector<int32_t> coefficients;
+    int shift = 0;
+    if (lpc) {
+      unsigned precision = reader.Read(4) + 1;
+      if (precision == 16) return false;
+      shift = reader.ReadSigned(5);
+      if (shift < 0) return false;
+      for (size_t idx = 0; idx < order; idx++) {
+        coefficients.push_back(reader.ReadSigned(precision));
+      }
+    }
+
+    // Step 3: The residual
+    unsigned method = reader.Read(2);
+    if (method > 1) return false;
+    unsigned parameter_bits = (method == 0) ? 4 : 5;
+    unsigned escape = (method == 0) ? kFlacRiceEscape : 31;
+
+    unsigned partition_order = reader.Read(4);
+    size_t number_of_partitions = static_cast<size_t>(1) << partition_order;
+    size_t partition_size = block_size >> partition_order;
+    if ((partition_size << partition_order) != block_size ||
+        partition_size < order) {
+      return false;
+    }
+
+    size_t idx = order;
+    for (size_t partition = 0; partition < number_of_partitions;
+         partition++) {
+      size_t end = (partition + 1) * partition_size;
+      unsigned parameter = reader.Read(parameter_bits);
+
+      if (parameter == escape) {
+        unsigned bits = reader.Read(5);
+        for (; idx < end; idx++) samples[idx] = reader.ReadSigned(bits);
+      } else {
+        for (; idx < end; idx++) {
+          uint32_t folded = (reader.ReadUnary() << parameter) |
+                            reader.Read(parameter);
+          samples[idx] = static_cast<int32_t>(folded >> 1) ^
+                         -static_cast<int32_t>(folded & 1);
+        }
+      }
+      if (reader.error()) return false;
+    }
+
+    // Step 4: Undo the prediction, in place
+    if (lpc) {
+      for (size_t idx = order; idx < block_size; idx++) {
+        int64_t prediction = 0;
+        for (size_t tap = 0; tap < order; tap++) {
+          prediction += static_cast<int64_t>(coefficients[tap]) *
+                        samples[idx - 1 - tap];
+        }
+        samples[idx] += static_cast<int32_t>(prediction >> shift);
+      }
+    } else {
+      for (size_t idx = order; idx < block_size; idx++) {
+        int32_t* x = samples + idx;
+        switch (order) {
+          case 1:
+            x[0] += x[-1];
+            break;
+          case 2:
+            x[0] += 2 * x[-1] - x[-2];
+            break;
+          case 3:
+            x[0] += 3 * x[-1] - 3 * x[-2] + x[-3];
+            break;
+          case 4:
+            x[0] += 4 * x[-1] - 6 * x[-2] + 4 * x[-3] - x[-4];
+            break;
+        }
+      }
+    }
+  }
+
+  if (wasted_bits > 0) {
+    for (size_t idx = 0; idx < block_size; idx++) samples[idx] <<= wasted_bits;
+  }
+
+  return !reader.error();
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      SampleRateCode
+//
+//  DESCRIPTION:
+//      The sample rate code of the frame header. Rates without a code of
+//      their own are taken from STREAMINFO (code 0).
+//------------------------------------------------------------------------
+static uint32_t SampleRateCode(uint32_t sample_rate) {
+  switch (sample_rate) {
+    case 88200:
+      return 1;
+    case 176400:
+      return 2;
+    case 192000:
+      return 3;
+    case 8000:
+      return 4;
+    case 16000:
+      return 5;
+    case 22050:
+      return 6;
+    case 24000:
+      return 7;
+    case 32000:
+      return 8;
+    case 44100:
+      return 9;
+    case 48000:
+      return 10;
+    case 96000:
+      return 11;
+    default:
+      return 0;
+  }
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      EstimateCost
+//
+//  DESCRIPTION:
+//      A cheap estimate of how well a channel compresses - the sum of the
+//      magnitudes of its second order residual. Used for choosing the
+//      stereo decorrelation.
+//------------------------------------------------------------------------
+static uint64_t EstimateCost(const int32_t* samples, size_t block_size) {
+  uint64_t cost = 0;
+  for (size_t idx = 2; idx < block_size; idx++) {
+    cost += static_cast<uint64_t>(
+        abs(samples[idx] - 2 * samples[idx - 1] + samples[idx - 2]));
+  }
+  return cost;
+}
+
+//========================================================================
+// CLASS: FlacEncoder
+//========================================================================
+//------------------------------------------------------------------------
+// 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+//------------------------------------------------------------------------
+FlacEncoder::FlacEncoder(uint32_t sample_rate, uint16_t number_of_channels,
+                         size_t number_of_threads)
+    : sample_rate_(sample_rate),
+      number_of_channels_(number_of_channels),
+      number_of_threads_(max<size_t>(1, number_of_threads)) {
+  assert((number_of_channels > 0) && (number_of_channels <= 8));
+  assert((sample_rate > 0) && (sample_rate < (1 << 20)));
+}
+
+//------------------------------------------------------------------------
+// 2. GENERAL USER INTERFACE
+//------------------------------------------------------------------------
+vector<uint8_t> FlacEncoder::Encode(const int16_t* samples,
+                                    size_t number_of_samples) const {
+  const uint64_t number_of_frames = number_of_samples / number_of_channels_;
+  const size_t number_of_blocks = static_cast<size_t>(
+      (number_of_frames + kFlacBlockSize - 1) / kFlacBlockSize);
+
+  // Step 1: Encode the frames. They're independent, so every thread
+  //         takes a contiguous share of them. The caller's thread takes
+  //         the first share.
+  vector<vector<uint8_t>> frames(number_of_blocks);
+  auto encode_frames = [&](size_t first, size_t last) {
+    for (size_t block = first; block < last; block++) {
+      uint64_t begin = static_cast<uint64_t>(block) * kFlacBlockSize;
+      size_t block_size = static_cast<size_t>(
+          min<uint64_t>(kFlacBlockSize, number_of_frames - begin));
+      EncodeFrame(samples + begin * number_of_channels_, block_size,
+                  static_cast<uint32_t>(block), frames[block]);
+    }
+  };
+
+  size_t number_of_threads =
+      max<size_t>(1, min(number_of_threads_, number_of_blocks));
+  const size_t share = number_of_blocks / number_of_threads;
+  const size_t remainder = number_of_blocks % number_of_threads;
+
+  vector<thread> workers;
+  size_t first = share + (remainder > 0 ? 1 : 0);
+  for (size_t thread_idx = 1; thread_idx < number_of_threads; thread_idx++) {
+    size_t last = first + share + (thread_idx < remainder ? 1 : 0);
+    workers.emplace_back(encode_frames, first, last);
+    first = last;
+  }
+
+  encode_frames(0, share + (remainder > 0 ? 1 : 0));
+
+  for (auto& worker : workers) worker.join();
+
+  // Step 2: The stream marker and STREAMINFO (METADATA_BLOCK_STREAMINFO),
+  //         the only (and so the last) metadata block. The MD5 signature
+  //         is left unset (all zeros), which the format allows.
+  size_t min_frame_size = 0;
+  size_t max_frame_size = 0;
+  size_t stream_size = 4 + 4 + kFlacStreamInfoSize;
+  for (auto& frame : frames) {
+    min_frame_size = (min_frame_size == 0) ? frame.size()
+                                           : min(min_frame_size, frame.size());
+    max_frame_size = max(max_frame_size, frame.size());
+    stream_size += frame.size();
+  }
+
+  vector<uint8_t> stream(sizeof(kFlacStreamMarker));
+  stream.reserve(stream_size);
+  memcpy(stream.data(), &kFlacStreamMarker, sizeof(kFlacStreamMarker));
+
+  BitWriter writer(stream);
+  writer.Write(1, 1);
+  writer.Write(0, 7);
+  writer.Write(kFlacStreamInfoSize, 24);
+  writer.Write(kFlacBlockSize, 16);
+  writer.Write(kFlacBlockSize, 16);
+  writer.Write(static_cast<uint32_t>(min_frame_size), 24);
+  writer.Write(static_cast<uint32_t>(max_frame_size), 24);
+  writer.Write(sample_rate_, 20);
+  writer.Write(number_of_channels_ - 1u, 3);
+  writer.Write(kNumberOfBitsPerSample - 1u, 5);
+  writer.Write(static_cast<uint32_t>(number_of_frames >> 32), 4);
+  writer.Write(static_cast<uint32_t>(number_of_frames), 32);
+  for (int idx = 0; idx < 4; idx++) writer.Write(0, 32);
+
+  // Step 3: The frames
+  for (auto& frame : frames) {
+    stream.insert(stream.end(), frame.begin(), frame.end());
+  }
+
+  return stream;
+}
+
+//------------------------------------------------------------------------
+// 4. PRIVATE METHODS
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
+//  NAME:
+//      FlacEncoder::EncodeFrame
+//
+//  DESCRIPTION:
+//      Encodes one frame (FRAME): the header, one subframe per channel
+//      and the footer.
+//  INPUT:
+//      samples      - the interleaved samples of the frame
+//      block_size   - the number of samples per channel in the frame
+//      frame_number - the index of the frame in the stream
+//      output       - the encoded frame
+//  OUTPUT:
+//      None
+//------------------------------------------------------------------------
+void FlacEncoder::EncodeFrame(const int16_t* samples, size_t block_size,
+                              uint32_t frame_number,
+                              vector<uint8_t>& output) const {
+  // Step 1: Deinterleave
+  vector<vector<int32_t>> channels(number_of_channels_,
+                                   vector<int32_t>(block_size));
+  for (size_t idx = 0; idx < block_size; idx++) {
+    for (size_t channel = 0; channel < number_of_channels_; channel++) {
+      channels[channel][idx] = samples[idx * number_of_channels_ + channel];
+    }
+  }
+
+  // Step 2: Stereo decorrelation. The side channel takes an extra bit.
+  unsigned assignment = number_of_channels_ - 1u;
+  vector<unsigned> bits_per_sample(number_of_channels_,
+                                   kNumberOfBitsPerSample);
+  if (number_of_channels_ == 2) {
+    vector<int32_t> mid(block_size);
+    vector<int32_t> side(block_size);
+    for (size_t idx = 0; idx < block_size; idx++) {
+      mid[idx] = (channels[0][idx] + channels[1][idx]) >> 1;
+      side[idx] = channels[0][idx] - channels[1][idx];
+    }
+
+    uint64_t left_cost = EstimateCost(channels[0].data(), block_size);
+    uint64_t right_cost = EstimateCost(channels[1].data(), block_size);
+    uint64_t mid_cost = EstimateCost(mid.data(), block_size);
+    uint64_t side_cost = EstimateCost(side.data(), block_size);
+
+    uint64_t best_cost = left_cost + right_cost;
+    if (left_cost + side_cost < best_cost) {
+      best_cost = left_cost + side_cost;
+      assignment = kFlacLeftSide;
+    }
+    if (side_cost + right_cost < best_cost) {
+      best_cost = side_cost + right_cost;
+      assignment = kFlacRightSide;
+    }
+    if (mid_cost + side_cost < best_cost) assignment = kFlacMidSide;
+
+    if (assignment == kFlacLeftSide) {
+      channels[1].swap(side);
+      bits_per_sample[1]++;
+    } else if (assignment == kFlacRightSide) {
+      channels[0].swap(side);
+      bits_per_sample[0]++;
+    } else if (assignment == kFlacMidSide) {
+      channels[0].swap(mid);
+      channels[1].swap(side);
+      bits_per_sample[1]++;
+    }
+  }
+
+  // Step 3: The header (FRAME_HEADER), with the block size stored at the
+  //         end and 16 bits per sample
+  const size_t frame_start = output.size();
+  BitWriter writer(output);
+
+  writer.Write(kFlacFrameSync, 16);
+  writer.Write(7, 4);
+  writer.Write(SampleRateCode(sample_rate_), 4);
+  writer.Write(assignment, 4);
+  writer.Write(4, 3);
+  writer.Write(0, 1);
+  WriteUtf8(writer, frame_number);
+  writer.Write(static_cast<uint32_t>(block_size - 1), 16);
+  writer.Write(Crc8(output.data() + frame_start, output.size() - frame_start),
+               8);
+
+  // Step 4: The subframes and the footer (FRAME_FOOTER)
+  for (size_t channel = 0; channel < number_of_channels_; channel++) {
+    EncodeSubframe(writer, channels[channel].data(), block_size,
+                   bits_per_sample[channel]);
+  }
+
+  writer.AlignToByte();
+  writer.Write(Crc16(output.data() + frame_start, output.size() - frame_start),
+               16);
+}
+
+//========================================================================
+// CLASS: FlacDecoder
+//========================================================================
+//------------------------------------------------------------------------
+// 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+//------------------------------------------------------------------------
+FlacDecoder::FlacDecoder() : sample_rate_(0), number_of_channels_(0) {}
+
+//------------------------------------------------------------------------
+// 2. GENERAL USER INTERFACE
+//------------------------------------------------------------------------
+bool FlacDecoder::Decode(const uint8_t* data, size_t size,
+                         vector<int16_t>& samples) {
+  BitReader reader(data, size);
+  uint32_t marker = 0;
+  uint64_t total_frames = 0;
+  bool last_block = false;
+  bool has_stream_info = false;
+
+  samples.clear();
+
+  // Step 1: The marker and the metadata blocks. Only STREAMINFO matters.
+  if (size < sizeof(marker)) return false;
+  memcpy(&marker, data, sizeof(marker));
+  if (marker != kFlacStreamMarker) return false;
+  reader.Seek(sizeof(marker));
+
+  while (!last_block) {
+    last_block = reader.Read(1) != 0;
+    unsigned type = reader.Read(7);
+    size_t length = reader.Read(24);
+    size_t block_start = reader.byte_position();
+
+    if (reader.error() || (block_start + length > size)) return false;
+
+    if (type == 0) {
+      reader.Read(16);
+      reader.Read(16);
+      reader.Read(24);
+      reader.Read(24);
+      sample_rate_ = reader.Read(20);
+      number_of_channels_ = static_cast<uint16_t>(reader.Read(3) + 1);
+      if (reader.Read(5) + 1 != kNumberOfBitsPerSample) return false;
+      total_frames = static_cast<uint64_t>(reader.Read(4)) << 32;
+      total_frames |= reader.Read(32);
+      has_stream_info = true;
+    }
+
+    reader.Seek(block_start + length);
+  }
+  if (!has_stream_info) return false;
+
+  samples.reserve(static_cast<size_t>(total_frames * number_of_channels_));
+
+  // Step 2: The frames
+  vector<vector<int32_t>> channels(number_of_channels_);
+  while (reader.byte_position() + 2 <= size) {
+    const size_t frame_start = reader.byte_position();
+
+    // The header (FRAME_HEADER)
+    if (reader.Read(15) != (kFlacFrameSync >> 1)) return false;
+    reader.Read(1);
+    unsigned block_size_code = reader.Read(4);
+    unsigned sample_rate_code = reader.Read(4);
+    unsigned assignment = reader.Read(4);
+    unsigned sample_size_code = reader.Read(3);
+    if (reader.Read(1) != 0) return false;
+
+    uint64_t frame_number;
+    if (!ReadUtf8(reader, frame_number)) return false;
+
+    size_t block_size;
+    if (block_size_code == 0) {
+      return false;
+    } else if (block_size_code == 1) {
+      block_size = 192;
+    } else if (block_size_code <= 5) {
+      block_size = static_cast<size_t>(576) << (block_size_code - 2);
+    } else if (block_size_code == 6) {
+      block_size = reader.Read(8) + 1;
+    } else if (block_size_code == 7) {
+      block_size = reader.Read(16) + 1;
+    } else {
+      block_size = static_cast<size_t>(256) << (block_size_code - 8);
+    }
+
+    if (sample_rate_code == 12) {
+      reader.Read(8);
+    } else if (sample_rate_code == 13 || sample_rate_code == 14) {
+      reader.Read(16);
+    } else if (sample_rate_code == 15) {
+      return false;
+    }
+
+    size_t header_size = reader.byte_position() - frame_start;
+    if (reader.Read(8) != Crc8(data + frame_start, header_size)) return false;
+
+    size_t frame_channels = (assignment < 8) ? assignment + 1 : 2;
+    if ((assignment > kFlacMidSide) ||
+        (frame_channels != number_of_channels_)) {
+      return false;
+    }
+    if ((sample_size_code != 0) && (sample_size_code != 4)) return false;
+
+    // The subframes
+    for (size_t channel = 0; channel < number_of_channels_; channel++) {
+      bool side = ((assignment == kFlacLeftSide) && (channel == 1)) ||
+                  ((assignment == kFlacRightSide) && (channel == 0)) ||
+                  ((assignment == kFlacMidSide) && (channel == 1));
+
+      channels[channel].resize(block_size);
+      if (!DecodeSubframe(reader, block_size,
+                          kNumberOfBitsPerSample + (side ? 1 : 0),
+                          channels[channel].data())) {
+        return false;
+      }
+    }
+
+    // The footer (FRAME_FOOTER)
+    reader.AlignToByte();
+    uint16_t crc = Crc16(data + frame_start, reader.byte_position() -
+                                                 frame_start);
+    if (reader.Read(16) != crc || reader.error()) return false;
+
+    // Undo the stereo decorrelation and interleave
+    for (size_t idx = 0; idx < block_size; idx++) {
+      if (assignment == kFlacLeftSide) {
+        channels[1][idx] = channels[0][idx] - channels[1][idx];
+      } else if (assignment == kFlacRightSide) {
+        channels[0][idx] += channels[1][idx];
+      } else if (assignment == kFlacMidSide) {
+        int32_t side = channels[1][idx];
+        int32_t mid = (channels[0][idx] * 2) | (side & 1);
+        channels[0][idx] = (mid + side) >> 1;
+        channels[1][idx] = (mid - side) >> 1;
+      }
+
+      for (size_t channel = 0; channel < number_of_channels_; channel++) {
+        samples.push_back(static_cast<int16_t>(channels[channel][idx]));
+      }
+    }
+  }
+
+  return true;
+}
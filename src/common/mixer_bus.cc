@@ -0,0 +1,164 @@
+//========================================================================
+//  FILE:
+//      src/common/mixer_bus.cc
+//
+//  AUTHOR:
+//      zimzum@github
+//
+//  DESCRIPTION:
+//      Implementation of the MixerBus class.
+//
+//  License: GNU GPL v2.0
+//========================================================================
+
+#include <common/mixer_bus.h>
+
+#include <common/pcm_conversion.h>
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+//========================================================================
+// UTILITIES
+//========================================================================
+//------------------------------------------------------------------------
+//  NAME:
+//      AddScaled
+//
+//  DESCRIPTION:
+//      Adds one float signal, scaled by the gain, to the bus: 8 samples
+//      (two SSE2 registers) per iteration.
+//------------------------------------------------------------------------
+static void AddScaled(const float* input, size_t number_of_samples,
+                      float gain, float* bus) {
+  size_t idx = 0;
+#if defined(__SSE2__)
+  const __m128 scale = _mm_set1_ps(gain);
+
+  for (; idx + 8 <= number_of_samples; idx += 8) {
+    __m128 lo = _mm_mul_ps(_mm_loadu_ps(input + idx), scale);
+    __m128 hi = _mm_mul_ps(_mm_loadu_ps(input + idx + 4), scale);
+
+    _mm_storeu_ps(bus + idx, _mm_add_ps(_mm_loadu_ps(bus + idx), lo));
+    _mm_storeu_ps(bus + idx + 4,
+                  _mm_add_ps(_mm_loadu_ps(bus + idx + 4), hi));
+  }
+#endif
+  for (; idx < number_of_samples; idx++) bus[idx] += gain * input[idx];
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      AddScaled
+//
+//  DESCRIPTION:
+//      Like above, but for a 16-bit signal. The 8 samples of every
+//      iteration are sign-extended to 32 bits and converted to float
+//      first, with the full scale folded into the gain.
+//------------------------------------------------------------------------
+static void AddScaled(const int16_t* input, size_t number_of_samples,
+                      float gain, float* bus) {
+  gain /= kPcm16FullScale;
+
+  size_t idx = 0;
+#if defined(__SSE2__)
+  const __m128 scale = _mm_set1_ps(gain);
+
+  for (; idx + 8 <= number_of_samples; idx += 8) {
+    __m128i samples =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + idx));
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+
+    _mm_storeu_ps(bus + idx,
+                  _mm_add_ps(_mm_loadu_ps(bus + idx),
+                             _mm_mul_ps(_mm_cvtepi32_ps(lo), scale)));
+    _mm_storeu_ps(bus + idx + 4,
+                  _mm_add_ps(_mm_loadu_ps(bus + idx + 4),
+                             _mm_mul_ps(_mm_cvtepi32_ps(hi), scale)));
+  }
+#endif
+  for (; idx < number_of_samples; idx++) {
+    bus[idx] += gain * static_cast<float>(input[idx]);
+  }
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      MixInBlocks
+//
+//  DESCRIPTION:
+//      The body of both versions of MixSignals(): adds all the inputs to
+//      one block of the bus before moving on to the next one.
+//------------------------------------------------------------------------
+template <typename Sample>
+static void MixInBlocks(const Sample* const* inputs, const float* gains,
+                        size_t number_of_inputs, size_t number_of_samples,
+                        float* bus) {
+  for (size_t begin = 0; begin < number_of_samples;
+       begin += kMixerBlockSize) {
+    size_t length = min(kMixerBlockSize, number_of_samples - begin);
+
+    for (size_t input = 0; input < number_of_inputs; input++) {
+      AddScaled(inputs[input] + begin, length, gains[input], bus + begin);
+    }
+  }
+}
+
+//========================================================================
+// GENERAL USER INTERFACE
+//========================================================================
+void MixSignals(const float* const* inputs, const float* gains,
+                size_t number_of_inputs, size_t number_of_samples,
+                float* bus) {
+  MixInBlocks(inputs, gains, number_of_inputs, number_of_samples, bus);
+}
+
+void MixSignals(const int16_t* const* inputs, const float* gains,
+                size_t number_of_inputs, size_t number_of_samples,
+                float* bus) {
+  MixInBlocks(inputs, gains, number_of_inputs, number_of_samples, bus);
+}
+
+//========================================================================
+// CLASS: MixerBus
+//========================================================================
+//------------------------------------------------------------------------
+// 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+//------------------------------------------------------------------------
+MixerBus::MixerBus(size_t number_of_samples)
+    : bus_(number_of_samples, 0.0f) {}
+
+//------------------------------------------------------------------------
+// 2. GENERAL USER INTERFACE
+//------------------------------------------------------------------------
+void MixerBus::Add(const int16_t* const* inputs, const float* gains,
+                   size_t number_of_inputs) {
+  MixSignals(inputs, gains, number_of_inputs, bus_.size(), bus_.data());
+}
+
+void MixerBus::Add(const float* const* inputs, const float* gains,
+                   size_t number_of_inputs) {
+  MixSignals(inputs, gains, number_of_inputs, bus_.size(), bus_.data());
+}
+
+void MixerBus::Add(const int16_t* input, float gain) {
+  Add(&input, &gain, 1);
+}
+
+void MixerBus::Add(const float* input, float gain) { Add(&input, &gain, 1); }
+
+void MixerBus::ConvertToPcm16(int16_t* output) const {
+  ConvertFloatToPcm16(bus_.data(), bus_.size(), output);
+}
+
+void MixerBus::Clear() { fill(bus_.begin(), bus_.end(), 0.0f); }
+
+//========================================================================
+// End of file
+//========================================================================
@@ -0,0 +1,292 @@
+//========================================================================
+//  FILE:
+//      src/common/oversampler.cc
+//
+//  AUTHOR:
+//      zimzum@github
+//
+//  DESCRIPTION:
+//      Implementation of the Oversampler class.
+//
+//  License: GNU GPL v2.0
+//========================================================================
+
+#include <common/oversampler.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+//========================================================================
+// UTILITIES
+//========================================================================
+//------------------------------------------------------------------------
+//  NAME:
+//      DesignHalfBandFilter
+//
+//  DESCRIPTION:
+//      Designs a half-band low-pass filter with 4 * length - 1 taps
+//      (a Blackman-windowed sinc with the cut-off at a quarter of the
+//      sampling rate). Returns only the non-zero taps on one side of
+//      the centre tap, which is always 1/2. The taps are normalised
+//      for unity gain at DC.
+//------------------------------------------------------------------------
+static vector<float> DesignHalfBandFilter(size_t length) {
+  // The window spans one more tap on either side, so that the outermost
+  // taps aren't zeroed
+  const double centre = 2.0 * length;
+  const double width = 4.0 * length;
+  vector<double> taps(length);
+  double sum = 0.0;
+
+  for (size_t idx = 0; idx < length; idx++) {
+    double offset = 2.0 * idx + 1;
+    double position = centre + offset;
+    double window = 0.42 - 0.5 * cos(kTwoPi * position / width) +
+                    0.08 * cos(2 * kTwoPi * position / width);
+
+    taps[idx] = ((idx % 2) ? -1.0 : 1.0) / (kPi * offset) * window;
+    sum += taps[idx];
+  }
+
+  // The centre tap contributes 1/2 and every tap appears twice
+  vector<float> coefficients(length);
+  for (size_t idx = 0; idx < length; idx++) {
+    coefficients[idx] = static_cast<float>(taps[idx] * 0.25 / sum);
+  }
+
+  return coefficients;
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      DeinterleavePairs
+//
+//  DESCRIPTION:
+//      Splits the input into its even and odd samples.
+//  INPUT:
+//      input           - 2 * number_of_pairs samples
+//      number_of_pairs - the number of samples in every output
+//      even, odd       - the outputs
+//  OUTPUT:
+//      None
+//------------------------------------------------------------------------
+static void DeinterleavePairs(const float* input, size_t number_of_pairs,
+                              float* even, float* odd) {
+  size_t idx = 0;
+
+#if defined(__SSE2__)
+  for (; idx + 4 <= number_of_pairs; idx += 4) {
+    __m128 first = _mm_loadu_ps(input + 2 * idx);
+    __m128 second = _mm_loadu_ps(input + 2 * idx + 4);
+    _mm_storeu_ps(even + idx,
+                  _mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(odd + idx,
+                  _mm_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1)));
+  }
+#endif
+
+  for (; idx < number_of_pairs; idx++) {
+    even[idx] = input[2 * idx];
+    odd[idx] = input[2 * idx + 1];
+  }
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      FilterHalfBand
+//
+//  DESCRIPTION:
+//      Evaluates a decimating half-band filter in polyphase form:
+//          y[m] = E[m + K] / 2 + sum_i c[i] * (O[m + K - 1 - i] +
+//                                              O[m + K + i])
+//      where E and O are the even and the odd phase of the input
+//      (preceded by 2 * K - 1 samples of history) and c are the
+//      K = length coefficients. Four outputs are computed at a time,
+//      in the same order of operations as the scalar tail, so the
+//      result doesn't depend on where the blocks start.
+//  INPUT:
+//      even, odd         - the phases of the input
+//      coefficients      - the non-zero taps of the odd phase
+//      length            - the number of coefficients
+//      number_of_samples - the number of outputs
+//      output            - the output buffer
+//  OUTPUT:
+//      None
+//------------------------------------------------------------------------
+static void FilterHalfBand(const float* even, const float* odd,
+                           const float* coefficients, size_t length,
+                           size_t number_of_samples, float* output) {
+  size_t idx = 0;
+
+#if defined(__SSE2__)
+  const __m128 half = _mm_set1_ps(0.5f);
+  for (; idx + 4 <= number_of_samples; idx += 4) {
+    __m128 sum = _mm_mul_ps(half, _mm_loadu_ps(even + idx + length));
+    for (size_t tap = 0; tap < length; tap++) {
+      __m128 pair = _mm_add_ps(_mm_loadu_ps(odd + idx + length - 1 - tap),
+                               _mm_loadu_ps(odd + idx + length + tap));
+      __m128 coefficient = _mm_set1_ps(coefficients[tap]);
+      sum = _mm_add_ps(sum, _mm_mul_ps(coefficient, pair));
+    }
+    _mm_storeu_ps(output + idx, sum);
+  }
+#endif
+
+  for (; idx < number_of_samples; idx++) {
+    float sum = 0.5f * even[idx + length];
+    for (size_t tap = 0; tap < length; tap++) {
+      sum += coefficients[tap] *
+             (odd[idx + length - 1 - tap] + odd[idx + length + tap]);
+    }
+    output[idx] = sum;
+  }
+}
+
+//========================================================================
+// CLASS: Oversampler
+//========================================================================
+//------------------------------------------------------------------------
+// 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+//------------------------------------------------------------------------
+Oversampler::Oversampler(size_t factor, size_t block_size)
+    : factor_(factor), block_size_(block_size) {
+  assert(((factor_ == 1) || (factor_ == 2) || (factor_ == 4) ||
+          (factor_ == 8)) &&
+         "Only 1x, 2x, 4x and 8x oversampling is supported!");
+  assert(block_size_ > 0);
+
+  // One half-band stage per halving of the rate, the sharpest one last
+  size_t number_of_inputs = factor_ * block_size_;
+  for (size_t rate = factor_; rate > 1; rate /= 2) {
+    Stage stage;
+    stage.coefficients = DesignHalfBandFilter(
+        (rate == 2) ? kHalfBandFinalStageLength : kHalfBandStageLength);
+
+    size_t history = 2 * stage.coefficients.size() - 1;
+    number_of_inputs /= 2;
+    stage.even.assign(history + number_of_inputs, 0.0f);
+    stage.odd.assign(history + number_of_inputs, 0.0f);
+
+    stages_.push_back(std::move(stage));
+  }
+
+  buffers_[0].resize(factor_ * block_size_);
+  buffers_[1].resize(factor_ * block_size_ / 2);
+}
+
+Oversampler::~Oversampler() = default;
+
+//------------------------------------------------------------------------
+// 2. GENERAL USER INTERFACE
+//------------------------------------------------------------------------
+void Oversampler::Process(const function<void(float*, size_t)>& render,
+                          size_t number_of_samples, float* output) {
+  for (size_t done = 0; done < number_of_samples; done += block_size_) {
+    size_t length = min(block_size_, number_of_samples - done);
+
+    if (stages_.empty()) {
+      render(output + done, length);
+      continue;
+    }
+
+    render(buffers_[0].data(), length * factor_);
+    DecimateBlock(buffers_[0].data(), length, output + done);
+  }
+}
+
+void Oversampler::Decimate(const float* input, size_t number_of_samples,
+                           float* output) {
+  if (stages_.empty()) {
+    if (input != output) {
+      memmove(output, input, number_of_samples * sizeof(float));
+    }
+    return;
+  }
+
+  for (size_t done = 0; done < number_of_samples; done += block_size_) {
+    size_t length = min(block_size_, number_of_samples - done);
+    DecimateBlock(input + done * factor_, length, output + done);
+  }
+}
+
+void Oversampler::Reset() {
+  for (auto& stage : stages_) {
+    fill(stage.even.begin(), stage.even.end(), 0.0f);
+    fill(stage.odd.begin(), stage.odd.end(), 0.0f);
+  }
+}
+
+//------------------------------------------------------------------------
+// 3. ACCESSORS
+//------------------------------------------------------------------------
+double Oversampler::latency() const {
+  // Every stage delays its output by length - 1 of its own output
+  // samples, which are 1 / rate output samples long
+  double latency = 0.0;
+  size_t rate = factor_;
+
+  for (const auto& stage : stages_) {
+    rate /= 2;
+    latency += (stage.coefficients.size() - 1.0) / rate;
+  }
+
+  return latency;
+}
+
+//------------------------------------------------------------------------
+// 4. PRIVATE METHODS
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
+//  NAME:
+//      DecimateBlock()
+//
+//  DESCRIPTION:
+//      Runs one block through the cascade. Every stage splits its input
+//      into the two phases (after the history kept from the previous
+//      block), filters it into the next stage's input and keeps the
+//      tail of the phases as the history for the next block.
+//  INPUT:
+//      input             - factor() * number_of_samples samples
+//      number_of_samples - the number of outputs, at most block_size()
+//      output            - the output buffer
+//  OUTPUT:
+//      None
+//------------------------------------------------------------------------
+void Oversampler::DecimateBlock(const float* input, size_t number_of_samples,
+                                float* output) {
+  const float* stage_input = input;
+  size_t number_of_outputs = number_of_samples * factor_;
+
+  for (size_t idx = 0; idx < stages_.size(); idx++) {
+    Stage& stage = stages_[idx];
+    const size_t length = stage.coefficients.size();
+    const size_t history = 2 * length - 1;
+    float* stage_output = (idx + 1 == stages_.size())
+                              ? output
+                              : buffers_[(idx + 1) % 2].data();
+
+    number_of_outputs /= 2;
+    DeinterleavePairs(stage_input, number_of_outputs,
+                      stage.even.data() + history,
+                      stage.odd.data() + history);
+    FilterHalfBand(stage.even.data(), stage.odd.data(),
+                   stage.coefficients.data(), length, number_of_outputs,
+                   stage_output);
+
+    // Keep the history for the next block
+    memmove(stage.even.data(), stage.even.data() + number_of_outputs,
+            history * sizeof(float));
+    memmove(stage.odd.data(), stage.odd.data() + number_of_outputs,
+            history * sizeof(float));
+
+    stage_input = stage_output;
+  }
+}
@@ -0,0 +1,321 @@
+//========================================================================
+//  FILE:
+//      src/common/pcm_conversion.cc
+//
+//  AUTHOR:
+//      zimzum@github
+//
+//  DESCRIPTION:
+//      Implementation of the PCM sample conversion routines.
+//
+//  License: GNU GPL v2.0
+//========================================================================
+
+#include <common/pcm_conversion.h>
+
+#include <global/global_variables.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+//========================================================================
+// UTILITIES
+//========================================================================
+//------------------------------------------------------------------------
+//  NAME:
+//      InterleaveStereo
+//
+//  DESCRIPTION:
+//      Interleaves two channels: 8 frames per iteration, with one unpack
+//      for each half of the output.
+//------------------------------------------------------------------------
+static void InterleaveStereo(const int16_t* left, const int16_t* right,
+                             size_t number_of_frames, int16_t* interleaved) {
+  size_t idx = 0;
+#if defined(__SSE2__)
+  for (; idx + 8 <= number_of_frames; idx += 8) {
+    __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(left + idx));
+    __m128i r =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(right + idx));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(interleaved + 2 * idx),
+                     _mm_unpacklo_epi16(l, r));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(interleaved + 2 * idx + 8),
+                     _mm_unpackhi_epi16(l, r));
+  }
+#endif
+  for (; idx < number_of_frames; idx++) {
+    interleaved[2 * idx] = left[idx];
+    interleaved[2 * idx + 1] = right[idx];
+  }
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      InterleaveQuad
+//
+//  DESCRIPTION:
+//      Interleaves four channels: 8 frames per iteration. The channels
+//      are first interleaved in pairs (16-bit unpacks) and then the pairs
+//      are interleaved with each other (32-bit unpacks).
+//------------------------------------------------------------------------
+static void InterleaveQuad(const int16_t* const* channels,
+                           size_t number_of_frames, int16_t* interleaved) {
+  size_t idx = 0;
+#if defined(__SSE2__)
+  for (; idx + 8 <= number_of_frames; idx += 8) {
+    __m128i a =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(channels[0] + idx));
+    __m128i b =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(channels[1] + idx));
+    __m128i c =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(channels[2] + idx));
+    __m128i d =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(channels[3] + idx));
+
+    __m128i ab_lo = _mm_unpacklo_epi16(a, b);
+    __m128i ab_hi = _mm_unpackhi_epi16(a, b);
+    __m128i cd_lo = _mm_unpacklo_epi16(c, d);
+    __m128i cd_hi = _mm_unpackhi_epi16(c, d);
+
+    __m128i* output = reinterpret_cast<__m128i*>(interleaved + 4 * idx);
+    _mm_storeu_si128(output, _mm_unpacklo_epi32(ab_lo, cd_lo));
+    _mm_storeu_si128(output + 1, _mm_unpackhi_epi32(ab_lo, cd_lo));
+    _mm_storeu_si128(output + 2, _mm_unpacklo_epi32(ab_hi, cd_hi));
+    _mm_storeu_si128(output + 3, _mm_unpackhi_epi32(ab_hi, cd_hi));
+  }
+#endif
+  for (; idx < number_of_frames; idx++) {
+    for (size_t channel = 0; channel < 4; channel++) {
+      interleaved[4 * idx + channel] = channels[channel][idx];
+    }
+  }
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      InterleavePair
+//
+//  DESCRIPTION:
+//      Interleaves two channels into the corresponding (adjacent) slots
+//      of frames with 'stride' samples each. The pairs are formed with
+//      SIMD and written as 32-bit words, i.e. half as many stores as
+//      copying the samples one by one.
+//------------------------------------------------------------------------
+static void InterleavePair(const int16_t* first, const int16_t* second,
+                           size_t number_of_frames, size_t stride,
+                           int16_t* interleaved) {
+  size_t idx = 0;
+#if defined(__SSE2__)
+  int32_t pairs[8];
+  for (; idx + 8 <= number_of_frames; idx += 8) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + idx));
+    __m128i b =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(second + idx));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pairs),
+                     _mm_unpacklo_epi16(a, b));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pairs + 4),
+                     _mm_unpackhi_epi16(a, b));
+
+    for (size_t frame = 0; frame < 8; frame++) {
+      memcpy(interleaved + (idx + frame) * stride, &pairs[frame],
+             sizeof(int32_t));
+    }
+  }
+#endif
+  for (; idx < number_of_frames; idx++) {
+    interleaved[idx * stride] = first[idx];
+    interleaved[idx * stride + 1] = second[idx];
+  }
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      QuantiseSample
+//
+//  DESCRIPTION:
+//      Scales, clips and rounds one sample - the scalar version of what
+//      ConvertFloatToPcm16/24() do 4 samples at a time.
+//------------------------------------------------------------------------
+static int32_t QuantiseSample(float sample, float full_scale) {
+  float scaled = min(max(sample * full_scale, -full_scale), full_scale - 1);
+  return static_cast<int32_t>(lrintf(scaled));
+}
+
+//========================================================================
+// GENERAL USER INTERFACE
+//========================================================================
+void InterleaveChannels(const int16_t* const* channels,
+                        size_t number_of_channels, size_t number_of_frames,
+                        int16_t* interleaved) {
+  // Step 1: The layouts with dedicated routines
+  if (number_of_channels == 1) {
+    memcpy(interleaved, channels[0], number_of_frames * sizeof(int16_t));
+    return;
+  }
+
+  if (number_of_channels == 2) {
+    InterleaveStereo(channels[0], channels[1], number_of_frames, interleaved);
+    return;
+  }
+
+  if (number_of_channels == 4) {
+    InterleaveQuad(channels, number_of_frames, interleaved);
+    return;
+  }
+
+  // Step 2: Everything else, block by block, so that every pass over the
+  //         output block (one per pair of channels) hits L1
+  for (size_t begin = 0; begin < number_of_frames;
+       begin += kInterleaveBlockSize) {
+    size_t length = min(kInterleaveBlockSize, number_of_frames - begin);
+    int16_t* output = interleaved + begin * number_of_channels;
+    size_t channel = 0;
+
+    for (; channel + 2 <= number_of_channels; channel += 2) {
+      InterleavePair(channels[channel] + begin, channels[channel + 1] + begin,
+                     length, number_of_channels, output + channel);
+    }
+
+    // The odd one out
+    if (channel < number_of_channels) {
+      const int16_t* input = channels[channel] + begin;
+      for (size_t idx = 0; idx < length; idx++) {
+        output[idx * number_of_channels + channel] = input[idx];
+      }
+    }
+  }
+}
+
+void ConvertFloatToPcm16(const float* input, size_t number_of_samples,
+                         int16_t* output) {
+  size_t idx = 0;
+#if defined(__SSE2__)
+  const __m128 scale = _mm_set1_ps(kPcm16FullScale);
+  const __m128 lower = _mm_set1_ps(-kPcm16FullScale);
+  const __m128 upper = _mm_set1_ps(kPcm16FullScale - 1);
+
+  // Clip before converting - out of range samples would otherwise turn
+  // into 0x80000000
+  for (; idx + 8 <= number_of_samples; idx += 8) {
+    __m128 lo = _mm_mul_ps(_mm_loadu_ps(input + idx), scale);
+    __m128 hi = _mm_mul_ps(_mm_loadu_ps(input + idx + 4), scale);
+    lo = _mm_min_ps(_mm_max_ps(lo, lower), upper);
+    hi = _mm_min_ps(_mm_max_ps(hi, lower), upper);
+
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(output + idx),
+        _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi)));
+  }
+#endif
+  for (; idx < number_of_samples; idx++) {
+    output[idx] = static_cast<int16_t>(QuantiseSample(input[idx],
+                                                      kPcm16FullScale));
+  }
+}
+
+void ConvertFloatToPcm24(const float* input, size_t number_of_samples,
+                         uint8_t* output) {
+  size_t idx = 0;
+#if defined(__SSE2__)
+  const __m128 scale = _mm_set1_ps(kPcm24FullScale);
+  const __m128 lower = _mm_set1_ps(-kPcm24FullScale);
+  const __m128 upper = _mm_set1_ps(kPcm24FullScale - 1);
+  const __m128i low_mask = _mm_set1_epi64x(0x0000000000FFFFFFLL);
+  const __m128i high_mask = _mm_set1_epi64x(0x0000FFFFFF000000LL);
+
+  // Every 64-bit lane holds two 32-bit samples, a and b. Packing them
+  // into 48 bits is (a & 0xFFFFFF) | ((lane >> 8) & 0xFFFFFF000000).
+  // The last group is handled by the scalar loop, so that the 8-byte
+  // stores never write past the end of the output.
+  for (; idx + 8 <= number_of_samples; idx += 4) {
+    __m128 scaled = _mm_mul_ps(_mm_loadu_ps(input + idx), scale);
+    scaled = _mm_min_ps(_mm_max_ps(scaled, lower), upper);
+    __m128i samples = _mm_cvtps_epi32(scaled);
+
+    __m128i packed =
+        _mm_or_si128(_mm_and_si128(samples, low_mask),
+                     _mm_and_si128(_mm_srli_epi64(samples, 8), high_mask));
+
+    uint8_t* destination = output + 3 * idx;
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(destination), packed);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(destination + 6),
+                     _mm_unpackhi_epi64(packed, packed));
+  }
+#endif
+  for (; idx < number_of_samples; idx++) {
+    int32_t sample = QuantiseSample(input[idx], kPcm24FullScale);
+    output[3 * idx] = static_cast<uint8_t>(sample);
+    output[3 * idx + 1] = static_cast<uint8_t>(sample >> 8);
+    output[3 * idx + 2] = static_cast<uint8_t>(sample >> 16);
+  }
+}
+
+void ConvertPcm16ToFloat(const int16_t* input, size_t number_of_samples,
+                         float* output) {
+  size_t idx = 0;
+#if defined(__SSE2__)
+  const __m128 scale = _mm_set1_ps(1.0f / kPcm16FullScale);
+
+  for (; idx + 8 <= number_of_samples; idx += 8) {
+    __m128i samples =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + idx));
+    // Sign-extend to 32 bits: move every sample to the upper half of a
+    // 32-bit lane and shift it back arithmetically
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+
+    _mm_storeu_ps(output + idx, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+    _mm_storeu_ps(output + idx + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+  }
+#endif
+  for (; idx < number_of_samples; idx++) {
+    output[idx] = static_cast<float>(input[idx]) / kPcm16FullScale;
+  }
+}
+
+void ConvertPcm24ToFloat(const uint8_t* input, size_t number_of_samples,
+                         float* output) {
+  size_t idx = 0;
+#if defined(__SSE2__)
+  const __m128 scale = _mm_set1_ps(1.0f / kPcm24FullScale);
+  const __m128i low_mask = _mm_set1_epi64x(0x0000000000FFFFFFLL);
+  const __m128i high_mask = _mm_set1_epi64x(0x00FFFFFF00000000LL);
+
+  // The reverse of the packing in ConvertFloatToPcm24(): two samples
+  // (48 bits) per 64-bit lane are spread into two 32-bit lanes. The
+  // 8-byte loads stop short of the end of the input.
+  for (; idx + 8 <= number_of_samples; idx += 4) {
+    const uint8_t* source = input + 3 * idx;
+    __m128i packed = _mm_unpacklo_epi64(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(source)),
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(source + 6)));
+
+    __m128i samples =
+        _mm_or_si128(_mm_and_si128(packed, low_mask),
+                     _mm_and_si128(_mm_slli_epi64(packed, 8), high_mask));
+    // Sign-extend the 24-bit samples
+    samples = _mm_srai_epi32(_mm_slli_epi32(samples, 8), 8);
+
+    _mm_storeu_ps(output + idx, _mm_mul_ps(_mm_cvtepi32_ps(samples), scale));
+  }
+#endif
+  for (; idx < number_of_samples; idx++) {
+    const uint8_t* source = input + 3 * idx;
+    // Assemble the sample in the upper 24 bits, then shift it back
+    // arithmetically to sign-extend it
+    int32_t sample = static_cast<int32_t>(
+        (static_cast<uint32_t>(source[0]) << 8) |
+        (static_cast<uint32_t>(source[1]) << 16) |
+        (static_cast<uint32_t>(source[2]) << 24));
+    output[idx] = static_cast<float>(sample >> 8) / kPcm24FullScale;
+  }
+}
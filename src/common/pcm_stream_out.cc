@@ -0,0 +1,258 @@
+//========================================================================
+//  FILE:
+//      src/common/pcm_stream_out.cc
+//
+//  AUTHOR:
+//      zimzum@github
+//
+//  DESCRIPTION:
+//      Implementation of the PcmStreamOut class.
+//
+//  License: GNU GPL v2.0
+//========================================================================
+
+#include <common/pcm_stream_out.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+using namespace std;
+
+//========================================================================
+// UTILITIES
+//========================================================================
+//------------------------------------------------------------------------
+//  NAME:
+//      WriteToFile
+//
+//  DESCRIPTION:
+//      Writes the whole buffer, retrying on short writes (which are
+//      common with pipes) and interrupts. Errors are reported on
+//      stderr, as stdout may well be the stream itself.
+//  INPUT:
+//      fd     - the file descriptor to write to
+//      buffer - the data to write
+//      size   - the number of bytes to write
+//  OUTPUT:
+//      True on success, false otherwise
+//------------------------------------------------------------------------
+static bool WriteToFile(int fd, const uint8_t* buffer, size_t size) {
+  while (size > 0) {
+    ssize_t written = write(fd, buffer, size);
+
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      std::cerr << "Exception opening/reading/closing file\n";
+      return false;
+    }
+
+    buffer += written;
+    size -= static_cast<size_t>(written);
+  }
+
+  return true;
+}
+
+//========================================================================
+// CLASS: PcmStreamOut
+//========================================================================
+//------------------------------------------------------------------------
+// 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+//------------------------------------------------------------------------
+PcmStreamOut::PcmStreamOut(PcmStreamFraming framing,
+                           uint16_t number_of_channels, size_t buffer_size)
+    : framing_(framing),
+      buffer_size_(buffer_size),
+      storage_(buffer_size + kPcmStreamAlignment),
+      buffer_(nullptr),
+      bytes_buffered_(0),
+      file_descriptor_(-1),
+      owns_file_descriptor_(false),
+      header_offset_(-1),
+      bytes_written_(0) {
+  // Whole pages, large enough for the header
+  assert((buffer_size_ >= kPcmStreamAlignment) &&
+         (buffer_size_ % kPcmStreamAlignment == 0));
+
+  uintptr_t address = reinterpret_cast<uintptr_t>(storage_.data());
+  buffer_ = storage_.data() +
+            (kPcmStreamAlignment - address % kPcmStreamAlignment) %
+                kPcmStreamAlignment;
+
+  WaveFile::set_sample_layout(number_of_channels, SampleFormat::kPcm16);
+}
+
+PcmStreamOut::~PcmStreamOut() { Close(); }
+
+//------------------------------------------------------------------------
+// 2. GENERAL USER INTERFACE
+//------------------------------------------------------------------------
+bool PcmStreamOut::Open(int file_descriptor) {
+  struct stat file_status;
+
+  Close();
+
+  file_descriptor_ = file_descriptor;
+  owns_file_descriptor_ = false;
+  bytes_buffered_ = 0;
+  bytes_written_ = 0;
+
+  // Only regular files can be seeked back to, to patch the header
+  header_offset_ = -1;
+  if ((fstat(file_descriptor_, &file_status) == 0) &&
+      S_ISREG(file_status.st_mode)) {
+    header_offset_ = lseek(file_descriptor_, 0, SEEK_CUR);
+  }
+
+  if (framing_ == PcmStreamFraming::kWave) {
+    SerialiseStreamHeader(buffer_, false);
+    bytes_buffered_ = kPcmStreamAlignment;
+  }
+
+  return true;
+}
+
+bool PcmStreamOut::Open(const std::string& file_name) {
+  Close();
+
+  if (file_name == "-") return Open(STDOUT_FILENO);
+
+  int file_descriptor =
+      open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (file_descriptor < 0) {
+    std::cerr << "Exception opening/reading/closing file\n";
+    return false;
+  }
+
+  Open(file_descriptor);
+  owns_file_descriptor_ = true;
+
+  return true;
+}
+
+bool PcmStreamOut::Append(const int16_t* samples, size_t number_of_samples) {
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(samples);
+  size_t size = number_of_samples * sizeof(int16_t);
+
+  assert(IsOpen());
+
+  bytes_written_ += size;
+
+  // Step 1: Top up the buffer and write it once it's full
+  if (bytes_buffered_ > 0) {
+    size_t length = min(size, buffer_size_ - bytes_buffered_);
+    memcpy(buffer_ + bytes_buffered_, data, length);
+    bytes_buffered_ += length;
+    data += length;
+    size -= length;
+
+    if (bytes_buffered_ < buffer_size_) return true;
+
+    bytes_buffered_ = 0;
+    if (!WriteToFile(file_descriptor_, buffer_, buffer_size_)) return false;
+  }
+
+  // Step 2: Whole buffers are written straight from the input
+  size_t direct_size = size - size % buffer_size_;
+  if (direct_size > 0) {
+    if (!WriteToFile(file_descriptor_, data, direct_size)) return false;
+    data += direct_size;
+    size -= direct_size;
+  }
+
+  // Step 3: Keep the rest for later
+  memcpy(buffer_, data, size);
+  bytes_buffered_ = size;
+
+  return true;
+}
+
+bool PcmStreamOut::Append(const std::vector<int16_t>& samples) {
+  return Append(samples.data(), samples.size());
+}
+
+bool PcmStreamOut::Flush() {
+  assert(IsOpen());
+
+  size_t size = bytes_buffered_;
+  bytes_buffered_ = 0;
+
+  return WriteToFile(file_descriptor_, buffer_, size);
+}
+
+bool PcmStreamOut::Close() {
+  if (!IsOpen()) return true;
+
+  bool success = Flush();
+
+  // The buffer is empty now, so the header can be put together in it
+  if (success && (framing_ == PcmStreamFraming::kWave) &&
+      (header_offset_ >= 0)) {
+    SerialiseStreamHeader(buffer_, true);
+    success = (pwrite(file_descriptor_, buffer_, kPcmStreamAlignment,
+                      header_offset_) ==
+               static_cast<ssize_t>(kPcmStreamAlignment));
+  }
+
+  if (owns_file_descriptor_) {
+    success = (close(file_descriptor_) == 0) && success;
+  }
+  file_descriptor_ = -1;
+
+  if (!success) std::cerr << "Exception opening/reading/closing file\n";
+
+  return success;
+}
+
+//------------------------------------------------------------------------
+// 4. PRIVATE METHODS
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
+//  NAME:
+//      SerialiseStreamHeader()
+//
+//  DESCRIPTION:
+//      Puts together the WAVE header of the stream: the canonical
+//      header with a "JUNK" chunk inserted after the RIFF descriptor,
+//      kPcmStreamAlignment bytes in total. The sizes are set to
+//      "unknown" unless they're known and fit in 32 bits (there's no
+//      room to promote a stream to RF64).
+//  INPUT:
+//      header      - buffer of at least kPcmStreamAlignment bytes
+//      sizes_known - true if all the samples have been appended
+//  OUTPUT:
+//      None
+//------------------------------------------------------------------------
+void PcmStreamOut::SerialiseStreamHeader(uint8_t* header, bool sizes_known) {
+  uint8_t canonical_header[kWaveFileCanonicalHeaderSize];
+  const size_t descriptor_size = 3 * kSizeFourBytes;
+  const size_t sub_chunks_size =
+      kWaveFileCanonicalHeaderSize - descriptor_size;
+  const uint32_t junk_size = static_cast<uint32_t>(
+      kPcmStreamAlignment - kWaveFileCanonicalHeaderSize - 2 * kSizeFourBytes);
+  const uint64_t chunk_size =
+      kPcmStreamAlignment - 2 * kSizeFourBytes + bytes_written_;
+
+  if (sizes_known && (chunk_size <= kWaveFileUnknownSize)) {
+    WaveFile::set_data_size(bytes_written_);
+    WaveFile::set_chunk_size(static_cast<uint32_t>(chunk_size));
+  } else {
+    WaveFile::set_data_size(0);
+    WaveFile::set_chunk_size(kWaveFileUnknownSize);
+    WaveFile::set_subchunk_2_size(kWaveFileUnknownSize);
+  }
+  SerialiseHeader(canonical_header);
+
+  // RIFF descriptor | JUNK | "fmt " and "data" sub-chunks
+  memcpy(header, canonical_header, descriptor_size);
+  header += descriptor_size;
+  memcpy(header, &kJunkChunkId, kSizeFourBytes);
+  memcpy(header + kSizeFourBytes, &junk_size, kSizeFourBytes);
+  memset(header + 2 * kSizeFourBytes, 0, junk_size);
+  header += 2 * kSizeFourBytes + junk_size;
+  memcpy(header, canonical_header + descriptor_size, sub_chunks_size);
+}
@@ -0,0 +1,398 @@
+//========================================================================
+//  FILE:
+//      src/common/sample_rate_converter.cc
+//
+//  AUTHOR:
+//      zimzum@github
+//
+//  DESCRIPTION:
+//      Implementation of the SampleRateConverter and ResampledWaveFileIn
+//      classes.
+//
+//  License: GNU GPL v2.0
+//========================================================================
+
+#include <common/sample_rate_converter.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+//========================================================================
+// UTILITIES
+//========================================================================
+//------------------------------------------------------------------------
+//  NAME:
+//      GreatestCommonDivisor
+//
+//  DESCRIPTION:
+//      The greatest common divisor of two numbers (std::gcd is C++17).
+//------------------------------------------------------------------------
+static uint64_t GreatestCommonDivisor(uint64_t lhs, uint64_t rhs) {
+  while (rhs != 0) {
+    uint64_t remainder = lhs % rhs;
+    lhs = rhs;
+    rhs = remainder;
+  }
+
+  return lhs;
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      BesselI0
+//
+//  DESCRIPTION:
+//      The modified Bessel function of the first kind of order 0, for
+//      the Kaiser window. The series converges quickly for the
+//      arguments used here.
+//------------------------------------------------------------------------
+static double BesselI0(double x) {
+  double sum = 1.0;
+  double term = 1.0;
+
+  for (unsigned k = 1; term > sum * 1e-12; k++) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+  }
+
+  return sum;
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      DotProduct
+//
+//  DESCRIPTION:
+//      The dot product of two vectors, 4 elements at a time with SSE.
+//------------------------------------------------------------------------
+static float DotProduct(const float* lhs, const float* rhs, size_t length) {
+  size_t idx = 0;
+  float sum = 0.0f;
+
+#if defined(__SSE2__)
+  __m128 sums = _mm_setzero_ps();
+  for (; idx + 4 <= length; idx += 4) {
+    sums = _mm_add_ps(
+        sums, _mm_mul_ps(_mm_loadu_ps(lhs + idx), _mm_loadu_ps(rhs + idx)));
+  }
+
+  float lanes[4];
+  _mm_storeu_ps(lanes, sums);
+  sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+
+  for (; idx < length; idx++) {
+    sum += lhs[idx] * rhs[idx];
+  }
+
+  return sum;
+}
+
+//========================================================================
+// CLASS: SampleRateConverter
+//========================================================================
+//------------------------------------------------------------------------
+// 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+//------------------------------------------------------------------------
+SampleRateConverter::SampleRateConverter(uint32_t input_rate,
+                                         uint32_t output_rate,
+                                         uint16_t number_of_channels)
+    : input_rate_(input_rate),
+      output_rate_(output_rate),
+      number_of_channels_(number_of_channels),
+      history_(number_of_channels) {
+  assert((input_rate_ > 0) && (output_rate_ > 0));
+  assert(number_of_channels_ > 0);
+
+  uint64_t divisor = GreatestCommonDivisor(input_rate_, output_rate_);
+  interpolation_ = output_rate_ / divisor;
+  decimation_ = input_rate_ / divisor;
+
+  // When downsampling the filter is stretched to cut off below the
+  // output Nyquist frequency
+  number_of_taps_ = kResamplerNumberOfTaps;
+  if (decimation_ > interpolation_) {
+    number_of_taps_ = static_cast<size_t>(
+        ceil(kResamplerNumberOfTaps * static_cast<double>(decimation_) /
+             interpolation_));
+    number_of_taps_ = (number_of_taps_ + 3) / 4 * 4;
+  }
+
+  number_of_phases_ = static_cast<size_t>(
+      min<uint64_t>(interpolation_, kResamplerMaxNumberOfPhases));
+  DesignFilter();
+
+  for (auto& channel : history_) {
+    channel.resize(number_of_taps_ + kResamplerBlockSize);
+  }
+  Reset();
+}
+
+SampleRateConverter::~SampleRateConverter() = default;
+
+//------------------------------------------------------------------------
+// 2. GENERAL USER INTERFACE
+//------------------------------------------------------------------------
+size_t SampleRateConverter::Process(const float* input,
+                                    size_t number_of_frames, float* output) {
+  const size_t capacity = history_[0].size();
+  size_t number_of_outputs = 0;
+
+  for (size_t done = 0; done < number_of_frames;) {
+    // 1. Append as many input frames as fit, one channel at a time
+    size_t length = min(number_of_frames - done, capacity - history_size_);
+    for (uint16_t channel = 0; channel < number_of_channels_; channel++) {
+      const float* source = input + done * number_of_channels_ + channel;
+      float* destination = history_[channel].data() + history_size_;
+      for (size_t idx = 0; idx < length; idx++) {
+        destination[idx] = source[idx * number_of_channels_];
+      }
+    }
+    history_size_ += length;
+    done += length;
+
+    // 2. Interpolate every output frame whose input frames are all here
+    while (position_ + number_of_taps_ <= history_size_) {
+      for (uint16_t channel = 0; channel < number_of_channels_; channel++) {
+        output[number_of_outputs * number_of_channels_ + channel] =
+            Interpolate(history_[channel].data() + position_, fraction_);
+      }
+      number_of_outputs++;
+
+      fraction_ += decimation_;
+      position_ += static_cast<size_t>(fraction_ / interpolation_);
+      fraction_ %= interpolation_;
+    }
+
+    // 3. Drop the frames that no output frame needs any more
+    size_t drop = min(position_, history_size_);
+    for (auto& channel : history_) {
+      memmove(channel.data(), channel.data() + drop,
+              (history_size_ - drop) * sizeof(float));
+    }
+    history_size_ -= drop;
+    position_ -= drop;
+  }
+
+  return number_of_outputs;
+}
+
+void SampleRateConverter::Reset() {
+  // The first output frame is at the first input frame, which is
+  // preceded by half of the filter
+  for (auto& channel : history_) {
+    fill(channel.begin(), channel.end(), 0.0f);
+  }
+  history_size_ = number_of_taps_ / 2 - 1;
+  position_ = 0;
+  fraction_ = 0;
+}
+
+//------------------------------------------------------------------------
+// 3. ACCESSORS
+//------------------------------------------------------------------------
+size_t SampleRateConverter::max_output_frames(size_t number_of_frames) const {
+  return static_cast<size_t>(
+      (number_of_frames * interpolation_ + decimation_ - 1) / decimation_);
+}
+
+//------------------------------------------------------------------------
+// 4. PRIVATE METHODS
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
+//  NAME:
+//      DesignFilter()
+//
+//  DESCRIPTION:
+//      Computes the rows of the filter table. The row for the phase p
+//      interpolates the output frame that lies p / number_of_phases_ of
+//      a frame after the centre of the taps, i.e. after tap
+//      number_of_taps_ / 2 - 1. Every row is normalised for unity gain
+//      at DC.
+//  INPUT:
+//      None
+//  OUTPUT:
+//      None
+//------------------------------------------------------------------------
+void SampleRateConverter::DesignFilter() {
+  // The cut-off in cycles per input frame
+  const double cutoff =
+      0.5 * kResamplerCutoff *
+      min(1.0, static_cast<double>(interpolation_) / decimation_);
+  const double half_width = number_of_taps_ / 2.0;
+  const double window_scale = 1.0 / BesselI0(kResamplerKaiserBeta);
+
+  coefficients_.resize((number_of_phases_ + 1) * number_of_taps_);
+
+  for (size_t phase = 0; phase <= number_of_phases_; phase++) {
+    const double offset =
+        half_width - 1.0 + static_cast<double>(phase) / number_of_phases_;
+    float* row = coefficients_.data() + phase * number_of_taps_;
+    vector<double> taps(number_of_taps_);
+    double sum = 0.0;
+
+    for (size_t tap = 0; tap < number_of_taps_; tap++) {
+      double x = offset - static_cast<double>(tap);
+      double argument = kTwoPi * cutoff * x;
+      double sinc = (fabs(argument) < 1e-9) ? 1.0 : sin(argument) / argument;
+      double ratio = min(1.0, fabs(x) / half_width);
+      double window =
+          BesselI0(kResamplerKaiserBeta * sqrt(1.0 - ratio * ratio)) *
+          window_scale;
+
+      taps[tap] = sinc * window;
+      sum += taps[tap];
+    }
+
+    for (size_t tap = 0; tap < number_of_taps_; tap++) {
+      row[tap] = static_cast<float>(taps[tap] / sum);
+    }
+  }
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      Interpolate()
+//
+//  DESCRIPTION:
+//      Interpolates one output sample of one channel.
+//  INPUT:
+//      frames   - number_of_taps_ samples of the channel
+//      fraction - the position of the output sample after the centre
+//                 of the taps, in units of 1 / interpolation_
+//  OUTPUT:
+//      The output sample.
+//------------------------------------------------------------------------
+float SampleRateConverter::Interpolate(const float* frames,
+                                       uint64_t fraction) const {
+  if (number_of_phases_ == interpolation_) {
+    return DotProduct(frames,
+                      coefficients_.data() + fraction * number_of_taps_,
+                      number_of_taps_);
+  }
+
+  // The position falls between two rows
+  uint64_t scaled = fraction * number_of_phases_;
+  const float* row =
+      coefficients_.data() + (scaled / interpolation_) * number_of_taps_;
+  float weight = static_cast<float>(static_cast<double>(
+                     scaled % interpolation_) / interpolation_);
+  float before = DotProduct(frames, row, number_of_taps_);
+  float after = DotProduct(frames, row + number_of_taps_, number_of_taps_);
+
+  return before + weight * (after - before);
+}
+
+//========================================================================
+// CLASS: ResampledWaveFileIn
+//========================================================================
+//------------------------------------------------------------------------
+// 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+//------------------------------------------------------------------------
+ResampledWaveFileIn::ResampledWaveFileIn(WaveFileIn& wave_file,
+                                         const SynthConfig& synthesiser)
+    : wave_file_(wave_file),
+      number_of_channels_(wave_file.num_channels()),
+      converter_(wave_file.sample_rate(), synthesiser.sampling_rate(),
+                 wave_file.num_channels()),
+      frames_read_(0),
+      next_input_frame_(0),
+      padding_(0),
+      output_position_(0),
+      output_size_(0) {
+  assert(wave_file_.IsOpen() && "The file has to be open!");
+
+  // One output frame per input frame position within the file
+  number_of_frames_ =
+      (wave_file_.number_of_frames() * converter_.output_rate() +
+       converter_.input_rate() - 1) /
+      converter_.input_rate();
+
+  input_.resize(kResamplerBlockSize * number_of_channels_);
+  output_.resize(converter_.max_output_frames(kResamplerBlockSize) *
+                 number_of_channels_);
+}
+
+ResampledWaveFileIn::~ResampledWaveFileIn() = default;
+
+//------------------------------------------------------------------------
+// 2. GENERAL USER INTERFACE
+//------------------------------------------------------------------------
+size_t ResampledWaveFileIn::Read(float* samples, size_t number_of_frames) {
+  number_of_frames = static_cast<size_t>(
+      min<uint64_t>(number_of_frames, number_of_frames_ - frames_read_));
+
+  // The same sampling rate - nothing to convert
+  if (converter_.input_rate() == converter_.output_rate()) {
+    size_t count = wave_file_.ReadFrames(frames_read_, number_of_frames,
+                                         samples);
+    frames_read_ += count;
+    return count;
+  }
+
+  size_t done = 0;
+  while (done < number_of_frames) {
+    if (output_position_ == output_size_) {
+      if (!Refill()) break;
+      continue;
+    }
+
+    size_t count =
+        min(number_of_frames - done, output_size_ - output_position_);
+    copy(output_.begin() + output_position_ * number_of_channels_,
+         output_.begin() + (output_position_ + count) * number_of_channels_,
+         samples + done * number_of_channels_);
+    output_position_ += count;
+    done += count;
+  }
+
+  frames_read_ += done;
+  return done;
+}
+
+//------------------------------------------------------------------------
+// 4. PRIVATE METHODS
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
+//  NAME:
+//      Refill()
+//
+//  DESCRIPTION:
+//      Reads the next block of the file and converts it. After the end
+//      of the file the converter is flushed with silence.
+//  INPUT:
+//      None
+//  OUTPUT:
+//      False if there's nothing more to convert or the file could not
+//      be read, true otherwise.
+//------------------------------------------------------------------------
+bool ResampledWaveFileIn::Refill() {
+  size_t count = 0;
+  uint64_t remaining = wave_file_.number_of_frames() - next_input_frame_;
+
+  if (remaining > 0) {
+    count = wave_file_.ReadFrames(
+        next_input_frame_,
+        static_cast<size_t>(min<uint64_t>(remaining, kResamplerBlockSize)),
+        input_.data());
+    if (count == 0) return false;
+    next_input_frame_ += count;
+  } else {
+    if (padding_ >= converter_.latency()) return false;
+    count = min(kResamplerBlockSize, converter_.latency() - padding_);
+    fill(input_.begin(), input_.begin() + count * number_of_channels_, 0.0f);
+    padding_ += count;
+  }
+
+  output_size_ = converter_.Process(input_.data(), count, output_.data());
+  output_position_ = 0;
+  return true;
+}
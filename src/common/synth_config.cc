@@ -12,42 +12,69 @@
 //========================================================================
 
 #include <common/synth_config.h>
+#include <common/pitch_tables.h>
 #include <global/global_include.h>
 
 using namespace std;
 
 //========================================================================
-// Class: SynthConfig
+// UTILITIES
 //========================================================================
 //------------------------------------------------------------------------
-// 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+//  NAME:
+//      FindPhaseIncrementTable
+//
+//  DESCRIPTION:
+//      Returns the compile-time table of phase increments for the given
+//      sampling rate, or nullptr if there isn't one.
 //------------------------------------------------------------------------
-SynthConfig::~SynthConfig() = default;
+static const double* FindPhaseIncrementTable(uint32_t sampling_rate) {
+  switch (sampling_rate) {
+    case 44100:
+      return PitchTable::PhaseIncrements<44100>::values;
+    case 48000:
+      return PitchTable::PhaseIncrements<48000>::values;
+    case 88200:
+      return PitchTable::PhaseIncrements<88200>::values;
+    case 96000:
+      return PitchTable::PhaseIncrements<96000>::values;
+    default:
+      return nullptr;
+  }
+}
 
+//========================================================================
+// Class: SynthConfig
+//========================================================================
 //------------------------------------------------------------------------
-// 2. GENERAL USER INTERFACE
+// 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
 //------------------------------------------------------------------------
-SynthConfig& SynthConfig::getInstance() {
-  // The only instance of the SynthConfig class. Guaranteed to be
-  // lazy initialised and destroyed correctly.
-  static SynthConfig instance;
+SynthConfig::SynthConfig(uint32_t sampling_rate_arg)
+    : sampling_rate_(sampling_rate_arg),
+      nyquist_limit_(sampling_rate_arg >> 1),
+      phase_increment_per_sample_(kTwoPi / sampling_rate_arg),
+      frequency_table_(PitchTable::frequencies),
+      phase_increment_table_(FindPhaseIncrementTable(sampling_rate_arg)) {
+  assert(sampling_rate_arg > 0);
+  assert(kNumberOfFrequencies == kPitchTableSize);
 
-  return instance;
+  // A less common sampling rate - the same calculation, at run time
+  if (phase_increment_table_ == nullptr) {
+    phase_increment_storage_.resize(kPitchTableSize);
+    for (size_t pitch = 0; pitch < kPitchTableSize; pitch++) {
+      phase_increment_storage_[pitch] =
+          PitchPhaseIncrement(sampling_rate_, pitch);
+    }
+    phase_increment_table_ = phase_increment_storage_.data();
+  }
 }
 
-void SynthConfig::Init(uint32_t sampling_rate_arg) {
-  double frequency = kNoteC0;
-
-  for (vector<double>::iterator it = frequency_table_.begin();
-       it != frequency_table_.end(); ++it) {
-    *it = frequency;
-    frequency *= kTwelthRootOfTwo;
-  }
+SynthConfig::~SynthConfig() = default;
 
-  sampling_rate_ = sampling_rate_arg;
-  nyquist_limit_ = sampling_rate_ >> 1;
-  phase_increment_per_sample_ = kTwoPi / sampling_rate_;
-}
+//------------------------------------------------------------------------
+// 2. GENERAL USER INTERFACE
+//------------------------------------------------------------------------
+// None
 
 //------------------------------------------------------------------------
 // 3. ACCESSORS
@@ -56,6 +83,11 @@ double SynthConfig::frequency_table(vector<double>::size_type pitch) const {
   return frequency_table_[pitch];
 }
 
+double SynthConfig::phase_increment_table(
+    vector<double>::size_type pitch) const {
+  return phase_increment_table_[pitch];
+}
+
 uint32_t SynthConfig::sampling_rate() const { return sampling_rate_; }
 
 double SynthConfig::phase_increment_per_sample() const {
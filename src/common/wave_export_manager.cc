@@ -0,0 +1,190 @@
+//========================================================================
+//  FILE:
+//      src/common/wave_export_manager.cc
+//
+//  AUTHOR:
+//      zimzum@github
+//
+//  DESCRIPTION:
+//      Implementation of the WaveExportManager class.
+//
+//  License: GNU GPL v2.0
+//========================================================================
+
+#include <common/wave_export_manager.h>
+
+#include <algorithm>
+
+using namespace std;
+
+//========================================================================
+// CLASS: WaveExportManager
+//========================================================================
+//------------------------------------------------------------------------
+// 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+//------------------------------------------------------------------------
+WaveExportManager::WaveExportManager(size_t number_of_threads,
+                                     size_t max_files_in_flight)
+    : number_of_threads_(max<size_t>(1, number_of_threads)),
+      max_files_in_flight_(max<size_t>(1, max_files_in_flight)),
+      start_time_(chrono::steady_clock::now()),
+      files_in_flight_(0),
+      stop_(false),
+      metrics_() {
+  for (size_t idx = 0; idx < number_of_threads_; idx++) {
+    io_threads_.emplace_back(&WaveExportManager::IoThreadLoop, this);
+  }
+}
+
+WaveExportManager::~WaveExportManager() { Finish(); }
+
+//------------------------------------------------------------------------
+// 2. GENERAL USER INTERFACE
+//------------------------------------------------------------------------
+void WaveExportManager::Submit(const std::string& file_name,
+                               std::vector<int16_t>&& samples,
+                               uint16_t number_of_channels,
+                               uint32_t sample_rate) {
+  unique_lock<mutex> lock(mutex_);
+
+  assert(!stop_ && "The manager has finished!");
+  assert(samples.size() % number_of_channels == 0);
+
+  if (files_in_flight_ >= max_files_in_flight_) {
+    // All the slots are taken - the disk is slower than the renderer
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    slot_available_.wait(
+        lock, [this] { return files_in_flight_ < max_files_in_flight_; });
+
+    metrics_.number_of_stalls++;
+    metrics_.stall_time_ns += chrono::duration_cast<chrono::nanoseconds>(
+                                  chrono::steady_clock::now() - start)
+                                  .count();
+  }
+
+  Job job;
+  job.file_name = file_name;
+  job.samples = std::move(samples);
+  job.number_of_channels = number_of_channels;
+  job.sample_rate = sample_rate;
+  jobs_.push_back(std::move(job));
+
+  files_in_flight_++;
+  metrics_.max_files_in_flight =
+      max(metrics_.max_files_in_flight, files_in_flight_);
+
+  lock.unlock();
+  job_available_.notify_one();
+}
+
+bool WaveExportManager::Finish() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    stop_ = true;
+  }
+  job_available_.notify_all();
+
+  // The I/O threads drain the queue before they exit
+  for (auto& io_thread : io_threads_) io_thread.join();
+  io_threads_.clear();
+
+  lock_guard<mutex> lock(mutex_);
+  return metrics_.number_of_failures == 0;
+}
+
+//------------------------------------------------------------------------
+// 3. ACCESSORS
+//------------------------------------------------------------------------
+WaveExportMetrics WaveExportManager::metrics() const {
+  lock_guard<mutex> lock(mutex_);
+  return metrics_;
+}
+
+double WaveExportManager::files_per_second() const {
+  WaveExportMetrics snapshot = metrics();
+
+  if (snapshot.elapsed_time_ns == 0) return 0.0;
+  return snapshot.number_of_files * 1e9 / snapshot.elapsed_time_ns;
+}
+
+double WaveExportManager::bytes_per_second() const {
+  WaveExportMetrics snapshot = metrics();
+
+  if (snapshot.elapsed_time_ns == 0) return 0.0;
+  return snapshot.number_of_bytes * 1e9 / snapshot.elapsed_time_ns;
+}
+
+//------------------------------------------------------------------------
+// 4. PRIVATE METHODS
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
+//  NAME:
+//      WriteFile()
+//
+//  DESCRIPTION:
+//      Writes the samples of one job with WaveFileOut::SaveBufferToFile(),
+//      i.e. a canonical 44-byte header and the samples in one vectored
+//      write. The file is sized by the number of frames, so any length
+//      gets the same header layout.
+//  INPUT:
+//      job             - the file to write
+//      number_of_bytes - the size of the file written (output)
+//  OUTPUT:
+//      True on success, false otherwise.
+//------------------------------------------------------------------------
+bool WaveExportManager::WriteFile(Job& job, uint64_t& number_of_bytes) {
+  WaveFileOut wave_file(0, job.number_of_channels, SampleFormat::kPcm16,
+                        job.sample_rate);
+
+  wave_file.set_number_of_frames(job.samples.size() / job.number_of_channels);
+  number_of_bytes = wave_file.header_size() + wave_file.data_size();
+  return wave_file.SaveBufferToFile(job.file_name, job.samples);
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      IoThreadLoop()
+//
+//  DESCRIPTION:
+//      The body of every I/O thread. Takes the files off the queue in
+//      the order they were submitted and writes them, each in one go
+//      with the mutex released. Sleeps while there's nothing to write
+//      and exits once Finish() was called and the queue is empty.
+//  INPUT:
+//      None
+//  OUTPUT:
+//      None
+//------------------------------------------------------------------------
+void WaveExportManager::IoThreadLoop() {
+  unique_lock<mutex> lock(mutex_);
+
+  while (true) {
+    job_available_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+    if (jobs_.empty()) break;
+
+    Job job = std::move(jobs_.front());
+    jobs_.pop_front();
+    lock.unlock();
+
+    // Write the file
+    uint64_t number_of_bytes;
+    bool success = WriteFile(job, number_of_bytes);
+
+    // Free the samples before the slot, so that the memory held by the
+    // manager stays bounded
+    vector<int16_t>().swap(job.samples);
+
+    lock.lock();
+    if (success) {
+      metrics_.number_of_files++;
+      metrics_.number_of_bytes += number_of_bytes;
+    } else {
+      metrics_.number_of_failures++;
+    }
+    metrics_.elapsed_time_ns = chrono::duration_cast<chrono::nanoseconds>(
+                                   chrono::steady_clock::now() - start_time_)
+                                   .count();
+    files_in_flight_--;
+    slot_available_.notify_one();
+  }
+}
@@ -14,8 +14,222 @@
 
 #include "common/wave_file.h"
 
+#include <common/flac_codec.h>
+#include <common/pcm_conversion.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
 using namespace std;
 
+//=============================================================
+// UTILITIES
+//=============================================================
+//--------------------------------------------------------------
+//  NAME:
+//      PutField
+//
+//  DESCRIPTION:
+//      Copies one header field into the header buffer. The fields
+//      are stored in the byte order of the host, which (like
+//      everywhere else in this file) is assumed to be little-endian.
+//  INPUT:
+//      destination - where to write the field
+//      value       - the field
+//  OUTPUT:
+//      Pointer to the byte following the field
+//--------------------------------------------------------------
+template <typename T>
+static uint8_t* PutField(uint8_t* destination, T value) {
+  memcpy(destination, &value, sizeof(value));
+  return destination + sizeof(value);
+}
+
+//--------------------------------------------------------------
+//  NAME:
+//      GetField
+//
+//  DESCRIPTION:
+//      The counterpart of PutField: copies one header field out of
+//      the header buffer.
+//  INPUT:
+//      source - where to read the field from
+//      value  - the field
+//  OUTPUT:
+//      Pointer to the byte following the field
+//--------------------------------------------------------------
+template <typename T>
+static const uint8_t* GetField(const uint8_t* source, T& value) {
+  memcpy(&value, source, sizeof(value));
+  return source + sizeof(value);
+}
+
+//--------------------------------------------------------------
+//  NAME:
+//      WriteVectorToFile
+//
+//  DESCRIPTION:
+//      Writes all the buffers described by 'iov' to the file using
+//      as few writev() calls as the kernel allows (normally one).
+//      Short writes and interrupted calls are resumed.
+//  INPUT:
+//      fd           - the file descriptor to write to
+//      iov          - the buffers to write (modified on short writes)
+//      iov_count    - the number of buffers
+//  OUTPUT:
+//      True on success, false otherwise
+//--------------------------------------------------------------
+static bool WriteVectorToFile(int fd, struct iovec* iov, int iov_count) {
+  while (iov_count > 0) {
+    ssize_t written = writev(fd, iov, iov_count);
+
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+
+    // Skip whatever has been written and try again with the rest
+    size_t remaining = static_cast<size_t>(written);
+    while (iov_count > 0 && remaining >= iov->iov_len) {
+      remaining -= iov->iov_len;
+      iov++;
+      iov_count--;
+    }
+    if (iov_count > 0) {
+      iov->iov_base = static_cast<uint8_t*>(iov->iov_base) + remaining;
+      iov->iov_len -= remaining;
+    }
+  }
+
+  return true;
+}
+
+//--------------------------------------------------------------
+//  NAME:
+//      ReadFromFile
+//
+//  DESCRIPTION:
+//      Reads exactly "size" bytes at the given position of the file,
+//      retrying on short reads and interrupts. The file position is
+//      neither used nor changed.
+//  INPUT:
+//      fd     - the file descriptor to read from
+//      buffer - the output buffer
+//      size   - the number of bytes to read
+//      offset - the position in the file to read from
+//  OUTPUT:
+//      True on success, false on errors and at the end of the file
+//--------------------------------------------------------------
+static bool ReadFromFile(int fd, void* buffer, size_t size, uint64_t offset) {
+  uint8_t* destination = static_cast<uint8_t*>(buffer);
+
+  while (size > 0) {
+    ssize_t bytes_read =
+        pread(fd, destination, size, static_cast<off_t>(offset));
+
+    if (bytes_read < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    if (bytes_read == 0) return false;
+
+    destination += bytes_read;
+    size -= static_cast<size_t>(bytes_read);
+    offset += static_cast<uint64_t>(bytes_read);
+  }
+
+  return true;
+}
+
+//--------------------------------------------------------------
+//  NAME:
+//      BytesPerSample
+//
+//  DESCRIPTION:
+//      Returns the size of one sample (in one channel) of the given
+//      format.
+//  INPUT:
+//      sample_format - the format of the samples
+//  OUTPUT:
+//      The size in bytes
+//--------------------------------------------------------------
+static size_t BytesPerSample(SampleFormat sample_format) {
+  switch (sample_format) {
+    case SampleFormat::kPcm24:
+      return kNumberOfBitsPerSample24 / kNumberOfBitsPerByte;
+    case SampleFormat::kFloat32:
+      return kNumberOfBitsPerSample32 / kNumberOfBitsPerByte;
+    default:
+      return kNumberOfBitsPerSample / kNumberOfBitsPerByte;
+  }
+}
+
+//--------------------------------------------------------------
+//  NAME:
+//      ConvertFromFloat
+//
+//  DESCRIPTION:
+//      Converts floating point samples to the given format of the
+//      samples in a WAVE file.
+//  INPUT:
+//      sample_format     - the format to convert to
+//      input             - the samples to convert
+//      number_of_samples - the number of samples
+//      output            - the converted samples
+//  OUTPUT:
+//      None
+//--------------------------------------------------------------
+static void ConvertFromFloat(SampleFormat sample_format, const float* input,
+                             size_t number_of_samples, uint8_t* output) {
+  switch (sample_format) {
+    case SampleFormat::kPcm16:
+      ConvertFloatToPcm16(input, number_of_samples,
+                          reinterpret_cast<int16_t*>(output));
+      break;
+    case SampleFormat::kPcm24:
+      ConvertFloatToPcm24(input, number_of_samples, output);
+      break;
+    case SampleFormat::kFloat32:
+      memcpy(output, input, number_of_samples * sizeof(float));
+      break;
+  }
+}
+
+//--------------------------------------------------------------
+//  NAME:
+//      ConvertToFloat
+//
+//  DESCRIPTION:
+//      The counterpart of ConvertFromFloat.
+//  INPUT:
+//      sample_format     - the format to convert from
+//      input             - the samples to convert
+//      number_of_samples - the number of samples
+//      output            - the converted samples
+//  OUTPUT:
+//      None
+//--------------------------------------------------------------
+static void ConvertToFloat(SampleFormat sample_format, const uint8_t* input,
+                           size_t number_of_samples, float* output) {
+  switch (sample_format) {
+    case SampleFormat::kPcm16:
+      ConvertPcm16ToFloat(reinterpret_cast<const int16_t*>(input),
+                          number_of_samples, output);
+      break;
+    case SampleFormat::kPcm24:
+      ConvertPcm24ToFloat(input, number_of_samples, output);
+      break;
+    case SampleFormat::kFloat32:
+      memcpy(output, input, number_of_samples * sizeof(float));
+      break;
+  }
+}
+
 //=============================================================
 // CLASS: WaveFile
 //=============================================================
@@ -37,8 +251,9 @@ WaveFile::WaveFile() {
   // Step 2: Member variables that dependend on previously defined
   //         variables. subchunk_2_size is initialised to 0 as there
   //         are no data samples associated with this file yet.
-  subchunk_2_size_ = 0;
-  chunk_size_ = kWaveFileHeaderSize + subchunk_2_size_;
+  force_rf64_ = false;
+  reserve_ds64_ = false;
+  set_data_size(0);
   byte_rate_ =
       sample_rate_ * num_channels_ * bits_per_sample_ / kNumberOfBitsPerByte;
   block_align_ = (num_channels_ * bits_per_sample_) / kNumberOfBitsPerByte;
@@ -49,7 +264,10 @@ WaveFile::~WaveFile() = default;
 //--------------------------------------------------------------
 // 2. GENERAL USER INTERFACE
 //--------------------------------------------------------------
-// None
+void WaveFile::ForceRf64() {
+  force_rf64_ = true;
+  set_data_size(data_size_);
+}
 
 //--------------------------------------------------------------
 // 3. ACCESSORS
@@ -67,6 +285,19 @@ uint16_t WaveFile::block_align() { return block_align_; }
 uint16_t WaveFile::bits_per_sample() { return bits_per_sample_; }
 uint32_t WaveFile::subchunk_2_id() { return subchunk_2_id_; }
 uint32_t WaveFile::subchunk_2_size() { return subchunk_2_size_; }
+uint64_t WaveFile::data_size() { return data_size_; }
+bool WaveFile::is_rf64() { return rf64_; }
+
+SampleFormat WaveFile::sample_format() const {
+  if (audio_format_ == kIeeeFloatAudioFormat) return SampleFormat::kFloat32;
+  if (bits_per_sample_ == kNumberOfBitsPerSample24) return SampleFormat::kPcm24;
+  return SampleFormat::kPcm16;
+}
+
+std::size_t WaveFile::header_size() const {
+  return (rf64_ || reserve_ds64_) ? kWaveFileExtendedHeaderSize
+                                  : kWaveFileCanonicalHeaderSize;
+}
 
 //--------------------------------------------------------------
 // 4. MUTATORS
@@ -85,6 +316,240 @@ void WaveFile::set_bits_per_sample(uint16_t value) { bits_per_sample_ = value; }
 void WaveFile::set_subchunk_2_id(uint32_t value) { subchunk_2_id_ = value; }
 void WaveFile::set_subchunk_2_size(uint32_t value) { subchunk_2_size_ = value; }
 
+void WaveFile::set_data_size(uint64_t value) {
+  data_size_ = value;
+
+  // Step 1: Promote to RF64 if the size of the RIFF chunk (assuming the
+  //         larger of the two headers) doesn't fit in 32 bits
+  rf64_ = force_rf64_ ||
+          (kWaveFileExtendedHeaderSize - kWaveFileCanonicalHeaderSize +
+               kWaveFileHeaderSize + value >
+           UINT32_MAX);
+
+  // Step 2: Update the 32-bit sizes. In RF64 files the actual sizes are
+  //         stored in the "ds64" chunk.
+  if (rf64_) {
+    chunk_id_ = kRf64ChunkId;
+    chunk_size_ = kRf64SizePlaceholder;
+    subchunk_2_size_ = kRf64SizePlaceholder;
+  } else {
+    chunk_id_ = kRiffChunkId;
+    subchunk_2_size_ = static_cast<uint32_t>(value);
+    chunk_size_ = static_cast<uint32_t>(
+        header_size() - kWaveFileCanonicalHeaderSize + kWaveFileHeaderSize +
+        value);
+  }
+}
+
+void WaveFile::set_reserve_ds64(bool value) {
+  reserve_ds64_ = value;
+  set_data_size(data_size_);
+}
+
+void WaveFile::set_sample_layout(uint16_t number_of_channels,
+                                 SampleFormat sample_format) {
+  assert(number_of_channels > 0);
+
+  switch (sample_format) {
+    case SampleFormat::kPcm16:
+      audio_format_ = kPcmAudioFormat;
+      bits_per_sample_ = kNumberOfBitsPerSample;
+      break;
+    case SampleFormat::kPcm24:
+      audio_format_ = kPcmAudioFormat;
+      bits_per_sample_ = kNumberOfBitsPerSample24;
+      break;
+    case SampleFormat::kFloat32:
+      audio_format_ = kIeeeFloatAudioFormat;
+      bits_per_sample_ = kNumberOfBitsPerSample32;
+      break;
+  }
+
+  num_channels_ = number_of_channels;
+  byte_rate_ =
+      sample_rate_ * num_channels_ * bits_per_sample_ / kNumberOfBitsPerByte;
+  block_align_ = (num_channels_ * bits_per_sample_) / kNumberOfBitsPerByte;
+}
+
+//--------------------------------------------------------------
+// HELPERS FOR DERIVED CLASSES
+//--------------------------------------------------------------
+//--------------------------------------------------------------
+//  NAME:
+//      WaveFile::SerialiseHeader
+//
+//  DESCRIPTION:
+//      Packs the WAVE header (see wave_file.h) into a buffer, ready
+//      to be written to a file in one go. The header is header_size()
+//      bytes long: the canonical header, optionally followed by either
+//      the "ds64" chunk (RF64 files) or a "JUNK" chunk reserving space
+//      for it.
+//  INPUT:
+//      header - buffer of at least kWaveFileExtendedHeaderSize bytes
+//  OUTPUT:
+//      None
+//--------------------------------------------------------------
+void WaveFile::SerialiseHeader(uint8_t* header) const {
+  uint8_t* field = header;
+
+  field = PutField(field, chunk_id_);
+  field = PutField(field, chunk_size_);
+  field = PutField(field, format_);
+
+  if (header_size() == kWaveFileExtendedHeaderSize) {
+    if (rf64_) {
+      uint64_t riff_size = kWaveFileExtendedHeaderSize -
+                           kWaveFileCanonicalHeaderSize +
+                           kWaveFileHeaderSize + data_size_;
+      uint64_t sample_count = data_size_ / block_align_;
+
+      field = PutField(field, kDs64ChunkId);
+      field = PutField(field, kDs64ChunkSize);
+      field = PutField(field, riff_size);
+      field = PutField(field, data_size_);
+      field = PutField(field, sample_count);
+      field = PutField(field, static_cast<uint32_t>(0));
+    } else {
+      field = PutField(field, kJunkChunkId);
+      field = PutField(field, kDs64ChunkSize);
+      memset(field, 0, kDs64ChunkSize);
+      field += kDs64ChunkSize;
+    }
+  }
+
+  field = PutField(field, subchunk_1_id_);
+  field = PutField(field, subchunk_1_size_);
+  field = PutField(field, audio_format_);
+  field = PutField(field, num_channels_);
+  field = PutField(field, sample_rate_);
+  field = PutField(field, byte_rate_);
+  field = PutField(field, block_align_);
+  field = PutField(field, bits_per_sample_);
+  field = PutField(field, subchunk_2_id_);
+  field = PutField(field, subchunk_2_size_);
+
+  assert(field == header + header_size());
+}
+
+//--------------------------------------------------------------
+//  NAME:
+//      WaveFile::ParseChunks
+//
+//  DESCRIPTION:
+//      The counterpart of SerialiseHeader(): reads the header of a
+//      WAVE file. Rather than assuming the layout written by this
+//      class, the RIFF chunks are walked one by one with positioned
+//      reads, up to the "data" chunk. Chunks other than "ds64",
+//      "fmt " and "data" are skipped without being read. The size of
+//      the data is trimmed to the whole frames present in the file.
+//  INPUT:
+//      file_descriptor - the file to read
+//      data_offset     - the position of the first sample (output)
+//  OUTPUT:
+//      True on success. False if the file is not a WAVE file or its
+//      samples are in a format other than those in SampleFormat.
+//--------------------------------------------------------------
+bool WaveFile::ParseChunks(int file_descriptor, uint64_t& data_offset) {
+  uint8_t buffer[kWaveFileExtendedHeaderSize];
+  const uint8_t* field;
+  uint32_t id;
+  uint32_t size;
+  uint64_t ds64_data_size = 0;
+  bool has_format = false;
+  struct stat file_status;
+
+  if (fstat(file_descriptor, &file_status) != 0) return false;
+  const uint64_t file_size = static_cast<uint64_t>(file_status.st_size);
+
+  // Step 1: The "RIFF" (or "RF64") chunk descriptor
+  if (!ReadFromFile(file_descriptor, buffer, 3 * kSizeFourBytes, 0)) {
+    return false;
+  }
+  field = GetField(buffer, chunk_id_);
+  field = GetField(field, chunk_size_);
+  GetField(field, format_);
+  if (((chunk_id_ != kRiffChunkId) && (chunk_id_ != kRf64ChunkId)) ||
+      (format_ != kRiffFormat)) {
+    return false;
+  }
+
+  rf64_ = (chunk_id_ == kRf64ChunkId);
+  reserve_ds64_ = false;
+
+  // Step 2: The sub-chunks, up to "data". Every sub-chunk starts with its
+  //         ID and size, and is padded to an even number of bytes.
+  uint64_t offset = 3 * kSizeFourBytes;
+  while (ReadFromFile(file_descriptor, buffer, 2 * kSizeFourBytes, offset)) {
+    GetField(GetField(buffer, id), size);
+    offset += 2 * kSizeFourBytes;
+
+    if (id == kDs64ChunkId) {
+      // Only the data size is needed - the RIFF size and the sample count
+      // are derived from it
+      if ((size < kDs64ChunkSize) ||
+          !ReadFromFile(file_descriptor, buffer, 2 * sizeof(uint64_t),
+                        offset)) {
+        return false;
+      }
+      GetField(buffer + sizeof(uint64_t), ds64_data_size);
+      reserve_ds64_ = true;
+    } else if ((id == kJunkChunkId) && (size == kDs64ChunkSize) &&
+               (offset == 5 * kSizeFourBytes)) {
+      // The space for "ds64" reserved by WaveFileStreamOut
+      reserve_ds64_ = true;
+    } else if (id == kFmtSubchunkId) {
+      // The sub-format of WAVE_FORMAT_EXTENSIBLE is read too
+      uint32_t format_size =
+          min<uint32_t>(size, kExtensibleSubFormatOffset + kSizeTwoBytes);
+      if ((size < kPcmSubchunk1Size) ||
+          !ReadFromFile(file_descriptor, buffer, format_size, offset)) {
+        return false;
+      }
+
+      subchunk_1_id_ = id;
+      subchunk_1_size_ = size;
+      field = GetField(buffer, audio_format_);
+      field = GetField(field, num_channels_);
+      field = GetField(field, sample_rate_);
+      field = GetField(field, byte_rate_);
+      field = GetField(field, block_align_);
+      GetField(field, bits_per_sample_);
+      if ((audio_format_ == kExtensibleAudioFormat) &&
+          (format_size == kExtensibleSubFormatOffset + kSizeTwoBytes)) {
+        GetField(buffer + kExtensibleSubFormatOffset, audio_format_);
+      }
+
+      bool supported =
+          ((audio_format_ == kPcmAudioFormat) &&
+           ((bits_per_sample_ == kNumberOfBitsPerSample) ||
+            (bits_per_sample_ == kNumberOfBitsPerSample24))) ||
+          ((audio_format_ == kIeeeFloatAudioFormat) &&
+           (bits_per_sample_ == kNumberOfBitsPerSample32));
+      if (!supported || (num_channels_ == 0) ||
+          (block_align_ !=
+           num_channels_ * bits_per_sample_ / kNumberOfBitsPerByte)) {
+        return false;
+      }
+      has_format = true;
+    } else if (id == kDataSubchunkId) {
+      if (!has_format) return false;
+
+      subchunk_2_id_ = id;
+      subchunk_2_size_ = size;
+      data_size_ = (rf64_ && (size == kRf64SizePlaceholder)) ? ds64_data_size
+                                                              : size;
+      data_size_ = min(data_size_, file_size - min(file_size, offset));
+      data_size_ -= data_size_ % block_align_;
+      data_offset = offset;
+      return true;
+    }
+
+    offset += size + (size & 1);
+  }
+
+  return false;
+}
+
 //=============================================================
 // CLASS: WaveFileOut
 //=============================================================
@@ -96,81 +561,423 @@ WaveFileOut::~WaveFileOut() = default;
 //--------------------------------------------------------------
 // 2. GENERAL USER INTERFACE
 //--------------------------------------------------------------
-WaveFileOut::WaveFileOut(uint32_t number_of_seconds) {
-  uint32_t temp_size;
+WaveFileOut::WaveFileOut(uint32_t number_of_seconds,
+                         uint16_t number_of_channels,
+                         SampleFormat sample_format, uint32_t sample_rate) {
+  uint64_t temp_size;
+
+  // The byte rate is derived from the sample rate in set_sample_layout()
+  WaveFile::set_sample_rate(sample_rate);
+  WaveFile::set_sample_layout(number_of_channels, sample_format);
 
   temp_size = WaveFile::sample_rate() * WaveFile::num_channels() *
               WaveFile::bits_per_sample() / kNumberOfBitsPerByte;
 
-  WaveFile::set_subchunk_2_size(temp_size * number_of_seconds);
+  // Long enough files are promoted to RF64 here
+  WaveFile::set_data_size(temp_size * number_of_seconds);
 }
 
-void WaveFileOut::SaveBufferToFile(const std::string& file_name,
+bool WaveFileOut::SaveBufferToFile(const std::string& file_name,
                                    std::vector<int16_t>& samples) {
-  uint32_t temp32;
-  uint16_t temp16;
+  uint8_t header[kWaveFileExtendedHeaderSize];
+
+  assert(sample_format() == SampleFormat::kPcm16);
+
+  // Make sure that there's enough input samples.
+  if (samples.size() * sizeof(int16_t) < data_size()) {
+    throw BufferToSmallException();
+  }
 
-  try {
-    // Make sure that there's enough input samples.
-    if (samples.size() * sizeof(int16_t) < subchunk_2_size()) {
+  // Create and open the output file
+  int output_file = open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (output_file < 0) {
+    std::cout << "Exception opening/reading/closing file\n";
+    return false;
+  }
+
+  // Write the header followed by the samples with one system call, so that
+  // a correct Wave file is constructed
+  SerialiseHeader(header);
+
+  struct iovec iov[2];
+  iov[0].iov_base = header;
+  iov[0].iov_len = header_size();
+  iov[1].iov_base = samples.data();
+  iov[1].iov_len = WaveFile::data_size();
+
+  bool success = WriteVectorToFile(output_file, iov, 2);
+
+  // Tidy up and return
+  success = (close(output_file) == 0) && success;
+  if (!success) std::cout << "Exception opening/reading/closing file\n";
+
+  return success;
+}
+
+bool WaveFileOut::SaveBufferToFile(
+    const std::string& file_name,
+    const std::vector<std::vector<int16_t>>& channels) {
+  uint8_t header[kWaveFileExtendedHeaderSize];
+  const size_t number_of_channels = WaveFile::num_channels();
+  const uint64_t number_of_frames =
+      WaveFile::data_size() / WaveFile::block_align();
+  vector<const int16_t*> inputs(number_of_channels);
+
+  assert(sample_format() == SampleFormat::kPcm16);
+
+  // Make sure that there's enough input samples in every channel
+  if (channels.size() < number_of_channels) throw BufferToSmallException();
+  for (size_t channel = 0; channel < number_of_channels; channel++) {
+    if (channels[channel].size() < number_of_frames) {
       throw BufferToSmallException();
     }
+    inputs[channel] = channels[channel].data();
+  }
+
+  int output_file = open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (output_file < 0) {
+    std::cout << "Exception opening/reading/closing file\n";
+    return false;
+  }
+
+  // Interleave one buffer-full of frames at a time. The header goes out
+  // with the first one.
+  const size_t frames_per_buffer =
+      kWaveFileWriteBufferSize / number_of_channels;
+  vector<int16_t> buffer(frames_per_buffer * number_of_channels);
+  uint64_t frame = 0;
+  bool success = true;
+
+  SerialiseHeader(header);
+
+  struct iovec iov[2];
+  int iov_count = 0;
+  iov[iov_count].iov_base = header;
+  iov[iov_count++].iov_len = header_size();
+
+  do {
+    size_t length = static_cast<size_t>(
+        min<uint64_t>(frames_per_buffer, number_of_frames - frame));
+
+    InterleaveChannels(inputs.data(), number_of_channels, length,
+                       buffer.data());
+    for (size_t channel = 0; channel < number_of_channels; channel++) {
+      inputs[channel] += length;
+    }
+
+    iov[iov_count].iov_base = buffer.data();
+    iov[iov_count++].iov_len = length * number_of_channels * sizeof(int16_t);
+    success = WriteVectorToFile(output_file, iov, iov_count);
+
+    iov_count = 0;
+    frame += length;
+  } while (success && (frame < number_of_frames));
+
+  // Tidy up and return
+  success = (close(output_file) == 0) && success;
+  if (!success) std::cout << "Exception opening/reading/closing file\n";
+
+  return success;
+}
+
+bool WaveFileOut::SaveBufferToFile(const std::string& file_name,
+                                   const std::vector<float>& samples) {
+  uint8_t header[kWaveFileExtendedHeaderSize];
+  const size_t bytes_per_sample = BytesPerSample(sample_format());
+  const uint64_t number_of_samples = data_size() / bytes_per_sample;
+
+  // Make sure that there's enough input samples.
+  if (samples.size() < number_of_samples) throw BufferToSmallException();
+
+  int output_file = open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (output_file < 0) {
+    std::cout << "Exception opening/reading/closing file\n";
+    return false;
+  }
+
+  SerialiseHeader(header);
+
+  struct iovec iov[2];
+  int iov_count = 0;
+  iov[iov_count].iov_base = header;
+  iov[iov_count++].iov_len = header_size();
+  bool success = true;
+
+  if (sample_format() == SampleFormat::kFloat32) {
+    // Nothing to convert - write the header and the samples in one go
+    iov[iov_count].iov_base = const_cast<float*>(samples.data());
+    iov[iov_count++].iov_len = data_size();
+    success = WriteVectorToFile(output_file, iov, iov_count);
+  } else {
+    // Convert one buffer-full at a time. The header goes out with the
+    // first one.
+    vector<uint8_t> buffer(kWaveFileWriteBufferSize * bytes_per_sample);
+    uint64_t sample = 0;
+
+    do {
+      size_t length = static_cast<size_t>(
+          min<uint64_t>(kWaveFileWriteBufferSize, number_of_samples - sample));
+
+      ConvertFromFloat(sample_format(), samples.data() + sample, length,
+                       buffer.data());
+
+      iov[iov_count].iov_base = buffer.data();
+      iov[iov_count++].iov_len = length * bytes_per_sample;
+      success = WriteVectorToFile(output_file, iov, iov_count);
+
+      iov_count = 0;
+      sample += length;
+    } while (success && (sample < number_of_samples));
+  }
+
+  // Tidy up and return
+  success = (close(output_file) == 0) && success;
+  if (!success) std::cout << "Exception opening/reading/closing file\n";
+
+  return success;
+}
+
+//=============================================================
+// CLASS: WaveFileStreamOut
+//=============================================================
+//--------------------------------------------------------------
+// 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+//--------------------------------------------------------------
+WaveFileStreamOut::WaveFileStreamOut(uint16_t number_of_channels,
+                                     SampleFormat sample_format,
+                                     uint32_t sample_rate)
+    : file_descriptor_(-1), bytes_written_(0) {
+  WaveFile::set_sample_rate(sample_rate);
+  WaveFile::set_sample_layout(number_of_channels, sample_format);
+
+  // Allocated up-front, so that appending never allocates
+  if (sample_format != SampleFormat::kFloat32) {
+    conversion_buffer_.resize(kWaveFileWriteBufferSize *
+                              BytesPerSample(sample_format));
+  }
+}
+
+WaveFileStreamOut::~WaveFileStreamOut() { Close(); }
+
+//--------------------------------------------------------------
+// 2. GENERAL USER INTERFACE
+//--------------------------------------------------------------
+bool WaveFileStreamOut::Open(const std::string& file_name) {
+  uint8_t header[kWaveFileExtendedHeaderSize];
+
+  Close();
+
+  file_descriptor_ = open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+                          0644);
+  if (file_descriptor_ < 0) {
+    std::cout << "Exception opening/reading/closing file\n";
+    return false;
+  }
+
+  // Placeholder header - the sizes are patched in Close(). The final size
+  // isn't known, so leave space for promoting the file to RF64.
+  bytes_written_ = 0;
+  WaveFile::set_reserve_ds64(true);
+  WaveFile::set_data_size(0);
+  SerialiseHeader(header);
+
+  struct iovec iov;
+  iov.iov_base = header;
+  iov.iov_len = header_size();
+  if (!WriteVectorToFile(file_descriptor_, &iov, 1)) {
+    std::cout << "Exception opening/reading/closing file\n";
+    close(file_descriptor_);
+    file_descriptor_ = -1;
+    return false;
+  }
+
+  return true;
+}
+
+bool WaveFileStreamOut::Append(const int16_t* samples,
+                               std::size_t number_of_samples) {
+  uint64_t block_size = number_of_samples * sizeof(int16_t);
+
+  assert(IsOpen());
+  assert(sample_format() == SampleFormat::kPcm16);
+
+  struct iovec iov;
+  iov.iov_base = const_cast<int16_t*>(samples);
+  iov.iov_len = block_size;
+  if (!WriteVectorToFile(file_descriptor_, &iov, 1)) {
+    std::cout << "Exception opening/reading/closing file\n";
+    return false;
+  }
+
+  bytes_written_ += block_size;
+  return true;
+}
+
+bool WaveFileStreamOut::Append(const std::vector<int16_t>& samples) {
+  return Append(samples.data(), samples.size());
+}
+
+bool WaveFileStreamOut::Append(const float* samples,
+                               std::size_t number_of_samples) {
+  const size_t bytes_per_sample = BytesPerSample(sample_format());
+  struct iovec iov;
+
+  assert(IsOpen());
+
+  if (sample_format() == SampleFormat::kFloat32) {
+    iov.iov_base = const_cast<float*>(samples);
+    iov.iov_len = number_of_samples * sizeof(float);
+    if (!WriteVectorToFile(file_descriptor_, &iov, 1)) {
+      std::cout << "Exception opening/reading/closing file\n";
+      return false;
+    }
 
-    // Create and open the output file
-    std::ofstream output_file;
-    output_file.exceptions(ifstream::failbit | ifstream::badbit);
-    output_file.open(file_name, ifstream::binary);
+    bytes_written_ += iov.iov_len;
+    return true;
+  }
 
-    // Write in binary format to the file so that correct Wave file is
-    // constructed
-    temp32 = WaveFile::chunk_id();
-    output_file.write(reinterpret_cast<const char*>(&temp32), kSizeFourBytes);
+  // Convert to PCM one buffer-full at a time
+  while (number_of_samples > 0) {
+    size_t length = min(number_of_samples, kWaveFileWriteBufferSize);
 
-    temp32 = WaveFile::chunk_size();
-    output_file.write(reinterpret_cast<const char*>(&temp32), kSizeFourBytes);
+    ConvertFromFloat(sample_format(), samples, length,
+                     conversion_buffer_.data());
 
-    temp32 = WaveFile::format();
-    output_file.write(reinterpret_cast<const char*>(&temp32), kSizeFourBytes);
+    iov.iov_base = conversion_buffer_.data();
+    iov.iov_len = length * bytes_per_sample;
+    if (!WriteVectorToFile(file_descriptor_, &iov, 1)) {
+      std::cout << "Exception opening/reading/closing file\n";
+      return false;
+    }
 
-    temp32 = WaveFile::subchunk_1_id();
-    output_file.write(reinterpret_cast<const char*>(&temp32), kSizeFourBytes);
+    bytes_written_ += length * bytes_per_sample;
+    samples += length;
+    number_of_samples -= length;
+  }
 
-    temp32 = WaveFile::subchunk_1_size();
-    output_file.write(reinterpret_cast<const char*>(&temp32), kSizeFourBytes);
+  return true;
+}
 
-    temp16 = WaveFile::audio_format();
-    output_file.write(reinterpret_cast<const char*>(&temp16), kSizeTwoBytes);
+bool WaveFileStreamOut::Append(const std::vector<float>& samples) {
+  return Append(samples.data(), samples.size());
+}
 
-    temp16 = WaveFile::num_channels();
-    output_file.write(reinterpret_cast<const char*>(&temp16), kSizeTwoBytes);
+bool WaveFileStreamOut::Close() {
+  uint8_t header[kWaveFileExtendedHeaderSize];
+  bool success = true;
 
-    temp32 = WaveFile::sample_rate();
-    output_file.write(reinterpret_cast<const char*>(&temp32), kSizeFourBytes);
+  if (!IsOpen()) return true;
 
-    temp32 = WaveFile::byte_rate();
-    output_file.write(reinterpret_cast<const char*>(&temp32), kSizeFourBytes);
+  // Patch the header now that the size of the data is known
+  WaveFile::set_data_size(bytes_written_);
+  SerialiseHeader(header);
 
-    temp16 = WaveFile::block_align();
-    output_file.write(reinterpret_cast<const char*>(&temp16), kSizeTwoBytes);
+  ssize_t header_length = static_cast<ssize_t>(header_size());
+  success = (pwrite(file_descriptor_, header, header_size(), 0) ==
+             header_length);
+  success = (close(file_descriptor_) == 0) && success;
+  file_descriptor_ = -1;
 
-    temp16 = WaveFile::bits_per_sample();
-    output_file.write(reinterpret_cast<const char*>(&temp16), kSizeTwoBytes);
+  if (!success) std::cout << "Exception opening/reading/closing file\n";
+  return success;
+}
 
-    temp32 = WaveFile::subchunk_2_id();
-    output_file.write(reinterpret_cast<const char*>(&temp32), kSizeFourBytes);
+//--------------------------------------------------------------
+// 3. ACCESSORS
+//--------------------------------------------------------------
+uint64_t WaveFileStreamOut::number_of_samples_written() const {
+  return bytes_written_ / BytesPerSample(sample_format());
+}
 
-    temp32 = WaveFile::subchunk_2_size();
-    output_file.write(reinterpret_cast<const char*>(&temp32), kSizeFourBytes);
+bool WaveFileOut::SaveBufferToFlacFile(const std::string& file_name,
+                                       std::vector<int16_t>& samples,
+                                       std::size_t number_of_threads) {
+  assert(sample_format() == SampleFormat::kPcm16);
 
-    output_file.write(reinterpret_cast<const char*>(&samples[0]),
-                      WaveFile::subchunk_2_size());
+  // Make sure that there's enough input samples.
+  if (samples.size() * sizeof(int16_t) < data_size()) {
+    throw BufferToSmallException();
+  }
 
-    // Tidy up and return
-    output_file.close();
-    return;
-  } catch (std::ifstream::failure e) {
+  // Compress the whole file first, so that it's written in one go
+  FlacEncoder encoder(WaveFile::sample_rate(), WaveFile::num_channels(),
+                      number_of_threads);
+  vector<uint8_t> stream = encoder.Encode(
+      samples.data(),
+      static_cast<std::size_t>(WaveFile::data_size() / sizeof(int16_t)));
+
+  int output_file = open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (output_file < 0) {
+    std::cout << "Exception opening/reading/closing file\n";
+    return false;
+  }
+
+  struct iovec iov;
+  iov.iov_base = stream.data();
+  iov.iov_len = stream.size();
+
+  bool success = WriteVectorToFile(output_file, &iov, 1);
+
+  // Tidy up and return
+  success = (close(output_file) == 0) && success;
+  if (!success) std::cout << "Exception opening/reading/closing file\n";
+
+  return success;
+}
+
+WaveFileOutMapping WaveFileOut::MapBufferToFile(const std::string& file_name) {
+  WaveFileOutMapping mapping;
+  const size_t file_size = header_size() + WaveFile::data_size();
+
+  assert(sample_format() == SampleFormat::kPcm16);
+
+  int output_file = open(file_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (output_file < 0) {
     std::cout << "Exception opening/reading/closing file\n";
+    return mapping;
   }
+
+  // Allocate the blocks now rather than on first touch. File systems
+  // without fallocate() get a sparse file instead.
+  bool success = (fallocate(output_file, 0, 0, file_size) == 0);
+  if (!success && (errno == EOPNOTSUPP)) {
+    success = (ftruncate(output_file, file_size) == 0);
+  }
+
+  if (success) {
+    mapping.mapping_size_ = file_size;
+    mapping.mapping_ = mmap(nullptr, mapping.mapping_size_,
+                            PROT_READ | PROT_WRITE, MAP_SHARED, output_file, 0);
+    success = (mapping.mapping_ != MAP_FAILED);
+  }
+
+  // The mapping keeps the file alive, the descriptor is no longer needed
+  success = (close(output_file) == 0) && success;
+
+  if (!success) {
+    std::cout << "Exception opening/reading/closing file\n";
+    if (mapping.mapping_ == MAP_FAILED) mapping.mapping_ = nullptr;
+    mapping.Release();
+    return mapping;
+  }
+
+  // The samples are rendered sequentially in the typical use case
+  madvise(mapping.mapping_, mapping.mapping_size_, MADV_SEQUENTIAL);
+
+  uint8_t* file_data = static_cast<uint8_t*>(mapping.mapping_);
+  SerialiseHeader(file_data);
+  mapping.samples_ = reinterpret_cast<int16_t*>(file_data + header_size());
+  mapping.number_of_samples_ =
+      static_cast<size_t>(WaveFile::data_size() / sizeof(int16_t));
+
+  return mapping;
+}
+
+//--------------------------------------------------------------
+// 4. MUTATORS
+//--------------------------------------------------------------
+void WaveFileOut::set_number_of_frames(uint64_t number_of_frames) {
+  WaveFile::set_data_size(number_of_frames * WaveFile::block_align());
 }
 
 //=============================================================
@@ -179,87 +986,447 @@ void WaveFileOut::SaveBufferToFile(const std::string& file_name,
 //--------------------------------------------------------------
 // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
 //--------------------------------------------------------------
-WaveFileIn::~WaveFileIn() = default;
+WaveFileIn::WaveFileIn() : file_descriptor_(-1), data_offset_(0) {}
+
+WaveFileIn::~WaveFileIn() { Close(); }
 
 //--------------------------------------------------------------
 // 2. GENERAL USER INTERFACE
 //--------------------------------------------------------------
 std::vector<int16_t> WaveFileIn::ReadBufferFromFile(
     const std::string& file_name) {
-  uint32_t temp32;
-  uint16_t temp16;
-  int16_t signed_temp16;
-  std::size_t number_of_samples;
   vector<int16_t> samples;
 
-  try {
-    // Create and open the input file
-    std::ifstream input_file;
-    input_file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    input_file.open(file_name, std::ifstream::binary);
+  if (ReadFlacFile(file_name, samples)) return samples;
 
-    // Read from the binary file assume it's in the cannoncial Wave
-    // format
-    input_file.read(reinterpret_cast<char*>(&temp32), kSizeFourBytes);
-    WaveFile::set_chunk_id(temp32);
+  if (!Open(file_name)) return samples;
 
-    input_file.read(reinterpret_cast<char*>(&temp32), kSizeFourBytes);
-    WaveFile::set_chunk_size(temp32);
+  // Read all the samples straight into the "samples" vector
+  samples.resize(static_cast<std::size_t>(number_of_frames()) *
+                 WaveFile::num_channels());
+  std::size_t frames_read =
+      ReadFrames(0, static_cast<std::size_t>(number_of_frames()),
+                 samples.data());
+  samples.resize(frames_read * WaveFile::num_channels());
 
-    input_file.read(reinterpret_cast<char*>(&temp32), kSizeFourBytes);
-    WaveFile::set_format(temp32);
+  // Tidy up
+  Close();
 
-    input_file.read(reinterpret_cast<char*>(&temp32), kSizeFourBytes);
-    WaveFile::set_subchunk_1_id(temp32);
+  return samples;
+}
 
-    input_file.read(reinterpret_cast<char*>(&temp32), kSizeFourBytes);
-    WaveFile::set_subchunk_1_size(temp32);
+std::vector<float> WaveFileIn::ReadFloatBufferFromFile(
+    const std::string& file_name) {
+  vector<float> samples;
 
-    input_file.read(reinterpret_cast<char*>(&temp16), kSizeTwoBytes);
-    WaveFile::set_audio_format(temp16);
+  vector<int16_t> decoded;
+  if (ReadFlacFile(file_name, decoded)) {
+    samples.resize(decoded.size());
+    ConvertPcm16ToFloat(decoded.data(), decoded.size(), samples.data());
+    return samples;
+  }
 
-    input_file.read(reinterpret_cast<char*>(&temp16), kSizeTwoBytes);
-    WaveFile::set_num_channels(temp16);
+  if (!Open(file_name)) return samples;
 
-    input_file.read(reinterpret_cast<char*>(&temp32), kSizeFourBytes);
-    WaveFile::set_sample_rate(temp32);
+  samples.resize(static_cast<std::size_t>(number_of_frames()) *
+                 WaveFile::num_channels());
+  std::size_t frames_read =
+      ReadFrames(0, static_cast<std::size_t>(number_of_frames()),
+                 samples.data());
+  samples.resize(frames_read * WaveFile::num_channels());
 
-    input_file.read(reinterpret_cast<char*>(&temp32), kSizeFourBytes);
-    WaveFile::set_byte_rate(temp32);
+  Close();
 
-    input_file.read(reinterpret_cast<char*>(&temp16), kSizeTwoBytes);
-    WaveFile::set_block_align(temp16);
+  return samples;
+}
 
-    input_file.read(reinterpret_cast<char*>(&temp16), kSizeTwoBytes);
-    WaveFile::set_bits_per_sample(temp16);
+WaveFileMapping WaveFileIn::MapBufferFromFile(const std::string& file_name) {
+  WaveFileMapping mapping;
+  struct stat file_status;
 
-    input_file.read(reinterpret_cast<char*>(&temp32), kSizeFourBytes);
-    WaveFile::set_subchunk_2_id(temp32);
+  // Parse the header, then map the whole file
+  if (!Open(file_name)) return mapping;
 
-    input_file.read(reinterpret_cast<char*>(&temp32), kSizeFourBytes);
-    WaveFile::set_subchunk_2_size(temp32);
+  // The view is of 16-bit samples
+  if ((sample_format() != SampleFormat::kPcm16) ||
+      (fstat(file_descriptor_, &file_status) != 0)) {
+    std::cout << "Exception opening/reading/closing file\n";
+    Close();
+    return mapping;
+  }
 
-    // There's now enough data to calculate the number of samples
-    number_of_samples = WaveFile::subchunk_2_size() * kNumberOfBitsPerByte /
-                        WaveFile::num_channels() / WaveFile::bits_per_sample();
-    samples.resize(number_of_samples);
+  mapping.mapping_size_ = static_cast<std::size_t>(file_status.st_size);
+  mapping.mapping_ = mmap(nullptr, mapping.mapping_size_, PROT_READ,
+                          MAP_PRIVATE, file_descriptor_, 0);
+  // The mapping keeps the file alive, the descriptor is no longer needed
+  Close();
 
-    // Read the samples into the "samples" vector
-    for (size_t idx = 0; idx < number_of_samples; idx++) {
-      input_file.read(reinterpret_cast<char*>(&signed_temp16),
-                      sizeof(signed_temp16));
-      samples[idx] = signed_temp16;
-    }
+  if (mapping.mapping_ == MAP_FAILED) {
+    std::cout << "Exception opening/reading/closing file\n";
+    mapping.mapping_ = nullptr;
+    mapping.mapping_size_ = 0;
+    return mapping;
+  }
+
+  // The samples are read sequentially in the typical use case
+  madvise(mapping.mapping_, mapping.mapping_size_, MADV_SEQUENTIAL);
 
-    // Tidy up
-    input_file.close();
-  } catch (std::ifstream::failure e) {
+  const uint8_t* file_data = static_cast<const uint8_t*>(mapping.mapping_);
+  mapping.samples_ =
+      reinterpret_cast<const int16_t*>(file_data + data_offset_);
+  mapping.number_of_samples_ =
+      static_cast<std::size_t>(number_of_frames()) * WaveFile::num_channels();
+
+  return mapping;
+}
+
+bool WaveFileIn::Open(const std::string& file_name) {
+  Close();
+
+  file_descriptor_ = open(file_name.c_str(), O_RDONLY);
+  if (file_descriptor_ < 0) {
     std::cout << "Exception opening/reading/closing file\n";
+    return false;
   }
 
+  if (!ParseChunks(file_descriptor_, data_offset_)) {
+    std::cout << "Exception opening/reading/closing file\n";
+    Close();
+    return false;
+  }
+
+  return true;
+}
+
+std::size_t WaveFileIn::ReadFrames(uint64_t first_frame, std::size_t count,
+                                   int16_t* samples) {
+  assert(IsOpen());
+
+  // Only the frames that are in the file
+  if (first_frame >= number_of_frames()) return 0;
+  count = static_cast<std::size_t>(
+      min<uint64_t>(count, number_of_frames() - first_frame));
+
+  const std::size_t number_of_samples = count * WaveFile::num_channels();
+  const uint64_t first_sample = first_frame * WaveFile::num_channels();
+
+  if (sample_format() == SampleFormat::kPcm16) {
+    if (!ReadFromFile(file_descriptor_, samples,
+                      number_of_samples * sizeof(int16_t),
+                      data_offset_ + first_sample * sizeof(int16_t))) {
+      std::cout << "Exception opening/reading/closing file\n";
+      return 0;
+    }
+    return count;
+  }
+
+  // Go through float, one buffer-full at a time
+  vector<float> buffer(min(number_of_samples, kWaveFileWriteBufferSize));
+  for (size_t idx = 0; idx < number_of_samples;
+       idx += kWaveFileWriteBufferSize) {
+    size_t length = min(kWaveFileWriteBufferSize, number_of_samples - idx);
+    if (!ReadSamples(first_sample + idx, length, buffer.data())) return 0;
+    ConvertFloatToPcm16(buffer.data(), length, samples + idx);
+  }
+
+  return count;
+}
+
+std::size_t WaveFileIn::ReadFrames(uint64_t first_frame, std::size_t count,
+                                   float* samples) {
+  assert(IsOpen());
+
+  if (first_frame >= number_of_frames()) return 0;
+  count = static_cast<std::size_t>(
+      min<uint64_t>(count, number_of_frames() - first_frame));
+
+  if (!ReadSamples(first_frame * WaveFile::num_channels(),
+                   count * WaveFile::num_channels(), samples)) {
+    return 0;
+  }
+
+  return count;
+}
+
+std::vector<int16_t> WaveFileIn::ReadFrames(uint64_t first_frame,
+                                            std::size_t count) {
+  vector<int16_t> samples;
+
+  if (first_frame >= number_of_frames()) return samples;
+  count = static_cast<std::size_t>(
+      min<uint64_t>(count, number_of_frames() - first_frame));
+
+  samples.resize(count * WaveFile::num_channels());
+  samples.resize(ReadFrames(first_frame, count, samples.data()) *
+                 WaveFile::num_channels());
+
   return samples;
 }
 
+bool WaveFileIn::Close() {
+  if (!IsOpen()) return true;
+
+  bool success = (close(file_descriptor_) == 0);
+  file_descriptor_ = -1;
+  if (!success) std::cout << "Exception opening/reading/closing file\n";
+
+  return success;
+}
+
+//--------------------------------------------------------------
+// 3. ACCESSORS
+//--------------------------------------------------------------
+uint64_t WaveFileIn::number_of_frames() {
+  return WaveFile::data_size() / WaveFile::block_align();
+}
+
+//--------------------------------------------------------------
+// 4. PRIVATE METHODS
+//--------------------------------------------------------------
+//--------------------------------------------------------------
+//  NAME:
+//      WaveFileIn::ReadFlacFile
+//
+//  DESCRIPTION:
+//      Checks whether the file is a FLAC file and if so, reads and
+//      decodes all of it. The header is then set up as if the file
+//      was a 16-bit PCM WAVE file with the decoded samples. Files
+//      that fail to decode give no samples.
+//  INPUT:
+//      file_name - the name of the file to read
+//      samples   - the decoded samples
+//  OUTPUT:
+//      True if the file is a FLAC file, false otherwise (including
+//      when it can't be opened).
+//--------------------------------------------------------------
+bool WaveFileIn::ReadFlacFile(const std::string& file_name,
+                              std::vector<int16_t>& samples) {
+  uint32_t marker;
+  struct stat file_status;
+  vector<uint8_t> stream;
+
+  int input_file = open(file_name.c_str(), O_RDONLY);
+  if (input_file < 0) return false;
+
+  bool is_flac = (fstat(input_file, &file_status) == 0) &&
+                 ReadFromFile(input_file, &marker, sizeof(marker), 0) &&
+                 (marker == kFlacStreamMarker);
+  if (is_flac) {
+    stream.resize(static_cast<std::size_t>(file_status.st_size));
+    if (!ReadFromFile(input_file, stream.data(), stream.size(), 0)) {
+      stream.clear();
+    }
+  }
+  close(input_file);
+
+  if (!is_flac) return false;
+
+  FlacDecoder decoder;
+  if (!decoder.Decode(stream.data(), stream.size(), samples)) {
+    std::cout << "Exception opening/reading/closing file\n";
+    samples.clear();
+    return true;
+  }
+
+  WaveFile::set_sample_rate(decoder.sample_rate());
+  WaveFile::set_sample_layout(decoder.number_of_channels(),
+                              SampleFormat::kPcm16);
+  WaveFile::set_data_size(samples.size() * sizeof(int16_t));
+
+  return true;
+}
+
+//--------------------------------------------------------------
+//  NAME:
+//      WaveFileIn::ReadSamples
+//
+//  DESCRIPTION:
+//      Reads samples from the open file and converts them to float.
+//      Float samples are read straight into the output, PCM samples
+//      go through a buffer of kWaveFileWriteBufferSize samples.
+//  INPUT:
+//      first_sample      - the index of the first sample to read
+//      number_of_samples - the number of samples to read
+//      samples           - the output
+//  OUTPUT:
+//      True on success, false otherwise
+//--------------------------------------------------------------
+bool WaveFileIn::ReadSamples(uint64_t first_sample,
+                             std::size_t number_of_samples, float* samples) {
+  const size_t bytes_per_sample = BytesPerSample(sample_format());
+  uint64_t offset = data_offset_ + first_sample * bytes_per_sample;
+
+  if (sample_format() == SampleFormat::kFloat32) {
+    if (!ReadFromFile(file_descriptor_, samples,
+                      number_of_samples * sizeof(float), offset)) {
+      std::cout << "Exception opening/reading/closing file\n";
+      return false;
+    }
+    return true;
+  }
+
+  vector<uint8_t> buffer(
+      min(number_of_samples, kWaveFileWriteBufferSize) * bytes_per_sample);
+  for (size_t idx = 0; idx < number_of_samples;
+       idx += kWaveFileWriteBufferSize) {
+    size_t length = min(kWaveFileWriteBufferSize, number_of_samples - idx);
+    if (!ReadFromFile(file_descriptor_, buffer.data(),
+                      length * bytes_per_sample, offset)) {
+      std::cout << "Exception opening/reading/closing file\n";
+      return false;
+    }
+    ConvertToFloat(sample_format(), buffer.data(), length, samples + idx);
+    offset += length * bytes_per_sample;
+  }
+
+  return true;
+}
+
+//=============================================================
+//  CLASS: WaveFileMapping
+//=============================================================
+//--------------------------------------------------------------
+// 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+//--------------------------------------------------------------
+WaveFileMapping::WaveFileMapping()
+    : mapping_(nullptr),
+      mapping_size_(0),
+      samples_(nullptr),
+      number_of_samples_(0) {}
+
+WaveFileMapping::~WaveFileMapping() { Release(); }
+
+WaveFileMapping::WaveFileMapping(WaveFileMapping&& rhs)
+    : mapping_(rhs.mapping_),
+      mapping_size_(rhs.mapping_size_),
+      samples_(rhs.samples_),
+      number_of_samples_(rhs.number_of_samples_) {
+  rhs.mapping_ = nullptr;
+  rhs.mapping_size_ = 0;
+  rhs.samples_ = nullptr;
+  rhs.number_of_samples_ = 0;
+}
+
+WaveFileMapping& WaveFileMapping::operator=(WaveFileMapping&& rhs) {
+  if (this != &rhs) {
+    Release();
+    swap(mapping_, rhs.mapping_);
+    swap(mapping_size_, rhs.mapping_size_);
+    swap(samples_, rhs.samples_);
+    swap(number_of_samples_, rhs.number_of_samples_);
+  }
+
+  return *this;
+}
+
+//--------------------------------------------------------------
+// 4. PRIVATE METHODS
+//--------------------------------------------------------------
+//--------------------------------------------------------------
+//  NAME:
+//      WaveFileMapping::Release
+//
+//  DESCRIPTION:
+//      Unmaps the file (if mapped) and leaves this view empty.
+//  INPUT:
+//      None
+//  OUTPUT:
+//      None
+//--------------------------------------------------------------
+void WaveFileMapping::Release() {
+  if (mapping_ != nullptr) munmap(mapping_, mapping_size_);
+
+  mapping_ = nullptr;
+  mapping_size_ = 0;
+  samples_ = nullptr;
+  number_of_samples_ = 0;
+}
+
+//=============================================================
+//  CLASS: WaveFileOutMapping
+//=============================================================
+//--------------------------------------------------------------
+// 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+//--------------------------------------------------------------
+WaveFileOutMapping::WaveFileOutMapping()
+    : mapping_(nullptr),
+      mapping_size_(0),
+      samples_(nullptr),
+      number_of_samples_(0) {}
+
+WaveFileOutMapping::~WaveFileOutMapping() { Release(); }
+
+WaveFileOutMapping::WaveFileOutMapping(WaveFileOutMapping&& rhs)
+    : mapping_(rhs.mapping_),
+      mapping_size_(rhs.mapping_size_),
+      samples_(rhs.samples_),
+      number_of_samples_(rhs.number_of_samples_) {
+  rhs.mapping_ = nullptr;
+  rhs.mapping_size_ = 0;
+  rhs.samples_ = nullptr;
+  rhs.number_of_samples_ = 0;
+}
+
+WaveFileOutMapping& WaveFileOutMapping::operator=(WaveFileOutMapping&& rhs) {
+  if (this != &rhs) {
+    Release();
+    swap(mapping_, rhs.mapping_);
+    swap(mapping_size_, rhs.mapping_size_);
+    swap(samples_, rhs.samples_);
+    swap(number_of_samples_, rhs.number_of_samples_);
+  }
+
+  return *this;
+}
+
+//--------------------------------------------------------------
+// 2. GENERAL USER INTERFACE
+//--------------------------------------------------------------
+void WaveFileOutMapping::Evict(size_t first_sample,
+                               size_t number_of_samples) {
+  const uintptr_t page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+
+  assert(first_sample + number_of_samples <= number_of_samples_);
+
+  // Only the pages that lie entirely within the range, so that samples
+  // next to it that are still being rendered are left alone
+  uintptr_t begin = reinterpret_cast<uintptr_t>(samples_ + first_sample);
+  uintptr_t end = begin + number_of_samples * sizeof(int16_t);
+  begin = (begin + page_size - 1) / page_size * page_size;
+  end = end / page_size * page_size;
+  if (begin >= end) return;
+
+  // Dirty pages aren't lost when they're dropped from the mapping - they
+  // stay in the page cache until written back
+  void* pages = reinterpret_cast<void*>(begin);
+  msync(pages, end - begin, MS_ASYNC);
+  madvise(pages, end - begin, MADV_DONTNEED);
+}
+
+//--------------------------------------------------------------
+// 4. PRIVATE METHODS
+//--------------------------------------------------------------
+//--------------------------------------------------------------
+//  NAME:
+//      WaveFileOutMapping::Release
+//
+//  DESCRIPTION:
+//      Unmaps the file (if mapped) and leaves this view empty. The
+//      samples rendered so far stay in the file.
+//  INPUT:
+//      None
+//  OUTPUT:
+//      None
+//--------------------------------------------------------------
+void WaveFileOutMapping::Release() {
+  if (mapping_ != nullptr) munmap(mapping_, mapping_size_);
+
+  mapping_ = nullptr;
+  mapping_size_ = 0;
+  samples_ = nullptr;
+  number_of_samples_ = 0;
+}
+
 //=============================================================
 //  CLASS: BufferToSmallException
 //=============================================================
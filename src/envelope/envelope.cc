@@ -13,8 +13,114 @@
 
 #include <envelope/envelope.h>
 
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 using namespace std;
 
+//========================================================================
+// UTILITIES
+//========================================================================
+//------------------------------------------------------------------------
+//  NAME:
+//      SaturateSample
+//
+//  DESCRIPTION:
+//      Truncates a scaled sample to 16 bits, clamping it to the range of
+//      int16_t - the scalar version of _mm_cvttps_epi32() followed by
+//      _mm_packs_epi32(), so that every sample of a buffer is treated the
+//      same regardless of its position.
+//------------------------------------------------------------------------
+static int16_t SaturateSample(float sample) {
+  return static_cast<int16_t>(min(max(sample, -32768.0f), 32767.0f));
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      ScaleSamples
+//
+//  DESCRIPTION:
+//      Multiplies every sample by the same gain. Unity gain leaves the
+//      samples untouched and zero gain simply clears them. Any other
+//      gain is broadcast and applied 8 samples at a time.
+//  INPUT:
+//      gain              - the gain to apply
+//      samples           - the samples to scale (in place)
+//      number_of_samples - the number of samples to scale
+//  OUTPUT:
+//      None
+//------------------------------------------------------------------------
+static void ScaleSamples(float gain, int16_t *samples,
+                         size_t number_of_samples) {
+  if (gain == 1.0f) return;
+
+  if (gain == 0.0f) {
+    memset(samples, 0, number_of_samples * sizeof(int16_t));
+    return;
+  }
+
+  size_t idx = 0;
+#if defined(__SSE2__)
+  const __m128 gain_x4 = _mm_set1_ps(gain);
+  for (; idx + 8 <= number_of_samples; idx += 8) {
+    __m128i in =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples + idx));
+    // Sign-extend to 2 x 4 int32, scale and truncate (like static_cast)
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16);
+    lo = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(lo), gain_x4));
+    hi = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(hi), gain_x4));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(samples + idx),
+                     _mm_packs_epi32(lo, hi));
+  }
+#endif
+  for (; idx < number_of_samples; idx++) {
+    samples[idx] = SaturateSample(gain * static_cast<float>(samples[idx]));
+  }
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      MultiplySamples
+//
+//  DESCRIPTION:
+//      Multiplies every sample by the corresponding entry in the gain
+//      table, 8 samples at a time.
+//  INPUT:
+//      gain              - the gain table (at least number_of_samples long)
+//      samples           - the samples to scale (in place)
+//      number_of_samples - the number of samples to scale
+//  OUTPUT:
+//      None
+//------------------------------------------------------------------------
+static void MultiplySamples(const float *gain, int16_t *samples,
+                            size_t number_of_samples) {
+  size_t idx = 0;
+#if defined(__SSE2__)
+  for (; idx + 8 <= number_of_samples; idx += 8) {
+    __m128i in =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples + idx));
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16);
+    lo = _mm_cvttps_epi32(
+        _mm_mul_ps(_mm_loadu_ps(gain + idx), _mm_cvtepi32_ps(lo)));
+    hi = _mm_cvttps_epi32(
+        _mm_mul_ps(_mm_loadu_ps(gain + idx + 4), _mm_cvtepi32_ps(hi)));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(samples + idx),
+                     _mm_packs_epi32(lo, hi));
+  }
+#endif
+  for (; idx < number_of_samples; idx++) {
+    samples[idx] =
+        SaturateSample(gain[idx] * static_cast<float>(samples[idx]));
+  }
+}
+
 //========================================================================
 // CLASS: Envelope
 //========================================================================
@@ -28,6 +134,60 @@ Envelope::~Envelope() {}
 //------------------------------------------------------------------------
 // 2. GENERAL USER INTERFACE
 //------------------------------------------------------------------------
+void Envelope::ApplyEnvelopeBatch(vector<vector<int16_t>> &buffers,
+                                  size_t number_of_threads) const {
+  if (buffers.empty()) return;
+
+  const size_t number_of_samples = buffers.front().size();
+#ifndef NDEBUG
+  for (auto &buffer : buffers) {
+    assert(buffer.size() == number_of_samples);
+  }
+#endif
+
+  // 1. Work out where the segments go and make sure that the sample tables
+  //    are generated before any thread starts reading them.
+  vector<SegmentSpan> spans;
+  GetSegmentSpans(number_of_samples, spans);
+
+  for (auto &span : spans) PrepareSegment(*span.segment);
+
+  // 2. Tiled application: for every block of every segment, go through all
+  //    the buffers in [first, last) before moving on to the next block.
+  auto apply_tiled = [&spans, &buffers](size_t first, size_t last) {
+    for (auto &span : spans) {
+      size_t length = span.segment->GetLength();
+
+      for (size_t begin = 0; begin < length;
+           begin += kEnvelopeBatchBlockSize) {
+        size_t end = min(begin + kEnvelopeBatchBlockSize, length);
+
+        for (size_t idx = first; idx < last; idx++) {
+          ApplySegmentRange(*span.segment, begin, end,
+                            buffers[idx].data() + span.offset + begin);
+        }
+      }
+    }
+  };
+
+  // 3. Split the buffers between the threads. The caller's thread takes
+  //    the first share.
+  number_of_threads = max<size_t>(1, min(number_of_threads, buffers.size()));
+  const size_t share = buffers.size() / number_of_threads;
+  const size_t remainder = buffers.size() % number_of_threads;
+
+  vector<thread> workers;
+  size_t first = share + (remainder > 0 ? 1 : 0);
+  for (size_t thread_idx = 1; thread_idx < number_of_threads; thread_idx++) {
+    size_t last = first + share + (thread_idx < remainder ? 1 : 0);
+    workers.emplace_back(apply_tiled, first, last);
+    first = last;
+  }
+
+  apply_tiled(0, share + (remainder > 0 ? 1 : 0));
+
+  for (auto &worker : workers) worker.join();
+}
 
 //------------------------------------------------------------------------
 // 3. ACCESSORS
@@ -38,13 +198,95 @@ Envelope::~Envelope() {}
 //------------------------------------------------------------------------
 // None
 
+//------------------------------------------------------------------------
+// HELPERS FOR DERIVED CLASSES
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
+//  NAME:
+//      Envelope::PrepareSegment
+//
+//  DESCRIPTION:
+//      Generates the samples of a segment on first use. ApplyEnvelope()
+//      is const and may be called from several threads at once, so the
+//      segment is generated through its once_flag: exactly one thread
+//      generates it, and the others wait for it to finish. Constant
+//      segments (see Segment::IsConstant()) are applied as a single
+//      gain and are never generated.
+//  INPUT:
+//      segment - the segment to generate
+//  OUTPUT:
+//      None
+//------------------------------------------------------------------------
+void Envelope::PrepareSegment(Segment &segment) {
+  float gain;
+
+  if (segment.IsConstant(gain)) return;
+
+  call_once(*segment.generate_once_, [&segment]() {
+    if (!segment.generated_) segment.GenerateSamples();
+  });
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      Envelope::ApplySegment
+//
+//  DESCRIPTION:
+//      Applies one segment to the samples it spans, generating the
+//      segment first if necessary (see PrepareSegment()).
+//  INPUT:
+//      segment - the segment to apply
+//      samples - pointer to the first sample covered by the segment. At
+//                least segment.GetLength() samples have to follow.
+//  OUTPUT:
+//      None
+//------------------------------------------------------------------------
+void Envelope::ApplySegment(Segment &segment, int16_t *samples) {
+  PrepareSegment(segment);
+  ApplySegmentRange(segment, 0, segment.GetLength(), samples);
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      Envelope::ApplySegmentRange
+//
+//  DESCRIPTION:
+//      Applies samples [begin, end) of one segment. Only reads the
+//      segment, which makes it safe to call from several threads at
+//      once. Non-constant segments have to be generated beforehand.
+//  INPUT:
+//      segment - the segment to apply
+//      begin   - the first sample of the segment to apply
+//      end     - one past the last sample of the segment to apply
+//      samples - pointer to the signal sample corresponding to 'begin'
+//  OUTPUT:
+//      None
+//------------------------------------------------------------------------
+void Envelope::ApplySegmentRange(const Segment &segment, size_t begin,
+                                 size_t end, int16_t *samples) {
+  float gain;
+
+  assert(begin <= end && end <= segment.GetLength());
+  if (begin == end) return;
+
+  if (segment.IsConstant(gain)) {
+    ScaleSamples(gain, samples, end - begin);
+    return;
+  }
+
+  assert(segment.generated_ && "Samples not generated!");
+  end = min(end, segment.samples_.size());
+  if (begin < end)
+    MultiplySamples(segment.samples_.data() + begin, samples, end - begin);
+}
+
 //========================================================================
 // CLASS: ArEnvelope
 //========================================================================
 //------------------------------------------------------------------------
 // 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
 //------------------------------------------------------------------------
-ArEnvelope::ArEnvelope(SynthConfig &synthesiser, float peak_amplitude_arg,
+ArEnvelope::ArEnvelope(const SynthConfig &synthesiser, float peak_amplitude_arg,
                        double attack_duration_arg, double decay_duration_arg)
     : Envelope(),
       attack_number_of_samples_(static_cast<size_t>(
@@ -62,33 +304,32 @@ ArEnvelope::ArEnvelope(SynthConfig &synthesiser, float peak_amplitude_arg,
 //------------------------------------------------------------------------
 // 2. GENERAL USER INTERFACE
 //------------------------------------------------------------------------
-void ArEnvelope::ApplyEnvelope(std::vector<int16_t> &samples) const {
-  assert(samples.size() >=
+void ArEnvelope::ApplyEnvelope(int16_t *samples,
+                               size_t number_of_samples) const {
+  assert(number_of_samples >=
          (attack_number_of_samples_ + decay_number_of_samples_));
-  assert(!samples.empty());
+  assert(number_of_samples != 0);
 
   // 1. Apply attack
-  vector<float>::const_iterator it_seg = attack_segment_.samples_.begin();
-  vector<float>::const_iterator it_seg_end = attack_segment_.samples_.end();
-  vector<int16_t>::iterator it_data = samples.begin();
-  vector<int16_t>::const_iterator it_data_end =
-      samples.begin() +
-      static_cast<vector<int16_t>::difference_type>(attack_number_of_samples_);
-
-  for (; it_seg != it_seg_end && it_data != it_data_end; it_seg++, it_data++) {
-    *it_data = static_cast<int16_t>(*it_seg * static_cast<float>(*it_data));
-  }
+  ApplySegment(attack_segment_, samples);
 
   // 2. Apply decay
-  it_seg = decay_segment_.samples_.begin();
-  it_seg_end = decay_segment_.samples_.end();
-  it_data = samples.end() - static_cast<vector<int16_t>::difference_type>(
-                                decay_number_of_samples_);
-  it_data_end = samples.end();
-
-  for (; it_seg != it_seg_end && it_data != it_data_end; it_seg++, it_data++) {
-    *it_data = static_cast<int16_t>(*it_seg * static_cast<float>(*it_data));
-  }
+  ApplySegment(decay_segment_,
+               samples + number_of_samples - decay_number_of_samples_);
+}
+
+//------------------------------------------------------------------------
+// INTERFACE DEFINITION
+//------------------------------------------------------------------------
+void ArEnvelope::GetSegmentSpans(size_t number_of_samples,
+                                 vector<SegmentSpan> &spans) const {
+  assert(number_of_samples >=
+         (attack_number_of_samples_ + decay_number_of_samples_));
+
+  spans.clear();
+  spans.push_back({&attack_segment_, 0});
+  spans.push_back(
+      {&decay_segment_, number_of_samples - decay_number_of_samples_});
 }
 
 //------------------------------------------------------------------------
@@ -122,63 +363,37 @@ AdsrEnvelope::AdsrEnvelope(std::unique_ptr<Segment> &attack_segment_arg,
 //------------------------------------------------------------------------
 // 2. GENERAL USER INTERFACE
 //------------------------------------------------------------------------
-void AdsrEnvelope::ApplyEnvelope(std::vector<int16_t> &samples) const {
-  // TODO: This is a rather slow and inefficient implementation and I'm unhappy
-  //       about it. Come back here and improve.
-  assert(samples.size() == length_);
-  assert(!samples.empty());
-
-  // 1. Apply attack
-  vector<float> attack_segment = attack_segment_->GetSamples();
+void AdsrEnvelope::ApplyEnvelope(int16_t *samples,
+                                 size_t number_of_samples) const {
+  assert(number_of_samples == length_);
+  assert(number_of_samples != 0);
 
-  vector<float>::const_iterator it_seg = attack_segment.begin();
-  vector<float>::const_iterator it_seg_end = attack_segment.end();
-  vector<int16_t>::iterator it_data = samples.begin();
-  vector<int16_t>::iterator it_data_end =
-      samples.begin() + static_cast<vector<int16_t>::difference_type>(
-                            attack_segment_->GetLength());
+  Segment *segments[] = {attack_segment_.get(), decay_segment_.get(),
+                         sustain_segment_.get(), release_segment_.get()};
+  int16_t *data = samples;
 
-  for (; it_seg != it_seg_end && it_data != it_data_end; it_seg++, it_data++) {
-    *it_data = static_cast<int16_t>(*it_seg * static_cast<float>(*it_data));
-  }
-
-  // 2. Apply decay
-  vector<float> decay_segment = decay_segment_->GetSamples();
-
-  it_data = it_data_end;
-  it_data_end = it_data + static_cast<vector<int16_t>::difference_type>(
-                              decay_segment_->GetLength());
-  it_seg = decay_segment.begin();
-  it_seg_end = decay_segment.end();
-
-  for (; it_seg != it_seg_end && it_data != it_data_end; it_seg++, it_data++) {
-    *it_data = static_cast<int16_t>(*it_seg * static_cast<float>(*it_data));
-  }
-
-  // 3. Apply sustain
-  vector<float> sustain_segment = sustain_segment_->GetSamples();
-
-  it_data = it_data_end;
-  it_data_end = it_data + static_cast<vector<int16_t>::difference_type>(
-                              sustain_segment_->GetLength());
-  it_seg = sustain_segment.begin();
-  it_seg_end = sustain_segment.end();
-
-  for (; it_seg != it_seg_end && it_data != it_data_end; it_seg++, it_data++) {
-    *it_data = static_cast<int16_t>(*it_seg * static_cast<float>(*it_data));
+  // Apply attack, decay, sustain and release one after another
+  for (Segment *segment : segments) {
+    ApplySegment(*segment, data);
+    data += segment->GetLength();
   }
+}
 
-  // 4. Apply release
-  vector<float> release_segment = release_segment_->GetSamples();
+//------------------------------------------------------------------------
+// INTERFACE DEFINITION
+//------------------------------------------------------------------------
+void AdsrEnvelope::GetSegmentSpans(size_t number_of_samples,
+                                   vector<SegmentSpan> &spans) const {
+  assert(number_of_samples == length_);
 
-  it_data = it_data_end;
-  it_data_end = it_data + static_cast<vector<int16_t>::difference_type>(
-                              release_segment_->GetLength());
-  it_seg = release_segment.begin();
-  it_seg_end = release_segment.end();
+  Segment *segments[] = {attack_segment_.get(), decay_segment_.get(),
+                         sustain_segment_.get(), release_segment_.get()};
+  size_t offset = 0;
 
-  for (; it_seg != it_seg_end && it_data != it_data_end; it_seg++, it_data++) {
-    *it_data = static_cast<int16_t>(*it_seg * static_cast<float>(*it_data));
+  spans.clear();
+  for (Segment *segment : segments) {
+    spans.push_back({segment, offset});
+    offset += segment->GetLength();
   }
 }
 
@@ -15,6 +15,10 @@
 
 #include <global/global_include.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 using namespace std;
 
 //========================================================================
@@ -26,7 +30,8 @@ using namespace std;
 Segment::Segment(size_t number_of_samples_arg)
     : samples_(0),
       generated_(false),
-      number_of_samples_(number_of_samples_arg) {}
+      number_of_samples_(number_of_samples_arg),
+      generate_once_(new once_flag) {}
 Segment::~Segment() {}
 
 const float& Segment::operator[](const size_t position) const {
@@ -38,11 +43,16 @@ const float& Segment::operator[](const size_t position) const {
 
 float& Segment::operator[](const size_t position) {
   assert(position <= number_of_samples_);
-  assert(generated_ && "Samples not generated!");
+  if (!generated_) GenerateSamples();
 
   return samples_[position];
 }
 
+void Segment::Invalidate() {
+  generated_ = false;
+  generate_once_.reset(new once_flag);
+}
+
 //========================================================================
 // CLASS: ConstantSegment
 //========================================================================
@@ -68,6 +78,11 @@ bool ConstantSegment::IsEmpty() const { return (number_of_samples_ == 0); }
 
 size_t ConstantSegment::GetLength() const { return number_of_samples_; }
 
+bool ConstantSegment::IsConstant(float& gain) const {
+  gain = amplitude_;
+  return true;
+}
+
 //========================================================================
 // CLASS: LinearSegment
 //========================================================================
@@ -79,38 +94,61 @@ LinearSegment::LinearSegment(float peak_amplitude_arg,
                              SegmentGradient seg_gradient_arg)
     : Segment(number_of_samples_arg),
       peak_amplitude_(peak_amplitude_arg),
-      seg_gradient_(seg_gradient_arg) {
-  GenerateSamples();
-}
+      seg_gradient_(seg_gradient_arg) {}
 
 void LinearSegment::GenerateSamples() {
-  double volume = 0;
+  double start = 0;
   double increment = 0;
-  samples_.clear();
 
-  samples_.reserve(number_of_samples_);
+  samples_.resize(number_of_samples_);
 
   // Step 1: Calculate the starting value and the increment that will be used
   //         to step through the segment.
-  if (seg_gradient_ == SegmentGradient::kIncline) {
+  if (number_of_samples_ > 1) {
     increment = static_cast<double>(peak_amplitude_) /
                 static_cast<double>(number_of_samples_ - 1);
-    volume = 0;
+  }
+
+  if (seg_gradient_ == SegmentGradient::kIncline) {
+    start = 0;
   } else {
-    increment = -static_cast<double>(peak_amplitude_) /
-                static_cast<double>(number_of_samples_ - 1);
-    volume = peak_amplitude_;
+    start = peak_amplitude_;
+    increment = -increment;
   }
 
-  // Step 2: Walk through the segment and propagate with the right values
-  for (size_t idx = 0; idx < number_of_samples_; idx++) {
-    samples_.push_back(static_cast<float>(volume));
-    volume += increment;
+  // Step 2: Walk through the segment and calculate every value directly as
+  //         start + idx * increment. Unlike accumulating the increment,
+  //         this doesn't propagate the rounding error from one sample to
+  //         the next and there's no dependency between iterations, so 4
+  //         values are calculated at a time.
+  float* samples = samples_.data();
+  size_t idx = 0;
+#if defined(__SSE2__)
+  const __m128d start_x2 = _mm_set1_pd(start);
+  const __m128d increment_x2 = _mm_set1_pd(increment);
+  const __m128d four_x2 = _mm_set1_pd(4.0);
+  __m128d idx_lo = _mm_set_pd(1.0, 0.0);
+  __m128d idx_hi = _mm_set_pd(3.0, 2.0);
+
+  for (; idx + 4 <= number_of_samples_; idx += 4) {
+    __m128 lo = _mm_cvtpd_ps(
+        _mm_add_pd(start_x2, _mm_mul_pd(idx_lo, increment_x2)));
+    __m128 hi = _mm_cvtpd_ps(
+        _mm_add_pd(start_x2, _mm_mul_pd(idx_hi, increment_x2)));
+    _mm_storeu_ps(samples + idx, _mm_movelh_ps(lo, hi));
+
+    idx_lo = _mm_add_pd(idx_lo, four_x2);
+    idx_hi = _mm_add_pd(idx_hi, four_x2);
+  }
+#endif
+  for (; idx < number_of_samples_; idx++) {
+    samples[idx] =
+        static_cast<float>(start + static_cast<double>(idx) * increment);
   }
 
-  // Step 3: Fix what's at the beginning/end as due to rounding error
-  //         the last/first (incline/decline) entry might be different from
-  //         peak_amplitude. Force it to be equal.
+  // Step 3: Fix what's at the end as due to rounding error the last
+  //         entry might be different from peak_amplitude (kIncline) or 0
+  //         (kDecline). Force it to be equal. The first entry is exact.
   if (number_of_samples_ > 0) {
     if (seg_gradient_ == SegmentGradient::kIncline) {
       samples_[number_of_samples_ - 1] = peak_amplitude_;
@@ -127,10 +165,26 @@ LinearSegment::~LinearSegment() {}
 //------------------------------------------------------------------------
 // 2. GENERAL USER INTERFACE
 //------------------------------------------------------------------------
-bool LinearSegment::IsEmpty() const { return samples_.empty(); }
+bool LinearSegment::IsEmpty() const { return (number_of_samples_ == 0); }
 
 size_t LinearSegment::GetLength() const { return number_of_samples_; }
 
+bool LinearSegment::IsConstant(float& gain) const {
+  // A ramp from 0 to 0 is flat. So is a single-sample segment, which after
+  // the end-point fix-up in GenerateSamples() holds only the final value.
+  if (peak_amplitude_ == 0) {
+    gain = 0;
+    return true;
+  }
+
+  if (number_of_samples_ == 1) {
+    gain = (seg_gradient_ == SegmentGradient::kIncline) ? peak_amplitude_ : 0;
+    return true;
+  }
+
+  return false;
+}
+
 //========================================================================
 // CLASS: ExponentialSegment
 //========================================================================
@@ -144,9 +198,7 @@ ExponentialSegment::ExponentialSegment(float amplitude_start_arg,
     : Segment(number_of_samples_arg),
       amplitude_start_(amplitude_start_arg),
       amplitude_end_(amplitude_end_arg),
-      exponent_(exponent_arg) {
-  GenerateSamples();
-}
+      exponent_(exponent_arg) {}
 
 void ExponentialSegment::GenerateSamples() {
   // ALGORITHM: This segment is calculated using the following equation:
@@ -212,10 +264,29 @@ ExponentialSegment::~ExponentialSegment() {}
 //------------------------------------------------------------------------
 // 2. GENERAL USER INTERFACE
 //------------------------------------------------------------------------
-bool ExponentialSegment::IsEmpty() const { return samples_.empty(); }
+bool ExponentialSegment::IsEmpty() const {
+  return (number_of_samples_ == 0);
+}
 
 size_t ExponentialSegment::GetLength() const { return number_of_samples_; }
 
+bool ExponentialSegment::IsConstant(float& gain) const {
+  // With a zero exponent every sample evaluates to a + c (0^0 is taken to
+  // be 1, see GenerateSamples()), i.e. to amplitude_end_. Equal end-points
+  // make 'a' vanish and leave 'c', i.e. amplitude_start_.
+  if (fabs(exponent_) <= kEps) {
+    gain = amplitude_end_;
+    return true;
+  }
+
+  if (amplitude_start_ == amplitude_end_) {
+    gain = amplitude_start_;
+    return true;
+  }
+
+  return false;
+}
+
 //=============================================================
 //  CLASS: SegmentInitialisationException
 //=============================================================
@@ -53,9 +53,9 @@ vector<int16_t> FmSynthesiser::operator()(uint32_t number_of_seconds) const {
   vector<int16_t> samples_output(number_of_samples);
   vector<int16_t> samples_modulator(number_of_samples);
 
-  // Use Oscillator to get the modulating signal
-  SynthConfig& synthesiser = SynthConfig::getInstance();
-  SineWaveform osc(synthesiser, index_of_modulation_, initial_phase_,
+  // Use Oscillator to get the modulating signal (at the same sampling
+  // rate)
+  SineWaveform osc(synthesiser_, index_of_modulation_, initial_phase_,
                    frequency_modulator_);
   samples_modulator = osc(number_of_seconds);
 
@@ -21,8 +21,6 @@ using namespace std;
 //========================================================================
 // Floating poing globals
 //========================================================================
-const double kTwelthRootOfTwo = 1.0594630943593;
-
 // Pi and 2*Pi
 const double kPi = 3.14159265358979;
 const double kTwoPi = 6.28318530717958;
@@ -31,9 +29,6 @@ const double kTwoPi = 6.28318530717958;
 // accurate enough for you!?
 extern const double kEps = 1e-14;
 
-// Notes: C0
-const double kNoteC0 = 16.35;
-
 //========================================================================
 // Fixed point globals
 //========================================================================
@@ -42,6 +37,14 @@ const double kNoteC0 = 16.35;
 //------------------------------------------------------------------------
 const uint16_t kNumberOfBitsPerByte = 8;
 const uint8_t kNumberOfBitsPerSample = 16;
+// Packed 24-bit PCM and 32-bit IEEE float samples, respectively
+const uint8_t kNumberOfBitsPerSample24 = 24;
+const uint8_t kNumberOfBitsPerSample32 = 32;
+
+// Full scale of the PCM formats, i.e. the value of the floating point
+// sample 1.0 (see pcm_conversion.h)
+const float kPcm16FullScale = 32768.0f;
+const float kPcm24FullScale = 8388608.0f;
 
 // The size of the header in the Canonical Wave File format. See
 // WaveFile.h for description of this format. This is basically
@@ -50,11 +53,40 @@ const uint8_t kNumberOfBitsPerSample = 16;
 //      - size of data (sound samples) in bytes.
 const uint8_t kWaveFileHeaderSize = 36;
 
+// The size of the whole header in the Canonical Wave File format, i.e.
+// everything that precedes the data samples.
+const uint8_t kWaveFileCanonicalHeaderSize = 44;
+
+// The size of the whole header in the RF64 format, or in the canonical
+// format with space reserved for the "ds64" chunk (see wave_file.h).
+const uint8_t kWaveFileExtendedHeaderSize = 80;
+
 // Contains the letters "RIFF" in ASCII in little-endian form,
 // so that on little-endia machine (i.e. x86) it will be saved in
 // big-endian form, as per the format
 const uint32_t kRiffChunkId = 0x46464952;
 
+// Contains the letters "RF64" in ASCII in little-endian form. Replaces
+// "RIFF" in files with more than 4GB of data (EBU Tech 3306).
+const uint32_t kRf64ChunkId = 0x34364652;
+
+// In RF64 files the 32-bit size fields hold this value and the actual
+// sizes are stored in the "ds64" chunk
+const uint32_t kRf64SizePlaceholder = 0xFFFFFFFF;
+
+// Contains the letters "ds64" in ASCII in little-endian form
+const uint32_t kDs64ChunkId = 0x34367364;
+
+// Contains the letters "JUNK" in ASCII in little-endian form. Files
+// that might have to be promoted to RF64 reserve space for the "ds64"
+// chunk with a "JUNK" chunk of the same size, which readers skip.
+const uint32_t kJunkChunkId = 0x4b4e554a;
+
+// The size of the "ds64" chunk (without the id and the size fields)
+// when it contains no table: RIFF size, data size and sample count
+// (8 bytes each) and the table length (4 bytes)
+const uint32_t kDs64ChunkSize = 28;
+
 // Contains the letters "WAVE" in ASCII in little-endian form,
 // so that on little-endia machine (i.e. x86) it will be saved in
 // big-endian form, as per the format
@@ -76,9 +108,103 @@ const uint32_t kPcmSubchunk1Size = 16;
 // 1 for pcm
 const uint16_t kPcmAudioFormat = 1;
 
+// 3 for IEEE float
+const uint16_t kIeeeFloatAudioFormat = 3;
+
+// WAVE_FORMAT_EXTENSIBLE - the actual format is in the first two bytes of
+// the sub-format GUID, at this offset within the "fmt " sub-chunk
+const uint16_t kExtensibleAudioFormat = 0xFFFE;
+const uint32_t kExtensibleSubFormatOffset = 24;
+
 const uint16_t kNumberOfChannelsMono = 1;
 const uint16_t kNumberOfChannelsStereo = 2;
 
+// InterleaveChannels() interleaves layouts other than mono, stereo and
+// 4 channels in blocks of this many frames. Even for 8 channels, the
+// input (8 x 2KB) and the output (16KB) blocks together fit in L1.
+const size_t kInterleaveBlockSize = 1024;
+
+// WaveFileOut interleaves planar channels through a buffer of this many
+// samples (64KB), which is written with one system call
+const size_t kWaveFileWriteBufferSize = 32768;
+
+// AsyncWaveWriter defaults: blocks of 4096 samples (8KB, i.e. two pages)
+// and 4 of them, so that up to 3 blocks can wait for the disk while the
+// next one is being rendered.
+const size_t kAsyncWaveWriterBlockSize = 4096;
+const size_t kAsyncWaveWriterNumberOfBlocks = 4;
+
+// PcmStreamOut writes in blocks of this many bytes - as much as a pipe
+// holds by default (16 pages). With WAVE framing the header is padded to
+// one page, so that the samples start at a page boundary.
+const size_t kPcmStreamBufferSize = 65536;
+const size_t kPcmStreamAlignment = 4096;
+
+// WaveExportManager defaults: 4 I/O threads and up to 8 files queued or
+// being written, i.e. up to 4 rendered files can wait for a free thread
+const size_t kWaveExportNumberOfThreads = 4;
+const size_t kWaveExportMaxFilesInFlight = 8;
+
+// The size fields of WAVE streams whose length isn't known up-front
+const uint32_t kWaveFileUnknownSize = 0xFFFFFFFF;
+
+// FLAC streams start with "fLaC" (stored little-endian, like the chunk
+// IDs above)
+const uint32_t kFlacStreamMarker = 0x43614c66;
+// FlacEncoder: samples per channel in a frame (the format's default),
+// the highest order of the linear predictor, the precision of its
+// coefficients in bits and the highest order of residual partitioning
+const size_t kFlacBlockSize = 4096;
+const size_t kFlacMaxLpcOrder = 8;
+const unsigned kFlacLpcPrecision = 12;
+const unsigned kFlacMaxPartitionOrder = 8;
+
+//------------------------------------------------------------------------
+// Oversampler
+//------------------------------------------------------------------------
+// Oversampler processes blocks of this many output samples (so up to 8x
+// as many oversampled ones, 32KB)
+const size_t kOversamplerBlockSize = 1024;
+
+// The number of non-zero taps on either side of the centre of the
+// half-band filters (i.e. 4 * length - 1 taps in total). The last stage
+// of the decimator has a transition band of about 0.4-0.6 of the output
+// Nyquist frequency and rejects the rest by more than 70dB. The earlier
+// stages have a lot more room.
+const size_t kHalfBandFinalStageLength = 16;
+const size_t kHalfBandStageLength = 6;
+
+//------------------------------------------------------------------------
+// SampleRateConverter
+//------------------------------------------------------------------------
+// The length of the interpolation filter, in input frames (a multiple of
+// 4). It's stretched by the ratio of the rates when downsampling, so
+// that it cuts off below the output Nyquist frequency.
+const size_t kResamplerNumberOfTaps = 64;
+
+// The largest number of phases (fractional positions) that the table of
+// the interpolation filter has. When the ratio of the rates needs more
+// (e.g. 44100 -> 44101), the neighbouring phases are interpolated.
+const size_t kResamplerMaxNumberOfPhases = 1024;
+
+// The cut-off of the interpolation filter, relative to the lower of the
+// two Nyquist frequencies, and the parameter of its Kaiser window. With
+// the number of taps above, the filter is flat to about 18kHz at 44.1kHz
+// and rejects the images and the aliases by about 90dB.
+const double kResamplerCutoff = 0.91;
+const double kResamplerKaiserBeta = 9.0;
+
+// ResampledWaveFileIn reads the file in blocks of this many frames
+const size_t kResamplerBlockSize = 1024;
+
+//------------------------------------------------------------------------
+// MixerBus
+//------------------------------------------------------------------------
+// MixSignals() adds every input to a block of this many samples of the
+// bus before moving on to the next block, so the bus (8KB) stays in L1
+// while the inputs stream through.
+const size_t kMixerBlockSize = 2048;
+
 //------------------------------------------------------------------------
 // SynthConfig
 //------------------------------------------------------------------------
@@ -86,6 +212,53 @@ const uint16_t kNumberOfChannelsStereo = 2;
 // This number specifies how many of those it contains.
 const size_t kNumberOfFrequencies = 128;
 
+//------------------------------------------------------------------------
+// VoiceManager
+//------------------------------------------------------------------------
+// The default number of voices, i.e. of notes that can sound at the same
+// time before the oldest ones are cut off
+const size_t kNumberOfVoices = 32;
+
+//------------------------------------------------------------------------
+// ProcessingGraph
+//------------------------------------------------------------------------
+// ProcessingGraph processes blocks of this many samples. Short enough for
+// all the buffers of a typical patch (1KB each) to stay in L1, long
+// enough for the cost of calling every node to be negligible.
+const size_t kGraphBlockSize = 256;
+
+//------------------------------------------------------------------------
+// MidiFile
+//------------------------------------------------------------------------
+// The chunks of a Standard MIDI File: "MThd" (the header) and "MTrk"
+// (a track), read as big-endian numbers
+const uint32_t kMidiHeaderChunkId = 0x4D546864;
+const uint32_t kMidiTrackChunkId = 0x4D54726B;
+
+// The types of the meta events that matter for rendering
+const uint8_t kMidiSetTempoType = 0x51;
+const uint8_t kMidiEndOfTrackType = 0x2F;
+
+// The tempo until the first Set Tempo event: 120 beats per minute, in
+// microseconds per quarter note
+const uint32_t kMidiDefaultTempo = 500000;
+
+// The MIDI note number of pitch 0 of the frequency table: MIDI note 69
+// is A4, which is pitch 57 (see pitch_tables.h)
+const uint8_t kMidiNoteOfFirstPitch = 12;
+
+// The number of channels of a MIDI track (the low nibble of the status
+// byte of the channel messages)
+const std::size_t kMidiNumberOfChannels = 16;
+
+//------------------------------------------------------------------------
+// Envelope
+//------------------------------------------------------------------------
+// Envelope::ApplyEnvelopeBatch() applies the envelope in blocks of this
+// many samples. A block of gains (8KB) together with a block of samples
+// from one buffer (4KB) comfortably fits in L1.
+const size_t kEnvelopeBatchBlockSize = 2048;
+
 //------------------------------------------------------------------------
 // General
 //------------------------------------------------------------------------
@@ -0,0 +1,278 @@
+//========================================================================
+// FILE:
+//      src/graph/processing_graph.cc
+//
+// AUTHOR:
+//      zimzum@github
+//
+// DESCRIPTION:
+//      Implements the ProcessorNode and ProcessingGraph classes.
+//
+//  License: GNU GPL v2.0
+//========================================================================
+
+#include <graph/processing_graph.h>
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <limits>
+
+using namespace std;
+
+//========================================================================
+// CLASS: ProcessorNode
+//========================================================================
+//------------------------------------------------------------------------
+// 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+//------------------------------------------------------------------------
+ProcessorNode::ProcessorNode(size_t number_of_inputs)
+    : number_of_inputs_(number_of_inputs) {}
+
+ProcessorNode::~ProcessorNode() = default;
+
+//========================================================================
+// CLASS: ProcessingGraph
+//========================================================================
+const size_t ProcessingGraph::kNoNode = numeric_limits<size_t>::max();
+
+//------------------------------------------------------------------------
+// 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+//------------------------------------------------------------------------
+ProcessingGraph::ProcessingGraph(size_t block_size, size_t number_of_threads)
+    : block_size_(block_size), compiled_(false) {
+  assert(block_size_ > 0);
+
+  if (number_of_threads > 1) {
+    pool_.reset(new WorkStealingPool(number_of_threads));
+  }
+}
+
+ProcessingGraph::~ProcessingGraph() = default;
+
+//------------------------------------------------------------------------
+// 2. GENERAL USER INTERFACE
+//------------------------------------------------------------------------
+size_t ProcessingGraph::AddNode(unique_ptr<ProcessorNode> node) {
+  assert(node != nullptr);
+
+  NodeEntry entry;
+  entry.sources.assign(node->number_of_inputs(), kNoNode);
+  entry.node = std::move(node);
+  entry.output_buffer = nullptr;
+  nodes_.push_back(std::move(entry));
+
+  compiled_ = false;
+  return nodes_.size() - 1;
+}
+
+void ProcessingGraph::Connect(size_t source, size_t destination,
+                              size_t input) {
+  assert((source < nodes_.size()) && (destination < nodes_.size()));
+  assert(input < nodes_[destination].sources.size());
+  assert(nodes_[source].node->has_output() && "Sinks have no output!");
+
+  nodes_[destination].sources[input] = source;
+  compiled_ = false;
+}
+
+bool ProcessingGraph::Compile() {
+  const size_t number_of_nodes = nodes_.size();
+  vector<vector<size_t>> consumers(number_of_nodes);
+  vector<size_t> number_of_pending_inputs(number_of_nodes, 0);
+  vector<size_t> number_of_readers(number_of_nodes, 0);
+
+  compiled_ = false;
+  schedule_.clear();
+  buffers_.clear();
+  tasks_.number_of_dependencies.assign(number_of_nodes, 0);
+  tasks_.successors.assign(number_of_nodes, vector<size_t>());
+
+  // 1. Every input has to be connected
+  for (size_t node_id = 0; node_id < number_of_nodes; node_id++) {
+    for (size_t source : nodes_[node_id].sources) {
+      if (source == kNoNode) return false;
+      consumers[source].push_back(node_id);
+      number_of_pending_inputs[node_id]++;
+      number_of_readers[source]++;
+    }
+  }
+
+  // 2. Topological order (Kahn's algorithm): a node is ready once all
+  //    the nodes feeding it are scheduled. Ties are broken by the id, so
+  //    the order only depends on the graph.
+  deque<size_t> ready;
+  for (size_t node_id = 0; node_id < number_of_nodes; node_id++) {
+    if (number_of_pending_inputs[node_id] == 0) ready.push_back(node_id);
+  }
+  while (!ready.empty()) {
+    size_t node_id = ready.front();
+    ready.pop_front();
+    schedule_.push_back(node_id);
+
+    for (size_t consumer : consumers[node_id]) {
+      if (--number_of_pending_inputs[consumer] == 0) {
+        ready.push_back(consumer);
+      }
+    }
+  }
+  if (schedule_.size() != number_of_nodes) {
+    // A cycle
+    schedule_.clear();
+    return false;
+  }
+
+  // 3. Liveness: walk the schedule, taking a buffer from the pool for
+  //    every output and returning it once its last reader has run. The
+  //    output is taken before the inputs are returned, so that a node
+  //    never writes over its own inputs. On several threads, a node only
+  //    takes a buffer if it depends on everything that used it before.
+  vector<size_t> buffer_ids(number_of_nodes, kNoNode);
+  vector<size_t> buffer_writers;
+  vector<size_t> free_buffers;
+  vector<vector<bool>> ancestors;
+  if (pool_ != nullptr) ancestors = FindAncestors(consumers);
+
+  for (size_t node_id : schedule_) {
+    if (nodes_[node_id].node->has_output()) {
+      auto found = free_buffers.rbegin();
+      if (pool_ != nullptr) {
+        found = find_if(free_buffers.rbegin(), free_buffers.rend(),
+                        [&](size_t buffer_id) {
+                          return FollowsAllUsers(node_id,
+                                                 buffer_writers[buffer_id],
+                                                 consumers, ancestors);
+                        });
+      }
+
+      if (found == free_buffers.rend()) {
+        buffer_ids[node_id] = buffer_writers.size();
+        buffer_writers.push_back(node_id);
+      } else {
+        buffer_ids[node_id] = *found;
+        buffer_writers[*found] = node_id;
+        free_buffers.erase(next(found).base());
+      }
+    }
+
+    for (size_t source : nodes_[node_id].sources) {
+      if (--number_of_readers[source] == 0) {
+        free_buffers.push_back(buffer_ids[source]);
+      }
+    }
+
+    // Nobody reads this output
+    if ((buffer_ids[node_id] != kNoNode) &&
+        (number_of_readers[node_id] == 0)) {
+      free_buffers.push_back(buffer_ids[node_id]);
+    }
+  }
+
+  // 4. Allocate the pool and resolve the buffers of every node
+  buffers_.assign(buffer_writers.size(), vector<float>(block_size_, 0.0f));
+  for (size_t node_id = 0; node_id < number_of_nodes; node_id++) {
+    NodeEntry& entry = nodes_[node_id];
+    entry.output_buffer = (buffer_ids[node_id] != kNoNode)
+                              ? buffers_[buffer_ids[node_id]].data()
+                              : nullptr;
+    entry.input_buffers.clear();
+    for (size_t source : entry.sources) {
+      entry.input_buffers.push_back(buffers_[buffer_ids[source]].data());
+    }
+
+    tasks_.number_of_dependencies[node_id] = entry.sources.size();
+    tasks_.successors[node_id] = consumers[node_id];
+  }
+
+  compiled_ = true;
+  return true;
+}
+
+void ProcessingGraph::Process(size_t number_of_samples) {
+  assert(compiled_ && "The graph has to be compiled!");
+
+  size_t length = 0;
+  const function<void(size_t)> process_node = [this, &length](size_t id) {
+    NodeEntry& entry = nodes_[id];
+    entry.node->Process(entry.input_buffers.data(), entry.output_buffer,
+                        length);
+  };
+
+  for (size_t done = 0; done < number_of_samples; done += block_size_) {
+    length = min(block_size_, number_of_samples - done);
+
+    if (pool_ == nullptr) {
+      for (size_t node_id : schedule_) process_node(node_id);
+    } else {
+      pool_->Run(tasks_, process_node);
+    }
+  }
+}
+
+//------------------------------------------------------------------------
+// 4. PRIVATE METHODS
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
+//  NAME:
+//      FindAncestors()
+//
+//  DESCRIPTION:
+//      Finds all the nodes that every node depends on, directly or not.
+//      The graph has to be scheduled.
+//  INPUT:
+//      consumers - the nodes fed by every node
+//  OUTPUT:
+//      For every node, a flag per node that's set for its ancestors.
+//------------------------------------------------------------------------
+vector<vector<bool>> ProcessingGraph::FindAncestors(
+    const vector<vector<size_t>>& consumers) const {
+  const size_t number_of_nodes = nodes_.size();
+  vector<vector<bool>> ancestors(number_of_nodes,
+                                 vector<bool>(number_of_nodes, false));
+
+  // A node's ancestors are complete before it feeds anything
+  for (size_t node_id : schedule_) {
+    for (size_t consumer : consumers[node_id]) {
+      vector<bool>& inherited = ancestors[consumer];
+      inherited[node_id] = true;
+      for (size_t idx = 0; idx < number_of_nodes; idx++) {
+        if (ancestors[node_id][idx]) inherited[idx] = true;
+      }
+    }
+  }
+
+  return ancestors;
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      FollowsAllUsers()
+//
+//  DESCRIPTION:
+//      Checks whether a node can write to the buffer last written by
+//      another node when the nodes run on several threads, i.e. whether
+//      it always runs after the writer and all the readers of that
+//      buffer. The earlier users of the buffer ran before its writer.
+//  INPUT:
+//      node_id   - the node that needs a buffer
+//      writer_id - the last node that wrote to the buffer
+//      consumers - the nodes fed by every node
+//      ancestors - see FindAncestors()
+//  OUTPUT:
+//      True if the node may take the buffer.
+//------------------------------------------------------------------------
+bool ProcessingGraph::FollowsAllUsers(
+    size_t node_id, size_t writer_id, const vector<vector<size_t>>& consumers,
+    const vector<vector<bool>>& ancestors) const {
+  if (!ancestors[node_id][writer_id]) return false;
+
+  for (size_t reader_id : consumers[writer_id]) {
+    if (!ancestors[node_id][reader_id]) return false;
+  }
+
+  return true;
+}
+
+//========================================================================
+// End of file
+//========================================================================
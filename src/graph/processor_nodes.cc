@@ -0,0 +1,218 @@
+//========================================================================
+// FILE:
+//      src/graph/processor_nodes.cc
+//
+// AUTHOR:
+//      zimzum@github
+//
+// DESCRIPTION:
+//      Implements the nodes of the ProcessingGraph.
+//
+//  License: GNU GPL v2.0
+//========================================================================
+
+#include <graph/processor_nodes.h>
+
+#include <common/mixer_bus.h>
+
+#include <algorithm>
+
+using namespace std;
+
+//========================================================================
+// UTILITIES
+//========================================================================
+//------------------------------------------------------------------------
+//  NAME:
+//      RenderWaveform
+//
+//  DESCRIPTION:
+//      Generates a block of a waveform, optionally with the phase
+//      modulated by a signal. The waveform is a template parameter, so
+//      there's no dispatch per sample.
+//  INPUT:
+//      output              - the output block
+//      number_of_samples   - the length of the block
+//      amplitude           - the peak amplitude
+//      phase               - the phase of the first sample (updated)
+//      phase_increment     - the phase increment per sample
+//      modulation          - the modulating signal (nullptr if none)
+//      index_of_modulation - the scale of the modulating signal
+//  OUTPUT:
+//      None
+//------------------------------------------------------------------------
+template <double (*Shape)(double)>
+static void RenderWaveform(float* output, size_t number_of_samples,
+                           float amplitude, double& phase,
+                           double phase_increment, const float* modulation,
+                           double index_of_modulation) {
+  for (size_t idx = 0; idx < number_of_samples; idx++) {
+    double modulated_phase = phase;
+    if (modulation != nullptr) {
+      modulated_phase =
+          WrapPhase(phase + index_of_modulation * modulation[idx]);
+    }
+    output[idx] = amplitude * static_cast<float>(Shape(modulated_phase));
+
+    if ((phase += phase_increment) >= kTwoPi) phase -= kTwoPi;
+  }
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      RenderWaveform
+//
+//  DESCRIPTION:
+//      As above, for the waveform given at run time.
+//------------------------------------------------------------------------
+static void RenderWaveform(Waveform waveform, float* output,
+                           size_t number_of_samples, float amplitude,
+                           double& phase, double phase_increment,
+                           const float* modulation,
+                           double index_of_modulation) {
+  switch (waveform) {
+    case Waveform::kSine:
+      RenderWaveform<SineShape>(output, number_of_samples, amplitude, phase,
+                                phase_increment, modulation,
+                                index_of_modulation);
+      break;
+    case Waveform::kSawtooth:
+      RenderWaveform<SawtoothShape>(output, number_of_samples, amplitude,
+                                    phase, phase_increment, modulation,
+                                    index_of_modulation);
+      break;
+    case Waveform::kSquare:
+      RenderWaveform<SquareShape>(output, number_of_samples, amplitude,
+                                  phase, phase_increment, modulation,
+                                  index_of_modulation);
+      break;
+    case Waveform::kTriangle:
+      RenderWaveform<TriangleShape>(output, number_of_samples, amplitude,
+                                    phase, phase_increment, modulation,
+                                    index_of_modulation);
+      break;
+  }
+}
+
+//========================================================================
+// CLASS: OscillatorNode
+//========================================================================
+OscillatorNode::OscillatorNode(const SynthConfig& synthesiser,
+                               Waveform waveform, float amplitude,
+                               double frequency, double initial_phase)
+    : ProcessorNode(0),
+      waveform_(waveform),
+      amplitude_(amplitude),
+      phase_increment_(
+          fmod(synthesiser.phase_increment_per_sample() * frequency, kPi)),
+      phase_(initial_phase) {
+  assert((initial_phase >= 0) && (initial_phase < kTwoPi));
+  assert((frequency >= 0) && (frequency <= synthesiser.sampling_rate() / 2.0));
+}
+
+void OscillatorNode::Process(const float* const* inputs, float* output,
+                             size_t number_of_samples) {
+  RenderWaveform(waveform_, output, number_of_samples, amplitude_, phase_,
+                 phase_increment_, nullptr, 0.0);
+}
+
+//========================================================================
+// CLASS: FmNode
+//========================================================================
+FmNode::FmNode(const SynthConfig& synthesiser, Waveform waveform,
+               float amplitude, double frequency, double index_of_modulation)
+    : ProcessorNode(1),
+      waveform_(waveform),
+      amplitude_(amplitude),
+      phase_increment_(
+          fmod(synthesiser.phase_increment_per_sample() * frequency, kPi)),
+      index_of_modulation_(index_of_modulation),
+      phase_(0.0) {
+  assert((frequency >= 0) && (frequency <= synthesiser.sampling_rate() / 2.0));
+}
+
+void FmNode::Process(const float* const* inputs, float* output,
+                     size_t number_of_samples) {
+  RenderWaveform(waveform_, output, number_of_samples, amplitude_, phase_,
+                 phase_increment_, inputs[0], index_of_modulation_);
+}
+
+//========================================================================
+// CLASS: VoiceNode
+//========================================================================
+VoiceNode::VoiceNode(VoiceManager& voices)
+    : ProcessorNode(0), voices_(voices) {}
+
+void VoiceNode::Process(const float* const* inputs, float* output,
+                        size_t number_of_samples) {
+  voices_.Render(output, number_of_samples);
+}
+
+//========================================================================
+// CLASS: EnvelopeNode
+//========================================================================
+EnvelopeNode::EnvelopeNode(const vector<unique_ptr<Segment>>& segments)
+    : ProcessorNode(1), final_gain_(0.0f), position_(0) {
+  for (const auto& segment : segments) {
+    assert(segment != nullptr);
+    if (segment->IsEmpty()) continue;
+
+    vector<float> samples = segment->GetSamples();
+    samples.resize(segment->GetLength());
+    gains_.insert(gains_.end(), samples.begin(), samples.end());
+  }
+
+  if (!gains_.empty()) final_gain_ = gains_.back();
+}
+
+void EnvelopeNode::Process(const float* const* inputs, float* output,
+                           size_t number_of_samples) {
+  const float* input = inputs[0];
+  size_t idx = 0;
+
+  // Within the envelope
+  if (position_ < gains_.size()) {
+    size_t length = min(number_of_samples, gains_.size() - position_);
+    const float* gains = gains_.data() + position_;
+    for (; idx < length; idx++) output[idx] = input[idx] * gains[idx];
+    position_ += length;
+  }
+
+  // After it
+  for (; idx < number_of_samples; idx++) output[idx] = input[idx] * final_gain_;
+}
+
+//========================================================================
+// CLASS: MixerNode
+//========================================================================
+MixerNode::MixerNode(const vector<float>& gains)
+    : ProcessorNode(gains.size()), gains_(gains) {
+  assert(!gains_.empty());
+}
+
+void MixerNode::Process(const float* const* inputs, float* output,
+                        size_t number_of_samples) {
+  // The first input (scaled) seeds the output, the rest are added to it
+  const float gain = gains_[0];
+  for (size_t idx = 0; idx < number_of_samples; idx++) {
+    output[idx] = gain * inputs[0][idx];
+  }
+
+  MixSignals(inputs + 1, gains_.data() + 1, gains_.size() - 1,
+             number_of_samples, output);
+}
+
+//========================================================================
+// CLASS: SinkNode
+//========================================================================
+SinkNode::SinkNode(const function<void(const float*, size_t)>& consume)
+    : ProcessorNode(1), consume_(consume) {}
+
+void SinkNode::Process(const float* const* inputs, float* output,
+                       size_t number_of_samples) {
+  consume_(inputs[0], number_of_samples);
+}
+
+//========================================================================
+// End of file
+//========================================================================
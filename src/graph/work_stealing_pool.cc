@@ -0,0 +1,224 @@
+//========================================================================
+// FILE:
+//      src/graph/work_stealing_pool.cc
+//
+// AUTHOR:
+//      zimzum@github
+//
+// DESCRIPTION:
+//      Implements the WorkStealingPool class.
+//
+//  License: GNU GPL v2.0
+//========================================================================
+
+#include <graph/work_stealing_pool.h>
+
+#include <algorithm>
+
+using namespace std;
+
+//========================================================================
+// CLASS: WorkStealingPool
+//========================================================================
+//------------------------------------------------------------------------
+// 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+//------------------------------------------------------------------------
+WorkStealingPool::WorkStealingPool(size_t number_of_threads)
+    : tasks_(nullptr),
+      execute_(nullptr),
+      capacity_(0),
+      remaining_tasks_(0),
+      number_of_steals_(0),
+      run_id_(0),
+      busy_threads_(0),
+      stop_(false) {
+  number_of_threads = max<size_t>(1, number_of_threads);
+
+  for (size_t idx = 0; idx < number_of_threads; idx++) {
+    queues_.emplace_back(new TaskQueue());
+    queues_.back()->front = queues_.back()->back = 0;
+  }
+
+  // Thread 0 is the one that calls Run()
+  for (size_t worker_id = 1; worker_id < number_of_threads; worker_id++) {
+    threads_.emplace_back(&WorkStealingPool::WorkerLoop, this, worker_id);
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    stop_ = true;
+  }
+  run_started_.notify_all();
+
+  for (auto& thread : threads_) thread.join();
+}
+
+//------------------------------------------------------------------------
+// 2. GENERAL USER INTERFACE
+//------------------------------------------------------------------------
+void WorkStealingPool::Run(const TaskGraph& tasks,
+                           const function<void(size_t)>& execute) {
+  const size_t number_of_tasks = tasks.number_of_dependencies.size();
+  assert(tasks.successors.size() == number_of_tasks);
+  if (number_of_tasks == 0) return;
+
+  // 1. Fresh counters and empty queues (only allocated when the graph
+  //    grows)
+  if (number_of_tasks > capacity_) {
+    capacity_ = number_of_tasks;
+    pending_dependencies_.reset(new atomic<size_t>[capacity_]);
+    for (auto& queue : queues_) queue->tasks.resize(capacity_);
+  }
+  for (size_t task = 0; task < number_of_tasks; task++) {
+    pending_dependencies_[task].store(tasks.number_of_dependencies[task],
+                                      memory_order_relaxed);
+  }
+  for (auto& queue : queues_) queue->front = queue->back = 0;
+
+  // 2. Deal the tasks that are ready straight away between the threads
+  size_t worker_id = 0;
+  for (size_t task = 0; task < number_of_tasks; task++) {
+    if (tasks.number_of_dependencies[task] == 0) {
+      Push(worker_id, task);
+      worker_id = (worker_id + 1) % queues_.size();
+    }
+  }
+
+  // 3. Start the threads and join in
+  {
+    lock_guard<mutex> lock(mutex_);
+    tasks_ = &tasks;
+    execute_ = &execute;
+    remaining_tasks_.store(number_of_tasks, memory_order_release);
+    busy_threads_ = threads_.size();
+    run_id_++;
+  }
+  run_started_.notify_all();
+
+  RunTasks(0);
+
+  // 4. Nothing may refer to this run once it's over
+  unique_lock<mutex> lock(mutex_);
+  run_finished_.wait(lock, [this] { return busy_threads_ == 0; });
+  tasks_ = nullptr;
+  execute_ = nullptr;
+}
+
+//------------------------------------------------------------------------
+// 4. PRIVATE METHODS
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
+//  NAME:
+//      WorkerLoop()
+//
+//  DESCRIPTION:
+//      The body of every thread but the caller's. Sleeps until a run
+//      starts, takes part in it and reports back once it's over.
+//  INPUT:
+//      worker_id - the index of the thread (and of its queue)
+//  OUTPUT:
+//      None
+//------------------------------------------------------------------------
+void WorkStealingPool::WorkerLoop(size_t worker_id) {
+  uint64_t last_run_id = 0;
+  unique_lock<mutex> lock(mutex_);
+
+  while (true) {
+    run_started_.wait(lock,
+                      [&] { return stop_ || (run_id_ != last_run_id); });
+    if (stop_) break;
+    last_run_id = run_id_;
+
+    lock.unlock();
+    RunTasks(worker_id);
+    lock.lock();
+
+    if (--busy_threads_ == 0) run_finished_.notify_one();
+  }
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      RunTasks()
+//
+//  DESCRIPTION:
+//      Runs ready tasks - its own first, then stolen ones - until all
+//      the tasks of the run have finished. The tasks made ready by a
+//      finished task are queued before the task is counted as finished,
+//      so there's always a task queued or running until the very end.
+//  INPUT:
+//      worker_id - the index of the thread
+//  OUTPUT:
+//      None
+//------------------------------------------------------------------------
+void WorkStealingPool::RunTasks(size_t worker_id) {
+  size_t task;
+
+  while (remaining_tasks_.load(memory_order_acquire) > 0) {
+    if (!Pop(worker_id, task) && !Steal(worker_id, task)) {
+      this_thread::yield();
+      continue;
+    }
+
+    (*execute_)(task);
+
+    for (size_t successor : tasks_->successors[task]) {
+      if (pending_dependencies_[successor].fetch_sub(
+              1, memory_order_acq_rel) == 1) {
+        Push(worker_id, successor);
+      }
+    }
+    remaining_tasks_.fetch_sub(1, memory_order_acq_rel);
+  }
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      Push(), Pop(), Steal()
+//
+//  DESCRIPTION:
+//      Queue a ready task at the back of the given thread's queue, take
+//      the newest task from the back of it, and take the oldest task
+//      from the front of another thread's queue, respectively.
+//  INPUT:
+//      worker_id - the index of the thread
+//      task      - the task (output for Pop() and Steal())
+//  OUTPUT:
+//      Pop() and Steal(): true if a task was taken.
+//------------------------------------------------------------------------
+void WorkStealingPool::Push(size_t worker_id, size_t task) {
+  TaskQueue& queue = *queues_[worker_id];
+  lock_guard<mutex> lock(queue.mutex);
+
+  queue.tasks[queue.back++] = task;
+}
+
+bool WorkStealingPool::Pop(size_t worker_id, size_t& task) {
+  TaskQueue& queue = *queues_[worker_id];
+  lock_guard<mutex> lock(queue.mutex);
+
+  if (queue.front == queue.back) return false;
+  task = queue.tasks[--queue.back];
+  return true;
+}
+
+bool WorkStealingPool::Steal(size_t worker_id, size_t& task) {
+  for (size_t offset = 1; offset < queues_.size(); offset++) {
+    TaskQueue& queue = *queues_[(worker_id + offset) % queues_.size()];
+    lock_guard<mutex> lock(queue.mutex);
+
+    if (queue.front != queue.back) {
+      task = queue.tasks[queue.front++];
+      number_of_steals_++;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+//========================================================================
+// End of file
+//========================================================================
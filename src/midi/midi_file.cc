@@ -0,0 +1,316 @@
+//========================================================================
+// FILE:
+//      src/midi/midi_file.cc
+//
+// AUTHOR:
+//      zimzum@github
+//
+// DESCRIPTION:
+//      Implements the MidiFile class.
+//
+//  License: GNU GPL v2.0
+//========================================================================
+
+#include <midi/midi_file.h>
+
+#include <algorithm>
+#include <iterator>
+
+using namespace std;
+
+//========================================================================
+// UTILITIES
+//========================================================================
+//------------------------------------------------------------------------
+//  NAME:
+//      ReadBigEndian
+//
+//  DESCRIPTION:
+//      Reads an unsigned big-endian number of the given size (at most 4
+//      bytes). All the numbers in MIDI files are big-endian.
+//------------------------------------------------------------------------
+static uint32_t ReadBigEndian(const uint8_t* data, size_t number_of_bytes) {
+  uint32_t value = 0;
+  for (size_t idx = 0; idx < number_of_bytes; idx++) {
+    value = (value << 8) | data[idx];
+  }
+
+  return value;
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      ReadVariableLength
+//
+//  DESCRIPTION:
+//      Reads a variable-length quantity: 7 bits per byte, most
+//      significant first, the top bit set on all the bytes but the last
+//      one. At most 4 bytes. Returns false if it runs past the end.
+//------------------------------------------------------------------------
+static bool ReadVariableLength(const uint8_t* data, size_t size,
+                               size_t& position, uint32_t& value) {
+  value = 0;
+  for (size_t idx = 0; idx < 4; idx++) {
+    if (position >= size) return false;
+
+    uint8_t byte = data[position++];
+    value = (value << 7) | (byte & 0x7F);
+    if ((byte & 0x80) == 0) return true;
+  }
+
+  return false;
+}
+
+//========================================================================
+// CLASS: MidiFile
+//========================================================================
+//------------------------------------------------------------------------
+// 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+//------------------------------------------------------------------------
+MidiFile::MidiFile()
+    : duration_(0.0), ticks_per_quarter_note_(0), ticks_per_second_(0.0) {}
+
+//------------------------------------------------------------------------
+// 2. GENERAL USER INTERFACE
+//------------------------------------------------------------------------
+bool MidiFile::Parse(const uint8_t* data, size_t size) {
+  Clear();
+
+  // 1. The header chunk: the format, the number of tracks and the time
+  //    division
+  if ((size < 14) || (ReadBigEndian(data, 4) != kMidiHeaderChunkId)) {
+    return false;
+  }
+  uint32_t header_size = ReadBigEndian(data + 4, 4);
+  if ((header_size < 6) || (header_size > size - 8)) return false;
+
+  uint16_t format = ReadBigEndian(data + 8, 2);
+  uint16_t number_of_tracks = ReadBigEndian(data + 10, 2);
+  uint16_t division = ReadBigEndian(data + 12, 2);
+  if ((format > 1) || ((format == 0) && (number_of_tracks != 1))) {
+    return false;
+  }
+
+  if (division & 0x8000) {
+    // SMPTE: frames per second (negative) and ticks per frame. 29 stands
+    // for 29.97 (drop frame).
+    int frames_per_second = -static_cast<int8_t>(division >> 8);
+    double frame_rate = (frames_per_second == 29) ? 29.97 : frames_per_second;
+    ticks_per_second_ = frame_rate * (division & 0xFF);
+    if (ticks_per_second_ <= 0.0) return false;
+  } else {
+    ticks_per_quarter_note_ = division;
+    if (ticks_per_quarter_note_ == 0) return false;
+  }
+
+  // 2. The track chunks (chunks of other types are skipped)
+  vector<vector<TimedEvent>> timed_tracks;
+  vector<TempoChange> tempo_changes;
+  uint64_t end_tick = 0;
+
+  size_t position = 8 + header_size;
+  while ((timed_tracks.size() < number_of_tracks) && (position + 8 <= size)) {
+    uint32_t chunk_id = ReadBigEndian(data + position, 4);
+    uint32_t chunk_size = ReadBigEndian(data + position + 4, 4);
+    position += 8;
+    if (chunk_size > size - position) return false;
+
+    if (chunk_id == kMidiTrackChunkId) {
+      timed_tracks.emplace_back();
+      uint64_t track_end_tick = 0;
+      if (!ParseTrack(data + position, chunk_size, timed_tracks.back(),
+                      track_end_tick, tempo_changes)) {
+        return false;
+      }
+      end_tick = max(end_tick, track_end_tick);
+    }
+    position += chunk_size;
+  }
+  if (timed_tracks.size() != number_of_tracks) return false;
+
+  // 3. Ticks to seconds. The time of every tempo change is computed
+  //    once, in order, from the previous one. SMPTE files have no tempo.
+  if (ticks_per_quarter_note_ == 0) tempo_changes.clear();
+  stable_sort(tempo_changes.begin(), tempo_changes.end(),
+              [](const TempoChange& lhs, const TempoChange& rhs) {
+                return lhs.tick < rhs.tick;
+              });
+
+  vector<double> change_times;
+  double time = 0.0;
+  uint64_t tick = 0;
+  uint32_t tempo = kMidiDefaultTempo;
+  for (const TempoChange& change : tempo_changes) {
+    time += (change.tick - tick) * (tempo * 1e-6) / ticks_per_quarter_note_;
+    change_times.push_back(time);
+    tick = change.tick;
+    tempo = change.microseconds_per_quarter_note;
+  }
+
+  for (const auto& timed_track : timed_tracks) {
+    tracks_.emplace_back();
+    for (const TimedEvent& timed_event : timed_track) {
+      tracks_.back().push_back(timed_event.event);
+      tracks_.back().back().time =
+          TicksToSeconds(timed_event.tick, tempo_changes, change_times);
+    }
+  }
+  duration_ = TicksToSeconds(end_tick, tempo_changes, change_times);
+
+  return true;
+}
+
+bool MidiFile::Load(const string& file_name) {
+  Clear();
+
+  ifstream file(file_name, ios::binary);
+  if (!file) return false;
+  vector<uint8_t> data((istreambuf_iterator<char>(file)),
+                       istreambuf_iterator<char>());
+
+  return Parse(data.data(), data.size());
+}
+
+//------------------------------------------------------------------------
+// 4. PRIVATE METHODS
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
+//  NAME:
+//      ParseTrack()
+//
+//  DESCRIPTION:
+//      Reads the notes and the tempo changes of one track chunk. Handles
+//      running status (channel messages without a status byte repeat
+//      the previous one). The track ends with the End of Track meta
+//      event or with the chunk.
+//  INPUT:
+//      data          - the contents of the chunk
+//      size          - the size of the chunk
+//      events        - the notes of the track (output)
+//      end_tick      - the time of the end of the track (output)
+//      tempo_changes - the tempo changes are appended here
+//  OUTPUT:
+//      True on success, false if the track is invalid.
+//------------------------------------------------------------------------
+bool MidiFile::ParseTrack(const uint8_t* data, size_t size,
+                          vector<TimedEvent>& events, uint64_t& end_tick,
+                          vector<TempoChange>& tempo_changes) const {
+  uint64_t tick = 0;
+  uint8_t running_status = 0;
+  size_t position = 0;
+
+  while (position < size) {
+    uint32_t delta_time;
+    if (!ReadVariableLength(data, size, position, delta_time)) return false;
+    tick += delta_time;
+    if (position >= size) return false;
+
+    uint8_t status = running_status;
+    if (data[position] & 0x80) status = data[position++];
+    if (status == 0) return false;
+
+    // Meta events and SysEx
+    if ((status == 0xFF) || (status == 0xF0) || (status == 0xF7)) {
+      running_status = 0;
+      uint8_t type = 0;
+      if (status == 0xFF) {
+        if (position >= size) return false;
+        type = data[position++];
+      }
+
+      uint32_t length;
+      if (!ReadVariableLength(data, size, position, length) ||
+          (length > size - position)) {
+        return false;
+      }
+
+      if ((status == 0xFF) && (type == kMidiSetTempoType) && (length == 3)) {
+        tempo_changes.push_back({tick, ReadBigEndian(data + position, 3)});
+      }
+      position += length;
+
+      if ((status == 0xFF) && (type == kMidiEndOfTrackType)) break;
+      continue;
+    }
+
+    // Channel messages: 1 data byte for program change and channel
+    // pressure, 2 for the rest
+    if (status >= 0xF0) return false;
+    running_status = status;
+
+    uint8_t message = status & 0xF0;
+    size_t number_of_data_bytes =
+        ((message == 0xC0) || (message == 0xD0)) ? 1 : 2;
+    if (number_of_data_bytes > size - position) return false;
+    for (size_t idx = 0; idx < number_of_data_bytes; idx++) {
+      if (data[position + idx] & 0x80) return false;
+    }
+
+    if ((message == 0x80) || (message == 0x90)) {
+      TimedEvent timed_event;
+      timed_event.tick = tick;
+      timed_event.event.time = 0.0;
+      timed_event.event.channel = status & 0x0F;
+      timed_event.event.key = data[position];
+      timed_event.event.velocity = data[position + 1];
+      timed_event.event.note_on =
+          (message == 0x90) && (timed_event.event.velocity > 0);
+      events.push_back(timed_event);
+    }
+    position += number_of_data_bytes;
+  }
+
+  end_tick = tick;
+  return true;
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      TicksToSeconds()
+//
+//  DESCRIPTION:
+//      Converts a time in ticks to seconds: the time of the last tempo
+//      change before it plus the remaining ticks at that tempo (the
+//      default tempo before the first change).
+//  INPUT:
+//      tick          - the time in ticks
+//      tempo_changes - the tempo changes, in order
+//      change_times  - the times of the tempo changes in seconds
+//  OUTPUT:
+//      The time in seconds.
+//------------------------------------------------------------------------
+double MidiFile::TicksToSeconds(uint64_t tick,
+                                const vector<TempoChange>& tempo_changes,
+                                const vector<double>& change_times) const {
+  if (ticks_per_quarter_note_ == 0) return tick / ticks_per_second_;
+
+  auto next_change =
+      upper_bound(tempo_changes.begin(), tempo_changes.end(), tick,
+                  [](uint64_t value, const TempoChange& change) {
+                    return value < change.tick;
+                  });
+
+  double start_time = 0.0;
+  uint64_t start_tick = 0;
+  uint32_t tempo = kMidiDefaultTempo;
+  if (next_change != tempo_changes.begin()) {
+    size_t change = distance(tempo_changes.begin(), next_change) - 1;
+    start_time = change_times[change];
+    start_tick = tempo_changes[change].tick;
+    tempo = tempo_changes[change].microseconds_per_quarter_note;
+  }
+
+  return start_time + (tick - start_tick) * (tempo * 1e-6) /
+                          ticks_per_quarter_note_;
+}
+
+void MidiFile::Clear() {
+  tracks_.clear();
+  duration_ = 0.0;
+  ticks_per_quarter_note_ = 0;
+  ticks_per_second_ = 0.0;
+}
+
+//========================================================================
+// End of file
+//========================================================================
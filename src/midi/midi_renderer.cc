@@ -0,0 +1,184 @@
+//========================================================================
+// FILE:
+//      src/midi/midi_renderer.cc
+//
+// AUTHOR:
+//      zimzum@github
+//
+// DESCRIPTION:
+//      Implements the MidiRenderer class.
+//
+//  License: GNU GPL v2.0
+//========================================================================
+
+#include <midi/midi_renderer.h>
+
+#include <graph/processing_graph.h>
+#include <graph/processor_nodes.h>
+
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+
+//========================================================================
+// UTILITIES
+//========================================================================
+// An event of any part, at the sample at which it happens
+struct ScheduledEvent {
+  uint64_t sample;
+  VoiceManager* voices;
+  const MidiNoteEvent* event;
+};
+
+//------------------------------------------------------------------------
+//  NAME:
+//      PlayEvent
+//
+//  DESCRIPTION:
+//      Passes a note event to the voices of its part. MIDI notes below
+//      the frequency table are ignored.
+//------------------------------------------------------------------------
+static void PlayEvent(const ScheduledEvent& scheduled) {
+  const MidiNoteEvent& event = *scheduled.event;
+  if (event.key < kMidiNoteOfFirstPitch) return;
+
+  size_t pitch_id = event.key - kMidiNoteOfFirstPitch;
+  if (event.note_on) {
+    scheduled.voices->NoteOn(pitch_id, event.velocity / 127.0f);
+  } else {
+    scheduled.voices->NoteOff(pitch_id);
+  }
+}
+
+//========================================================================
+// CLASS: MidiRenderer
+//========================================================================
+//------------------------------------------------------------------------
+// 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+//------------------------------------------------------------------------
+MidiRenderer::MidiRenderer(const SynthConfig& synthesiser,
+                           const VoiceParameters& parameters,
+                           size_t number_of_threads, size_t number_of_voices)
+    : synthesiser_(synthesiser),
+      parameters_(parameters),
+      number_of_threads_(number_of_threads),
+      number_of_voices_(number_of_voices),
+      metrics_() {}
+
+//------------------------------------------------------------------------
+// 2. GENERAL USER INTERFACE
+//------------------------------------------------------------------------
+void MidiRenderer::Render(
+    const MidiFile& file,
+    const function<void(const float*, size_t)>& consume) {
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  const double sampling_rate = synthesiser_.sampling_rate();
+  metrics_ = MidiRenderMetrics();
+
+  // 1. A voice pool for every part, i.e. every channel of every track
+  //    with notes, so that notes on different channels never cut each
+  //    other off. Then the events of all the parts in the order in
+  //    which they happen (ties are kept in the order of the tracks).
+  vector<unique_ptr<VoiceManager>> voices;
+  vector<ScheduledEvent> events;
+  for (size_t track_id = 0; track_id < file.number_of_tracks(); track_id++) {
+    const vector<MidiNoteEvent>& track = file.track(track_id);
+    if (track.empty()) continue;
+
+    vector<bool> channel_used(kMidiNumberOfChannels, false);
+    for (const MidiNoteEvent& event : track) {
+      channel_used[event.channel] = true;
+    }
+
+    vector<VoiceManager*> channel_voices(kMidiNumberOfChannels, nullptr);
+    for (size_t channel = 0; channel < kMidiNumberOfChannels; channel++) {
+      if (!channel_used[channel]) continue;
+      voices.emplace_back(
+          new VoiceManager(synthesiser_, parameters_, number_of_voices_));
+      channel_voices[channel] = voices.back().get();
+    }
+
+    for (const MidiNoteEvent& event : track) {
+      uint64_t sample = llround(event.time * sampling_rate);
+      events.push_back({sample, channel_voices[event.channel], &event});
+      if (event.note_on) metrics_.number_of_notes++;
+    }
+  }
+  stable_sort(events.begin(), events.end(),
+              [](const ScheduledEvent& lhs, const ScheduledEvent& rhs) {
+                return lhs.sample < rhs.sample;
+              });
+  metrics_.number_of_parts = voices.size();
+
+  // 2. The graph: the parts, mixed into the output
+  if (!voices.empty()) {
+    ProcessingGraph graph(kGraphBlockSize, number_of_threads_);
+    size_t mixer = graph.AddNode(unique_ptr<ProcessorNode>(
+        new MixerNode(vector<float>(voices.size(), 1.0f))));
+    for (size_t part = 0; part < voices.size(); part++) {
+      size_t voice_node = graph.AddNode(
+          unique_ptr<ProcessorNode>(new VoiceNode(*voices[part])));
+      graph.Connect(voice_node, mixer, part);
+    }
+    size_t sink = graph.AddNode(unique_ptr<ProcessorNode>(
+        new SinkNode([&](const float* block, size_t length) {
+          consume(block, length);
+          metrics_.number_of_samples += length;
+        })));
+    graph.Connect(mixer, sink);
+    bool compiled = graph.Compile();
+    assert(compiled && "The graph of the parts is always valid!");
+    (void)compiled;
+
+    // 3. Up to every event, then the event
+    uint64_t position = 0;
+    for (size_t idx = 0; idx < events.size();) {
+      uint64_t sample = events[idx].sample;
+      graph.Process(sample - position);
+      position = sample;
+
+      for (; (idx < events.size()) && (events[idx].sample == sample); idx++) {
+        PlayEvent(events[idx]);
+      }
+    }
+
+    // 4. Up to the end of the file, then the releases of the notes that
+    //    are still held
+    uint64_t end = llround(file.duration() * sampling_rate);
+    if (end > position) graph.Process(end - position);
+    for (auto& part_voices : voices) part_voices->AllNotesOff();
+    graph.Process(ceil(parameters_.release_duration * sampling_rate));
+  }
+
+  metrics_.rendered_duration = metrics_.number_of_samples / sampling_rate;
+  metrics_.elapsed_time_ns = chrono::duration_cast<chrono::nanoseconds>(
+                                 chrono::steady_clock::now() - start)
+                                 .count();
+}
+
+bool MidiRenderer::RenderToFile(const MidiFile& file,
+                                const string& file_name) {
+  WaveFileStreamOut wave_file(kNumberOfChannelsMono, SampleFormat::kPcm16,
+                              synthesiser_.sampling_rate());
+  if (!wave_file.Open(file_name)) return false;
+
+  bool succeeded = true;
+  Render(file, [&](const float* block, size_t length) {
+    succeeded = wave_file.Append(block, length) && succeeded;
+  });
+
+  return wave_file.Close() && succeeded;
+}
+
+//------------------------------------------------------------------------
+// 3. ACCESSORS
+//------------------------------------------------------------------------
+double MidiRenderer::real_time_factor() const {
+  if (metrics_.rendered_duration == 0.0) return 0.0;
+  return metrics_.elapsed_time_ns * 1e-9 / metrics_.rendered_duration;
+}
+
+//========================================================================
+// End of file
+//========================================================================
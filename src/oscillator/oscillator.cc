@@ -33,9 +33,8 @@ Oscillator::Oscillator(const SynthConfig& synthesiser,
   assert((initial_phase_arg >= 0) && (initial_phase_arg <= kTwoPi));
   assert((pitch_id_arg >= 0) && (pitch_id_arg <= kNumberOfFrequencies));
 
-  /* Calculate phase increment. Make sure it falls into the [0, kPi) range. */
-  phase_increment_ = synthesiser.phase_increment_per_sample() * frequency_;
-  phase_increment_ = fmod(phase_increment_, kPi);
+  /* The phase increment for every pitch is pre-calculated by SynthConfig */
+  phase_increment_ = synthesiser.phase_increment_table(pitch_id_arg);
 }
 
 Oscillator::Oscillator(const SynthConfig& synthesiser,
@@ -62,10 +61,17 @@ Oscillator::~Oscillator() = default;
 // 2. GENERAL USER INTERFACE
 //------------------------------------------------------------------------
 vector<int16_t> Oscillator::operator()(uint32_t number_of_seconds) {
-  size_t number_of_samples = (sampling_rate_ * number_of_seconds);
+  vector<int16_t> samples(sampling_rate_ * number_of_seconds);
 
-  return GenWaveform(number_of_samples, peak_amplitude_, initial_phase_,
-                     phase_increment_);
+  GenWaveform(samples.data(), samples.size(), peak_amplitude_, initial_phase_,
+              phase_increment_);
+
+  return samples;
+}
+
+void Oscillator::operator()(int16_t* samples, size_t number_of_samples) {
+  GenWaveform(samples, number_of_samples, peak_amplitude_, initial_phase_,
+              phase_increment_);
 }
 
 //========================================================================
@@ -95,6 +101,7 @@ SineWaveform::SineWaveform(const SynthConfig& synthesiser,
 //      Function that implements the waveform generation and which is
 //      used by Oscillator::operator().
 //  INPUT:
+//      samples             - the output buffer, number_of_samples long
 //      number_of_samples   - number of samples in the waveform
 //                            (TODO!!! min and max value)
 //      peak_amplitude      - peak amplitude of the waveform
@@ -105,23 +112,18 @@ SineWaveform::SineWaveform(const SynthConfig& synthesiser,
 //                            kTwoPi/sampling_rate * frequency
 //                            (range: [-kPi, kPi))
 //  RETURN:
-//      Vector of samples for the requested waveform
+//      None
 //------------------------------------------------------------------------
-std::vector<int16_t> SineWaveform::GenWaveform(size_t number_of_samples,
-                                               int16_t peak_amplitude,
-                                               double initial_phase,
-                                               double phase_increment) const {
+void SineWaveform::GenWaveform(int16_t* samples, size_t number_of_samples,
+                               int16_t peak_amplitude, double initial_phase,
+                               double phase_increment) const {
   double phase = initial_phase;
 
-  vector<int16_t> samples(number_of_samples);
-
-  for (auto& it : samples) {
-    it = static_cast<int16_t>(peak_amplitude * sin(phase));
+  for (int16_t* it = samples; it != samples + number_of_samples; it++) {
+    *it = static_cast<int16_t>(peak_amplitude * sin(phase));
 
     if ((phase += phase_increment) >= kTwoPi) phase -= kTwoPi;
   }
-
-  return samples;
 }
 
 //========================================================================
@@ -151,6 +153,7 @@ SawtoothWaveform::SawtoothWaveform(const SynthConfig& synthesiser,
 //      Function that implements the waveform generation and which is
 //      used by Oscillator::operator().
 //  INPUT:
+//      samples             - the output buffer, number_of_samples long
 //      number_of_samples   - number of samples in the waveform
 //                            (TODO!!! min and max value)
 //      peak_amplitude      - peak amplitude of the waveform
@@ -161,26 +164,22 @@ SawtoothWaveform::SawtoothWaveform(const SynthConfig& synthesiser,
 //                            kTwoPi/sampling_rate * frequency
 //                            (range: [-kPi, kPi))
 //  RETURN:
-//      Vector of samples for the requested waveform
+//      None
 //--------------------------------------------------------------------
-std::vector<int16_t> SawtoothWaveform::GenWaveform(
-    size_t number_of_samples, int16_t peak_amplitude, double initial_phase,
-    double phase_increment) const {
+void SawtoothWaveform::GenWaveform(int16_t* samples, size_t number_of_samples,
+                                   int16_t peak_amplitude, double initial_phase,
+                                   double phase_increment) const {
   // saw_tooth_value is a floating point in the [-1, 1] range.
   // (For consistency with sin()).
   double saw_tooth_value = initial_phase / kTwoPi;
   // saw_tooth_increment is a floating point in the [-1, 1] range.
   double saw_tooth_increment = phase_increment / kPi;
 
-  vector<int16_t> samples(number_of_samples);
-
-  for (auto& it : samples) {
-    it = static_cast<int16_t>(peak_amplitude * saw_tooth_value);
+  for (int16_t* it = samples; it != samples + number_of_samples; it++) {
+    *it = static_cast<int16_t>(peak_amplitude * saw_tooth_value);
 
     if ((saw_tooth_value += saw_tooth_increment) >= 1) saw_tooth_value -= 2;
   }
-
-  return samples;
 }
 
 //========================================================================
@@ -210,6 +209,7 @@ SquareWaveform::SquareWaveform(const SynthConfig& synthesiser,
 //      Function that implements the waveform generation and which is
 //      used by Oscillator::operator().
 //  INPUT:
+//      samples             - the output buffer, number_of_samples long
 //      number_of_samples   - number of samples in the waveform
 //                            (TODO!!! min and max value)
 //      peak_amplitude      - peak amplitude of the waveform
@@ -220,25 +220,20 @@ SquareWaveform::SquareWaveform(const SynthConfig& synthesiser,
 //                            kTwoPi/sampling_rate * frequency
 //                            (range: [-kPi, kPi))
 //  RETURN:
-//      Vector of samples for the requested waveform
+//      None
 //--------------------------------------------------------------------
-std::vector<int16_t> SquareWaveform::GenWaveform(size_t number_of_samples,
-                                                 int16_t peak_amplitude,
-                                                 double initial_phase,
-                                                 double phase_increment) const {
+void SquareWaveform::GenWaveform(int16_t* samples, size_t number_of_samples,
+                                 int16_t peak_amplitude, double initial_phase,
+                                 double phase_increment) const {
   double phase = initial_phase;
   double value = 0;
 
-  vector<int16_t> samples(number_of_samples);
-
-  for (auto& it : samples) {
+  for (int16_t* it = samples; it != samples + number_of_samples; it++) {
     value = phase > kPi ? 1.0 : -1.0;
-    it = static_cast<int16_t>(peak_amplitude * value);
+    *it = static_cast<int16_t>(peak_amplitude * value);
 
     if ((phase += phase_increment) >= kTwoPi) phase -= kTwoPi;
   }
-
-  return samples;
 }
 
 //========================================================================
@@ -268,6 +263,7 @@ TriangleWaveform::TriangleWaveform(const SynthConfig& synthesiser,
 //      Function that implements the waveform generation and which is
 //      used by Oscillator::operator().
 //  INPUT:
+//      samples             - the output buffer, number_of_samples long
 //      number_of_samples   - number of samples in the waveform
 //                            (TODO!!! min and max value)
 //      peak_amplitude      - peak amplitude of the waveform
@@ -278,20 +274,18 @@ TriangleWaveform::TriangleWaveform(const SynthConfig& synthesiser,
 //                            kTwoPi/sampling_rate * frequency
 //                            (range: [-kPi, kPi))
 //  RETURN:
-//      Vector of samples for the requested waveform
+//      None
 //--------------------------------------------------------------------
-std::vector<int16_t> TriangleWaveform::GenWaveform(
-    size_t number_of_samples, int16_t peak_amplitude, double initial_phase,
-    double phase_increment) const {
+void TriangleWaveform::GenWaveform(int16_t* samples, size_t number_of_samples,
+                                   int16_t peak_amplitude, double initial_phase,
+                                   double phase_increment) const {
   const double one_div_pi = 1.0 / kPi;
   double triangle_wave_value;
   double phase = initial_phase;
 
-  vector<int16_t> samples(number_of_samples);
-
-  for (auto& it : samples) {
+  for (int16_t* it = samples; it != samples + number_of_samples; it++) {
     triangle_wave_value = 1.0 - one_div_pi * fabs(phase - kTwoPi);
-    it = static_cast<int16_t>(peak_amplitude * triangle_wave_value);
+    *it = static_cast<int16_t>(peak_amplitude * triangle_wave_value);
 
     phase = phase + phase_increment;
 
@@ -300,8 +294,6 @@ std::vector<int16_t> TriangleWaveform::GenWaveform(
       phase_increment = -phase_increment;
     }
   }
-
-  return samples;
 }
 
 //========================================================================
@@ -0,0 +1,383 @@
+//========================================================================
+// FILE:
+//      src/voice/voice_manager.cc
+//
+// AUTHOR:
+//      zimzum@github
+//
+// DESCRIPTION:
+//      Implements the VoiceManager class.
+//
+//  License: GNU GPL v2.0
+//========================================================================
+
+#include <voice/voice_manager.h>
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+//========================================================================
+// CLASS: VoiceManager
+//========================================================================
+//------------------------------------------------------------------------
+// 1. CONSTRUCTORS/DESTRUCTOR/ASSIGNMENT OPERATORS
+//------------------------------------------------------------------------
+VoiceManager::VoiceManager(const SynthConfig& synthesiser,
+                           const VoiceParameters& parameters,
+                           size_t number_of_voices)
+    : synthesiser_(synthesiser),
+      parameters_(parameters),
+      attack_samples_(static_cast<size_t>(synthesiser.sampling_rate() *
+                                          parameters.attack_duration)),
+      decay_samples_(static_cast<size_t>(synthesiser.sampling_rate() *
+                                         parameters.decay_duration)),
+      release_samples_(static_cast<size_t>(synthesiser.sampling_rate() *
+                                           parameters.release_duration)),
+      voices_(number_of_voices),
+      held_voices_(kNumberOfFrequencies, number_of_voices),
+      number_of_stolen_(0) {
+  assert(number_of_voices > 0);
+  assert((parameters_.amplitude >= 0) && (parameters_.amplitude <= 1));
+  assert((parameters_.sustain_level >= 0) &&
+         (parameters_.sustain_level <= 1));
+  assert((parameters_.attack_duration >= 0) &&
+         (parameters_.decay_duration >= 0) &&
+         (parameters_.release_duration >= 0));
+
+  // All the voices start idle
+  for (auto& list : lists_) {
+    list.head = list.tail = voices_.size();
+    list.size = 0;
+  }
+  for (size_t voice_id = 0; voice_id < voices_.size(); voice_id++) {
+    voices_[voice_id].stage = EnvelopeStage::kOff;
+    voices_[voice_id].list = kNumberOfLists;
+    MoveVoice(voice_id, kIdle);
+  }
+}
+
+VoiceManager::~VoiceManager() = default;
+
+//------------------------------------------------------------------------
+// 2. GENERAL USER INTERFACE
+//------------------------------------------------------------------------
+void VoiceManager::NoteOn(size_t pitch_id, float velocity) {
+  assert(pitch_id < kNumberOfFrequencies);
+  assert((velocity >= 0) && (velocity <= 1));
+
+  if (held_voices_[pitch_id] != voices_.size()) {
+    ReleaseVoice(held_voices_[pitch_id]);
+  }
+
+  size_t voice_id = TakeVoice();
+  Voice& voice = voices_[voice_id];
+
+  voice.pitch_id = pitch_id;
+  voice.gain = parameters_.amplitude * velocity;
+  voice.phase = 0.0;
+  voice.phase_increment = synthesiser_.phase_increment_table(pitch_id);
+  voice.modulator_phase = 0.0;
+  voice.modulator_phase_increment =
+      fmod(voice.phase_increment * parameters_.modulator_ratio, kTwoPi);
+  voice.level = 0.0f;
+  StartStage(voice, EnvelopeStage::kAttack);
+
+  held_voices_[pitch_id] = voice_id;
+  MoveVoice(voice_id, kHeld);
+}
+
+void VoiceManager::NoteOff(size_t pitch_id) {
+  assert(pitch_id < kNumberOfFrequencies);
+
+  if (held_voices_[pitch_id] != voices_.size()) {
+    ReleaseVoice(held_voices_[pitch_id]);
+  }
+}
+
+void VoiceManager::AllNotesOff() {
+  while (lists_[kHeld].size > 0) ReleaseVoice(lists_[kHeld].head);
+}
+
+void VoiceManager::Render(float* samples, size_t number_of_samples) {
+  fill(samples, samples + number_of_samples, 0.0f);
+
+  // A voice that finishes moves to the idle list, so the next one is
+  // looked up first
+  for (VoiceList list : {kHeld, kReleased}) {
+    for (size_t voice_id = lists_[list].head; voice_id != voices_.size();) {
+      size_t next = voices_[voice_id].next;
+      RenderVoice(voice_id, samples, number_of_samples);
+      voice_id = next;
+    }
+  }
+}
+
+//------------------------------------------------------------------------
+// 3. ACCESSORS
+//------------------------------------------------------------------------
+size_t VoiceManager::number_of_active_voices() const {
+  return lists_[kHeld].size + lists_[kReleased].size;
+}
+
+//------------------------------------------------------------------------
+// 4. PRIVATE METHODS
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
+//  NAME:
+//      TakeVoice()
+//
+//  DESCRIPTION:
+//      Picks the voice for a new note: an idle one if there is one,
+//      otherwise the voice released the longest ago, otherwise the
+//      oldest held one. The voice stays on its list.
+//  INPUT:
+//      None
+//  OUTPUT:
+//      The index of the voice.
+//------------------------------------------------------------------------
+size_t VoiceManager::TakeVoice() {
+  if (lists_[kIdle].size > 0) return lists_[kIdle].head;
+
+  number_of_stolen_++;
+  if (lists_[kReleased].size > 0) return lists_[kReleased].head;
+
+  size_t voice_id = lists_[kHeld].head;
+  held_voices_[voices_[voice_id].pitch_id] = voices_.size();
+  return voice_id;
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      MoveVoice()
+//
+//  DESCRIPTION:
+//      Unlinks the voice from its list and appends it to the given one.
+//  INPUT:
+//      voice_id - the index of the voice
+//      list     - the list to move the voice to
+//  OUTPUT:
+//      None
+//------------------------------------------------------------------------
+void VoiceManager::MoveVoice(size_t voice_id, VoiceList list) {
+  Voice& voice = voices_[voice_id];
+  const size_t none = voices_.size();
+
+  // 1. Unlink
+  if (voice.list != kNumberOfLists) {
+    ListEnds& old_list = lists_[voice.list];
+    if (voice.previous != none) {
+      voices_[voice.previous].next = voice.next;
+    } else {
+      old_list.head = voice.next;
+    }
+    if (voice.next != none) {
+      voices_[voice.next].previous = voice.previous;
+    } else {
+      old_list.tail = voice.previous;
+    }
+    old_list.size--;
+  }
+
+  // 2. Append
+  ListEnds& new_list = lists_[list];
+  voice.list = list;
+  voice.previous = new_list.tail;
+  voice.next = none;
+  if (new_list.tail != none) {
+    voices_[new_list.tail].next = voice_id;
+  } else {
+    new_list.head = voice_id;
+  }
+  new_list.tail = voice_id;
+  new_list.size++;
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      ReleaseVoice()
+//
+//  DESCRIPTION:
+//      Starts the release of a held voice.
+//  INPUT:
+//      voice_id - the index of the voice
+//  OUTPUT:
+//      None
+//------------------------------------------------------------------------
+void VoiceManager::ReleaseVoice(size_t voice_id) {
+  Voice& voice = voices_[voice_id];
+
+  held_voices_[voice.pitch_id] = voices_.size();
+  StartStage(voice, EnvelopeStage::kRelease);
+  MoveVoice(voice_id, (voice.stage == EnvelopeStage::kOff) ? kIdle
+                                                           : kReleased);
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      StartStage()
+//
+//  DESCRIPTION:
+//      Moves the envelope of the voice to the given stage. Every stage
+//      starts where the previous one ended (the attack at 0) and ramps
+//      linearly to its final level. Stages of zero length are skipped.
+//  INPUT:
+//      voice - the voice
+//      stage - the new stage
+//  OUTPUT:
+//      None
+//------------------------------------------------------------------------
+void VoiceManager::StartStage(Voice& voice, EnvelopeStage stage) const {
+  voice.stage = stage;
+  voice.level_increment = 0.0f;
+
+  switch (stage) {
+    case EnvelopeStage::kAttack:
+      if (attack_samples_ == 0) {
+        voice.level = 1.0f;
+        StartStage(voice, EnvelopeStage::kDecay);
+        return;
+      }
+      voice.level_increment = (1.0f - voice.level) / attack_samples_;
+      voice.stage_samples_left = attack_samples_;
+      break;
+    case EnvelopeStage::kDecay:
+      if (decay_samples_ == 0) {
+        StartStage(voice, EnvelopeStage::kSustain);
+        return;
+      }
+      voice.level_increment =
+          (parameters_.sustain_level - voice.level) / decay_samples_;
+      voice.stage_samples_left = decay_samples_;
+      break;
+    case EnvelopeStage::kSustain:
+      voice.level = parameters_.sustain_level;
+      voice.stage_samples_left = numeric_limits<size_t>::max();
+      break;
+    case EnvelopeStage::kRelease:
+      if ((release_samples_ == 0) || (voice.level <= 0.0f)) {
+        StartStage(voice, EnvelopeStage::kOff);
+        return;
+      }
+      voice.level_increment = -voice.level / release_samples_;
+      voice.stage_samples_left = release_samples_;
+      break;
+    case EnvelopeStage::kOff:
+      voice.level = 0.0f;
+      voice.stage_samples_left = 0;
+      break;
+  }
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      RenderVoice()
+//
+//  DESCRIPTION:
+//      Adds the next block of one voice to the output, one envelope
+//      stage at a time. A voice whose release has finished goes back to
+//      the idle list.
+//  INPUT:
+//      voice_id          - the index of the voice
+//      samples           - the output buffer
+//      number_of_samples - the length of the block
+//  OUTPUT:
+//      None
+//------------------------------------------------------------------------
+void VoiceManager::RenderVoice(size_t voice_id, float* samples,
+                               size_t number_of_samples) {
+  Voice& voice = voices_[voice_id];
+
+  for (size_t done = 0;
+       (done < number_of_samples) && (voice.stage != EnvelopeStage::kOff);) {
+    size_t length = min(number_of_samples - done, voice.stage_samples_left);
+
+    switch (parameters_.waveform) {
+      case Waveform::kSine:
+        RenderRun<SineShape>(voice, samples + done, length);
+        break;
+      case Waveform::kSawtooth:
+        RenderRun<SawtoothShape>(voice, samples + done, length);
+        break;
+      case Waveform::kSquare:
+        RenderRun<SquareShape>(voice, samples + done, length);
+        break;
+      case Waveform::kTriangle:
+        RenderRun<TriangleShape>(voice, samples + done, length);
+        break;
+    }
+    done += length;
+
+    // The stage has ended - land exactly on its final level
+    if ((voice.stage_samples_left -= length) == 0) {
+      switch (voice.stage) {
+        case EnvelopeStage::kAttack:
+          voice.level = 1.0f;
+          StartStage(voice, EnvelopeStage::kDecay);
+          break;
+        case EnvelopeStage::kDecay:
+          StartStage(voice, EnvelopeStage::kSustain);
+          break;
+        default:
+          StartStage(voice, EnvelopeStage::kOff);
+          break;
+      }
+    }
+  }
+
+  if (voice.stage == EnvelopeStage::kOff) MoveVoice(voice_id, kIdle);
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      RenderRun()
+//
+//  DESCRIPTION:
+//      Adds samples of one voice to the output, within one stage of the
+//      envelope (so that the level changes linearly). The waveform is a
+//      template parameter, so there's no dispatch per sample.
+//  INPUT:
+//      voice             - the voice
+//      samples           - the output buffer
+//      number_of_samples - the number of samples
+//  OUTPUT:
+//      None
+//------------------------------------------------------------------------
+template <double (*Shape)(double)>
+void VoiceManager::RenderRun(Voice& voice, float* samples,
+                             size_t number_of_samples) const {
+  const double index_of_modulation = parameters_.index_of_modulation;
+  double phase = voice.phase;
+  double modulator_phase = voice.modulator_phase;
+  float level = voice.level;
+
+  if (index_of_modulation == 0.0) {
+    for (float* it = samples; it != samples + number_of_samples; it++) {
+      *it += voice.gain * level * static_cast<float>(Shape(phase));
+
+      level += voice.level_increment;
+      if ((phase += voice.phase_increment) >= kTwoPi) phase -= kTwoPi;
+    }
+  } else {
+    for (float* it = samples; it != samples + number_of_samples; it++) {
+      double modulation = index_of_modulation * sin(modulator_phase);
+      *it += voice.gain * level *
+             static_cast<float>(Shape(WrapPhase(phase + modulation)));
+
+      level += voice.level_increment;
+      if ((phase += voice.phase_increment) >= kTwoPi) phase -= kTwoPi;
+      if ((modulator_phase += voice.modulator_phase_increment) >= kTwoPi) {
+        modulator_phase -= kTwoPi;
+      }
+    }
+  }
+
+  voice.phase = phase;
+  voice.modulator_phase = modulator_phase;
+  voice.level = level;
+}
+
+//========================================================================
+// End of file
+//========================================================================
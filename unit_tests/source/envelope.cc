@@ -18,6 +18,7 @@
 #include <envelope/envelope.h>
 #include <oscillator/oscillator.h>
 #include <cmath>
+#include <thread>
 
 using namespace std;
 
@@ -275,8 +276,7 @@ TEST(ArEnvelopeGenerationTest, HandleDifferentPitches) {
   const string file_name("test_pitch.wav");
 
   // Initialise the synthesiser
-  SynthConfig &synthesiser = SynthConfig::getInstance();
-  synthesiser.Init();
+  const SynthConfig synthesiser(kCdSampleRate);
 
   // Initialise the envelope
   ArEnvelope envelope(synthesiser, peak_amplitude, attack_duration,
@@ -317,8 +317,7 @@ TEST(ArEnvelopeGenerationTest, BasicTest) {
   const string file_name("test_pitch.wav");
 
   // Initialise the synthesiser
-  SynthConfig &synthesiser = SynthConfig::getInstance();
-  synthesiser.Init();
+  const SynthConfig synthesiser(kCdSampleRate);
 
   // Initialise the envelope
   ArEnvelope envelope(synthesiser, peak_amplitude, attack_duration,
@@ -359,8 +358,7 @@ TEST(ArEnvelopeGenerationTest, HandleDifferentOveralDuration) {
   const string file_name("test_pitch.wav");
 
   // Initialise the synthesiser
-  SynthConfig &synthesiser = SynthConfig::getInstance();
-  synthesiser.Init();
+  const SynthConfig synthesiser(kCdSampleRate);
 
   // Initialise the envelope
   ArEnvelope envelope(synthesiser, peak_amplitude, attack_duration,
@@ -406,8 +404,7 @@ TEST(ArEnvelopeGenerationTest, HandleDifferentDecayDuration) {
   const string file_name("test_pitch.wav");
 
   // Initialise the synthesiser
-  SynthConfig &synthesiser = SynthConfig::getInstance();
-  synthesiser.Init();
+  const SynthConfig synthesiser(kCdSampleRate);
 
   for (auto it = decay_duration.begin(); it != decay_duration.end(); it++) {
     // 1. Initialise the envelope
@@ -452,8 +449,7 @@ TEST(ArEnvelopeGenerationTest, HandleDifferentAttackDuration) {
   const string file_name("test_pitch.wav");
 
   // Initialise the synthesiser
-  SynthConfig &synthesiser = SynthConfig::getInstance();
-  synthesiser.Init();
+  const SynthConfig synthesiser(kCdSampleRate);
 
   for (auto it = attack_duration.begin(); it != attack_duration.end(); it++) {
     // 1. Initialise the envelope
@@ -487,6 +483,29 @@ TEST(ArEnvelopeGenerationTest, HandleDifferentAttackDuration) {
   }
 }
 
+TEST(ArEnvelopeGenerationTest, ApplyFromSeveralThreads) {
+  const SynthConfig synthesiser(kCdSampleRate);
+  ArEnvelope envelope(synthesiser, 1.0f, 0.5, 0.5);
+
+  // The segments are generated by the first ApplyEnvelope(), here by
+  // several threads at once
+  SineWaveform osc(synthesiser, 1 << 14, 0, kNumberOfFrequencies / 2);
+  const vector<int16_t> samples = osc(2);
+  vector<int16_t> expected = samples;
+  vector<vector<int16_t>> results(4, samples);
+
+  vector<thread> threads;
+  for (auto &result : results) {
+    threads.emplace_back([&envelope, &result]() {
+      envelope.ApplyEnvelope(result);
+    });
+  }
+  for (auto &worker : threads) worker.join();
+
+  envelope.ApplyEnvelope(expected);
+  for (auto &result : results) EXPECT_EQ(result, expected);
+}
+
 //------------------------------------------------------------------------
 //  ADSR envelope
 //------------------------------------------------------------------------
@@ -518,8 +537,7 @@ TEST(AdsrEnvelopeGenerationTest, HandleDifferentSustainLevels) {
   //       is equivalent to setting the sustain segment level.
 
   // Initialise the synthesiser
-  SynthConfig &synthesiser = SynthConfig::getInstance();
-  synthesiser.Init();
+  const SynthConfig synthesiser(kCdSampleRate);
 
   // Number of samples in every segment
   adsr_segment_duration = duration / 4.0;
@@ -582,6 +600,192 @@ TEST(AdsrEnvelopeGenerationTest, HandleDifferentSustainLevels) {
                                   samples_post_envelope);
   }
 }
+
+TEST(AdsrEnvelopeGenerationTest, GenerateOnFirstUse) {
+  const SynthConfig synthesiser(kCdSampleRate);
+  size_t number_of_samples = synthesiser.sampling_rate();
+
+  auto segment_attack = unique_ptr<Segment>(
+      new LinearSegment(1.0f, number_of_samples, SegmentGradient::kIncline));
+  auto segment_decay = unique_ptr<Segment>(
+      new ExponentialSegment(1.0f, 0.5f, 2.0f, number_of_samples));
+  auto segment_sustain =
+      unique_ptr<Segment>(new ConstantSegment(0.5f, number_of_samples));
+  auto segment_release = unique_ptr<Segment>(
+      new LinearSegment(0.5f, number_of_samples, SegmentGradient::kDecline));
+  const Segment *attack = segment_attack.get();
+  const Segment *sustain = segment_sustain.get();
+
+  // Constructing an envelope (e.g. for a voice that's stolen before it's
+  // rendered) doesn't generate anything
+  AdsrEnvelope envelope(segment_attack, segment_decay, segment_sustain,
+                        segment_release);
+  EXPECT_FALSE(attack->IsGenerated());
+
+  // The first application does, except for constant segments
+  vector<int16_t> samples(4 * number_of_samples, 1 << 14);
+  envelope.ApplyEnvelope(samples);
+  EXPECT_TRUE(attack->IsGenerated());
+  EXPECT_FALSE(sustain->IsGenerated());
+}
+
+TEST(AdsrEnvelopeGenerationTest, HandleConstantSegments) {
+  size_t pitch = kNumberOfFrequencies / size_t(2);
+  int16_t volume = 1 << 14;
+  uint32_t duration = 4;
+  double initial_phase = 0;
+  vector<float> gain = {0.0f, 1.0f, 0.5f, 1.5f};
+
+  // Initialise the synthesiser
+  const SynthConfig synthesiser(kCdSampleRate);
+
+  // Every segment is 1 second long. Odd lengths make sure that the tail
+  // of every segment (i.e. the samples that don't fill a whole SIMD
+  // register) is covered too.
+  size_t number_of_samples = synthesiser.sampling_rate() + 3;
+
+  for (auto it : gain) {
+    // 1. Create the envelope - all segments are constant and the sustain
+    //    segment is an exponential segment with exponent equal to 0
+    auto segment_attack =
+        unique_ptr<Segment>(new ConstantSegment(it, number_of_samples));
+    auto segment_decay =
+        unique_ptr<Segment>(new ConstantSegment(1.0f, number_of_samples));
+    auto segment_sustain = unique_ptr<Segment>(
+        new ExponentialSegment(0.0f, it, 0.0f, number_of_samples));
+    auto segment_release =
+        unique_ptr<Segment>(new ConstantSegment(0.0f, number_of_samples - 12));
+
+    AdsrEnvelope envelope(segment_attack, segment_decay, segment_sustain,
+                          segment_release);
+
+    // 2. Generate the samples and apply the envelope
+    SineWaveform osc(synthesiser, volume, initial_phase, pitch);
+    vector<int16_t> samples_pre_envelope = osc(duration);
+    vector<int16_t> samples_post_envelope = samples_pre_envelope;
+    envelope.ApplyEnvelope(samples_post_envelope);
+
+    // 3. Calculate the expected result sample by sample
+    vector<int16_t> samples_expected = samples_pre_envelope;
+    for (size_t idx = 0; idx < samples_expected.size(); idx++) {
+      float expected_gain = 0.0f;
+      if (idx < number_of_samples) {
+        expected_gain = it;
+      } else if (idx < 2 * number_of_samples) {
+        expected_gain = 1.0f;
+      } else if (idx < 3 * number_of_samples) {
+        expected_gain = it;
+      }
+      samples_expected[idx] = static_cast<int16_t>(
+          expected_gain * static_cast<float>(samples_expected[idx]));
+    }
+
+    EXPECT_THAT(samples_post_envelope,
+                ::testing::ContainerEq(samples_expected));
+  }
+}
+
+TEST(AdsrEnvelopeGenerationTest, SaturateGainsAboveUnity) {
+  size_t pitch = kNumberOfFrequencies / size_t(2);
+  int16_t volume = 30000;
+  uint32_t duration = 4;
+  double initial_phase = 0;
+
+  // Initialise the synthesiser
+  const SynthConfig synthesiser(kCdSampleRate);
+
+  // Odd lengths, so that the samples that don't fill a whole SIMD
+  // register are covered too. The attack ramps up to a gain of 2 (a gain
+  // table), the decay and the sustain are constant (a single gain).
+  size_t number_of_samples = synthesiser.sampling_rate() + 3;
+  auto segment_attack = unique_ptr<Segment>(
+      new LinearSegment(2.0f, number_of_samples, SegmentGradient::kIncline));
+  vector<float> attack_gains = segment_attack->GetSamples();
+  auto segment_decay =
+      unique_ptr<Segment>(new ConstantSegment(1.5f, number_of_samples));
+  auto segment_sustain =
+      unique_ptr<Segment>(new ConstantSegment(1.5f, number_of_samples));
+  auto segment_release =
+      unique_ptr<Segment>(new ConstantSegment(0.0f, number_of_samples - 12));
+
+  AdsrEnvelope envelope(segment_attack, segment_decay, segment_sustain,
+                        segment_release);
+
+  SineWaveform osc(synthesiser, volume, initial_phase, pitch);
+  vector<int16_t> samples_pre_envelope = osc(duration);
+  vector<int16_t> samples_post_envelope = samples_pre_envelope;
+  envelope.ApplyEnvelope(samples_post_envelope);
+
+  // Loud samples saturate wherever they are in the buffer, they never
+  // wrap around
+  for (size_t idx = 0; idx < 3 * number_of_samples; idx++) {
+    float gain = (idx < number_of_samples) ? attack_gains[idx] : 1.5f;
+    float expected = gain * static_cast<float>(samples_pre_envelope[idx]);
+    expected = min(max(expected, -32768.0f), 32767.0f);
+    ASSERT_EQ(samples_post_envelope[idx], static_cast<int16_t>(expected))
+        << idx;
+  }
+}
+
+//------------------------------------------------------------------------
+//  Batch application
+//------------------------------------------------------------------------
+TEST(EnvelopeBatchTest, MatchesSingleBufferApplication) {
+  vector<size_t> pitch = {10, 30, 50, 70, 90, 110, 127};
+  int16_t volume = 1 << 14;
+  uint32_t duration = 3;
+  double initial_phase = 0;
+
+  // Initialise the synthesiser
+  const SynthConfig synthesiser(kCdSampleRate);
+
+  // 1. One AR envelope and one ADSR envelope. The segment lengths are not
+  //    multiples of the block size.
+  ArEnvelope ar_envelope(synthesiser, 1.0f, 0.7, 1.1);
+
+  size_t number_of_samples = duration * synthesiser.sampling_rate();
+  size_t attack_length = number_of_samples / 5 + 1;
+  size_t decay_length = number_of_samples / 7 + 3;
+  size_t release_length = number_of_samples / 3 + 5;
+  size_t sustain_length =
+      number_of_samples - attack_length - decay_length - release_length;
+
+  auto segment_attack = unique_ptr<Segment>(
+      new ExponentialSegment(0.0f, 1.0f, 2.0f, attack_length));
+  auto segment_decay = unique_ptr<Segment>(
+      new ExponentialSegment(1.0f, 0.5f, 1.0f, decay_length));
+  auto segment_sustain =
+      unique_ptr<Segment>(new ConstantSegment(0.5f, sustain_length));
+  auto segment_release = unique_ptr<Segment>(
+      new ExponentialSegment(0.5f, 0.0f, 1.5f, release_length));
+  AdsrEnvelope adsr_envelope(segment_attack, segment_decay, segment_sustain,
+                             segment_release);
+
+  const Envelope *envelopes[] = {&ar_envelope, &adsr_envelope};
+
+  for (const Envelope *envelope : envelopes) {
+    for (size_t number_of_threads : {1, 3}) {
+      // 2. Generate one buffer per pitch
+      vector<vector<int16_t>> buffers;
+      for (auto it : pitch) {
+        SineWaveform osc(synthesiser, volume, initial_phase, it);
+        buffers.push_back(osc(duration));
+      }
+
+      // 3. The reference: one buffer at a time
+      vector<vector<int16_t>> buffers_expected = buffers;
+      for (auto &buffer : buffers_expected) envelope->ApplyEnvelope(buffer);
+
+      // 4. All buffers at once
+      envelope->ApplyEnvelopeBatch(buffers, number_of_threads);
+
+      for (size_t idx = 0; idx < buffers.size(); idx++) {
+        EXPECT_THAT(buffers[idx],
+                    ::testing::ContainerEq(buffers_expected[idx]));
+      }
+    }
+  }
+}
 //========================================================================
 // End of file
 //========================================================================
@@ -0,0 +1,155 @@
+//========================================================================
+// FILE:
+//    unit_tests/source/flac_codec.cc
+//
+// AUTHOR:
+//    zimzum@github
+//
+// DESCRIPTION:
+//    Tests the FLAC encoder and decoder.
+//
+// License: GNU GPL v2.0
+//========================================================================
+
+#include <common/flac_codec.h>
+#include <global/global_variables.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+
+using namespace std;
+
+//========================================================================
+// UTILITIES
+//========================================================================
+//------------------------------------------------------------------------
+//  NAME:
+//      GenerateSamples
+//
+//  DESCRIPTION:
+//      Generates interleaved samples: a sine wave per channel (with
+//      harmonics and a different pitch in every channel) plus a little
+//      noise, so that all the subframe types get used.
+//------------------------------------------------------------------------
+static vector<int16_t> GenerateSamples(size_t number_of_channels,
+                                       size_t number_of_frames,
+                                       double noise) {
+  vector<int16_t> samples(number_of_channels * number_of_frames);
+  mt19937 generator(42);
+  normal_distribution<double> distribution(0.0, noise);
+
+  for (size_t frame = 0; frame < number_of_frames; frame++) {
+    for (size_t channel = 0; channel < number_of_channels; channel++) {
+      double phase = 0.02 * (channel + 1) * frame;
+      double value = 16000 * sin(phase) + 4000 * sin(3 * phase) +
+                     ((noise > 0) ? distribution(generator) : 0.0);
+      value = max(-32768.0, min(32767.0, value));
+      samples[frame * number_of_channels + channel] =
+          static_cast<int16_t>(lround(value));
+    }
+  }
+
+  return samples;
+}
+
+//========================================================================
+// TESTS
+//========================================================================
+TEST(FlacCodecTest, RoundTrip) {
+  // Lengths around the frame size, including empty and odd ones
+  vector<size_t> frame_counts = {0,  1,  2,  17,
+                                 kFlacBlockSize - 1, kFlacBlockSize,
+                                 3 * kFlacBlockSize + 123};
+
+  for (size_t number_of_channels = 1; number_of_channels <= 3;
+       number_of_channels++) {
+    for (auto number_of_frames : frame_counts) {
+      for (double noise : {0.0, 30.0, 20000.0}) {
+        vector<int16_t> samples =
+            GenerateSamples(number_of_channels, number_of_frames, noise);
+
+        FlacEncoder encoder(kCdSampleRate,
+                            static_cast<uint16_t>(number_of_channels));
+        vector<uint8_t> stream = encoder.Encode(samples.data(),
+                                                samples.size());
+
+        FlacDecoder decoder;
+        vector<int16_t> decoded;
+        ASSERT_TRUE(decoder.Decode(stream.data(), stream.size(), decoded));
+        EXPECT_EQ(decoder.sample_rate(), kCdSampleRate);
+        EXPECT_EQ(decoder.number_of_channels(), number_of_channels);
+        EXPECT_THAT(decoded, ::testing::ContainerEq(samples))
+            << number_of_channels << " channels, " << number_of_frames
+            << " frames, noise " << noise;
+      }
+    }
+  }
+
+  // Silence and full scale square waves (constant subframes, the widest
+  // side channel)
+  vector<int16_t> extremes(2 * kFlacBlockSize + 2);
+  for (size_t idx = kFlacBlockSize; idx < extremes.size(); idx++) {
+    extremes[idx] = ((idx / 7 + idx) % 2) ? 32767 : -32768;
+  }
+  FlacEncoder encoder(96000, kNumberOfChannelsStereo);
+  vector<uint8_t> stream = encoder.Encode(extremes.data(), extremes.size());
+  FlacDecoder decoder;
+  vector<int16_t> decoded;
+  ASSERT_TRUE(decoder.Decode(stream.data(), stream.size(), decoded));
+  EXPECT_THAT(decoded, ::testing::ContainerEq(extremes));
+}
+
+TEST(FlacCodecTest, Deterministic) {
+  vector<int16_t> samples =
+      GenerateSamples(kNumberOfChannelsStereo, 10 * kFlacBlockSize + 5, 10.0);
+
+  FlacEncoder encoder(kCdSampleRate, kNumberOfChannelsStereo);
+  vector<uint8_t> expected = encoder.Encode(samples.data(), samples.size());
+
+  // The stream doesn't depend on how the frames are shared between threads
+  for (size_t number_of_threads : {size_t(2), size_t(3), size_t(16)}) {
+    FlacEncoder parallel_encoder(kCdSampleRate, kNumberOfChannelsStereo,
+                                 number_of_threads);
+    EXPECT_THAT(parallel_encoder.Encode(samples.data(), samples.size()),
+                ::testing::ContainerEq(expected))
+        << number_of_threads << " threads";
+  }
+}
+
+TEST(FlacCodecTest, Compress) {
+  vector<int16_t> samples =
+      GenerateSamples(kNumberOfChannelsStereo, 5 * kCdSampleRate, 4.0);
+
+  FlacEncoder encoder(kCdSampleRate, kNumberOfChannelsStereo);
+  vector<uint8_t> stream = encoder.Encode(samples.data(), samples.size());
+
+  EXPECT_LT(stream.size(), samples.size() * sizeof(int16_t) / 2);
+}
+
+TEST(FlacCodecTest, DetectCorruption) {
+  vector<int16_t> samples =
+      GenerateSamples(kNumberOfChannelsMono, 2 * kFlacBlockSize, 10.0);
+
+  FlacEncoder encoder(kCdSampleRate, kNumberOfChannelsMono);
+  vector<uint8_t> stream = encoder.Encode(samples.data(), samples.size());
+
+  FlacDecoder decoder;
+  vector<int16_t> decoded;
+
+  // 1. A flipped bit in the middle of a frame fails the CRC
+  vector<uint8_t> corrupted = stream;
+  corrupted[corrupted.size() / 2] ^= 0x10;
+  EXPECT_FALSE(decoder.Decode(corrupted.data(), corrupted.size(), decoded));
+
+  // 2. So does a truncated stream, and one that's not FLAC at all
+  EXPECT_FALSE(decoder.Decode(stream.data(), stream.size() - 1, decoded));
+  corrupted = stream;
+  corrupted[0] = 'R';
+  EXPECT_FALSE(decoder.Decode(corrupted.data(), corrupted.size(), decoded));
+}
+//========================================================================
+// End of file
+//========================================================================
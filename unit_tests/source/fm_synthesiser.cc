@@ -11,6 +11,8 @@
 // License: GNU GPL v2.0
 //========================================================================
 
+#include <algorithm>
+
 #include <gtest/gtest.h>
 
 #include <common/synth_config.h>
@@ -22,7 +24,7 @@ using namespace std;
 //========================================================================
 // UTILITIES
 //========================================================================
-void TestFmSynthesiser() {
+void TestFmSynthesiser(uint32_t sampling_rate) {
   size_t pitch_carrier = 64;
   vector<size_t> pitch_modulator = {10, 20, 30, 40,  50,  60,
                                     70, 80, 90, 100, 110, 120};
@@ -33,8 +35,7 @@ void TestFmSynthesiser() {
   uint32_t duration = 1;
 
   // Initialise the synthesiser
-  SynthConfig &synthesiser = SynthConfig::getInstance();
-  synthesiser.Init();
+  const SynthConfig synthesiser(sampling_rate);
 
   // The following lambda is used to check whether the input sample
   // is within the volume bounds, i.e. sample \in (-volume, volume).
@@ -62,7 +63,13 @@ void TestFmSynthesiser() {
 //========================================================================
 // TESTS
 //========================================================================
-TEST(YourTestNameTest, SubtestName) { TestFmSynthesiser(); }
+TEST(YourTestNameTest, SubtestName) { TestFmSynthesiser(kCdSampleRate); }
+
+// The modulator is generated at the sampling rate of the synthesiser too
+TEST(YourTestNameTest, HandleSamplingRates) {
+  TestFmSynthesiser(48000);
+  TestFmSynthesiser(96000);
+}
 
 //========================================================================
 // End of file
@@ -0,0 +1,346 @@
+//========================================================================
+// FILE:
+//    unit_tests/source/midi_renderer.cc
+//
+// AUTHOR:
+//    zimzum@github
+//
+// DESCRIPTION:
+//    Tests the MidiFile and MidiRenderer classes.
+//
+// License: GNU GPL v2.0
+//========================================================================
+
+#include <common/pcm_conversion.h>
+#include <common/synth_config.h>
+#include <common/wave_file.h>
+#include <global/global_variables.h>
+#include <midi/midi_file.h>
+#include <midi/midi_renderer.h>
+#include <voice/voice_manager.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace std;
+
+//========================================================================
+// UTILITIES
+//========================================================================
+//------------------------------------------------------------------------
+//  NAME:
+//      AppendBigEndian
+//
+//  DESCRIPTION:
+//      Appends a big-endian number of the given size.
+//------------------------------------------------------------------------
+static void AppendBigEndian(vector<uint8_t>& data, uint32_t value,
+                            size_t number_of_bytes) {
+  for (size_t idx = number_of_bytes; idx > 0; idx--) {
+    data.push_back(static_cast<uint8_t>(value >> (8 * (idx - 1))));
+  }
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      MakeMidiFile
+//
+//  DESCRIPTION:
+//      Builds a format 1 Standard MIDI File from the contents of the
+//      track chunks.
+//------------------------------------------------------------------------
+static vector<uint8_t> MakeMidiFile(uint16_t division,
+                                    const vector<vector<uint8_t>>& tracks,
+                                    uint16_t format = 1) {
+  vector<uint8_t> data;
+  AppendBigEndian(data, kMidiHeaderChunkId, 4);
+  AppendBigEndian(data, 6, 4);
+  AppendBigEndian(data, format, 2);
+  AppendBigEndian(data, tracks.size(), 2);
+  AppendBigEndian(data, division, 2);
+
+  for (const auto& track : tracks) {
+    AppendBigEndian(data, kMidiTrackChunkId, 4);
+    AppendBigEndian(data, track.size(), 4);
+    data.insert(data.end(), track.begin(), track.end());
+  }
+
+  return data;
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      MakeChordTrack
+//
+//  DESCRIPTION:
+//      A track (480 ticks per quarter note) with a chord per bar, every
+//      chord shifted by the given number of semitones.
+//------------------------------------------------------------------------
+static vector<uint8_t> MakeChordTrack(uint8_t transpose) {
+  vector<uint8_t> track;
+  for (uint8_t root : {48, 53, 55, 48}) {
+    for (uint8_t interval : {0, 4, 7}) {
+      track.insert(track.end(), {0x00, 0x90,
+                                 static_cast<uint8_t>(root + interval +
+                                                      transpose),
+                                 0x60});
+    }
+    // Three beats (1440 ticks) later
+    track.insert(track.end(), {0x8B, 0x20, 0x80,
+                               static_cast<uint8_t>(root + transpose), 0x00});
+    track.insert(track.end(),
+                 {0x00, static_cast<uint8_t>(root + 4 + transpose), 0x00});
+    track.insert(track.end(),
+                 {0x00, static_cast<uint8_t>(root + 7 + transpose), 0x00});
+    // ... and a beat of rest
+    track.insert(track.end(), {0x83, 0x60, 0xFF, 0x01, 0x00});
+  }
+  track.insert(track.end(), {0x00, 0xFF, 0x2F, 0x00});
+
+  return track;
+}
+
+//========================================================================
+// TESTS
+//========================================================================
+TEST(MidiFileTest, ParseFile) {
+  // 96 ticks per quarter note. The first track holds the tempo: 120 BPM
+  // for two beats (1 second), then 240 BPM.
+  vector<uint8_t> tempo_track = {0x00, 0xFF, 0x51, 0x03, 0x07, 0xA1, 0x20,
+                                 0x81, 0x40, 0xFF, 0x51, 0x03, 0x03, 0xD0,
+                                 0x90, 0x00, 0xFF, 0x2F, 0x00};
+  vector<uint8_t> note_track = {
+      // A Note On, and a Note On with a velocity of 0 (running status)
+      0x00, 0x90, 0x3C, 0x64, 0x60, 0x3C, 0x00,
+      // A program change (skipped) and a note on channel 1
+      0x81, 0x40, 0xC0, 0x05, 0x00, 0x91, 0x43, 0x7F,
+      // A Note Off, a SysEx message (skipped) and the end
+      0x60, 0x81, 0x43, 0x40, 0x00, 0xF0, 0x03, 0x7E, 0x7F, 0xF7,
+      0x60, 0xFF, 0x2F, 0x00};
+  vector<uint8_t> data = MakeMidiFile(96, {tempo_track, note_track});
+
+  MidiFile file;
+  ASSERT_TRUE(file.Parse(data.data(), data.size()));
+  ASSERT_EQ(file.number_of_tracks(), 2u);
+  EXPECT_TRUE(file.track(0).empty());
+  EXPECT_DOUBLE_EQ(file.duration(), 1.75);
+
+  const vector<MidiNoteEvent>& track = file.track(1);
+  ASSERT_EQ(track.size(), 4u);
+  const double times[] = {0.0, 0.5, 1.25, 1.5};
+  const bool note_ons[] = {true, false, true, false};
+  const uint8_t channels[] = {0, 0, 1, 1};
+  const uint8_t keys[] = {60, 60, 67, 67};
+  const uint8_t velocities[] = {100, 0, 127, 64};
+  for (size_t idx = 0; idx < track.size(); idx++) {
+    EXPECT_DOUBLE_EQ(track[idx].time, times[idx]) << idx;
+    EXPECT_EQ(track[idx].note_on, note_ons[idx]) << idx;
+    EXPECT_EQ(track[idx].channel, channels[idx]) << idx;
+    EXPECT_EQ(track[idx].key, keys[idx]) << idx;
+    EXPECT_EQ(track[idx].velocity, velocities[idx]) << idx;
+  }
+
+  // SMPTE time division: 25 frames per second, 40 ticks per frame
+  data = MakeMidiFile(0xE728, {note_track});
+  ASSERT_TRUE(file.Parse(data.data(), data.size()));
+  EXPECT_DOUBLE_EQ(file.track(0)[2].time, 288 / 1000.0);
+}
+
+TEST(MidiFileTest, RejectInvalidFiles) {
+  const vector<uint8_t> track = {0x00, 0x90, 0x3C, 0x64, 0x00, 0xFF, 0x2F,
+                                 0x00};
+  MidiFile file;
+
+  vector<uint8_t> data = MakeMidiFile(96, {track});
+  ASSERT_TRUE(file.Parse(data.data(), data.size()));
+  EXPECT_EQ(file.number_of_tracks(), 1u);
+
+  // 1. Not a MIDI file
+  data[0] = 'X';
+  EXPECT_FALSE(file.Parse(data.data(), data.size()));
+  EXPECT_EQ(file.number_of_tracks(), 0u);
+
+  // 2. Truncated
+  data = MakeMidiFile(96, {track});
+  EXPECT_FALSE(file.Parse(data.data(), data.size() - 3));
+
+  // 3. A data byte without a status byte
+  data = MakeMidiFile(96, {{0x00, 0x3C, 0x64}});
+  EXPECT_FALSE(file.Parse(data.data(), data.size()));
+
+  // 4. Format 2 (independent sequences)
+  data = MakeMidiFile(96, {track}, 2);
+  EXPECT_FALSE(file.Parse(data.data(), data.size()));
+
+  // 5. No such file
+  EXPECT_FALSE(file.Load("no_such_file.mid"));
+}
+
+TEST(MidiRendererTest, RenderSampleAccurate) {
+  const SynthConfig synthesiser(kCdSampleRate);
+  VoiceParameters parameters;
+  parameters.index_of_modulation = 1.5;
+
+  // 480 ticks per quarter note at 120 BPM, i.e. 45.9375 samples per
+  // tick: the note starts at sample 1470 and stops at sample 45570,
+  // neither at the start of a block
+  vector<uint8_t> track = {0x20, 0x90, 0x3C, 0x64, 0x87, 0x40, 0x80,
+                           0x3C, 0x00, 0x00, 0xFF, 0x2F, 0x00};
+  vector<uint8_t> data = MakeMidiFile(480, {track});
+  MidiFile file;
+  ASSERT_TRUE(file.Parse(data.data(), data.size()));
+
+  vector<float> samples;
+  MidiRenderer renderer(synthesiser, parameters);
+  renderer.Render(file, [&](const float* block, size_t length) {
+    samples.insert(samples.end(), block, block + length);
+  });
+
+  // The same note, played directly
+  const size_t release_length = 0.2 * kCdSampleRate;
+  vector<float> expected(45570 + release_length);
+  VoiceManager voices(synthesiser, parameters);
+  voices.Render(expected.data(), 1470);
+  voices.NoteOn(60 - kMidiNoteOfFirstPitch, 100 / 127.0f);
+  voices.Render(expected.data() + 1470, 45570 - 1470);
+  voices.NoteOff(60 - kMidiNoteOfFirstPitch);
+  voices.Render(expected.data() + 45570, release_length);
+
+  EXPECT_THAT(samples, ::testing::ContainerEq(expected));
+  EXPECT_EQ(renderer.metrics().number_of_notes, 1u);
+  EXPECT_EQ(renderer.metrics().number_of_samples, expected.size());
+}
+
+TEST(MidiRendererTest, RenderChannelsSeparately) {
+  const SynthConfig synthesiser(kCdSampleRate);
+  VoiceParameters parameters;
+
+  // A format 0 file: middle C on channels 1 and 2 at once. The note on
+  // channel 2 stops after half a second (sample 22050), the one on
+  // channel 1 after a second (sample 44100).
+  vector<uint8_t> track = {0x00, 0x90, 0x3C, 0x64, 0x00, 0x91, 0x3C,
+                           0x64, 0x83, 0x60, 0x81, 0x3C, 0x00, 0x83,
+                           0x60, 0x80, 0x3C, 0x00, 0x00, 0xFF, 0x2F,
+                           0x00};
+  vector<uint8_t> data = MakeMidiFile(480, {track}, 0);
+  MidiFile file;
+  ASSERT_TRUE(file.Parse(data.data(), data.size()));
+
+  vector<float> samples;
+  MidiRenderer renderer(synthesiser, parameters, 2);
+  renderer.Render(file, [&](const float* block, size_t length) {
+    samples.insert(samples.end(), block, block + length);
+  });
+  EXPECT_EQ(renderer.metrics().number_of_parts, 2u);
+  EXPECT_EQ(renderer.metrics().number_of_notes, 2u);
+
+  // The same notes, played by two voice pools: the Note Off on channel
+  // 2 doesn't cut off the note on channel 1
+  const size_t pitch_id = 60 - kMidiNoteOfFirstPitch;
+  const size_t release_length = 0.2 * kCdSampleRate;
+  vector<float> first(kCdSampleRate + release_length);
+  vector<float> second(first.size());
+
+  VoiceManager first_voices(synthesiser, parameters);
+  first_voices.NoteOn(pitch_id, 100 / 127.0f);
+  first_voices.Render(first.data(), kCdSampleRate);
+  first_voices.NoteOff(pitch_id);
+  first_voices.Render(first.data() + kCdSampleRate, release_length);
+
+  VoiceManager second_voices(synthesiser, parameters);
+  second_voices.NoteOn(pitch_id, 100 / 127.0f);
+  second_voices.Render(second.data(), kCdSampleRate / 2);
+  second_voices.NoteOff(pitch_id);
+  second_voices.Render(second.data() + kCdSampleRate / 2,
+                       kCdSampleRate / 2 + release_length);
+
+  vector<float> expected(first.size());
+  for (size_t idx = 0; idx < expected.size(); idx++) {
+    expected[idx] = first[idx] + second[idx];
+  }
+  EXPECT_THAT(samples, ::testing::ContainerEq(expected));
+}
+
+TEST(MidiRendererTest, RenderTracksOnThreads) {
+  const SynthConfig synthesiser(kCdSampleRate);
+  VoiceParameters parameters;
+  parameters.amplitude = 0.05f;
+
+  vector<vector<uint8_t>> tracks;
+  for (uint8_t transpose : {0, 12, 19, 24}) {
+    tracks.push_back(MakeChordTrack(transpose));
+  }
+  vector<uint8_t> data = MakeMidiFile(480, tracks);
+  MidiFile file;
+  ASSERT_TRUE(file.Parse(data.data(), data.size()));
+
+  // The output doesn't depend on the number of threads
+  vector<float> expected;
+  for (size_t number_of_threads : {1, 2, 4}) {
+    vector<float> samples;
+    MidiRenderer renderer(synthesiser, parameters, number_of_threads);
+    renderer.Render(file, [&](const float* block, size_t length) {
+      samples.insert(samples.end(), block, block + length);
+    });
+
+    const MidiRenderMetrics& metrics = renderer.metrics();
+    EXPECT_EQ(metrics.number_of_parts, 4u);
+    EXPECT_EQ(metrics.number_of_notes, 48u);
+    EXPECT_EQ(metrics.number_of_samples, samples.size());
+    EXPECT_DOUBLE_EQ(metrics.rendered_duration,
+                     samples.size() / static_cast<double>(kCdSampleRate));
+    EXPECT_GT(renderer.real_time_factor(), 0.0);
+
+    if (expected.empty()) {
+      expected = samples;
+      // 8 seconds of chords, and the release of the last one
+      EXPECT_EQ(expected.size(), 8 * kCdSampleRate + kCdSampleRate / 5);
+    } else {
+      EXPECT_THAT(samples, ::testing::ContainerEq(expected))
+          << number_of_threads << " threads";
+    }
+  }
+}
+
+TEST(MidiRendererTest, RenderToFile) {
+  const SynthConfig synthesiser(kCdSampleRate);
+  const string file_name("test_midi_render.wav");
+  VoiceParameters parameters;
+  parameters.amplitude = 0.5f;
+
+  // Two tracks, loud enough for the mix to clip
+  vector<uint8_t> data =
+      MakeMidiFile(480, {MakeChordTrack(0), MakeChordTrack(12)});
+  MidiFile file;
+  ASSERT_TRUE(file.Parse(data.data(), data.size()));
+
+  MidiRenderer renderer(synthesiser, parameters, 2);
+  vector<float> mix;
+  renderer.Render(file, [&](const float* block, size_t length) {
+    mix.insert(mix.end(), block, block + length);
+  });
+  vector<int16_t> expected(mix.size());
+  ConvertFloatToPcm16(mix.data(), mix.size(), expected.data());
+
+  ASSERT_TRUE(renderer.RenderToFile(file, file_name));
+  WaveFileIn wave_file;
+  vector<int16_t> samples = wave_file.ReadBufferFromFile(file_name);
+  EXPECT_EQ(wave_file.sample_rate(), kCdSampleRate);
+  EXPECT_THAT(samples, ::testing::ContainerEq(expected));
+  EXPECT_THAT(samples, ::testing::Contains(32767));
+
+  // The file is written at the rate of the synthesiser
+  const SynthConfig other_synthesiser(96000);
+  MidiRenderer other_renderer(other_synthesiser, parameters);
+  ASSERT_TRUE(other_renderer.RenderToFile(file, file_name));
+  WaveFileIn other_wave_file;
+  samples = other_wave_file.ReadBufferFromFile(file_name);
+  EXPECT_EQ(other_wave_file.sample_rate(), 96000u);
+  EXPECT_EQ(other_wave_file.byte_rate(), 2 * 96000u);
+  EXPECT_EQ(samples.size(), other_renderer.metrics().number_of_samples);
+  EXPECT_NEAR(other_renderer.metrics().rendered_duration,
+              renderer.metrics().rendered_duration, 1e-3);
+}
+//========================================================================
+// End of file
+//========================================================================
@@ -0,0 +1,137 @@
+//========================================================================
+// FILE:
+//    unit_tests/source/mixer_bus.cc
+//
+// AUTHOR:
+//    zimzum@github
+//
+// DESCRIPTION:
+//    Tests the MixerBus class.
+//
+// License: GNU GPL v2.0
+//========================================================================
+
+#include <common/mixer_bus.h>
+#include <common/synth_config.h>
+#include <global/global_variables.h>
+#include <oscillator/oscillator.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+
+using namespace std;
+
+//========================================================================
+// TESTS
+//========================================================================
+TEST(MixerBusTest, MixChord) {
+  const SynthConfig synthesiser(kCdSampleRate);
+  const size_t number_of_samples = kCdSampleRate / 4;
+  const float gains[] = {1.0f, 0.8f, 0.6f};
+
+  // A C major chord, every note at full scale - far too loud for 16 bits
+  vector<vector<int16_t>> notes;
+  vector<const int16_t*> inputs;
+  for (size_t pitch_id : {60, 64, 67}) {
+    SineWaveform note(synthesiser, 32000, 0.0, pitch_id);
+    notes.emplace_back(number_of_samples);
+    note(notes.back().data(), number_of_samples);
+    inputs.push_back(notes.back().data());
+  }
+
+  MixerBus bus(number_of_samples);
+  bus.Add(inputs.data(), gains, inputs.size());
+  vector<int16_t> mix(number_of_samples);
+  bus.ConvertToPcm16(mix.data());
+
+  size_t number_of_clipped_samples = 0;
+  for (size_t idx = 0; idx < number_of_samples; idx++) {
+    double expected = 0.0;
+    for (size_t note = 0; note < notes.size(); note++) {
+      expected += gains[note] * notes[note][idx];
+    }
+    ASSERT_NEAR(bus.data()[idx] * 32768.0, expected, 1e-2) << idx;
+
+    // Clipped rather than wrapped around
+    expected = min(max(round(expected), -32768.0), 32767.0);
+    if (fabs(expected) >= 32767.0) number_of_clipped_samples++;
+    ASSERT_NEAR(mix[idx], expected, 1.0) << idx;
+  }
+  EXPECT_GT(number_of_clipped_samples, 0u);
+}
+
+TEST(MixerBusTest, MixInAnyOrder) {
+  // Longer than a block and not a multiple of the SIMD width
+  const size_t number_of_samples = 2 * kMixerBlockSize + 13;
+  const size_t number_of_inputs = 5;
+  mt19937 generator(7);
+  uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+
+  vector<vector<float>> signals(number_of_inputs,
+                                vector<float>(number_of_samples));
+  vector<const float*> inputs;
+  vector<float> gains;
+  for (auto& signal : signals) {
+    for (float& sample : signal) sample = distribution(generator);
+    inputs.push_back(signal.data());
+    gains.push_back(distribution(generator));
+  }
+
+  // 1. All at once
+  MixerBus all_at_once(number_of_samples);
+  all_at_once.Add(inputs.data(), gains.data(), number_of_inputs);
+
+  // 2. One at a time, in the same order - the sum is the same to the bit
+  MixerBus one_at_a_time(number_of_samples);
+  for (size_t input = 0; input < number_of_inputs; input++) {
+    one_at_a_time.Add(inputs[input], gains[input]);
+  }
+
+  vector<float> expected(number_of_samples, 0.0f);
+  for (size_t input = 0; input < number_of_inputs; input++) {
+    for (size_t idx = 0; idx < number_of_samples; idx++) {
+      expected[idx] += gains[input] * signals[input][idx];
+    }
+  }
+
+  vector<float> mix(all_at_once.data(),
+                    all_at_once.data() + number_of_samples);
+  EXPECT_THAT(mix, ::testing::ContainerEq(expected));
+  mix.assign(one_at_a_time.data(), one_at_a_time.data() + number_of_samples);
+  EXPECT_THAT(mix, ::testing::ContainerEq(expected));
+
+  // 3. Clearing the bus
+  all_at_once.Clear();
+  mix.assign(all_at_once.data(), all_at_once.data() + number_of_samples);
+  EXPECT_THAT(mix, ::testing::Each(0.0f));
+}
+
+TEST(MixerBusTest, MixPcm16) {
+  const int16_t loud[] = {32767, -32768, 20000, -20000, 100,
+                          -100,  0,      16384, -16384};
+  const size_t number_of_samples = sizeof(loud) / sizeof(loud[0]);
+  vector<int16_t> mix(number_of_samples);
+
+  // A single signal at unity gain comes back unchanged
+  MixerBus bus(number_of_samples);
+  bus.Add(loud);
+  bus.ConvertToPcm16(mix.data());
+  EXPECT_THAT(mix, ::testing::ElementsAreArray(loud));
+
+  // Twice as loud saturates
+  bus.Add(loud);
+  bus.ConvertToPcm16(mix.data());
+  EXPECT_THAT(mix, ::testing::ElementsAre(32767, -32768, 32767, -32768, 200,
+                                          -200, 0, 32767, -32768));
+
+  // ... and cancelling it out gives silence
+  bus.Add(loud, -2.0f);
+  bus.ConvertToPcm16(mix.data());
+  EXPECT_THAT(mix, ::testing::Each(0));
+}
+//========================================================================
+// End of file
+//========================================================================
@@ -12,6 +12,7 @@
 //========================================================================
 
 #include <algorithm>
+#include <thread>
 
 #include <gtest/gtest.h>
 
@@ -31,8 +32,7 @@ void TestOscillator() {
   double initial_phase = 0;
 
   // Initialise the synthesiser
-  SynthConfig &synthesiser = SynthConfig::getInstance();
-  synthesiser.Init();
+  const SynthConfig synthesiser(kCdSampleRate);
 
   // The following lambda is used to check whether the input sample
   // is within the volume bounds, i.e. sample \in (-volume, volume).
@@ -68,6 +68,41 @@ TEST(AllOscillators, BasicTest) {
   TestOscillator<SquareWaveform>();
   TestOscillator<TriangleWaveform>();
 }
+
+TEST(AllOscillators, HandleConcurrentSamplingRates) {
+  size_t pitch = kNumberOfFrequencies / size_t(2);
+  int16_t volume = 1 << 14;
+  uint32_t duration = 2;
+  double initial_phase = 0;
+
+  // Two configurations, each shared (read-only) by two threads
+  const SynthConfig synthesiser_cd(kCdSampleRate);
+  const SynthConfig synthesiser_hd(96000);
+  const SynthConfig *synthesisers[] = {&synthesiser_cd, &synthesiser_hd,
+                                       &synthesiser_cd, &synthesiser_hd};
+
+  // 1. Render concurrently
+  vector<vector<int16_t>> samples(4);
+  vector<thread> threads;
+  for (size_t idx = 0; idx < samples.size(); idx++) {
+    threads.emplace_back([&, idx] {
+      SineWaveform osc(*synthesisers[idx], volume, initial_phase, pitch);
+      samples[idx] = osc(duration);
+    });
+  }
+  for (auto &it : threads) it.join();
+
+  // 2. Every render is identical to one done on its own
+  for (size_t idx = 0; idx < samples.size(); idx++) {
+    SineWaveform osc(*synthesisers[idx], volume, initial_phase, pitch);
+    EXPECT_EQ(samples[idx].size(),
+              duration * synthesisers[idx]->sampling_rate());
+    EXPECT_EQ(samples[idx], osc(duration));
+  }
+  EXPECT_DOUBLE_EQ(synthesiser_hd.phase_increment_table(pitch),
+                   synthesiser_cd.phase_increment_table(pitch) *
+                       kCdSampleRate / 96000);
+}
 //========================================================================
 // End of file
 //========================================================================
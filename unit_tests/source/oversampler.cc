@@ -0,0 +1,163 @@
+//========================================================================
+// FILE:
+//    unit_tests/source/oversampler.cc
+//
+// AUTHOR:
+//    zimzum@github
+//
+// DESCRIPTION:
+//    Tests the Oversampler class.
+//
+// License: GNU GPL v2.0
+//========================================================================
+
+#include <common/oversampler.h>
+#include <global/global_variables.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+
+using namespace std;
+
+//========================================================================
+// UTILITIES
+//========================================================================
+//------------------------------------------------------------------------
+//  NAME:
+//      GenerateSine
+//
+//  DESCRIPTION:
+//      Generates number_of_samples samples of a sine wave at the given
+//      frequency, delayed by the given number of samples.
+//------------------------------------------------------------------------
+static vector<float> GenerateSine(double frequency, double sampling_rate,
+                                  size_t number_of_samples,
+                                  double delay = 0.0) {
+  vector<float> samples(number_of_samples);
+
+  for (size_t idx = 0; idx < number_of_samples; idx++) {
+    samples[idx] = static_cast<float>(
+        0.5 * sin(kTwoPi * frequency * (idx - delay) / sampling_rate));
+  }
+
+  return samples;
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      Rms
+//
+//  DESCRIPTION:
+//      The RMS of the samples from first onwards.
+//------------------------------------------------------------------------
+static double Rms(const vector<float>& samples, size_t first) {
+  double sum = 0.0;
+
+  for (size_t idx = first; idx < samples.size(); idx++) {
+    sum += samples[idx] * samples[idx];
+  }
+
+  return sqrt(sum / (samples.size() - first));
+}
+
+//========================================================================
+// TESTS
+//========================================================================
+TEST(OversamplerTest, PassBand) {
+  const size_t number_of_samples = 10000;
+  const size_t settle = 200;
+
+  for (size_t factor : {1, 2, 4, 8}) {
+    for (double frequency : {100.0, 1000.0, 15000.0}) {
+      Oversampler oversampler(factor);
+      vector<float> input = GenerateSine(
+          frequency, factor * kCdSampleRate, factor * number_of_samples);
+      vector<float> output(number_of_samples);
+      oversampler.Decimate(input.data(), number_of_samples, output.data());
+
+      // The signal is only delayed (by latency())
+      vector<float> expected = GenerateSine(
+          frequency, kCdSampleRate, number_of_samples, oversampler.latency());
+      for (size_t idx = settle; idx < number_of_samples; idx++) {
+        ASSERT_NEAR(output[idx], expected[idx], 2e-3)
+            << factor << "x, " << frequency << "Hz, sample " << idx;
+      }
+    }
+  }
+}
+
+TEST(OversamplerTest, StopBand) {
+  const size_t number_of_samples = 10000;
+  const size_t settle = 200;
+
+  // Frequencies above the output Nyquist frequency that would alias
+  for (size_t factor : {2, 4, 8}) {
+    for (double ratio : {0.65, 0.8, 1.3, 1.9, 2.6, 3.9}) {
+      if (ratio >= factor / 2.0) continue;
+
+      Oversampler oversampler(factor);
+      vector<float> input =
+          GenerateSine(ratio * kCdSampleRate, factor * kCdSampleRate,
+                       factor * number_of_samples);
+      vector<float> output(number_of_samples);
+      oversampler.Decimate(input.data(), number_of_samples, output.data());
+
+      // Attenuated by more than 60dB
+      EXPECT_LT(Rms(output, settle), 1e-3 * Rms(input, 0))
+          << factor << "x, " << ratio << " x sampling rate";
+    }
+  }
+}
+
+TEST(OversamplerTest, HandleBlocks) {
+  const size_t number_of_samples = 5000;
+  const size_t factor = 8;
+  mt19937 generator(7);
+  uniform_real_distribution<float> noise(-1.0f, 1.0f);
+  uniform_int_distribution<size_t> block_length(0, 300);
+
+  vector<float> input(factor * number_of_samples);
+  for (auto& it : input) it = noise(generator);
+
+  // 1. In one go
+  Oversampler oversampler(factor);
+  vector<float> expected(number_of_samples);
+  oversampler.Decimate(input.data(), number_of_samples, expected.data());
+
+  // 2. In blocks of random length, with small internal blocks. The state
+  //    carries over, so the result is identical.
+  Oversampler oversampler_blocks(factor, 100);
+  vector<float> output(number_of_samples);
+  for (size_t done = 0; done < number_of_samples;) {
+    size_t length = min(block_length(generator), number_of_samples - done);
+    oversampler_blocks.Decimate(input.data() + done * factor, length,
+                                output.data() + done);
+    done += length;
+  }
+  EXPECT_THAT(output, ::testing::ContainerEq(expected));
+
+  // 3. Rendered through the callback
+  Oversampler oversampler_render(factor);
+  size_t rendered = 0;
+  oversampler_render.Process(
+      [&](float* samples, size_t length) {
+        EXPECT_LE(length, factor * oversampler_render.block_size());
+        copy(input.begin() + rendered, input.begin() + rendered + length,
+             samples);
+        rendered += length;
+      },
+      number_of_samples, output.data());
+  EXPECT_EQ(rendered, input.size());
+  EXPECT_THAT(output, ::testing::ContainerEq(expected));
+
+  // 4. Reset() forgets the previous signal
+  oversampler_render.Reset();
+  oversampler_render.Decimate(input.data(), number_of_samples, output.data());
+  EXPECT_THAT(output, ::testing::ContainerEq(expected));
+}
+//========================================================================
+// End of file
+//========================================================================
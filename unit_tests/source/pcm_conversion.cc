@@ -0,0 +1,154 @@
+//========================================================================
+// FILE:
+//    unit_tests/source/pcm_conversion.cc
+//
+// AUTHOR:
+//    zimzum@github
+//
+// DESCRIPTION:
+//    Tests the PCM sample conversion routines.
+//
+// License: GNU GPL v2.0
+//========================================================================
+
+#include <common/pcm_conversion.h>
+#include <global/global_variables.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace std;
+
+//========================================================================
+// UTILITIES
+//========================================================================
+//------------------------------------------------------------------------
+//  NAME:
+//      GenerateChannels
+//
+//  DESCRIPTION:
+//      Generates planar channels in which every sample is unique, so that
+//      any sample that ends up in the wrong place is detected.
+//------------------------------------------------------------------------
+static vector<vector<int16_t>> GenerateChannels(size_t number_of_channels,
+                                                size_t number_of_frames) {
+  vector<vector<int16_t>> channels(number_of_channels,
+                                   vector<int16_t>(number_of_frames));
+
+  for (size_t channel = 0; channel < number_of_channels; channel++) {
+    for (size_t frame = 0; frame < number_of_frames; frame++) {
+      channels[channel][frame] =
+          static_cast<int16_t>(frame * number_of_channels + channel);
+    }
+  }
+
+  return channels;
+}
+
+//========================================================================
+// TESTS
+//========================================================================
+TEST(PcmConversionTest, InterleaveChannels) {
+  // Frame counts around the SIMD width and around the block size
+  vector<size_t> frame_counts = {0, 1, 7, 8, 9, 1000,
+                                 2 * kInterleaveBlockSize + 5};
+
+  for (size_t number_of_channels = 1; number_of_channels <= 8;
+       number_of_channels++) {
+    for (auto number_of_frames : frame_counts) {
+      vector<vector<int16_t>> channels =
+          GenerateChannels(number_of_channels, number_of_frames);
+      vector<const int16_t *> inputs;
+      for (auto &channel : channels) inputs.push_back(channel.data());
+
+      vector<int16_t> interleaved(number_of_channels * number_of_frames);
+      InterleaveChannels(inputs.data(), number_of_channels, number_of_frames,
+                         interleaved.data());
+
+      // The channels were generated so that interleaving them gives
+      // 0, 1, 2, ...
+      vector<int16_t> expected(interleaved.size());
+      for (size_t idx = 0; idx < expected.size(); idx++) {
+        expected[idx] = static_cast<int16_t>(idx);
+      }
+      EXPECT_THAT(interleaved, ::testing::ContainerEq(expected))
+          << number_of_channels << " channels, " << number_of_frames
+          << " frames";
+    }
+  }
+}
+
+TEST(PcmConversionTest, ConvertPcm16) {
+  // 1. Every 16-bit sample survives the round trip through float
+  vector<int16_t> samples(65536);
+  for (size_t idx = 0; idx < samples.size(); idx++) {
+    samples[idx] = static_cast<int16_t>(static_cast<int32_t>(idx) - 32768);
+  }
+
+  vector<float> converted(samples.size());
+  ConvertPcm16ToFloat(samples.data(), samples.size(), converted.data());
+  EXPECT_EQ(converted[0], -1.0f);
+  EXPECT_EQ(converted[32768], 0.0f);
+
+  vector<int16_t> round_trip(samples.size());
+  ConvertFloatToPcm16(converted.data(), converted.size(), round_trip.data());
+  EXPECT_THAT(round_trip, ::testing::ContainerEq(samples));
+
+  // 2. Out of range samples are clipped, the rest rounded. Enough samples
+  //    for both the SIMD and the scalar code.
+  vector<float> input = {-2.0f,        -1.0f,         1.0f,
+                         2.0f,         1e10f,         -1e10f,
+                         0.4f / 32768, 0.6f / 32768,  -0.6f / 32768,
+                         100.4f / 32768, 0.5f,        -0.5f};
+  vector<int16_t> expected = {-32768, -32768, 32767, 32767, 32767,  -32768,
+                              0,      1,      -1,    100,   16384, -16384};
+  vector<int16_t> output(input.size());
+  ConvertFloatToPcm16(input.data(), input.size(), output.data());
+  EXPECT_THAT(output, ::testing::ContainerEq(expected));
+}
+
+TEST(PcmConversionTest, ConvertPcm24) {
+  // 1. 24-bit samples (including the extremes) survive the round trip
+  //    through float. Odd counts exercise the scalar code too.
+  vector<int32_t> values = {-8388608, 8388607, 0, -1, 1};
+  for (int32_t value = -8388608; value < 8388607; value += 4099) {
+    values.push_back(value);
+  }
+
+  for (size_t number_of_samples : {values.size(), size_t(7), size_t(1)}) {
+    vector<uint8_t> packed(3 * number_of_samples);
+    for (size_t idx = 0; idx < number_of_samples; idx++) {
+      packed[3 * idx] = static_cast<uint8_t>(values[idx]);
+      packed[3 * idx + 1] = static_cast<uint8_t>(values[idx] >> 8);
+      packed[3 * idx + 2] = static_cast<uint8_t>(values[idx] >> 16);
+    }
+
+    vector<float> converted(number_of_samples);
+    ConvertPcm24ToFloat(packed.data(), number_of_samples, converted.data());
+    for (size_t idx = 0; idx < number_of_samples; idx++) {
+      EXPECT_EQ(converted[idx], values[idx] / 8388608.0f);
+    }
+
+    vector<uint8_t> round_trip(packed.size());
+    ConvertFloatToPcm24(converted.data(), number_of_samples,
+                        round_trip.data());
+    EXPECT_THAT(round_trip, ::testing::ContainerEq(packed));
+  }
+
+  // 2. Out of range samples are clipped
+  vector<float> input(9, 2.0f);
+  input[8] = -2.0f;
+  vector<uint8_t> output(3 * input.size());
+  ConvertFloatToPcm24(input.data(), input.size(), output.data());
+  for (size_t idx = 0; idx < 8; idx++) {
+    EXPECT_EQ(output[3 * idx], 0xFF);
+    EXPECT_EQ(output[3 * idx + 1], 0xFF);
+    EXPECT_EQ(output[3 * idx + 2], 0x7F);
+  }
+  EXPECT_EQ(output[24], 0x00);
+  EXPECT_EQ(output[25], 0x00);
+  EXPECT_EQ(output[26], 0x80);
+}
+//========================================================================
+// End of file
+//========================================================================
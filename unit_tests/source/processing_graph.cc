@@ -0,0 +1,353 @@
+//========================================================================
+// FILE:
+//    unit_tests/source/processing_graph.cc
+//
+// AUTHOR:
+//    zimzum@github
+//
+// DESCRIPTION:
+//    Tests the ProcessingGraph class and its nodes.
+//
+// License: GNU GPL v2.0
+//========================================================================
+
+#include <common/synth_config.h>
+#include <envelope/segment.h>
+#include <global/global_variables.h>
+#include <graph/processing_graph.h>
+#include <graph/processor_nodes.h>
+#include <voice/voice_manager.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+using namespace std;
+
+//========================================================================
+// UTILITIES
+//========================================================================
+//------------------------------------------------------------------------
+//  NAME:
+//      AddSink
+//
+//  DESCRIPTION:
+//      Adds a sink that appends everything it receives to the vector,
+//      and connects the given node to it.
+//------------------------------------------------------------------------
+static size_t AddSink(ProcessingGraph& graph, size_t source,
+                      vector<float>& samples) {
+  size_t sink = graph.AddNode(unique_ptr<ProcessorNode>(
+      new SinkNode([&samples](const float* block, size_t length) {
+        samples.insert(samples.end(), block, block + length);
+      })));
+  graph.Connect(source, sink);
+
+  return sink;
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      AddPolyphonicPatch
+//
+//  DESCRIPTION:
+//      Adds eight FM voices, each with its own envelope, mixed into two
+//      buses that are mixed into a sink. Every voice is an independent
+//      branch of the graph.
+//------------------------------------------------------------------------
+static void AddPolyphonicPatch(ProcessingGraph& graph,
+                               const SynthConfig& synthesiser,
+                               vector<float>& samples) {
+  const size_t number_of_voices = 8;
+  vector<unique_ptr<Segment>> segments;
+  segments.emplace_back(
+      new LinearSegment(1.0f, 700, SegmentGradient::kIncline));
+  segments.emplace_back(new ConstantSegment(0.6f, 900));
+
+  size_t buses[2];
+  for (size_t& bus : buses) {
+    bus = graph.AddNode(unique_ptr<ProcessorNode>(
+        new MixerNode(vector<float>(number_of_voices / 2, 0.125f))));
+  }
+
+  for (size_t voice = 0; voice < number_of_voices; voice++) {
+    double frequency = 110.0 * (voice + 1);
+    size_t modulator = graph.AddNode(unique_ptr<ProcessorNode>(
+        new OscillatorNode(synthesiser, Waveform::kSine, 1.0f,
+                           frequency * 1.5)));
+    size_t carrier = graph.AddNode(unique_ptr<ProcessorNode>(
+        new FmNode(synthesiser, Waveform::kSine, 0.8f, frequency,
+                   0.5 * voice)));
+    size_t envelope =
+        graph.AddNode(unique_ptr<ProcessorNode>(new EnvelopeNode(segments)));
+    graph.Connect(modulator, carrier);
+    graph.Connect(carrier, envelope);
+    graph.Connect(envelope, buses[voice % 2], voice / 2);
+  }
+
+  size_t master = graph.AddNode(
+      unique_ptr<ProcessorNode>(new MixerNode(vector<float>{1.0f, 0.5f})));
+  graph.Connect(buses[0], master, 0);
+  graph.Connect(buses[1], master, 1);
+  AddSink(graph, master, samples);
+}
+
+//========================================================================
+// TESTS
+//========================================================================
+TEST(ProcessingGraphTest, RenderPatch) {
+  const SynthConfig synthesiser(kCdSampleRate);
+  const size_t number_of_samples = 3000;
+  vector<float> samples;
+
+  // An oscillator with an envelope. The nodes are added in the reverse
+  // order, so the graph has to work out the order.
+  vector<unique_ptr<Segment>> segments;
+  segments.emplace_back(
+      new LinearSegment(1.0f, 1000, SegmentGradient::kIncline));
+  segments.emplace_back(new ConstantSegment(0.5f, 500));
+  vector<float> gains = segments[0]->GetSamples();
+  for (size_t idx = 0; idx < 2000; idx++) gains.push_back(0.5f);
+
+  ProcessingGraph graph;
+  size_t envelope =
+      graph.AddNode(unique_ptr<ProcessorNode>(new EnvelopeNode(segments)));
+  size_t oscillator = graph.AddNode(unique_ptr<ProcessorNode>(
+      new OscillatorNode(synthesiser, Waveform::kSine, 0.5f, 440.0)));
+  size_t sink = AddSink(graph, envelope, samples);
+  graph.Connect(oscillator, envelope);
+  ASSERT_TRUE(graph.Compile());
+  EXPECT_THAT(graph.schedule(),
+              ::testing::ElementsAre(oscillator, envelope, sink));
+
+  graph.Process(number_of_samples);
+  ASSERT_EQ(samples.size(), number_of_samples);
+
+  double phase_increment = synthesiser.phase_increment_per_sample() * 440.0;
+  for (size_t idx = 0; idx < number_of_samples; idx++) {
+    double expected = 0.5 * sin(phase_increment * idx) * gains[idx];
+    ASSERT_NEAR(samples[idx], expected, 1e-5) << idx;
+  }
+}
+
+TEST(ProcessingGraphTest, RenderFm) {
+  const SynthConfig synthesiser(kCdSampleRate);
+  const size_t number_of_samples = 3000;
+  const double index_of_modulation = 2.0;
+  vector<float> samples;
+
+  ProcessingGraph graph(100);
+  size_t modulator = graph.AddNode(unique_ptr<ProcessorNode>(
+      new OscillatorNode(synthesiser, Waveform::kSine, 1.0f, 220.0)));
+  size_t carrier = graph.AddNode(unique_ptr<ProcessorNode>(
+      new FmNode(synthesiser, Waveform::kSine, 0.5f, 440.0,
+                 index_of_modulation)));
+  graph.Connect(modulator, carrier);
+  AddSink(graph, carrier, samples);
+  ASSERT_TRUE(graph.Compile());
+  graph.Process(number_of_samples);
+
+  double phase_increment = synthesiser.phase_increment_per_sample() * 220.0;
+  for (size_t idx = 0; idx < number_of_samples; idx++) {
+    double modulation = sin(phase_increment * idx);
+    double expected = 0.5 * sin(2.0 * phase_increment * idx +
+                                index_of_modulation * modulation);
+    ASSERT_NEAR(samples[idx], expected, 1e-4) << idx;
+  }
+}
+
+TEST(ProcessingGraphTest, ReuseBuffers) {
+  const SynthConfig synthesiser(kCdSampleRate);
+  vector<float> samples;
+
+  // 1. A long chain only ever needs two buffers
+  ProcessingGraph chain;
+  vector<unique_ptr<Segment>> segments;
+  segments.emplace_back(new ConstantSegment(0.5f, 100));
+  size_t previous = chain.AddNode(unique_ptr<ProcessorNode>(
+      new OscillatorNode(synthesiser, Waveform::kSquare, 1.0f, 100.0)));
+  for (size_t idx = 0; idx < 10; idx++) {
+    size_t envelope =
+        chain.AddNode(unique_ptr<ProcessorNode>(new EnvelopeNode(segments)));
+    chain.Connect(previous, envelope);
+    previous = envelope;
+  }
+  AddSink(chain, previous, samples);
+  ASSERT_TRUE(chain.Compile());
+  EXPECT_EQ(chain.number_of_buffers(), 2);
+  chain.Process(10);
+  EXPECT_THAT(samples, ::testing::Each(-1.0f / 1024));
+
+  // 2. Two branches of a diamond are alive at the same time, and the
+  //    buffer of the source is reused for the mix. Every branch takes
+  //    a different share of the source, so a buffer written too early
+  //    would show in the mix.
+  ProcessingGraph diamond(64);
+  size_t source = diamond.AddNode(unique_ptr<ProcessorNode>(
+      new OscillatorNode(synthesiser, Waveform::kSine, 1.0f, 1000.0)));
+  size_t left = diamond.AddNode(
+      unique_ptr<ProcessorNode>(new MixerNode(vector<float>{0.25f})));
+  size_t right = diamond.AddNode(
+      unique_ptr<ProcessorNode>(new MixerNode(vector<float>{0.5f})));
+  size_t mixer = diamond.AddNode(
+      unique_ptr<ProcessorNode>(new MixerNode(vector<float>{1.0f, 1.0f})));
+  diamond.Connect(source, left);
+  diamond.Connect(source, right);
+  diamond.Connect(left, mixer, 0);
+  diamond.Connect(right, mixer, 1);
+  samples.clear();
+  AddSink(diamond, mixer, samples);
+  ASSERT_TRUE(diamond.Compile());
+  EXPECT_EQ(diamond.number_of_buffers(), 3);
+  diamond.Process(1000);
+
+  double phase_increment = synthesiser.phase_increment_per_sample() * 1000.0;
+  for (size_t idx = 0; idx < samples.size(); idx++) {
+    ASSERT_NEAR(samples[idx], 0.75 * sin(phase_increment * idx), 1e-5);
+  }
+}
+
+TEST(ProcessingGraphTest, RejectInvalidGraphs) {
+  const SynthConfig synthesiser(kCdSampleRate);
+
+  // 1. An input that isn't connected
+  ProcessingGraph unconnected;
+  unconnected.AddNode(
+      unique_ptr<ProcessorNode>(new MixerNode(vector<float>{1.0f, 1.0f})));
+  EXPECT_FALSE(unconnected.Compile());
+
+  // 2. A cycle
+  ProcessingGraph cycle;
+  size_t oscillator = cycle.AddNode(unique_ptr<ProcessorNode>(
+      new OscillatorNode(synthesiser, Waveform::kSine, 1.0f, 100.0)));
+  size_t first = cycle.AddNode(
+      unique_ptr<ProcessorNode>(new MixerNode(vector<float>{1.0f, 1.0f})));
+  size_t second = cycle.AddNode(
+      unique_ptr<ProcessorNode>(new MixerNode(vector<float>{1.0f})));
+  cycle.Connect(oscillator, first, 0);
+  cycle.Connect(second, first, 1);
+  cycle.Connect(first, second);
+  EXPECT_FALSE(cycle.Compile());
+  EXPECT_FALSE(cycle.is_compiled());
+
+  // 3. Breaking the cycle fixes it
+  cycle.Connect(oscillator, first, 1);
+  EXPECT_TRUE(cycle.Compile());
+}
+
+TEST(ProcessingGraphTest, RenderVoices) {
+  const SynthConfig synthesiser(kCdSampleRate);
+  VoiceParameters parameters;
+  VoiceManager voices(synthesiser, parameters);
+  VoiceManager expected_voices(synthesiser, parameters);
+  vector<float> samples;
+
+  ProcessingGraph graph;
+  size_t voice_node =
+      graph.AddNode(unique_ptr<ProcessorNode>(new VoiceNode(voices)));
+  AddSink(graph, voice_node, samples);
+  ASSERT_TRUE(graph.Compile());
+
+  voices.NoteOn(48);
+  voices.NoteOn(52);
+  graph.Process(5000);
+  voices.NoteOff(48);
+  graph.Process(5000);
+
+  vector<float> expected(10000);
+  expected_voices.NoteOn(48);
+  expected_voices.NoteOn(52);
+  for (size_t done = 0; done < 5000; done += graph.block_size()) {
+    expected_voices.Render(expected.data() + done,
+                           min(graph.block_size(), 5000 - done));
+  }
+  expected_voices.NoteOff(48);
+  for (size_t done = 5000; done < 10000; done += graph.block_size()) {
+    expected_voices.Render(expected.data() + done,
+                           min(graph.block_size(), 10000 - done));
+  }
+
+  EXPECT_THAT(samples, ::testing::ContainerEq(expected));
+}
+
+TEST(ProcessingGraphTest, RunOnThreads) {
+  const SynthConfig synthesiser(kCdSampleRate);
+  const size_t number_of_samples = 5000;
+
+  vector<float> expected;
+  ProcessingGraph serial(100);
+  AddPolyphonicPatch(serial, synthesiser, expected);
+  ASSERT_TRUE(serial.Compile());
+  serial.Process(number_of_samples);
+  ASSERT_EQ(expected.size(), number_of_samples);
+
+  // The output doesn't depend on the number of threads
+  for (size_t number_of_threads : {1, 2, 4, 8}) {
+    vector<float> samples;
+    ProcessingGraph graph(100, number_of_threads);
+    AddPolyphonicPatch(graph, synthesiser, samples);
+    ASSERT_TRUE(graph.Compile());
+    EXPECT_EQ(graph.number_of_threads(), number_of_threads);
+
+    graph.Process(number_of_samples / 2);
+    graph.Process(number_of_samples - number_of_samples / 2);
+    EXPECT_THAT(samples, ::testing::ContainerEq(expected))
+        << number_of_threads << " threads";
+  }
+}
+
+TEST(ProcessingGraphTest, ReuseBuffersOnThreads) {
+  const SynthConfig synthesiser(kCdSampleRate);
+  vector<float> first;
+  vector<float> second;
+
+  // 1. Branches that may run at the same time never share a buffer:
+  //    run in order, the second branch reuses the buffer of the first
+  ProcessingGraph serial;
+  ProcessingGraph parallel(kGraphBlockSize, 2);
+  for (ProcessingGraph* graph : {&serial, &parallel}) {
+    vector<float>& samples = (graph == &serial) ? first : second;
+    size_t oscillator = graph->AddNode(unique_ptr<ProcessorNode>(
+        new OscillatorNode(synthesiser, Waveform::kSine, 1.0f, 100.0)));
+    graph->AddNode(unique_ptr<ProcessorNode>(new SinkNode(
+        [](const float* block, size_t length) {})));
+    graph->Connect(oscillator, 1);
+    size_t previous = graph->AddNode(unique_ptr<ProcessorNode>(
+        new OscillatorNode(synthesiser, Waveform::kSine, 1.0f, 200.0)));
+    for (size_t idx = 0; idx < 2; idx++) {
+      size_t mixer = graph->AddNode(
+          unique_ptr<ProcessorNode>(new MixerNode(vector<float>{0.5f})));
+      graph->Connect(previous, mixer);
+      previous = mixer;
+    }
+    AddSink(*graph, previous, samples);
+    ASSERT_TRUE(graph->Compile());
+    graph->Process(1000);
+  }
+  EXPECT_EQ(serial.number_of_buffers(), 2);
+  EXPECT_EQ(parallel.number_of_buffers(), 3);
+  EXPECT_THAT(second, ::testing::ContainerEq(first));
+
+  // 2. Buffers are still reused along the dependencies
+  ProcessingGraph chain(kGraphBlockSize, 4);
+  vector<unique_ptr<Segment>> segments;
+  segments.emplace_back(new ConstantSegment(0.5f, 100));
+  size_t previous = chain.AddNode(unique_ptr<ProcessorNode>(
+      new OscillatorNode(synthesiser, Waveform::kSquare, 1.0f, 100.0)));
+  for (size_t idx = 0; idx < 10; idx++) {
+    size_t envelope =
+        chain.AddNode(unique_ptr<ProcessorNode>(new EnvelopeNode(segments)));
+    chain.Connect(previous, envelope);
+    previous = envelope;
+  }
+  first.clear();
+  AddSink(chain, previous, first);
+  ASSERT_TRUE(chain.Compile());
+  EXPECT_EQ(chain.number_of_buffers(), 2);
+  chain.Process(10);
+  EXPECT_THAT(first, ::testing::Each(-1.0f / 1024));
+}
+//========================================================================
+// End of file
+//========================================================================
@@ -11,14 +11,23 @@
 // License: GNU GPL v2.0
 //========================================================================
 
+#include <common/async_wave_writer.h>
+#include <common/pcm_conversion.h>
+#include <common/pcm_stream_out.h>
 #include <common/synth_config.h>
+#include <common/wave_export_manager.h>
 #include <common/wave_file.h>
+#include <envelope/envelope.h>
 #include <global/global_variables.h>
 #include <oscillator/oscillator.h>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <unistd.h>
+#include <cstring>
+#include <thread>
+
 using namespace std;
 
 //========================================================================
@@ -27,7 +36,11 @@ using namespace std;
 void CompareWaveHeaders(WaveFileOut &wf_out, WaveFileIn &wf_in);
 void CompareWaveHeaders(WaveFileOut &wf_out, WaveFileIn &wf_in) {
   EXPECT_EQ(wf_out.chunk_id(), wf_in.chunk_id());
-  EXPECT_EQ(wf_out.chunk_size(), wf_in.chunk_size());
+  // The files may differ in the space reserved for the "ds64" chunk
+  EXPECT_EQ(wf_out.chunk_size() - wf_out.header_size(),
+            wf_in.chunk_size() - wf_in.header_size());
+  EXPECT_EQ(wf_out.data_size(), wf_in.data_size());
+  EXPECT_EQ(wf_out.is_rf64(), wf_in.is_rf64());
   EXPECT_EQ(wf_out.format(), wf_in.format());
   EXPECT_EQ(wf_out.subchunk_1_id(), wf_in.subchunk_1_id());
   EXPECT_EQ(wf_out.subchunk_1_size(), wf_in.subchunk_1_size());
@@ -54,8 +67,7 @@ TEST(ReadWriteWaveFileTest, HandleDifferentPitches) {
   const string file_name("test_pitch.wav");
 
   // Initialise the synthesiser
-  SynthConfig &synthesiser = SynthConfig::getInstance();
-  synthesiser.Init();
+  const SynthConfig synthesiser(kCdSampleRate);
 
   for (auto it = pitch.begin(); it != pitch.end(); it++) {
     // 1. Generate the samples
@@ -85,8 +97,7 @@ TEST(ReadWriteWaveFileTest, HandleDifferentVolumes) {
   const string file_name("test_volume.wav");
 
   // Initialise the synthesiser
-  SynthConfig &synthesiser = SynthConfig::getInstance();
-  synthesiser.Init();
+  const SynthConfig synthesiser(kCdSampleRate);
 
   for (auto it = volume.begin(); it != volume.end(); it++) {
     // 1. Generate the samples
@@ -116,8 +127,7 @@ TEST(ReadWriteWaveFileTest, HandleDifferentDuration) {
   const string file_name("test_duration.wav");
 
   // Initialise the synthesiser
-  SynthConfig &synthesiser = SynthConfig::getInstance();
-  synthesiser.Init();
+  const SynthConfig synthesiser(kCdSampleRate);
 
   for (auto it = duration.begin(); it != duration.end(); it++) {
     // 1. Generate the samples
@@ -138,6 +148,699 @@ TEST(ReadWriteWaveFileTest, HandleDifferentDuration) {
     EXPECT_THAT(samples_in, ::testing::ContainerEq(samples_out));
   }
 }
+
+TEST(ReadWriteWaveFileTest, MapFile) {
+  size_t pitch = 48;
+  int16_t volume = 1 << 14;
+  vector<uint32_t> duration = {0, 1, 7};
+  double initial_phase = 0;
+  const string file_name("test_map.wav");
+
+  // Initialise the synthesiser
+  const SynthConfig synthesiser(kCdSampleRate);
+
+  for (auto it : duration) {
+    // 1. Generate the samples and save them to the file
+    SineWaveform osc(synthesiser, volume, initial_phase, pitch);
+    vector<int16_t> samples_out = osc(it);
+
+    WaveFileOut wf_out(it);
+    wf_out.SaveBufferToFile(file_name, samples_out);
+
+    // 2. Map the file saved in Step 1
+    WaveFileIn wf_in;
+    WaveFileMapping mapping = wf_in.MapBufferFromFile(file_name);
+
+    // 3. Validate by comparing input and output
+    CompareWaveHeaders(wf_out, wf_in);
+    vector<int16_t> samples_in(mapping.begin(), mapping.end());
+    EXPECT_THAT(samples_in, ::testing::ContainerEq(samples_out));
+
+    // 4. The view survives being moved
+    WaveFileMapping mapping_moved(std::move(mapping));
+    EXPECT_TRUE(mapping.empty());
+    EXPECT_EQ(mapping_moved.size(), samples_out.size());
+  }
+
+  // A file that doesn't exist gives an empty view
+  WaveFileIn wf_in;
+  EXPECT_TRUE(wf_in.MapBufferFromFile("does_not_exist.wav").empty());
+}
+
+TEST(ReadWriteWaveFileTest, RenderIntoMappedFile) {
+  size_t pitch = 48;
+  int16_t volume = 1 << 14;
+  vector<uint32_t> duration = {0, 1, 7};
+  double initial_phase = 0;
+  const string file_name("test_map_out.wav");
+
+  // Initialise the synthesiser
+  const SynthConfig synthesiser(kCdSampleRate);
+
+  for (auto it : duration) {
+    SineWaveform osc(synthesiser, volume, initial_phase, pitch);
+    ArEnvelope envelope(synthesiser, 1.0f, 0.25, 0.25);
+
+    // 1. The expected samples, rendered into a vector
+    vector<int16_t> samples_out = osc(it);
+    if (it > 0) envelope.ApplyEnvelope(samples_out);
+
+    // 2. Render the same samples straight into the file
+    WaveFileOut wf_out(it);
+    {
+      WaveFileOutMapping mapping = wf_out.MapBufferToFile(file_name);
+      ASSERT_EQ(mapping.size(), samples_out.size());
+      osc(mapping.data(), mapping.size());
+      if (it > 0) envelope.ApplyEnvelope(mapping.data(), mapping.size());
+
+      // Evicted samples stay in the file, samples next to them are
+      // left alone
+      mapping.Evict(mapping.size() / 4, mapping.size() / 2);
+      vector<int16_t> samples_mapped(mapping.begin(), mapping.end());
+      EXPECT_THAT(samples_mapped, ::testing::ContainerEq(samples_out));
+
+      // The view survives being moved
+      WaveFileOutMapping mapping_moved(std::move(mapping));
+      EXPECT_TRUE(mapping.empty());
+      EXPECT_EQ(mapping_moved.size(), samples_out.size());
+    }
+
+    // 3. Validate by reading the file back
+    WaveFileIn wf_in;
+    vector<int16_t> samples_in = wf_in.ReadBufferFromFile(file_name);
+    CompareWaveHeaders(wf_out, wf_in);
+    EXPECT_THAT(samples_in, ::testing::ContainerEq(samples_out));
+  }
+
+  // A file that can't be created gives an empty view
+  WaveFileOut wf_out(1);
+  EXPECT_TRUE(wf_out.MapBufferToFile("does_not_exist/test.wav").empty());
+}
+
+TEST(ReadWriteWaveFileTest, StreamFile) {
+  size_t pitch = 48;
+  int16_t volume = 1 << 14;
+  uint32_t duration = 3;
+  double initial_phase = 0;
+  vector<size_t> block_sizes = {1, 1000, 4096};
+  const string file_name("test_stream.wav");
+
+  // Initialise the synthesiser
+  const SynthConfig synthesiser(kCdSampleRate);
+
+  SineWaveform osc(synthesiser, volume, initial_phase, pitch);
+  vector<int16_t> samples_out = osc(duration);
+  WaveFileOut wf_out(duration);
+
+  for (auto block_size : block_sizes) {
+    // 1. Stream the samples to the file, one block at a time
+    WaveFileStreamOut wf_stream;
+    ASSERT_TRUE(wf_stream.Open(file_name));
+    for (size_t idx = 0; idx < samples_out.size(); idx += block_size) {
+      size_t length = min(block_size, samples_out.size() - idx);
+      ASSERT_TRUE(wf_stream.Append(samples_out.data() + idx, length));
+    }
+    EXPECT_EQ(wf_stream.number_of_samples_written(), samples_out.size());
+    ASSERT_TRUE(wf_stream.Close());
+    EXPECT_FALSE(wf_stream.IsOpen());
+
+    // 2. The result is identical to a file saved in one go
+    WaveFileIn wf_in;
+    vector<int16_t> samples_in = wf_in.ReadBufferFromFile(file_name);
+    CompareWaveHeaders(wf_out, wf_in);
+    EXPECT_THAT(samples_in, ::testing::ContainerEq(samples_out));
+  }
+
+  // A file that's never appended to is a valid, empty WAVE file
+  {
+    WaveFileStreamOut wf_stream;
+    ASSERT_TRUE(wf_stream.Open(file_name));
+  }
+  WaveFileOut wf_empty(0);
+  WaveFileIn wf_in;
+  EXPECT_TRUE(wf_in.ReadBufferFromFile(file_name).empty());
+  CompareWaveHeaders(wf_empty, wf_in);
+}
+
+TEST(ReadWriteWaveFileTest, HandleDifferentSampleRates) {
+  size_t pitch = 48;
+  int16_t volume = 1 << 14;
+  uint32_t duration = 2;
+  uint32_t sample_rate = 96000;
+  double initial_phase = 0;
+  const string file_name("test_sample_rate.wav");
+
+  // Initialise the synthesiser
+  const SynthConfig synthesiser(sample_rate);
+
+  SineWaveform osc(synthesiser, volume, initial_phase, pitch);
+  vector<int16_t> samples_out = osc(duration);
+  ASSERT_EQ(samples_out.size(), size_t(duration) * sample_rate);
+
+  // 1. Saved in one go
+  WaveFileOut wf_out(duration, kNumberOfChannelsMono, SampleFormat::kPcm16,
+                     sample_rate);
+  EXPECT_EQ(wf_out.sample_rate(), sample_rate);
+  EXPECT_EQ(wf_out.byte_rate(), sample_rate * sizeof(int16_t));
+  ASSERT_TRUE(wf_out.SaveBufferToFile(file_name, samples_out));
+
+  WaveFileIn wf_in;
+  vector<int16_t> samples_in = wf_in.ReadBufferFromFile(file_name);
+  CompareWaveHeaders(wf_out, wf_in);
+  EXPECT_THAT(samples_in, ::testing::ContainerEq(samples_out));
+
+  // 2. Streamed
+  WaveFileStreamOut wf_stream(kNumberOfChannelsMono, SampleFormat::kPcm16,
+                              sample_rate);
+  ASSERT_TRUE(wf_stream.Open(file_name));
+  ASSERT_TRUE(wf_stream.Append(samples_out));
+  ASSERT_TRUE(wf_stream.Close());
+
+  WaveFileIn wf_in_stream;
+  samples_in = wf_in_stream.ReadBufferFromFile(file_name);
+  CompareWaveHeaders(wf_out, wf_in_stream);
+  EXPECT_THAT(samples_in, ::testing::ContainerEq(samples_out));
+}
+
+TEST(ReadWriteWaveFileTest, WriteFileAsynchronously) {
+  size_t pitch = 48;
+  int16_t volume = 1 << 14;
+  uint32_t duration = 3;
+  double initial_phase = 0;
+  const string file_name("test_async.wav");
+
+  // Initialise the synthesiser
+  const SynthConfig synthesiser(kCdSampleRate);
+
+  SineWaveform osc(synthesiser, volume, initial_phase, pitch);
+  vector<int16_t> samples_out = osc(duration);
+  WaveFileOut wf_out(duration);
+
+  // 1. Copy the samples into the writer's blocks. With only 2 small
+  //    blocks the render thread is bound to catch up with the disk.
+  AsyncWaveWriter writer(1000, 2);
+  ASSERT_TRUE(writer.Open(file_name));
+  writer.Write(samples_out.data(), samples_out.size());
+  ASSERT_TRUE(writer.Close());
+  EXPECT_FALSE(writer.IsOpen());
+
+  size_t number_of_blocks = (samples_out.size() + 999) / 1000;
+  EXPECT_EQ(writer.metrics().number_of_blocks_submitted, number_of_blocks);
+  EXPECT_GE(writer.metrics().max_queue_depth, 1u);
+  EXPECT_LE(writer.metrics().max_queue_depth, 2u);
+
+  WaveFileIn wf_in;
+  vector<int16_t> samples_in = wf_in.ReadBufferFromFile(file_name);
+  CompareWaveHeaders(wf_out, wf_in);
+  EXPECT_THAT(samples_in, ::testing::ContainerEq(samples_out));
+
+  // 2. Render directly into the blocks, reusing the writer
+  ASSERT_TRUE(writer.Open(file_name));
+  EXPECT_EQ(writer.metrics().number_of_blocks_submitted, 0u);
+  for (size_t idx = 0; idx < samples_out.size(); idx += writer.block_size()) {
+    size_t length = min(writer.block_size(), samples_out.size() - idx);
+    int16_t *block = writer.AcquireBlock();
+    copy(samples_out.begin() + idx, samples_out.begin() + idx + length,
+         block);
+    writer.SubmitBlock(length);
+  }
+  ASSERT_TRUE(writer.Close());
+
+  WaveFileIn wf_in_direct;
+  samples_in = wf_in_direct.ReadBufferFromFile(file_name);
+  CompareWaveHeaders(wf_out, wf_in_direct);
+  EXPECT_THAT(samples_in, ::testing::ContainerEq(samples_out));
+}
+
+TEST(ReadWriteWaveFileTest, ExportFilesInParallel) {
+  vector<size_t> pitch = {20, 30, 40, 50, 60, 70, 80, 90, 100};
+  int16_t volume = 1 << 14;
+  uint32_t duration = 1;
+  double initial_phase = 0;
+  char file_name[100];
+
+  // Initialise the synthesiser
+  const SynthConfig synthesiser(kCdSampleRate);
+
+  // 1. Render and submit the files. With only 2 slots the renderer is
+  //    bound to catch up with the I/O threads.
+  WaveExportManager exporter(3, 2);
+  for (size_t idx = 0; idx < pitch.size(); idx++) {
+    SineWaveform osc(synthesiser, volume, initial_phase, pitch[idx]);
+    sprintf(file_name, "test_export_%zu.wav", idx);
+    exporter.Submit(file_name, osc(duration));
+  }
+  ASSERT_TRUE(exporter.Finish());
+
+  WaveExportMetrics metrics = exporter.metrics();
+  EXPECT_EQ(metrics.number_of_files, pitch.size());
+  EXPECT_EQ(metrics.number_of_failures, 0u);
+  EXPECT_GE(metrics.max_files_in_flight, 1u);
+  EXPECT_LE(metrics.max_files_in_flight, 2u);
+  EXPECT_GT(exporter.files_per_second(), 0.0);
+  EXPECT_GT(exporter.bytes_per_second(), 0.0);
+
+  // 2. Validate every file
+  WaveFileOut wf_out(duration);
+  uint64_t number_of_bytes = 0;
+  for (size_t idx = 0; idx < pitch.size(); idx++) {
+    SineWaveform osc(synthesiser, volume, initial_phase, pitch[idx]);
+    vector<int16_t> samples_out = osc(duration);
+    sprintf(file_name, "test_export_%zu.wav", idx);
+
+    WaveFileIn wf_in;
+    vector<int16_t> samples_in = wf_in.ReadBufferFromFile(file_name);
+    CompareWaveHeaders(wf_out, wf_in);
+    EXPECT_EQ(wf_in.header_size(), kWaveFileCanonicalHeaderSize);
+    EXPECT_THAT(samples_in, ::testing::ContainerEq(samples_out));
+    number_of_bytes += wf_in.header_size() + wf_in.data_size();
+  }
+  EXPECT_EQ(metrics.number_of_bytes, number_of_bytes);
+
+  // 3. Any length and sample rate gets the same, canonical header
+  const uint32_t high_sample_rate = 96000;
+  vector<int16_t> samples_out(1001 * kNumberOfChannelsStereo);
+  for (size_t idx = 0; idx < samples_out.size(); idx++) {
+    samples_out[idx] = static_cast<int16_t>(idx);
+  }
+  WaveExportManager high_rate_exporter(1, 1);
+  high_rate_exporter.Submit("test_export_96k.wav", vector<int16_t>(samples_out),
+                            kNumberOfChannelsStereo, high_sample_rate);
+  ASSERT_TRUE(high_rate_exporter.Finish());
+
+  WaveFileIn wf_in_96k;
+  EXPECT_THAT(wf_in_96k.ReadBufferFromFile("test_export_96k.wav"),
+              ::testing::ContainerEq(samples_out));
+  EXPECT_EQ(wf_in_96k.sample_rate(), high_sample_rate);
+  EXPECT_EQ(wf_in_96k.num_channels(), kNumberOfChannelsStereo);
+  EXPECT_EQ(wf_in_96k.header_size(), kWaveFileCanonicalHeaderSize);
+  EXPECT_EQ(
+      high_rate_exporter.metrics().number_of_bytes,
+      kWaveFileCanonicalHeaderSize + samples_out.size() * sizeof(int16_t));
+
+  // 4. A file that can't be written is reported
+  WaveExportManager failing_exporter(1, 1);
+  failing_exporter.Submit("does_not_exist/test.wav", vector<int16_t>(10));
+  EXPECT_FALSE(failing_exporter.Finish());
+  EXPECT_EQ(failing_exporter.metrics().number_of_failures, 1u);
+}
+
+TEST(ReadWriteWaveFileTest, HandleRf64) {
+  size_t pitch = 48;
+  int16_t volume = 1 << 14;
+  uint32_t duration = 2;
+  double initial_phase = 0;
+  const string file_name("test_rf64.wav");
+
+  // Initialise the synthesiser
+  const SynthConfig synthesiser(kCdSampleRate);
+
+  SineWaveform osc(synthesiser, volume, initial_phase, pitch);
+  vector<int16_t> samples_out = osc(duration);
+
+  // 1. Files are promoted to RF64 only when the data exceeds 4GB
+  //    (about 13.5 hours of mono audio at 44.1kHz)
+  WaveFileOut wf_short(13 * 3600);
+  EXPECT_FALSE(wf_short.is_rf64());
+  EXPECT_EQ(wf_short.chunk_id(), kRiffChunkId);
+
+  WaveFileOut wf_long(14 * 3600);
+  EXPECT_TRUE(wf_long.is_rf64());
+  EXPECT_EQ(wf_long.chunk_id(), kRf64ChunkId);
+  EXPECT_EQ(wf_long.subchunk_2_size(), kRf64SizePlaceholder);
+  EXPECT_EQ(wf_long.data_size(), uint64_t(kCdSampleRate) * 2 * 14 * 3600);
+
+  // 2. Save and read back a (small) RF64 file
+  WaveFileOut wf_out(duration);
+  wf_out.ForceRf64();
+  EXPECT_EQ(wf_out.header_size(), kWaveFileExtendedHeaderSize);
+  EXPECT_EQ(wf_out.chunk_size(), kRf64SizePlaceholder);
+  wf_out.SaveBufferToFile(file_name, samples_out);
+
+  WaveFileIn wf_in;
+  vector<int16_t> samples_in = wf_in.ReadBufferFromFile(file_name);
+  CompareWaveHeaders(wf_out, wf_in);
+  EXPECT_THAT(samples_in, ::testing::ContainerEq(samples_out));
+
+  WaveFileIn wf_in_mapped;
+  WaveFileMapping mapping = wf_in_mapped.MapBufferFromFile(file_name);
+  CompareWaveHeaders(wf_out, wf_in_mapped);
+  samples_in.assign(mapping.begin(), mapping.end());
+  EXPECT_THAT(samples_in, ::testing::ContainerEq(samples_out));
+
+  // 3. The "ds64" chunk holds the actual sizes
+  uint8_t header[kWaveFileExtendedHeaderSize];
+  ifstream raw_file(file_name, ifstream::binary);
+  raw_file.read(reinterpret_cast<char *>(header), sizeof(header));
+  uint32_t ds64_id;
+  uint64_t ds64_data_size;
+  memcpy(&ds64_id, header + 12, sizeof(ds64_id));
+  memcpy(&ds64_data_size, header + 28, sizeof(ds64_data_size));
+  EXPECT_EQ(ds64_id, kDs64ChunkId);
+  EXPECT_EQ(ds64_data_size, samples_out.size() * sizeof(int16_t));
+
+  // 4. Streamed files are promoted when they're closed
+  {
+    WaveFileStreamOut wf_stream;
+    ASSERT_TRUE(wf_stream.Open(file_name));
+    ASSERT_TRUE(wf_stream.Append(samples_out));
+    wf_stream.ForceRf64();
+    ASSERT_TRUE(wf_stream.Close());
+  }
+  WaveFileIn wf_in_streamed;
+  samples_in = wf_in_streamed.ReadBufferFromFile(file_name);
+  CompareWaveHeaders(wf_out, wf_in_streamed);
+  EXPECT_THAT(samples_in, ::testing::ContainerEq(samples_out));
+}
+
+TEST(ReadWriteWaveFileTest, HandleMultipleChannels) {
+  vector<uint16_t> channel_counts = {kNumberOfChannelsMono,
+                                     kNumberOfChannelsStereo, 6};
+  int16_t volume = 1 << 14;
+  uint32_t duration = 2;
+  double initial_phase = 0;
+  const string file_name("test_channels.wav");
+
+  // Initialise the synthesiser
+  const SynthConfig synthesiser(kCdSampleRate);
+
+  for (auto number_of_channels : channel_counts) {
+    // 1. Generate a different pitch for every channel
+    vector<vector<int16_t>> channels;
+    for (size_t channel = 0; channel < number_of_channels; channel++) {
+      SineWaveform osc(synthesiser, volume, initial_phase, 40 + channel);
+      channels.push_back(osc(duration));
+    }
+
+    // 2. Save the planar channels to the file
+    WaveFileOut wf_out(duration, number_of_channels);
+    EXPECT_EQ(wf_out.block_align(), number_of_channels * sizeof(int16_t));
+    EXPECT_EQ(wf_out.byte_rate(),
+              kCdSampleRate * number_of_channels * sizeof(int16_t));
+    ASSERT_TRUE(wf_out.SaveBufferToFile(file_name, channels));
+
+    // 3. Read the file back - the samples come out interleaved
+    WaveFileIn wf_in;
+    vector<int16_t> samples_in = wf_in.ReadBufferFromFile(file_name);
+    CompareWaveHeaders(wf_out, wf_in);
+
+    vector<int16_t> expected;
+    for (size_t frame = 0; frame < channels[0].size(); frame++) {
+      for (size_t channel = 0; channel < number_of_channels; channel++) {
+        expected.push_back(channels[channel][frame]);
+      }
+    }
+    EXPECT_THAT(samples_in, ::testing::ContainerEq(expected));
+
+    // 4. A file that can't be written is reported
+    EXPECT_FALSE(wf_out.SaveBufferToFile("does_not_exist/test.wav", channels));
+
+    // 5. Too few channels
+    channels.pop_back();
+    EXPECT_THROW(wf_out.SaveBufferToFile(file_name, channels),
+                 BufferToSmallException);
+  }
+}
+
+TEST(ReadWriteWaveFileTest, HandleSampleFormats) {
+  vector<SampleFormat> formats = {SampleFormat::kPcm16, SampleFormat::kPcm24,
+                                  SampleFormat::kFloat32};
+  vector<uint16_t> bits = {16, 24, 32};
+  vector<uint16_t> audio_formats = {kPcmAudioFormat, kPcmAudioFormat,
+                                    kIeeeFloatAudioFormat};
+  // The worst quantisation error of every format
+  vector<float> tolerance = {0.5f / 32768, 0.5f / 8388608, 0.0f};
+  uint32_t duration = 2;
+  const string file_name("test_formats.wav");
+
+  // A sine wave, straight in floating point
+  vector<float> samples_out(kCdSampleRate * kNumberOfChannelsStereo *
+                            duration);
+  for (size_t idx = 0; idx < samples_out.size(); idx++) {
+    samples_out[idx] = static_cast<float>(0.9 * sin(0.01 * idx));
+  }
+
+  for (size_t format = 0; format < formats.size(); format++) {
+    // 1. Save the samples to the file
+    WaveFileOut wf_out(duration, kNumberOfChannelsStereo, formats[format]);
+    EXPECT_EQ(wf_out.sample_format(), formats[format]);
+    EXPECT_EQ(wf_out.bits_per_sample(), bits[format]);
+    EXPECT_EQ(wf_out.audio_format(), audio_formats[format]);
+    EXPECT_EQ(wf_out.data_size(), samples_out.size() * bits[format] / 8);
+    ASSERT_TRUE(wf_out.SaveBufferToFile(file_name, samples_out));
+    EXPECT_FALSE(
+        wf_out.SaveBufferToFile("does_not_exist/test.wav", samples_out));
+
+    // 2. Read them back as float
+    WaveFileIn wf_in;
+    vector<float> samples_in = wf_in.ReadFloatBufferFromFile(file_name);
+    CompareWaveHeaders(wf_out, wf_in);
+    EXPECT_EQ(wf_in.sample_format(), formats[format]);
+    ASSERT_EQ(samples_in.size(), samples_out.size());
+    for (size_t idx = 0; idx < samples_in.size(); idx++) {
+      ASSERT_NEAR(samples_in[idx], samples_out[idx], tolerance[format]);
+    }
+
+    // 3. Streaming the samples gives the same samples
+    {
+      WaveFileStreamOut wf_stream(kNumberOfChannelsStereo, formats[format]);
+      ASSERT_TRUE(wf_stream.Open(file_name));
+      ASSERT_TRUE(wf_stream.Append(samples_out.data(), 1001));
+      ASSERT_TRUE(wf_stream.Append(samples_out.data() + 1001,
+                                   samples_out.size() - 1001));
+      EXPECT_EQ(wf_stream.number_of_samples_written(), samples_out.size());
+    }
+    WaveFileIn wf_in_streamed;
+    EXPECT_THAT(wf_in_streamed.ReadFloatBufferFromFile(file_name),
+                ::testing::ContainerEq(samples_in));
+
+    // 4. ... and so does reading them as 16-bit samples
+    vector<int16_t> expected(samples_out.size());
+    ConvertFloatToPcm16(samples_in.data(), samples_in.size(),
+                        expected.data());
+    WaveFileIn wf_in_pcm16;
+    EXPECT_THAT(wf_in_pcm16.ReadBufferFromFile(file_name),
+                ::testing::ContainerEq(expected));
+  }
+}
+TEST(ReadWriteWaveFileTest, HandleFlac) {
+  uint32_t duration = 3;
+  const string file_name("test_flac.flac");
+
+  // A stereo sine wave, with the channels slightly out of phase
+  vector<int16_t> samples_out(kCdSampleRate * kNumberOfChannelsStereo *
+                              duration);
+  for (size_t idx = 0; idx < samples_out.size(); idx++) {
+    samples_out[idx] = static_cast<int16_t>(
+        20000 * sin(0.03 * (idx / 2) + ((idx % 2) ? 0.1 : 0.0)));
+  }
+
+  for (size_t number_of_threads : {size_t(1), size_t(4)}) {
+    // 1. Save the samples to the file
+    WaveFileOut wf_out(duration, kNumberOfChannelsStereo);
+    ASSERT_TRUE(
+        wf_out.SaveBufferToFlacFile(file_name, samples_out, number_of_threads));
+    EXPECT_FALSE(wf_out.SaveBufferToFlacFile("does_not_exist/test.flac",
+                                             samples_out, number_of_threads));
+
+    // 2. Read them back, both as 16-bit samples and as float
+    WaveFileIn wf_in;
+    vector<int16_t> samples_in = wf_in.ReadBufferFromFile(file_name);
+    EXPECT_EQ(wf_out.data_size(), wf_in.data_size());
+    EXPECT_EQ(wf_out.num_channels(), wf_in.num_channels());
+    EXPECT_EQ(wf_out.sample_rate(), wf_in.sample_rate());
+    EXPECT_EQ(wf_out.bits_per_sample(), wf_in.bits_per_sample());
+    EXPECT_THAT(samples_in, ::testing::ContainerEq(samples_out));
+
+    vector<float> expected(samples_out.size());
+    ConvertPcm16ToFloat(samples_out.data(), samples_out.size(),
+                        expected.data());
+    WaveFileIn wf_in_float;
+    EXPECT_THAT(wf_in_float.ReadFloatBufferFromFile(file_name),
+                ::testing::ContainerEq(expected));
+
+    // 3. The file is at most half the size of the WAVE file
+    std::ifstream flac_file(file_name, std::ifstream::binary |
+                                           std::ifstream::ate);
+    EXPECT_LT(static_cast<uint64_t>(flac_file.tellg()),
+              wf_out.data_size() / 2);
+  }
+}
+TEST(ReadWriteWaveFileTest, ReadFrames) {
+  uint32_t duration = 1;
+  const string file_name("test_frames.wav");
+  const string chunks_file_name("test_chunks.wav");
+
+  vector<int16_t> samples_out(kCdSampleRate * kNumberOfChannelsStereo *
+                              duration);
+  for (size_t idx = 0; idx < samples_out.size(); idx++) {
+    samples_out[idx] = static_cast<int16_t>(idx * 7);
+  }
+
+  WaveFileOut wf_out(duration, kNumberOfChannelsStereo);
+  wf_out.SaveBufferToFile(file_name, samples_out);
+
+  // 1. Rebuild the file with chunks that the parser has to skip: an odd
+  //    sized "LIST" chunk (followed by a pad byte) before "fmt " and a
+  //    "fact" chunk after it
+  std::ifstream input_file(file_name, std::ifstream::binary);
+  vector<char> original((std::istreambuf_iterator<char>(input_file)),
+                        std::istreambuf_iterator<char>());
+  vector<char> list_chunk = {'L', 'I', 'S', 'T', 5, 0, 0, 0,
+                             'I', 'N', 'F', 'O', 'x', 0};
+  vector<char> fact_chunk = {'f', 'a', 'c', 't', 4, 0, 0, 0, 1, 2, 3, 4};
+
+  vector<char> rebuilt(original.begin(), original.begin() + 12);
+  rebuilt.insert(rebuilt.end(), list_chunk.begin(), list_chunk.end());
+  rebuilt.insert(rebuilt.end(), original.begin() + 12,
+                 original.begin() + 36);
+  rebuilt.insert(rebuilt.end(), fact_chunk.begin(), fact_chunk.end());
+  rebuilt.insert(rebuilt.end(), original.begin() + 36, original.end());
+  std::ofstream output_file(chunks_file_name, std::ofstream::binary);
+  output_file.write(rebuilt.data(), static_cast<std::streamsize>(
+                                        rebuilt.size()));
+  output_file.close();
+
+  WaveFileIn wf_in;
+  EXPECT_THAT(wf_in.ReadBufferFromFile(chunks_file_name),
+              ::testing::ContainerEq(samples_out));
+  EXPECT_EQ(wf_out.num_channels(), wf_in.num_channels());
+  EXPECT_EQ(wf_out.data_size(), wf_in.data_size());
+  WaveFileMapping mapping = wf_in.MapBufferFromFile(chunks_file_name);
+  EXPECT_THAT(vector<int16_t>(mapping.begin(), mapping.end()),
+              ::testing::ContainerEq(samples_out));
+
+  // 2. Random access to any range of frames
+  ASSERT_TRUE(wf_in.Open(chunks_file_name));
+  EXPECT_EQ(wf_in.data_offset(),
+            kWaveFileCanonicalHeaderSize + list_chunk.size() +
+                fact_chunk.size());
+  EXPECT_EQ(wf_in.number_of_frames(), kCdSampleRate * duration);
+  for (uint64_t first_frame : {0, 1, 1000, 44000}) {
+    vector<int16_t> expected(
+        samples_out.begin() + first_frame * kNumberOfChannelsStereo,
+        samples_out.begin() + (first_frame + 100) * kNumberOfChannelsStereo);
+    EXPECT_THAT(wf_in.ReadFrames(first_frame, 100),
+                ::testing::ContainerEq(expected));
+  }
+
+  // 3. Ranges past the end of the data are cut short
+  vector<int16_t> last_frames = wf_in.ReadFrames(kCdSampleRate - 3, 100);
+  EXPECT_THAT(last_frames,
+              ::testing::ElementsAreArray(samples_out.end() - 6,
+                                          samples_out.end()));
+  EXPECT_TRUE(wf_in.ReadFrames(kCdSampleRate, 1).empty());
+  EXPECT_TRUE(wf_in.Close());
+  EXPECT_FALSE(wf_in.IsOpen());
+
+  // 4. A truncated file (with half a frame at the end) gives the frames
+  //    it still has
+  output_file.open(chunks_file_name, std::ofstream::binary);
+  output_file.write(rebuilt.data(), static_cast<std::streamsize>(
+                                        rebuilt.size() - 4003));
+  output_file.close();
+  WaveFileIn wf_in_truncated;
+  vector<int16_t> samples_in =
+      wf_in_truncated.ReadBufferFromFile(chunks_file_name);
+  EXPECT_EQ(wf_in_truncated.number_of_frames(), kCdSampleRate - 1001);
+  EXPECT_THAT(samples_in,
+              ::testing::ElementsAreArray(samples_out.begin(),
+                                          samples_out.end() - 2002));
+
+  // 5. Files that aren't WAVE files can't be opened
+  EXPECT_FALSE(wf_in.Open("does_not_exist.wav"));
+  output_file.open(chunks_file_name, std::ofstream::binary);
+  output_file.write("RIFX", 4);
+  output_file.close();
+  EXPECT_FALSE(wf_in.Open(chunks_file_name));
+}
+TEST(ReadWriteWaveFileTest, StreamToDescriptor) {
+  uint32_t duration = 2;
+  vector<size_t> block_sizes = {1, 1000, kPcmStreamBufferSize};
+  const string file_name("test_pcm_stream.wav");
+
+  vector<int16_t> samples_out(kCdSampleRate * kNumberOfChannelsStereo *
+                              duration);
+  for (size_t idx = 0; idx < samples_out.size(); idx++) {
+    samples_out[idx] = static_cast<int16_t>(idx * 3);
+  }
+  WaveFileOut wf_out(duration, kNumberOfChannelsStereo);
+
+  for (auto block_size : block_sizes) {
+    // 1. To a regular file - the header is patched at the end
+    {
+      PcmStreamOut stream(PcmStreamFraming::kWave, kNumberOfChannelsStereo);
+      ASSERT_TRUE(stream.Open(file_name));
+      for (size_t idx = 0; idx < samples_out.size(); idx += block_size) {
+        size_t length = min(block_size, samples_out.size() - idx);
+        ASSERT_TRUE(stream.Append(samples_out.data() + idx, length));
+      }
+      EXPECT_EQ(stream.number_of_samples_written(), samples_out.size());
+      ASSERT_TRUE(stream.Close());
+    }
+
+    WaveFileIn wf_in;
+    EXPECT_THAT(wf_in.ReadBufferFromFile(file_name),
+                ::testing::ContainerEq(samples_out));
+    EXPECT_EQ(wf_in.data_size(), wf_out.data_size());
+    EXPECT_EQ(wf_in.num_channels(), wf_out.num_channels());
+    EXPECT_EQ(wf_in.chunk_size() - wf_in.data_size(),
+              kPcmStreamAlignment - 8);
+
+    // 2. To a pipe, both raw and with a WAVE header, while the other end
+    //    is being read
+    for (auto framing : {PcmStreamFraming::kRaw, PcmStreamFraming::kWave}) {
+      int pipe_ends[2];
+      ASSERT_EQ(pipe(pipe_ends), 0);
+
+      vector<uint8_t> received;
+      thread consumer([&received, &pipe_ends] {
+        uint8_t buffer[4096];
+        ssize_t size;
+        while ((size = read(pipe_ends[0], buffer, sizeof(buffer))) > 0) {
+          received.insert(received.end(), buffer, buffer + size);
+        }
+      });
+
+      {
+        PcmStreamOut stream(framing, kNumberOfChannelsStereo);
+        ASSERT_TRUE(stream.Open(pipe_ends[1]));
+        for (size_t idx = 0; idx < samples_out.size(); idx += block_size) {
+          size_t length = min(block_size, samples_out.size() - idx);
+          ASSERT_TRUE(stream.Append(samples_out.data() + idx, length));
+        }
+      }
+      close(pipe_ends[1]);
+      consumer.join();
+      close(pipe_ends[0]);
+
+      // The samples start at a page boundary, after a header with
+      // "unknown" sizes
+      size_t header_size =
+          (framing == PcmStreamFraming::kWave) ? kPcmStreamAlignment : 0;
+      ASSERT_EQ(received.size(),
+                header_size + samples_out.size() * sizeof(int16_t));
+      EXPECT_EQ(memcmp(received.data() + header_size, samples_out.data(),
+                       samples_out.size() * sizeof(int16_t)),
+                0);
+      if (framing == PcmStreamFraming::kRaw) continue;
+
+      uint32_t chunk_size;
+      memcpy(&chunk_size, received.data() + 4, sizeof(chunk_size));
+      EXPECT_EQ(chunk_size, kWaveFileUnknownSize);
+
+      // Such a stream, once captured, reads back as any other file
+      std::ofstream output_file(file_name, std::ofstream::binary);
+      output_file.write(reinterpret_cast<const char *>(received.data()),
+                        static_cast<std::streamsize>(received.size()));
+      output_file.close();
+      WaveFileIn wf_in_captured;
+      EXPECT_THAT(wf_in_captured.ReadBufferFromFile(file_name),
+                  ::testing::ContainerEq(samples_out));
+      EXPECT_EQ(wf_in_captured.data_offset(), kPcmStreamAlignment);
+    }
+  }
+}
 //========================================================================
 // End of file
 //========================================================================
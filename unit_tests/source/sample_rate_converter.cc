@@ -0,0 +1,230 @@
+//========================================================================
+// FILE:
+//    unit_tests/source/sample_rate_converter.cc
+//
+// AUTHOR:
+//    zimzum@github
+//
+// DESCRIPTION:
+//    Tests the SampleRateConverter and ResampledWaveFileIn classes.
+//
+// License: GNU GPL v2.0
+//========================================================================
+
+#include <common/pcm_conversion.h>
+#include <common/sample_rate_converter.h>
+#include <common/synth_config.h>
+#include <common/wave_file.h>
+#include <global/global_variables.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+
+using namespace std;
+
+//========================================================================
+// UTILITIES
+//========================================================================
+//------------------------------------------------------------------------
+//  NAME:
+//      GenerateSine
+//
+//  DESCRIPTION:
+//      Generates number_of_frames frames of a sine wave at the given
+//      frequency. The channels are a quarter of a period apart.
+//------------------------------------------------------------------------
+static vector<float> GenerateSine(double frequency, double sampling_rate,
+                                  size_t number_of_frames,
+                                  uint16_t number_of_channels = 1) {
+  vector<float> samples(number_of_frames * number_of_channels);
+
+  for (size_t idx = 0; idx < samples.size(); idx++) {
+    size_t frame = idx / number_of_channels;
+    size_t channel = idx % number_of_channels;
+    samples[idx] = static_cast<float>(
+        0.5 * sin(kTwoPi * frequency * frame / sampling_rate +
+                  kPi / 2 * channel));
+  }
+
+  return samples;
+}
+
+//------------------------------------------------------------------------
+//  NAME:
+//      Convert
+//
+//  DESCRIPTION:
+//      Converts the whole input in one go, flushing the converter at the
+//      end.
+//------------------------------------------------------------------------
+static vector<float> Convert(SampleRateConverter& converter,
+                             const vector<float>& input) {
+  const uint16_t number_of_channels = converter.number_of_channels();
+  const size_t number_of_frames = input.size() / number_of_channels;
+  vector<float> silence(converter.latency() * number_of_channels, 0.0f);
+  vector<float> output(
+      (converter.max_output_frames(number_of_frames) +
+       converter.max_output_frames(converter.latency())) *
+      number_of_channels);
+
+  size_t count =
+      converter.Process(input.data(), number_of_frames, output.data());
+  count += converter.Process(silence.data(), converter.latency(),
+                             output.data() + count * number_of_channels);
+  output.resize(count * number_of_channels);
+
+  return output;
+}
+
+//========================================================================
+// TESTS
+//========================================================================
+TEST(SampleRateConverterTest, ConvertSine) {
+  const size_t number_of_frames = 20000;
+  const size_t edge = 200;
+
+  // Common ratios, and ones with more phases than the table has
+  vector<pair<uint32_t, uint32_t>> rates = {
+      {44100, 48000}, {48000, 44100}, {44100, 96000}, {96000, 44100},
+      {22050, 44100}, {44100, 44101}, {48000, 44099}};
+
+  for (const auto& rate : rates) {
+    for (double frequency : {100.0, 1000.0, 10000.0}) {
+      // Only the passband of the filter
+      if (frequency > 0.4 * min(rate.first, rate.second)) continue;
+
+      SampleRateConverter converter(rate.first, rate.second);
+      vector<float> output = Convert(
+          converter, GenerateSine(frequency, rate.first, number_of_frames));
+
+      // One output frame for every position within the input
+      size_t expected_frames = static_cast<size_t>(
+          (static_cast<uint64_t>(number_of_frames) * rate.second +
+           rate.first - 1) /
+          rate.first);
+      ASSERT_EQ(output.size(), expected_frames);
+
+      // The same sine wave, at the new rate, without a delay
+      vector<float> expected =
+          GenerateSine(frequency, rate.second, expected_frames);
+      for (size_t idx = edge; idx < expected_frames - edge; idx++) {
+        ASSERT_NEAR(output[idx], expected[idx], 1e-3)
+            << rate.first << " -> " << rate.second << ", " << frequency
+            << "Hz, frame " << idx;
+      }
+    }
+  }
+}
+
+TEST(SampleRateConverterTest, RejectAliases) {
+  const size_t number_of_frames = 20000;
+  const size_t edge = 200;
+
+  // Above the output Nyquist frequency
+  for (double frequency : {23000.0, 30000.0, 45000.0}) {
+    SampleRateConverter converter(96000, kCdSampleRate);
+    vector<float> output =
+        Convert(converter, GenerateSine(frequency, 96000, number_of_frames));
+
+    double sum = 0.0;
+    for (size_t idx = edge; idx < output.size() - edge; idx++) {
+      sum += output[idx] * output[idx];
+    }
+    double rms = sqrt(sum / (output.size() - 2 * edge));
+
+    // Attenuated by more than 60dB
+    EXPECT_LT(rms, 1e-3 * 0.5 / sqrt(2.0)) << frequency << "Hz";
+  }
+}
+
+TEST(SampleRateConverterTest, HandleBlocks) {
+  const size_t number_of_frames = 10000;
+  mt19937 generator(11);
+  uniform_int_distribution<size_t> block_length(0, 3000);
+
+  for (uint32_t output_rate : {48000, 22050, 44101}) {
+    vector<float> input = GenerateSine(
+        440.0, kCdSampleRate, number_of_frames, kNumberOfChannelsStereo);
+
+    // 1. In one go
+    SampleRateConverter converter(kCdSampleRate, output_rate,
+                                  kNumberOfChannelsStereo);
+    vector<float> expected = Convert(converter, input);
+
+    // 2. In blocks of random length - the result is identical
+    converter.Reset();
+    vector<float> output;
+    for (size_t done = 0; done < number_of_frames;) {
+      size_t length = min(block_length(generator), number_of_frames - done);
+      vector<float> block(
+          converter.max_output_frames(length) * kNumberOfChannelsStereo);
+      size_t count = converter.Process(
+          input.data() + done * kNumberOfChannelsStereo, length,
+          block.data());
+      output.insert(output.end(), block.begin(),
+                    block.begin() + count * kNumberOfChannelsStereo);
+      done += length;
+    }
+    vector<float> tail = Convert(converter, vector<float>());
+    output.insert(output.end(), tail.begin(), tail.end());
+
+    EXPECT_THAT(output, ::testing::ContainerEq(expected)) << output_rate;
+  }
+}
+
+TEST(SampleRateConverterTest, ReadResampledWaveFile) {
+  const uint32_t duration = 1;
+  const string file_name("test_resampled.wav");
+  const size_t read_size = 777;
+
+  // 1. A stereo file at the CD sampling rate
+  vector<float> samples_float = GenerateSine(
+      1000.0, kCdSampleRate, kCdSampleRate * duration,
+      kNumberOfChannelsStereo);
+  vector<int16_t> samples_out(samples_float.size());
+  ConvertFloatToPcm16(samples_float.data(), samples_float.size(),
+                      samples_out.data());
+  WaveFileOut wf_out(duration, kNumberOfChannelsStereo);
+  wf_out.SaveBufferToFile(file_name, samples_out);
+
+  // 2. Read at a different sampling rate, in arbitrary chunks - the same
+  //    as converting the whole file in one go
+  WaveFileIn wf_in;
+  ASSERT_TRUE(wf_in.Open(file_name));
+  vector<float> samples_in(wf_in.number_of_frames() *
+                           kNumberOfChannelsStereo);
+  wf_in.ReadFrames(0, static_cast<size_t>(wf_in.number_of_frames()),
+                   samples_in.data());
+  SampleRateConverter converter(kCdSampleRate, 48000,
+                                kNumberOfChannelsStereo);
+  vector<float> expected = Convert(converter, samples_in);
+
+  const SynthConfig synthesiser(48000);
+  ResampledWaveFileIn resampled(wf_in, synthesiser);
+  EXPECT_EQ(resampled.number_of_frames(), 48000 * duration);
+  vector<float> output;
+  vector<float> chunk(read_size * kNumberOfChannelsStereo);
+  while (size_t count = resampled.Read(chunk.data(), read_size)) {
+    output.insert(output.end(), chunk.begin(),
+                  chunk.begin() + count * kNumberOfChannelsStereo);
+  }
+  EXPECT_EQ(resampled.frames_read(), resampled.number_of_frames());
+  EXPECT_THAT(output, ::testing::ContainerEq(expected));
+
+  // 3. At the same sampling rate the file is read as it is
+  const SynthConfig synthesiser_cd(kCdSampleRate);
+  ResampledWaveFileIn not_resampled(wf_in, synthesiser_cd);
+  EXPECT_EQ(not_resampled.number_of_frames(), wf_in.number_of_frames());
+  output.assign(samples_in.size(), 0.0f);
+  EXPECT_EQ(not_resampled.Read(output.data(), kCdSampleRate * duration),
+            kCdSampleRate * duration);
+  EXPECT_THAT(output, ::testing::ContainerEq(samples_in));
+
+  EXPECT_TRUE(wf_in.Close());
+}
+//========================================================================
+// End of file
+//========================================================================
@@ -127,7 +127,7 @@ typedef struct SegConf {
 
 class ConstSegmentTestFixture : public ::testing::Test {
   // Initialise the synthesiser
-  SynthConfig &synthesiser = SynthConfig::getInstance();
+  const SynthConfig synthesiser;
 
  protected:
   // Init the segment
@@ -136,7 +136,6 @@ class ConstSegmentTestFixture : public ::testing::Test {
   static const SegConf default_conf;
 
   virtual void SetUp() {
-    synthesiser.Init();
     segment.SetAmplitude(default_conf.amplitude);
     segment.SetNumberOfSamples(default_conf.number_of_samples);
   }
@@ -146,7 +145,7 @@ SegConf const ConstSegmentTestFixture::default_conf;
 
 class LinearSegmentTestFixture : public ::testing::Test {
   // Initialise the synthesiser
-  SynthConfig &synthesiser = SynthConfig::getInstance();
+  const SynthConfig synthesiser;
 
  protected:
   // Init the segment
@@ -155,7 +154,6 @@ class LinearSegmentTestFixture : public ::testing::Test {
   static const SegConf default_conf;
 
   virtual void SetUp() {
-    synthesiser.Init();
     segment.SetPeakAmplitude(default_conf.amplitude);
     segment.SetNumberOfSamples(default_conf.number_of_samples);
     segment.SetGradient(default_conf.grad);
@@ -166,7 +164,7 @@ SegConf const LinearSegmentTestFixture::default_conf;
 
 class ExponentialSegmentTestFixture : public ::testing::Test {
   // Initialise the synthesiser
-  SynthConfig &synthesiser = SynthConfig::getInstance();
+  const SynthConfig synthesiser;
 
  protected:
   // Init the segment
@@ -175,7 +173,6 @@ class ExponentialSegmentTestFixture : public ::testing::Test {
   static const SegConf default_conf;
 
   virtual void SetUp() {
-    synthesiser.Init();
     segment.SetStartAmplitude(default_conf.amplitude_start);
     segment.SetEndAmplitude(default_conf.amplitude_end);
     segment.SetNumberOfSamples(default_conf.number_of_samples);
@@ -199,8 +196,7 @@ TEST(AllSegmentTypesTest, HandleEmptySegment) {
   float exponent = 100;
 
   // Initialise the synthesiser
-  SynthConfig &synthesiser = SynthConfig::getInstance();
-  synthesiser.Init();
+  const SynthConfig synthesiser(kCdSampleRate);
 
   // Constant segment
   ConstantSegment segment_c(peak_amplitude, number_of_samples);
@@ -217,6 +213,31 @@ TEST(AllSegmentTypesTest, HandleEmptySegment) {
   EXPECT_EQ(segment_e.IsEmpty(), true);
 }
 
+TEST(AllSegmentTypesTest, GenerateOnFirstUse) {
+  size_t number_of_samples = 101;
+
+  LinearSegment segment_l(1.0f, number_of_samples, SegmentGradient::kIncline);
+  ExponentialSegment segment_e(0.0f, 1.0f, 2.0f, number_of_samples);
+
+  // Nothing is generated on construction
+  EXPECT_FALSE(segment_l.IsGenerated());
+  EXPECT_FALSE(segment_e.IsGenerated());
+  EXPECT_FALSE(segment_l.IsEmpty());
+  EXPECT_FALSE(segment_e.IsEmpty());
+
+  // Reconfiguring before first use is free too
+  segment_l.SetNumberOfSamples(2 * number_of_samples);
+  segment_e.SetExponent(3.0f);
+  EXPECT_FALSE(segment_l.IsGenerated());
+  EXPECT_FALSE(segment_e.IsGenerated());
+
+  // The samples are generated on first use
+  EXPECT_EQ(segment_l.GetSamples().size(), 2 * number_of_samples);
+  EXPECT_TRUE(segment_l.IsGenerated());
+  EXPECT_EQ(segment_e[number_of_samples - 1], 1.0f);
+  EXPECT_TRUE(segment_e.IsGenerated());
+}
+
 //------------------------------------------------------------------------
 // ConstantSegment
 //------------------------------------------------------------------------
@@ -290,6 +311,37 @@ TEST_F(LinearSegmentTestFixture, HandleDifferentVolumesDecline) {
   }
 }
 
+TEST_F(LinearSegmentTestFixture, HandleLongSegments) {
+  // 10 minutes at 44.1kHz. Every entry should be the closest float to the
+  // exact value, i.e. there should be no error accumulated along the way.
+  size_t number_of_samples = 10 * 60 * 44100 + 1;
+  double peak_amplitude = default_conf.amplitude;
+
+  for (auto grad : {SegmentGradient::kIncline, SegmentGradient::kDecline}) {
+    segment.SetGradient(grad);
+    segment.SetNumberOfSamples(number_of_samples);
+    segment.GenerateSamples();
+
+    size_t number_of_mismatches = 0;
+    for (size_t idx = 0; idx < number_of_samples; idx++) {
+      double ramp = peak_amplitude * static_cast<double>(idx) /
+                    static_cast<double>(number_of_samples - 1);
+      double expected = (grad == SegmentGradient::kIncline)
+                            ? ramp
+                            : peak_amplitude - ramp;
+      // Allow for one rounding step of float
+      if (fabs(segment[idx] - expected) > fabs(expected) * 1e-7 + 1e-7)
+        number_of_mismatches++;
+    }
+
+    EXPECT_EQ(number_of_mismatches, 0u);
+    ValidateLinearSegment(
+        grad == SegmentGradient::kIncline ? 0.0f : default_conf.amplitude,
+        grad == SegmentGradient::kIncline ? default_conf.amplitude : 0.0f,
+        number_of_samples, segment);
+  }
+}
+
 //------------------------------------------------------------------------
 // ExponentialSegment
 //------------------------------------------------------------------------
@@ -0,0 +1,74 @@
+//========================================================================
+// FILE:
+//    unit_tests/source/synth_config.cc
+//
+// AUTHOR:
+//    zimzum@github
+//
+// DESCRIPTION:
+//    Tests the SynthConfig class and the compile-time pitch tables.
+//
+// License: GNU GPL v2.0
+//========================================================================
+
+#include <common/pitch_tables.h>
+#include <common/synth_config.h>
+#include <global/global_variables.h>
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+using namespace std;
+
+//========================================================================
+// TESTS
+//========================================================================
+// The tables are usable in constant expressions
+static_assert(PitchTable::frequencies[kPitchA4] == 440.0, "A4 is 440Hz");
+static_assert(PitchTable::frequencies[kPitchA4 + 12] == 880.0, "A5 is 880Hz");
+static_assert(PitchTable::PhaseIncrements<44100>::values[0] > 0.0,
+              "The phase increments are generated at compile time");
+
+TEST(SynthConfigTest, FrequencyTable) {
+  const SynthConfig synthesiser(kCdSampleRate);
+
+  for (size_t pitch = 0; pitch < kNumberOfFrequencies; pitch++) {
+    double expected = 440.0 * pow(2.0, (pitch - 57.0) / 12.0);
+    EXPECT_DOUBLE_EQ(synthesiser.frequency_table(pitch), expected) << pitch;
+
+    // No error accumulates over the octaves
+    if (pitch >= 12) {
+      EXPECT_EQ(synthesiser.frequency_table(pitch),
+                2.0 * synthesiser.frequency_table(pitch - 12));
+    }
+  }
+
+  // Middle C
+  EXPECT_NEAR(synthesiser.frequency_table(48), 261.6256, 1e-4);
+}
+
+TEST(SynthConfigTest, PhaseIncrementTable) {
+  // Rates with compile-time tables, and without
+  vector<uint32_t> sampling_rates = {44100, 48000, 88200, 96000, 22050, 192000};
+
+  for (auto sampling_rate : sampling_rates) {
+    const SynthConfig synthesiser(sampling_rate);
+    EXPECT_EQ(synthesiser.sampling_rate(), sampling_rate);
+
+    for (size_t pitch = 0; pitch < kNumberOfFrequencies; pitch++) {
+      double expected = fmod(
+          2.0 * M_PI / sampling_rate * synthesiser.frequency_table(pitch),
+          M_PI);
+      double phase_increment = synthesiser.phase_increment_table(pitch);
+
+      EXPECT_DOUBLE_EQ(phase_increment, expected)
+          << sampling_rate << "Hz, pitch " << pitch;
+      EXPECT_GE(phase_increment, 0.0);
+      EXPECT_LT(phase_increment, M_PI);
+    }
+  }
+}
+//========================================================================
+// End of file
+//========================================================================
@@ -0,0 +1,195 @@
+//========================================================================
+// FILE:
+//    unit_tests/source/voice_manager.cc
+//
+// AUTHOR:
+//    zimzum@github
+//
+// DESCRIPTION:
+//    Tests the VoiceManager class.
+//
+// License: GNU GPL v2.0
+//========================================================================
+
+#include <common/synth_config.h>
+#include <global/global_variables.h>
+#include <voice/voice_manager.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+using namespace std;
+
+//========================================================================
+// UTILITIES
+//========================================================================
+//------------------------------------------------------------------------
+//  NAME:
+//      RenderInBlocks
+//
+//  DESCRIPTION:
+//      Renders number_of_samples samples in blocks of the given size.
+//------------------------------------------------------------------------
+static vector<float> RenderInBlocks(VoiceManager& voices,
+                                    size_t number_of_samples,
+                                    size_t block_size) {
+  vector<float> samples(number_of_samples);
+
+  for (size_t done = 0; done < number_of_samples; done += block_size) {
+    voices.Render(samples.data() + done,
+                  min(block_size, number_of_samples - done));
+  }
+
+  return samples;
+}
+
+//========================================================================
+// TESTS
+//========================================================================
+TEST(VoiceManagerTest, RenderNote) {
+  const SynthConfig synthesiser(kCdSampleRate);
+  const size_t pitch = 57;
+  const size_t number_of_samples = 5000;
+
+  // A plain sine wave, and one with FM
+  for (double index_of_modulation : {0.0, 3.0}) {
+    VoiceParameters parameters;
+    parameters.amplitude = 0.5f;
+    parameters.attack_duration = 0.0;
+    parameters.decay_duration = 0.0;
+    parameters.sustain_level = 1.0f;
+    parameters.modulator_ratio = 2.0;
+    parameters.index_of_modulation = index_of_modulation;
+
+    VoiceManager voices(synthesiser, parameters);
+    voices.NoteOn(pitch, 0.5f);
+    vector<float> samples = RenderInBlocks(voices, number_of_samples, 100);
+
+    double phase_increment = synthesiser.phase_increment_table(pitch);
+    for (size_t idx = 0; idx < number_of_samples; idx++) {
+      double phase = phase_increment * idx;
+      double expected =
+          0.25 * sin(phase + index_of_modulation * sin(2.0 * phase));
+      ASSERT_NEAR(samples[idx], expected, 1e-4) << idx;
+    }
+  }
+}
+
+TEST(VoiceManagerTest, ApplyEnvelope) {
+  // 1 sample per millisecond. A square wave at full amplitude, so the
+  // magnitude of every sample is the level of the envelope.
+  const SynthConfig synthesiser(1000);
+  VoiceParameters parameters;
+  parameters.waveform = Waveform::kSquare;
+  parameters.amplitude = 1.0f;
+  parameters.attack_duration = 0.1;
+  parameters.decay_duration = 0.05;
+  parameters.sustain_level = 0.5f;
+  parameters.release_duration = 0.2;
+
+  VoiceManager voices(synthesiser, parameters);
+  voices.NoteOn(30);
+
+  // 1. Attack, decay and sustain, in blocks of a different length
+  vector<float> samples = RenderInBlocks(voices, 300, 64);
+  for (size_t idx = 0; idx < 100; idx++) {
+    ASSERT_NEAR(fabs(samples[idx]), idx / 100.0, 1e-5) << idx;
+  }
+  for (size_t idx = 100; idx < 150; idx++) {
+    ASSERT_NEAR(fabs(samples[idx]), 1.0 - (idx - 100) / 100.0, 1e-5) << idx;
+  }
+  for (size_t idx = 150; idx < 300; idx++) {
+    ASSERT_NEAR(fabs(samples[idx]), 0.5, 1e-5) << idx;
+  }
+
+  // 2. Release, after which the voice is idle again
+  voices.NoteOff(30);
+  EXPECT_EQ(voices.number_of_active_voices(), 1);
+  samples = RenderInBlocks(voices, 300, 64);
+  for (size_t idx = 0; idx < 200; idx++) {
+    ASSERT_NEAR(fabs(samples[idx]), 0.5 - idx / 400.0, 1e-5) << idx;
+  }
+  for (size_t idx = 200; idx < 300; idx++) {
+    ASSERT_EQ(samples[idx], 0.0f) << idx;
+  }
+  EXPECT_EQ(voices.number_of_active_voices(), 0);
+}
+
+TEST(VoiceManagerTest, HandleBlocks) {
+  const SynthConfig synthesiser(kCdSampleRate);
+  VoiceParameters parameters;
+  parameters.waveform = Waveform::kTriangle;
+  parameters.index_of_modulation = 1.0;
+
+  // The same notes, rendered in blocks of different length
+  vector<vector<float>> outputs;
+  for (size_t block_size : {4096, 256, 33}) {
+    VoiceManager voices(synthesiser, parameters, 4);
+    vector<float> output;
+    for (size_t pitch : {40, 44, 47, 52, 56}) {
+      voices.NoteOn(pitch, 0.8f);
+      vector<float> samples = RenderInBlocks(voices, 4096, block_size);
+      output.insert(output.end(), samples.begin(), samples.end());
+      voices.NoteOff(pitch - 12);
+    }
+    voices.AllNotesOff();
+    vector<float> samples = RenderInBlocks(voices, 20000, block_size);
+    output.insert(output.end(), samples.begin(), samples.end());
+
+    EXPECT_EQ(voices.number_of_active_voices(), 0);
+    outputs.push_back(output);
+  }
+
+  EXPECT_THAT(outputs[1], ::testing::ContainerEq(outputs[0]));
+  EXPECT_THAT(outputs[2], ::testing::ContainerEq(outputs[0]));
+}
+
+TEST(VoiceManagerTest, StealVoices) {
+  // A square wave starts at -1, so the first sample after the notes
+  // start is minus the sum of the gains of the voices that are playing
+  const SynthConfig synthesiser(kCdSampleRate);
+  VoiceParameters parameters;
+  parameters.waveform = Waveform::kSquare;
+  parameters.amplitude = 1.0f;
+  parameters.attack_duration = 0.0;
+  parameters.decay_duration = 0.0;
+  parameters.sustain_level = 1.0f;
+  parameters.release_duration = 1.0;
+  float sample;
+
+  // 1. The voice that was released gets stolen first
+  VoiceManager voices(synthesiser, parameters, 2);
+  voices.NoteOn(10, 0.125f);
+  voices.NoteOn(20, 0.25f);
+  voices.NoteOff(10);
+  voices.NoteOn(30, 0.5f);
+  voices.Render(&sample, 1);
+  EXPECT_FLOAT_EQ(sample, -0.75f);
+  EXPECT_EQ(voices.number_of_stolen_voices(), 1);
+  EXPECT_EQ(voices.number_of_active_voices(), 2);
+
+  // 2. Otherwise the oldest note gets stolen
+  VoiceManager held_voices(synthesiser, parameters, 2);
+  held_voices.NoteOn(10, 0.125f);
+  held_voices.NoteOn(20, 0.25f);
+  held_voices.NoteOn(30, 0.5f);
+  held_voices.NoteOff(10);
+  held_voices.Render(&sample, 1);
+  EXPECT_FLOAT_EQ(sample, -0.75f);
+  EXPECT_EQ(held_voices.number_of_stolen_voices(), 1);
+
+  // 3. Playing a held pitch again releases the old note, but takes a
+  //    new voice
+  VoiceManager same_pitch(synthesiser, parameters, 2);
+  same_pitch.NoteOn(10, 0.125f);
+  same_pitch.NoteOn(10, 0.25f);
+  same_pitch.Render(&sample, 1);
+  EXPECT_FLOAT_EQ(sample, -0.375f);
+  EXPECT_EQ(same_pitch.number_of_active_voices(), 2);
+  EXPECT_EQ(same_pitch.number_of_stolen_voices(), 0);
+}
+//========================================================================
+// End of file
+//========================================================================